@@ -11,4 +11,5 @@ else
 LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
 endif
 
+LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/mmi_bl_core.ko
 include $(DLKM_DIR)/AndroidKernelModule.mk
@@ -336,7 +336,7 @@ static int aw99703_backlight_enable(struct aw99703_data *drvdata)
 
 int  aw99703_set_brightness(struct aw99703_data *drvdata, int brt_val)
 {
-	pr_info("%s brt_val is %d\n", __func__, brt_val);
+	bool was_enabled = drvdata->enable;
 
 	if (drvdata->enable == false) {
 		if(brt_val == 0)
@@ -349,13 +349,13 @@ int  aw99703_set_brightness(struct aw99703_data *drvdata, int brt_val)
 	if (0 == drvdata->map_type) {
 		if(ALIGN_BL_MAPPING_450 == drvdata->led_current_align) {
 			brt_val = align_convert_450nit[brt_val];
-			pr_info("%s align 450nit convert brt_val is %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s align 450nit convert brt_val is %d\n", __func__, brt_val);
 		} else if(ALIGN_BL_MAPPING_1000 == drvdata->led_current_align) {
 			brt_val = align_convert_1000nit[brt_val];
-			pr_info("%s align 1000nit convert brt_val is %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s align 1000nit convert brt_val is %d\n", __func__, brt_val);
 		} else if(ALIGN_BL_MAPPING_GAMMA15 == drvdata->led_current_align) {
 			brt_val = align_convert_gamma15[brt_val];
-			pr_info("%s align gamma15 convert brt_val is %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s align gamma15 convert brt_val is %d\n", __func__, brt_val);
 		}
 	}
 
@@ -369,11 +369,12 @@ int  aw99703_set_brightness(struct aw99703_data *drvdata, int brt_val)
 				AW99703_REG_LEDMSB,
 				(brt_val >> 3)&0xff);
 
-		/* backlight enable */
-		aw99703_i2c_write_bit(drvdata->client,
-					AW99703_REG_MODE,
-					AW99703_MODE_WORKMODE_MASK,
-					AW99703_MODE_WORKMODE_BACKLIGHT);
+		/* backlight enable, still set if it was enabled */
+		if (!was_enabled)
+			aw99703_i2c_write_bit(drvdata->client,
+						AW99703_REG_MODE,
+						AW99703_MODE_WORKMODE_MASK,
+						AW99703_MODE_WORKMODE_BACKLIGHT);
 		drvdata->enable = true;
 	} else {
 		/* standby mode*/
@@ -408,8 +409,13 @@ static int aw99703_bl_update_status(struct backlight_device *bl_dev)
 		/*
 		 * Brightness register should always be written
 		 * not only register based mode but also in PWM mode.
+		 * Turning off is done by the time suspend returns.
 		 */
-		return aw99703_set_brightness(drvdata, brt);
+		if (!brt)
+				return mmi_bl_core_set(&drvdata->bl_core, 0);
+
+		mmi_bl_core_queue(&drvdata->bl_core, brt);
+		return 0;
 }
 
 static const struct backlight_ops aw99703_bl_ops = {
@@ -448,20 +454,10 @@ static int aw99703_read_chipid(struct aw99703_data *drvdata)
 }
 
 
-static void __aw99703_work(struct aw99703_data *led,
-				enum led_brightness value)
+/* Called by mmi_bl_core with the latest level that differs from the chip */
+static int aw99703_bl_core_update(void *data, int level)
 {
-	mutex_lock(&led->lock);
-	aw99703_set_brightness(led, value);
-	mutex_unlock(&led->lock);
-}
-
-static void aw99703_work(struct work_struct *work)
-{
-	struct aw99703_data *drvdata = container_of(work,
-					struct aw99703_data, work);
-
-	__aw99703_work(drvdata, drvdata->led_dev.brightness);
+	return aw99703_set_brightness(data, level);
 }
 
 
@@ -471,7 +467,7 @@ static void aw99703_brightness_set(struct led_classdev *led_cdev,
 	struct aw99703_data *drvdata;
 
 	drvdata = container_of(led_cdev, struct aw99703_data, led_dev);
-	schedule_work(&drvdata->work);
+	mmi_bl_core_queue(&drvdata->bl_core, brt_val);
 }
 
 static int aw99703_parse_dt(struct aw99703_data *drvdata)
@@ -743,8 +739,6 @@ static int aw99703_probe(struct i2c_client *client,
 	drvdata->led_dev.name = AW99703_LED_DEV;
 	drvdata->led_dev.brightness_set = aw99703_brightness_set;
 	drvdata->led_dev.max_brightness = MAX_BRIGHTNESS;
-	mutex_init(&drvdata->lock);
-	INIT_WORK(&drvdata->work, aw99703_work);
 	aw99703_get_dt_data(&client->dev, drvdata);
 	i2c_set_clientdata(client, drvdata);
 	aw99703_gpio_init(drvdata);
@@ -755,9 +749,12 @@ static int aw99703_probe(struct i2c_client *client,
 		goto err_init;
 	}
 
+	mmi_bl_core_init(&drvdata->bl_core, AW99703_NAME,
+			 aw99703_bl_core_update, drvdata);
 	err = led_classdev_register(&client->dev, &drvdata->led_dev);
 	if (err < 0) {
 		pr_err("%s : Register led class failed\n", __func__);
+		mmi_bl_core_exit(&drvdata->bl_core);
 		err = -ENODEV;
 		goto err_init;
 	} else {
@@ -777,7 +774,7 @@ static int aw99703_probe(struct i2c_client *client,
 	aw99703_backlight_init(drvdata);
 	aw99703_backlight_enable(drvdata);
 
-	aw99703_set_brightness(drvdata, drvdata->default_brightness);
+	mmi_bl_core_set(&drvdata->bl_core, drvdata->default_brightness);
 	err = sysfs_create_group(&client->dev.kobj, &aw99703_attribute_group);
 	if (err < 0) {
 		dev_info(&client->dev, "%s error creating sysfs attr files\n",
@@ -788,6 +785,8 @@ static int aw99703_probe(struct i2c_client *client,
 	return 0;
 
 err_sysfs:
+	led_classdev_unregister(&drvdata->led_dev);
+	mmi_bl_core_exit(&drvdata->bl_core);
 err_init:
 	gpio_free(drvdata->hwen_gpio);
 	kfree(drvdata);
@@ -800,6 +799,7 @@ static int aw99703_remove(struct i2c_client *client)
 	struct aw99703_data *drvdata = i2c_get_clientdata(client);
 
 	led_classdev_unregister(&drvdata->led_dev);
+	mmi_bl_core_exit(&drvdata->bl_core);
 
 	kfree(drvdata);
 	return 0;
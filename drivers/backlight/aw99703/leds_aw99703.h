@@ -1,6 +1,8 @@
 #ifndef _AW99703_REG_H_
 #define _AW99703_REG_H_
 
+#include <linux/mmi_bl_core.h>
+
 /*********************************************************
  *
  * kernel version
@@ -227,8 +229,7 @@ struct aw99703_data {
 	struct device dev;
 	struct i2c_adapter *adapter;
 	unsigned short addr;
-	struct mutex lock;
-	struct work_struct work;
+	struct mmi_bl_core bl_core;
 	enum led_brightness brightness;
 	bool enable;
 	unsigned char pwm_cfg;
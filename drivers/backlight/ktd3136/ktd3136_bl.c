@@ -161,7 +161,6 @@ static int ktd3136_masked_write(struct i2c_client *client, int reg, u8 mask, u8
 		}
 	}
 
-	ktd3136_read_reg(client, reg, &temp);
 	return rc;
 }
 
@@ -288,6 +287,7 @@ static int ktd3136_backlight_init(struct ktd3136_data *drvdata)
 
 	pr_info("%s enter.\n", __func__);
 
+	drvdata->bl_mode = -1;
 	ktd3136_write_reg(drvdata->client, REG_CONTROL, drvdata->reg_ctrl_val);
 	ktd3136_bl_enable_channel(drvdata);
 		if (drvdata->pwm_mode) {
@@ -321,8 +321,6 @@ static int ktd3136_backlight_enable(struct ktd3136_data *drvdata)
 
 int ktd3136_set_brightness(struct ktd3136_data *drvdata, int brt_val)
 {
-	pr_info("%s brt_val is %d\n", __func__, brt_val);
-
 	if (drvdata->enable == false) {
 		if (brt_val == 0) {
 			//avoid duplicate standby
@@ -338,21 +336,24 @@ int ktd3136_set_brightness(struct ktd3136_data *drvdata, int brt_val)
 	if(0 == drvdata->map_type) {
 		if(ALIGN_BL_MAPPING_450 == drvdata->led_current_align) {
 			brt_val = bl_mapping_450[brt_val];
-			pr_info("%s bl_mapping 450nit brt_val: %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s bl_mapping 450nit brt_val: %d\n", __func__, brt_val);
 		} else if(ALIGN_BL_MAPPING_1000 == drvdata->led_current_align) {
 			brt_val = bl_mapping_1000[brt_val];
-			pr_info("%s bl_mapping 1000nit brt_val: %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s bl_mapping 1000nit brt_val: %d\n", __func__, brt_val);
 		}else if(ALIGN_BL_MAPPING_GAMMA15 == drvdata->led_current_align){
 			brt_val = bl_mapping_gamma15[brt_val];
-			pr_info("%s bl_mapping gamma15 brt_val: %d\n", __func__, brt_val);
+			pr_info_ratelimited("%s bl_mapping gamma15 brt_val: %d\n", __func__, brt_val);
 		} else if (drvdata->led_current_align)
-			pr_info("%s: unsupport align type: %d\n", __func__, drvdata->led_current_align);
+			pr_info_ratelimited("%s: unsupport align type: %d\n", __func__, drvdata->led_current_align);
 	}
 
-	if (brt_val>0) {
-		ktd3136_masked_write(drvdata->client, REG_MODE, 0x01, 0x01); //enalbe bl mode
-	} else {
-		ktd3136_masked_write(drvdata->client, REG_MODE, 0x01, 0x00); //disable bl mode
+	if (drvdata->bl_mode != (brt_val > 0)) {
+		if (brt_val>0) {
+			ktd3136_masked_write(drvdata->client, REG_MODE, 0x01, 0x01); //enalbe bl mode
+		} else {
+			ktd3136_masked_write(drvdata->client, REG_MODE, 0x01, 0x00); //disable bl mode
+		}
+		drvdata->bl_mode = brt_val > 0;
 	}
 	if (drvdata->using_lsb) {
 		ktd3136_masked_write(drvdata->client, REG_RATIO_LSB, 0x07, brt_val);
@@ -391,8 +392,13 @@ static int ktd3136_bl_update_status(struct backlight_device *bl_dev)
 		/*
 		 * Brightness register should always be written
 		 * not only register based mode but also in PWM mode.
+		 * Turning off is done by the time suspend returns.
 		 */
-		return ktd3136_set_brightness(drvdata, brt);
+		if (!brt)
+				return mmi_bl_core_set(&drvdata->bl_core, 0);
+
+		mmi_bl_core_queue(&drvdata->bl_core, brt);
+		return 0;
 }
 
 static const struct backlight_ops ktd3136_bl_ops = {
@@ -457,30 +463,20 @@ static int fb_notifier_callback(struct notifier_block *self,
 	 */
 	if (evdata && evdata->data && (event == FB_EARLY_EVENT_BLANK)) {
 		blank = evdata->data;
-		if (*blank == FB_BLANK_POWERDOWN)
+		if (*blank == FB_BLANK_POWERDOWN) {
 			drvdata->enable = false;
+			mmi_bl_core_invalidate(&drvdata->bl_core);
+		}
 	}
 
 	return NOTIFY_OK;
 }
 #endif
 
-static void __ktd3136_work(struct ktd3136_data *led,
-				enum led_brightness value)
+/* Called by mmi_bl_core with the latest level that differs from the chip */
+static int ktd3136_bl_core_update(void *data, int level)
 {
-	mutex_lock(&led->lock);
-	ktd3136_set_brightness(led, value);
-	mutex_unlock(&led->lock);
-}
-
-static void ktd3136_work(struct work_struct *work)
-{
-	struct ktd3136_data *drvdata = container_of(work,
-					struct ktd3136_data, work);
-
-	__ktd3136_work(drvdata, drvdata->led_dev.brightness);
-
-	return;
+	return ktd3136_set_brightness(data, level);
 }
 
 
@@ -491,7 +487,7 @@ static void ktd3136_brightness_set(struct led_classdev *led_cdev,
 
 	drvdata = container_of(led_cdev, struct ktd3136_data, led_dev);
 
-	schedule_work(&drvdata->work);
+	mmi_bl_core_queue(&drvdata->bl_core, brt_val);
 }
 
 static void ktd3136_get_dt_data(struct device *dev, struct ktd3136_data *drvdata)
@@ -772,11 +768,13 @@ static int ktd3136_probe(struct i2c_client *client,
 		goto err_init;
 	}
 
-	mutex_init(&drvdata->lock);
-	INIT_WORK(&drvdata->work, ktd3136_work);
+	drvdata->bl_mode = -1;
+	mmi_bl_core_init(&drvdata->bl_core, KTD3136_NAME,
+			 ktd3136_bl_core_update, drvdata);
 	err = led_classdev_register(&client->dev, &drvdata->led_dev);
 	if (err < 0) {
 		pr_err("%s : Register led class failed\n", __func__);
+		mmi_bl_core_exit(&drvdata->bl_core);
 		err = -ENODEV;
 		goto err_init;
 	} else {
@@ -825,6 +823,7 @@ static int ktd3136_remove(struct i2c_client *client)
 	struct ktd3136_data *drvdata = i2c_get_clientdata(client);
 
 	led_classdev_unregister(&drvdata->led_dev);
+	mmi_bl_core_exit(&drvdata->bl_core);
 
 	kfree(drvdata);
 	return 0;
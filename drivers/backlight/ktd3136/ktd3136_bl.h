@@ -1,6 +1,7 @@
 #ifndef _KTD3136_REG_H_
 #define _KTD3136_REG_H_
 
+#include <linux/mmi_bl_core.h>
 #include <linux/version.h>
 
 /*********************************************************
@@ -113,13 +114,13 @@ struct ktd3136_data {
 	struct i2c_client *client;
 	struct i2c_adapter *adapter;
 	unsigned short addr;
-	struct mutex		lock;
-	struct work_struct	work;
+	struct mmi_bl_core	bl_core;
 	enum led_brightness brightness;
 #ifdef CONFIG_FB
 	struct notifier_block fb_notif;
 #endif
 	bool enable;
+	int bl_mode;	/* REG_MODE bit 0, -1 if unknown */
 	u8 pwm_cfg;
 	u8 boost_ctl;
 	u8 full_scale_current;
@@ -15,6 +15,7 @@
 
 #include <linux/backlight.h>
 #include <linux/device.h>
+#include <linux/mmi_bl_core.h>
 #include <linux/notifier.h>
 #include "ti_lm3697_regulator.h"
 #include "ti-lmu.h"
@@ -212,6 +213,10 @@ struct ti_lmu_bl {
 	unsigned int led_current_align;
 
 	struct pwm_device *pwm;
+
+	/* Enable register state, -1 if unknown */
+	int enabled;
+	struct mmi_bl_core bl_core;
 };
 
 enum backlight_hbm_mode {
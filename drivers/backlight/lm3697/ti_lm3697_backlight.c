@@ -201,19 +201,20 @@ static int ti_lmu_backlight_enable(struct ti_lmu_bl *lmu_bl, int enable)
 {
 	struct ti_lmu_bl_chip *chip = lmu_bl->chip;
 	struct regmap *regmap = chip->lmu->regmap;
-	unsigned long enable_time = chip->cfg->reginfo->enable_usec;
 	u8 *reg = chip->cfg->reginfo->enable;
+	int ret;
 
 	if (!reg)
 		return -EINVAL;
 
-	if (enable)
-		return regmap_write(regmap, *reg, 0x02);
-	else
-		return regmap_write(regmap, *reg, 0x00);
+	if (lmu_bl->enabled == enable)
+		return 0;
+
+	ret = regmap_write(regmap, *reg, enable ? 0x02 : 0x00);
+	if (!ret)
+		lmu_bl->enabled = enable;
 
-	if (enable_time > 0)
-		usleep_range(enable_time, enable_time + 100);
+	return ret;
 }
 
 static void ti_lmu_backlight_pwm_ctrl(struct ti_lmu_bl *lmu_bl, int brightness,
@@ -254,8 +255,6 @@ static int ti_lmu_backlight_update_brightness_register(struct ti_lmu_bl *lmu_bl,
 	int ret;
 	// int i = 0;
 
-	regmap_write(regmap, 0x13, 0x11);
-
 	if (lmu_bl->mode == BL_PWM_BASED) {
 		switch (cfg->pwm_action) {
 		case UPDATE_PWM_ONLY:
@@ -297,7 +296,7 @@ static int ti_lmu_backlight_update_brightness_register(struct ti_lmu_bl *lmu_bl,
 
 		if(lmu_bl->map_type == EXPONENTIAL_TYPE && lmu_bl->led_current_align) {
 			if(brightness) {
-				pr_info("[bkl] %s brightness = %d, align = %d\n", __func__,
+				pr_debug("[bkl] %s brightness = %d, align = %d\n", __func__,
 					brightness, lmu_bl->led_current_align);
 				brightness = brightness*8383/10000+324;
 			}
@@ -309,40 +308,39 @@ static int ti_lmu_backlight_update_brightness_register(struct ti_lmu_bl *lmu_bl,
 					 brightness);
 		if (ret)
 			return ret;
-		pr_info("[bkl][after]11bit %s brightness = %d\n", __func__, brightness);
+		pr_debug("[bkl][after]11bit %s brightness = %d\n", __func__, brightness);
 		val = (brightness >> LMU_BACKLIGHT_11BIT_MSB_SHIFT) & 0xFF;
 	} else {
 		val = brightness & 0xFF;
-		pr_err("[bkl]8bit %s val = %d\n", __func__, val);
+		pr_debug("[bkl]8bit %s val = %d\n", __func__, val);
 	}
 
 	reg = reginfo->brightness_msb[lmu_bl->bank_id];
     ret = regmap_write(regmap, reg, val);
 	return ret;
 }
-static int ti_lmu_backlight_set_brightness(int brightness)
+/* Called by mmi_bl_core with the latest level that differs from the chip */
+static int ti_lmu_backlight_update(void *data, int brightness)
 {
-	struct ti_lmu_bl *lmu_bl = bl_chip->lmu_bl;
+	struct ti_lmu_bl *lmu_bl = data;
 	int ret;
 
-	if (brightness > 0)
-		ret = ti_lmu_backlight_enable(lmu_bl, 1);
-	else
-		ret = ti_lmu_backlight_enable(lmu_bl, 0);
-
+	ret = ti_lmu_backlight_enable(lmu_bl, brightness > 0);
 	if (ret) {
 		pr_err("[bkl] %s enable failed ret %d \n", __func__, ret);
 		return ret;
 	}
 
+	if (lmu_bl->mode == BL_PWM_BASED)
+		ti_lmu_backlight_pwm_ctrl(lmu_bl, brightness,
+					  lmu_bl->bl_dev->props.max_brightness);
+
 	return ti_lmu_backlight_update_brightness_register(lmu_bl, brightness);
 }
 
 int lm3697_set_brightness(int brightness)
 {
-	printk(KERN_INFO "[bkl][before]%s brightness = %d\n", __func__, brightness);
-
-	return ti_lmu_backlight_set_brightness(brightness);
+	return mmi_bl_core_set(&bl_chip->lmu_bl->bl_core, brightness);
 }
 
 static int ti_lmu_backlight_get_brightness(struct backlight_device *bl_dev)
@@ -354,24 +352,16 @@ static int ti_lmu_backlight_update_status(struct backlight_device *bl_dev)
 {
 	struct ti_lmu_bl *lmu_bl = bl_get_data(bl_dev);
 	int brightness = bl_dev->props.brightness;
-	int ret;
 
 	if (bl_dev->props.state & (BL_CORE_SUSPENDED | BL_CORE_FBBLANK))
 		brightness = 0;
 
-	if (brightness > 0)
-		ret = ti_lmu_backlight_enable(lmu_bl, 1);
-	else
-		ret = ti_lmu_backlight_enable(lmu_bl, 0);
-
-	if (ret)
-		return ret;
-
-	if (lmu_bl->mode == BL_PWM_BASED)
-		ti_lmu_backlight_pwm_ctrl(lmu_bl, brightness,
-					  bl_dev->props.max_brightness);
+	/* Turning off must be done by the time suspend or blank returns */
+	if (!brightness)
+		return mmi_bl_core_set(&lmu_bl->bl_core, 0);
 
-	return ti_lmu_backlight_update_brightness_register(lmu_bl, brightness);
+	mmi_bl_core_queue(&lmu_bl->bl_core, brightness);
+	return 0;
 }
 
 static const struct backlight_ops lmu_backlight_ops = {
@@ -624,6 +614,7 @@ static int ti_lmu_backlight_init(struct ti_lmu_bl_chip *chip)
 	struct regmap *regmap = chip->lmu->regmap;
 	unsigned char boost_ctl;
 	unsigned char brightness_cfg;
+	int i;
 	pr_err("[bkl] %s enter\n", __func__);
 	/*
 	 * 'init' register data consists of address, mask, value.
@@ -645,6 +636,13 @@ static int ti_lmu_backlight_init(struct ti_lmu_bl_chip *chip)
 	//regmap_write(regmap, 0x23, 0xFF);
 	regmap_write(regmap, 0x24, 0x02);
 	regmap_write(regmap, 0xB4, 0x03);
+	regmap_write(regmap, LM3697_REG_RUNTIME_RAMP, 0x11);
+
+	/* Registers were rewritten, the next level must reach the chip */
+	for (i = 0; i < chip->num_backlights; i++) {
+		chip->lmu_bl[i].enabled = -1;
+		mmi_bl_core_invalidate(&chip->lmu_bl[i].bl_core);
+	}
 
 
 	pr_err("[bkl] %s finish\n", __func__);
@@ -682,10 +680,15 @@ static int ti_lmu_backlight_add_device(struct device *dev,
 	props.brightness = lmu_bl->default_brightness;
 	props.max_brightness = lmu_bl->chip->cfg->max_brightness;
 
+	lmu_bl->enabled = -1;
+	mmi_bl_core_init(&lmu_bl->bl_core, lmu_bl->name,
+			 ti_lmu_backlight_update, lmu_bl);
 	bl_dev = backlight_device_register(LM3697_NAME, dev, lmu_bl,
 					   &lmu_backlight_ops, &props);
-	if (IS_ERR(bl_dev))
+	if (IS_ERR(bl_dev)) {
+		mmi_bl_core_exit(&lmu_bl->bl_core);
 		return PTR_ERR(bl_dev);
+	}
 
 	lmu_bl->bl_dev = bl_dev;
 
@@ -850,6 +853,13 @@ ti_lmu_backlight_register(struct device *dev, struct ti_lmu *lmu,
 	return chip;
 
 err_init:
+	for (i = 0; chip->lmu_bl && i < chip->num_backlights; i++) {
+		each = chip->lmu_bl + i;
+		if (!each->bl_dev)
+			continue;
+		backlight_device_unregister(each->bl_dev);
+		mmi_bl_core_exit(&each->bl_core);
+	}
 	if(chip->lmu_bl)
 		devm_kfree(dev, chip->lmu_bl);
 	if(chip)
@@ -873,6 +883,7 @@ static void ti_lmu_backlight_unregister(struct ti_lmu_bl_chip *chip)
 		each->bl_dev->props.brightness = 0;
 		backlight_update_status(each->bl_dev);
 		backlight_device_unregister(each->bl_dev);
+		mmi_bl_core_exit(&each->bl_core);
 	}
 	device_remove_file(chip->dev, &dev_attr_i2c_reg_dump);
 }
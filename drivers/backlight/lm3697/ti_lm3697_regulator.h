@@ -26,6 +26,7 @@
 
 #define LM3697_REG_BL0_RAMP			0x11
 #define LM3697_REG_BL1_RAMP			0x12
+#define LM3697_REG_RUNTIME_RAMP			0x13
 #define LM3697_RAMPUP_MASK			0xF0
 #define LM3697_RAMPUP_SHIFT			4
 #define LM3697_RAMPDN_MASK			0x0F
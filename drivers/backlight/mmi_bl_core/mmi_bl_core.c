@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#define pr_fmt(fmt) "mmi_bl_core: " fmt
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/mmi_bl_core.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+
+static struct dentry *bl_core_dir;
+
+static void mmi_bl_core_stats_reset(struct mmi_bl_core *core)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&core->req_lock, flags);
+	core->requests = 0;
+	core->coalesced = 0;
+	spin_unlock_irqrestore(&core->req_lock, flags);
+	core->skipped = 0;
+	core->updates = 0;
+	core->errors = 0;
+	core->stats_start = ktime_get();
+}
+
+/* Must be called with core->lock held */
+static int mmi_bl_core_apply(struct mmi_bl_core *core)
+{
+	unsigned long flags;
+	int level, ret;
+
+	spin_lock_irqsave(&core->req_lock, flags);
+	if (!core->pending) {
+		spin_unlock_irqrestore(&core->req_lock, flags);
+		return 0;
+	}
+	level = core->requested;
+	core->pending = false;
+	spin_unlock_irqrestore(&core->req_lock, flags);
+
+	if (level == READ_ONCE(core->applied)) {
+		core->skipped++;
+		return 0;
+	}
+
+	ret = core->update(core->data, level);
+	if (ret < 0) {
+		core->errors++;
+		WRITE_ONCE(core->applied, -1);
+		pr_err_ratelimited("%s: level %d failed, ret %d\n",
+				   core->name, level, ret);
+		return ret;
+	}
+
+	if (__ratelimit(&core->rs))
+		pr_info("%s: level %d -> %d\n", core->name,
+			core->applied, level);
+	WRITE_ONCE(core->applied, level);
+	core->updates++;
+
+	return 0;
+}
+
+static void mmi_bl_core_work(struct work_struct *work)
+{
+	struct mmi_bl_core *core = container_of(work, struct mmi_bl_core, work);
+
+	mutex_lock(&core->lock);
+	mmi_bl_core_apply(core);
+	mutex_unlock(&core->lock);
+}
+
+static void mmi_bl_core_request(struct mmi_bl_core *core, int level)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&core->req_lock, flags);
+	core->requests++;
+	if (core->pending)
+		core->coalesced++;
+	core->requested = level;
+	core->pending = true;
+	spin_unlock_irqrestore(&core->req_lock, flags);
+}
+
+void mmi_bl_core_queue(struct mmi_bl_core *core, int level)
+{
+	mmi_bl_core_request(core, level);
+	schedule_work(&core->work);
+}
+EXPORT_SYMBOL(mmi_bl_core_queue);
+
+int mmi_bl_core_set(struct mmi_bl_core *core, int level)
+{
+	int ret;
+
+	mmi_bl_core_request(core, level);
+	mutex_lock(&core->lock);
+	ret = mmi_bl_core_apply(core);
+	mutex_unlock(&core->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL(mmi_bl_core_set);
+
+void mmi_bl_core_invalidate(struct mmi_bl_core *core)
+{
+	WRITE_ONCE(core->applied, -1);
+}
+EXPORT_SYMBOL(mmi_bl_core_invalidate);
+
+static int mmi_bl_core_stats_show(struct seq_file *s, void *unused)
+{
+	struct mmi_bl_core *core = s->private;
+	u64 elapsed_ms;
+
+	mutex_lock(&core->lock);
+	elapsed_ms = ktime_ms_delta(ktime_get(), core->stats_start);
+	seq_printf(s, "level: %d\n", core->applied);
+	seq_printf(s, "requests: %llu coalesced: %llu skipped: %llu\n",
+		   core->requests, core->coalesced, core->skipped);
+	seq_printf(s, "updates: %llu errors: %llu\n",
+		   core->updates, core->errors);
+	seq_printf(s, "updates per sec: %llu over %llu ms\n",
+		   elapsed_ms ? div64_u64(core->updates * 1000, elapsed_ms) : 0,
+		   elapsed_ms);
+	mutex_unlock(&core->lock);
+
+	return 0;
+}
+
+static int mmi_bl_core_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmi_bl_core_stats_show, inode->i_private);
+}
+
+static ssize_t mmi_bl_core_stats_write(struct file *filp,
+				       const char __user *buff,
+				       size_t count, loff_t *off)
+{
+	struct mmi_bl_core *core =
+		((struct seq_file *)filp->private_data)->private;
+
+	mutex_lock(&core->lock);
+	mmi_bl_core_stats_reset(core);
+	mutex_unlock(&core->lock);
+
+	return count;
+}
+
+static const struct file_operations mmi_bl_core_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = mmi_bl_core_stats_open,
+	.read = seq_read,
+	.write = mmi_bl_core_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int mmi_bl_core_init(struct mmi_bl_core *core, const char *name,
+		     int (*update)(void *data, int level), void *data)
+{
+	if (!core || !name || !update)
+		return -EINVAL;
+
+	core->name = name;
+	core->update = update;
+	core->data = data;
+	mutex_init(&core->lock);
+	spin_lock_init(&core->req_lock);
+	core->pending = false;
+	core->applied = -1;
+	INIT_WORK(&core->work, mmi_bl_core_work);
+	ratelimit_state_init(&core->rs, DEFAULT_RATELIMIT_INTERVAL,
+			     DEFAULT_RATELIMIT_BURST);
+	mmi_bl_core_stats_reset(core);
+	core->dentry = debugfs_create_file(name, 0600, bl_core_dir, core,
+					   &mmi_bl_core_stats_fops);
+
+	return 0;
+}
+EXPORT_SYMBOL(mmi_bl_core_init);
+
+void mmi_bl_core_exit(struct mmi_bl_core *core)
+{
+	debugfs_remove(core->dentry);
+	core->dentry = NULL;
+	cancel_work_sync(&core->work);
+}
+EXPORT_SYMBOL(mmi_bl_core_exit);
+
+static int __init mmi_bl_core_module_init(void)
+{
+	bl_core_dir = debugfs_create_dir("mmi_bl_core", NULL);
+
+	return 0;
+}
+
+static void __exit mmi_bl_core_module_exit(void)
+{
+	debugfs_remove_recursive(bl_core_dir);
+}
+
+module_init(mmi_bl_core_module_init);
+module_exit(mmi_bl_core_module_exit);
+MODULE_DESCRIPTION("Motorola backlight brightness core");
+MODULE_LICENSE("GPL v2");
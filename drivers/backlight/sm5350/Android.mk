@@ -5,4 +5,5 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := sm5350_bl.ko
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
+LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/mmi_bl_core.ko
 include $(DLKM_DIR)/AndroidKernelModule.mk
@@ -18,6 +18,7 @@
 #include <linux/regulator/consumer.h>
 #include <linux/module.h>
 #include <linux/backlight.h>
+#include <linux/mmi_bl_core.h>
 
 #define SM5350_NAME "sm5350-bl"
 
@@ -70,12 +71,14 @@ struct sm5350_data {
 	u8 boost_ctl;
 	u8 full_scale_current;
 	u8 map_mode;
+	u8 runtime_ramp;
 	unsigned int led_current_align; /* Align boost current to AW chip */
 	unsigned int default_brightness;
 	bool brt_code_enable;
 	u16 *brt_code_table;
 	int en_gpio;
 	struct backlight_device *bl_dev;
+	struct mmi_bl_core bl_core;
 };
 
 struct sm5350_data *g_sm5350_data;
@@ -163,6 +166,8 @@ static int sm5350_init_registers(struct sm5350_data *drvdata)
 	sm5350_write_reg(drvdata->client, SM5350_BRIGHTNESS_CFG_REG, drvdata->map_mode);
 	sm5350_write_reg(drvdata->client, SM5350_HVLED_CURR_SINK_OUT_CFG_REG, SM5350_HVLED_CURR_SINK_OUT_CFG);
 	sm5350_write_reg(drvdata->client, SM5350_CTL_B_FULL_SCALE_CURR_REG, drvdata->full_scale_current);
+	if (drvdata->runtime_ramp)
+		sm5350_write_reg(drvdata->client, SM5350_CTL_RUNTIME_RAMP_TIME_REG, drvdata->runtime_ramp);
 
 	drvdata->enable = true;
 
@@ -180,7 +185,6 @@ int sm5350_set_brightness(struct sm5350_data *drvdata, int brt_val)
 	u8 brt_MSB = 0;
 	int index = 0, remainder;
 	int code, code1, code2;
-	printk("%s backlight_val = %d\n",__func__, brt_val);
 
 	if ((drvdata->map_mode == 0) && (drvdata->led_current_align == ALIGN_AW99703))
 		brt_val = brt_val*8383/10000+324;
@@ -196,12 +200,12 @@ int sm5350_set_brightness(struct sm5350_data *drvdata, int brt_val)
 
 		brt_LSB = code % 0x7;
 		brt_MSB = (code >> 3) & 0xFF;
-		printk("brt_LSB_1 %x, brt_MSB_1 %x\n", brt_LSB, brt_MSB);
+		pr_debug("brt_LSB_1 %x, brt_MSB_1 %x\n", brt_LSB, brt_MSB);
 	} else {
 		brt_LSB = brt_val & 0x7;
 		brt_MSB = (brt_val >> 3) & 0xFF;
 	}
-	printk("brt_LSB %x, brt_MSB %x\n", brt_LSB, brt_MSB);
+	pr_debug("brt_LSB %x, brt_MSB %x\n", brt_LSB, brt_MSB);
 
 	if (drvdata->enable == false)
 		sm5350_init_registers(drvdata);
@@ -229,8 +233,19 @@ static int sm5350_bl_update_status(struct backlight_device *bl_dev)
 	/*
 	 * Brightness register should always be written
 	 * not only register based mode but also in PWM mode.
+	 * Turning off is done by the time suspend returns.
 	 */
-	return sm5350_set_brightness(drvdata, brt);
+	if (!brt)
+		return mmi_bl_core_set(&drvdata->bl_core, 0);
+
+	mmi_bl_core_queue(&drvdata->bl_core, brt);
+	return 0;
+}
+
+/* Called by mmi_bl_core with the latest level that differs from the chip */
+static int sm5350_bl_core_update(void *data, int level)
+{
+	return sm5350_set_brightness(data, level);
 }
 
 static const struct backlight_ops sm5350_bl_ops = {
@@ -286,6 +301,10 @@ static int sm5350_get_dt_data(struct device *dev, struct sm5350_data *drvdata)
 	drvdata->map_mode= (!rc ? tmp : 1); /* 1: linear, 0: expo, linear as default*/
 	pr_debug("%s : map_mode=0x%x\n",__func__, drvdata->map_mode);
 
+	rc = of_property_read_u32(of_node, "runtime-ramp", &tmp);
+	drvdata->runtime_ramp = (!rc ? tmp : 0); /* 0: no hardware ramp */
+	pr_debug("%s : runtime_ramp=0x%x\n",__func__, drvdata->runtime_ramp);
+
 	if (of_property_read_u32(of_node, "current-align-type", &drvdata->led_current_align))
 		drvdata->led_current_align = ALIGN_NONE;
 	pr_debug("%s : led_current_align=0x%x\n",__func__, drvdata->led_current_align);
@@ -469,15 +488,19 @@ static int sm5350_probe(struct i2c_client *client,
 	props.type = BACKLIGHT_PLATFORM;
 	props.brightness = MAX_BRIGHTNESS;
 	props.max_brightness = MAX_BRIGHTNESS;
+	mmi_bl_core_init(&drvdata->bl_core, SM5350_NAME,
+			 sm5350_bl_core_update, drvdata);
 	bl_dev = backlight_device_register(SM5350_NAME, &client->dev,
 					drvdata, &sm5350_bl_ops, &props);
 
-	if (IS_ERR(bl_dev))
+	if (IS_ERR(bl_dev)) {
+		mmi_bl_core_exit(&drvdata->bl_core);
 		return PTR_ERR(bl_dev);
+	}
 	drvdata->bl_dev = bl_dev;
 	sm5350_init_registers(drvdata);
 	dump_sm5350_regs(drvdata);
-	sm5350_set_brightness(drvdata, drvdata->default_brightness);
+	mmi_bl_core_set(&drvdata->bl_core, drvdata->default_brightness);
 
 	printk("sm-sm5350 probe okay\n");
 	return 0;
@@ -493,6 +516,7 @@ static int sm5350_remove(struct i2c_client *client)
 	struct sm5350_data *drvdata = i2c_get_clientdata(client);
 
 	backlight_device_unregister(drvdata->bl_dev);
+	mmi_bl_core_exit(&drvdata->bl_core);
 	kfree(drvdata);
 	return 0;
 }
@@ -22,6 +22,12 @@
 #include <linux/of_device.h>
 #include <linux/acpi.h>
 #include <linux/pinctrl/consumer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mmi_lat_hist.h>
+#include <linux/workqueue.h>
 
 #include <linux/spi/spi.h>
 #include <linux/spi/spidev.h>
@@ -36,6 +42,9 @@
 #include "linux/st21nfc.h"
 #include "linux/spi/spi-msm-geni.h"
 
+#define CREATE_TRACE_POINTS
+#include "st54spi_trace.h"
+
 
 /*
  * This supports access to SPI devices using normal userspace I/O calls.
@@ -59,6 +68,34 @@ static DECLARE_BITMAP(minors, N_SPI_MINORS);
 #define ST54SPI_IOC_RD_POWER _IOR(SPI_IOC_MAGIC, 99, __u32)
 #define ST54SPI_IOC_WR_POWER _IOW(SPI_IOC_MAGIC, 99, __u32)
 
+/*
+ * ST54SPI_IOC_BATCH sends several frames as one spi_message: each frame is
+ * its tx bytes then its rx bytes under one chip select, followed by a CS
+ * release of delay_usecs. The tx bytes of all the frames are read back to
+ * back from tx_buf, the rx bytes are written back to back into rx_buf, so
+ * each direction is a single copy.
+ */
+struct st54spi_ioc_frame {
+	__u32 tx_len;
+	__u32 rx_len;
+	__u16 delay_usecs;
+	__u16 pad;
+};
+
+struct st54spi_ioc_batch {
+	__u64 tx_buf;
+	__u64 rx_buf;
+	__u64 frames;		/* struct st54spi_ioc_frame array */
+	__u32 n_frames;
+	__u32 speed_hz;		/* 0 for the current speed */
+};
+
+#define ST54SPI_IOC_BATCH _IOW(SPI_IOC_MAGIC, 100, struct st54spi_ioc_batch)
+
+/* Transfers and frames handled without allocating */
+#define ST54SPI_MAX_XFERS 64
+#define ST54SPI_MAX_FRAMES (ST54SPI_MAX_XFERS / 2)
+
 /* Bit masks for spi_device.mode management.  Note that incorrect
  * settings for some settings can cause *lots* of trouble for other
  * devices on a shared bus:
@@ -77,6 +114,20 @@ static DECLARE_BITMAP(minors, N_SPI_MINORS);
 	SPI_NO_CS | SPI_READY | SPI_TX_DUAL |	\
 	SPI_TX_QUAD | SPI_RX_DUAL | SPI_RX_QUAD)
 
+/*
+ * The turnaround is the time between two transfers of an APDU exchange,
+ * longer gaps are idle time and are not counted.
+ */
+#define ST54SPI_TURNAROUND_MAX_MS 1000
+
+enum st54spi_lat_id {
+	ST54SPI_LAT_XFER,
+	ST54SPI_LAT_TURNAROUND,
+	ST54SPI_LAT_POWER_ON,
+	ST54SPI_LAT_POWER_OFF,
+	ST54SPI_LAT_NR,
+};
+
 struct st54spi_data {
 	dev_t devt;
 	spinlock_t spi_lock;
@@ -84,11 +135,18 @@ struct st54spi_data {
 	struct spi_device *spi_reset;
 	struct list_head device_entry;
 
-	/* TX/RX buffers are NULL unless this device is open (users > 0) */
+	/*
+	 * TX/RX bounce buffers and transfer scratch live as long as the
+	 * device, the buffers are DMA-safe so the controller can map them
+	 * in place.
+	 */
 	struct mutex buf_lock;
 	unsigned int users;
 	u8 *tx_buffer;
 	u8 *rx_buffer;
+	struct spi_ioc_transfer *ioc;
+	struct spi_transfer *xfers;
+	struct st54spi_ioc_frame *frames;
 	u32 speed_hz;
 
 	/* GPIO for SE_POWER_REQ / SE_nRESET */
@@ -100,8 +158,35 @@ struct st54spi_data {
 	struct pinctrl *pctrl;
 	struct pinctrl_state *pctrl_mode_spi, *pctrl_mode_idle;
 
+	/*
+	 * Power policy: once neither the SE HAL nor the NFC side needs the
+	 * SE, it is kept on for a hold-off learned from the gaps between
+	 * transactions, so bursts do not pay a cold power-up each time.
+	 */
+	struct mutex power_lock;	/* Serializes power transitions */
+	struct delayed_work power_work;
+	bool power_off_pending;
+	ktime_t release_ts;		/* Last time nobody needed the SE */
+	ktime_t power_on_ts;
+	unsigned int gap_avg_ms;	/* Running average of the gaps */
+	struct st54spi_power_stats {
+		u64 power_on;		/* Cold power-ups */
+		u64 power_off;
+		u64 warm_hits;		/* Power-ups saved by the hold-off */
+		u64 on_ms;		/* Time powered, energy proxy */
+		u64 holdoff_ms;		/* Part of it spent in hold-off */
+	} pstats;
+	struct dentry *power_dentry;
+
+	spinlock_t lat_lock;		/* Protects last_xfer_end and lat */
+	ktime_t last_xfer_end;
+	struct mmi_lat_hist lat[ST54SPI_LAT_NR];
+	struct dentry *lat_dentry;
 };
 
+/* Shortest hold-off the adaptive policy goes down to */
+#define ST54SPI_HOLDOFF_MIN_MS 50
+
 #define POWER_MODE_NONE -1
 #define POWER_MODE_ST54H 0
 #define POWER_MODE_ST54J 1
@@ -116,6 +201,98 @@ MODULE_PARM_DESC(bufsiz, "data bytes in biggest supported SPI message");
 static bool debug_enabled = true;
 #define VERBOSE 1
 
+static unsigned int power_holdoff_ms = 2000;
+module_param(power_holdoff_ms, uint, 0644);
+MODULE_PARM_DESC(power_holdoff_ms,
+		 "longest time the SE stays on after its last user, 0 to power off at once");
+
+static bool power_holdoff_adaptive = true;
+module_param(power_holdoff_adaptive, bool, 0644);
+MODULE_PARM_DESC(power_holdoff_adaptive,
+		 "learn the hold-off from the gaps between transactions");
+
+static void st54spi_power_flush(struct st54spi_data *st54spi);
+
+static void st54spi_free(struct st54spi_data *st54spi)
+{
+	st54spi_power_flush(st54spi);
+	kfree(st54spi->tx_buffer);
+	kfree(st54spi->rx_buffer);
+	kfree(st54spi->ioc);
+	kfree(st54spi->xfers);
+	kfree(st54spi->frames);
+	kfree(st54spi);
+}
+
+/*-------------------------------------------------------------------------*/
+
+static struct dentry *st54spi_debugfs_dir;
+
+static const char *const st54spi_lat_names[ST54SPI_LAT_NR] = {
+	[ST54SPI_LAT_XFER] = "xfer",
+	[ST54SPI_LAT_TURNAROUND] = "turnaround",
+	[ST54SPI_LAT_POWER_ON] = "power_on",
+	[ST54SPI_LAT_POWER_OFF] = "power_off",
+};
+
+static void st54spi_lat_add(struct st54spi_data *st54spi,
+			    enum st54spi_lat_id id, u64 delta_ns)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&st54spi->lat_lock, flags);
+	mmi_lat_hist_add(&st54spi->lat[id], div_u64(delta_ns, NSEC_PER_USEC));
+	spin_unlock_irqrestore(&st54spi->lat_lock, flags);
+}
+
+static int st54spi_lat_show(struct seq_file *s, void *unused)
+{
+	struct st54spi_data *st54spi = s->private;
+	struct mmi_lat_hist *hist;
+	int i;
+
+	hist = kmalloc_array(ST54SPI_LAT_NR, sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irq(&st54spi->lat_lock);
+	memcpy(hist, st54spi->lat, sizeof(st54spi->lat));
+	spin_unlock_irq(&st54spi->lat_lock);
+
+	for (i = 0; i < ST54SPI_LAT_NR; i++)
+		mmi_lat_hist_show(s, st54spi_lat_names[i], &hist[i]);
+
+	kfree(hist);
+	return 0;
+}
+
+static int st54spi_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, st54spi_lat_show, inode->i_private);
+}
+
+/* Any write resets the histograms */
+static ssize_t st54spi_lat_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct st54spi_data *st54spi = file_inode(file)->i_private;
+
+	spin_lock_irq(&st54spi->lat_lock);
+	memset(st54spi->lat, 0, sizeof(st54spi->lat));
+	st54spi->last_xfer_end = 0;
+	spin_unlock_irq(&st54spi->lat_lock);
+	return count;
+}
+
+static const struct file_operations st54spi_lat_fops = {
+	.owner = THIS_MODULE,
+	.open = st54spi_lat_open,
+	.read = seq_read,
+	.write = st54spi_lat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 /*-------------------------------------------------------------------------*/
 
 static ssize_t st54spi_sync(
@@ -124,15 +301,33 @@ static ssize_t st54spi_sync(
 	DECLARE_COMPLETION_ONSTACK(done);
 	int status;
 	struct spi_device *spi;
+	ktime_t start, end, last;
+	u64 idle_ns = 0;
 
 	spin_lock_irq(&st54spi->spi_lock);
 	spi = st54spi->spi;
 	spin_unlock_irq(&st54spi->spi_lock);
 
+	start = ktime_get();
 	if (spi == NULL)
 		status = -ESHUTDOWN;
 	else
 		status = spi_sync(spi, message);
+	end = ktime_get();
+
+	spin_lock_irq(&st54spi->lat_lock);
+	last = st54spi->last_xfer_end;
+	st54spi->last_xfer_end = end;
+	spin_unlock_irq(&st54spi->lat_lock);
+
+	if (last)
+		idle_ns = ktime_to_ns(ktime_sub(start, last));
+	if (last && idle_ns < ST54SPI_TURNAROUND_MAX_MS * NSEC_PER_MSEC)
+		st54spi_lat_add(st54spi, ST54SPI_LAT_TURNAROUND, idle_ns);
+	st54spi_lat_add(st54spi, ST54SPI_LAT_XFER,
+			ktime_to_ns(ktime_sub(end, start)));
+	trace_st54spi_xfer(message->frame_length, status,
+			   ktime_to_ns(ktime_sub(end, start)), idle_ns);
 
 	if (status == 0)
 		status = message->actual_length;
@@ -252,9 +447,14 @@ static int st54spi_message(
 	int status = -EFAULT;
 
 	spi_message_init(&msg);
-	k_xfers = kcalloc(n_xfers, sizeof(*k_tmp), GFP_KERNEL);
-	if (k_xfers == NULL)
-		return -ENOMEM;
+	if (n_xfers <= ST54SPI_MAX_XFERS) {
+		k_xfers = st54spi->xfers;
+		memset(k_xfers, 0, n_xfers * sizeof(*k_tmp));
+	} else {
+		k_xfers = kcalloc(n_xfers, sizeof(*k_tmp), GFP_KERNEL);
+		if (k_xfers == NULL)
+			return -ENOMEM;
+	}
 
 	/* Construct spi_message, copying any tx data to bounce buffer.
 	 * We walk the array of user-provided transfers, using each one
@@ -346,11 +546,95 @@ static int st54spi_message(
 	status = total;
 
 done:
-	kfree(k_xfers);
+	if (k_xfers != st54spi->xfers)
+		kfree(k_xfers);
 	return status;
 }
 
+static int st54spi_batch(
+	struct st54spi_data *st54spi,
+	const struct st54spi_ioc_batch __user *u_batch)
+{
+	struct st54spi_ioc_batch batch;
+	struct st54spi_ioc_frame *frame;
+	struct spi_transfer *k_tmp;
+	struct spi_message msg;
+	unsigned int n, tx_total = 0, rx_total = 0;
+	int status;
+
+	if (copy_from_user(&batch, u_batch, sizeof(batch)))
+		return -EFAULT;
+
+	if (!batch.n_frames)
+		return 0;
+	if (batch.n_frames > ST54SPI_MAX_FRAMES)
+		return -EMSGSIZE;
+
+	if (copy_from_user(st54spi->frames, u64_to_user_ptr(batch.frames),
+			   batch.n_frames * sizeof(*frame)))
+		return -EFAULT;
+
+	for (n = 0, frame = st54spi->frames; n < batch.n_frames; n++, frame++) {
+		if (frame->tx_len > bufsiz || frame->rx_len > bufsiz ||
+		    (!frame->tx_len && !frame->rx_len))
+			return -EINVAL;
+		tx_total += frame->tx_len;
+		rx_total += frame->rx_len;
+		if (tx_total > bufsiz || rx_total > bufsiz)
+			return -EMSGSIZE;
+	}
+
+	if (tx_total && copy_from_user(st54spi->tx_buffer,
+				       u64_to_user_ptr(batch.tx_buf), tx_total))
+		return -EFAULT;
+	if (rx_total && !access_ok(u64_to_user_ptr(batch.rx_buf), rx_total))
+		return -EFAULT;
+
+	spi_message_init(&msg);
+	k_tmp = st54spi->xfers;
+	memset(k_tmp, 0, 2 * batch.n_frames * sizeof(*k_tmp));
+	tx_total = 0;
+	rx_total = 0;
+	for (n = 0, frame = st54spi->frames; n < batch.n_frames; n++, frame++) {
+		if (frame->tx_len) {
+			k_tmp->tx_buf = st54spi->tx_buffer + tx_total;
+			k_tmp->len = frame->tx_len;
+			k_tmp->speed_hz = batch.speed_hz ?: st54spi->speed_hz;
+			tx_total += frame->tx_len;
+			spi_message_add_tail(k_tmp++, &msg);
+		}
+		if (frame->rx_len) {
+			k_tmp->rx_buf = st54spi->rx_buffer + rx_total;
+			k_tmp->len = frame->rx_len;
+			k_tmp->speed_hz = batch.speed_hz ?: st54spi->speed_hz;
+			rx_total += frame->rx_len;
+			spi_message_add_tail(k_tmp++, &msg);
+		}
+		/* Release CS between frames, the last one ends the message */
+		k_tmp[-1].cs_change = n != batch.n_frames - 1;
+		k_tmp[-1].delay_usecs = frame->delay_usecs;
+	}
+
+	status = st54spi_sync(st54spi, &msg);
+	if (status < 0)
+		return status;
+
+	if (rx_total && __copy_to_user(u64_to_user_ptr(batch.rx_buf),
+				       st54spi->rx_buffer, rx_total))
+		return -EFAULT;
+
+	return tx_total + rx_total;
+}
+
+static void st54spi_put_ioc_message(
+	struct st54spi_data *st54spi, struct spi_ioc_transfer *ioc)
+{
+	if (ioc != st54spi->ioc)
+		kfree(ioc);
+}
+
 static struct spi_ioc_transfer *st54spi_get_ioc_message(
+	struct st54spi_data *st54spi,
 	unsigned int cmd,
 	struct spi_ioc_transfer __user *u_ioc,
 	unsigned int *n_ioc)
@@ -373,12 +657,16 @@ static struct spi_ioc_transfer *st54spi_get_ioc_message(
 		return NULL;
 
 	/* copy into scratch area */
-	ioc = kmalloc(tmp, GFP_KERNEL);
-	if (!ioc)
-		return ERR_PTR(-ENOMEM);
+	if (*n_ioc <= ST54SPI_MAX_XFERS) {
+		ioc = st54spi->ioc;
+	} else {
+		ioc = kmalloc(tmp, GFP_KERNEL);
+		if (!ioc)
+			return ERR_PTR(-ENOMEM);
+	}
 
 	if (__copy_from_user(ioc, u_ioc, tmp)) {
-		kfree(ioc);
+		st54spi_put_ioc_message(st54spi, ioc);
 		return ERR_PTR(-EFAULT);
 	}
 	return ioc;
@@ -386,20 +674,27 @@ static struct spi_ioc_transfer *st54spi_get_ioc_message(
 
 static void st54spi_power_off(struct st54spi_data *st54spi)
 {
+	struct spi_device *spi;
+	ktime_t start = ktime_get();
+	u64 delta_ns;
 	int ret;
 
-	if (debug_enabled)
-		dev_info(&st54spi->spi->dev, "%s\n", __func__);
+	/* Once unbound, both are NULL but the SE may still be powered */
+	spi = st54spi->spi ? st54spi->spi : st54spi->spi_reset;
+	if (debug_enabled && spi)
+		dev_info(&spi->dev, "%s\n", __func__);
+
+	st54spi->pstats.power_off++;
+	st54spi->pstats.on_ms += ktime_ms_delta(start, st54spi->power_on_ts);
 
 	// Set NSS pin as highZ (ST54H and ST54J).
 
 	// Change NSS polarity to have NSS low.
 	ret = pinctrl_select_state(st54spi->pctrl, st54spi->pctrl_mode_idle);
 
-	if (ret < 0) {
-		dev_err(&st54spi->spi->dev,
-				"%s : change CSB management to High Z failed!\n", __func__);
-	}
+	if (ret < 0)
+		pr_err("st54spi: %s : change CSB management to High Z failed!\n",
+		       __func__);
 
 	// Set SE_PWR_REQ / SE_nRESET to low
 	if (st54spi->power_or_nreset_gpio)
@@ -422,10 +717,16 @@ static void st54spi_power_off(struct st54spi_data *st54spi)
 
 
 	st54spi->se_is_poweron = 0;
+
+	delta_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	st54spi_lat_add(st54spi, ST54SPI_LAT_POWER_OFF, delta_ns);
+	trace_st54spi_power(false, delta_ns);
 }
 
 static void st54spi_power_on(struct st54spi_data *st54spi)
 {
+	ktime_t start = ktime_get();
+	u64 delta_ns;
 	int ret;
 
 	if (debug_enabled)
@@ -458,6 +759,99 @@ static void st54spi_power_on(struct st54spi_data *st54spi)
 	}
 
 	st54spi->se_is_poweron = 1;
+	st54spi->pstats.power_on++;
+	st54spi->power_on_ts = ktime_get();
+
+	delta_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	st54spi_lat_add(st54spi, ST54SPI_LAT_POWER_ON, delta_ns);
+	trace_st54spi_power(true, delta_ns);
+}
+
+static unsigned int st54spi_power_holdoff(struct st54spi_data *st54spi)
+{
+	unsigned int max = READ_ONCE(power_holdoff_ms);
+
+	if (!READ_ONCE(power_holdoff_adaptive))
+		return max;
+
+	return clamp(st54spi->gap_avg_ms + st54spi->gap_avg_ms / 2,
+		     min_t(unsigned int, ST54SPI_HOLDOFF_MIN_MS, max), max);
+}
+
+/* Called with power_lock held when the SE is needed */
+static void st54spi_power_acquire(struct st54spi_data *st54spi)
+{
+	ktime_t now = ktime_get();
+	s64 gap_ms;
+
+	if (st54spi->release_ts) {
+		gap_ms = ktime_ms_delta(now, st54spi->release_ts);
+		st54spi->release_ts = 0;
+
+		/* Gaps past the longest hold-off are idle time, back off */
+		if (gap_ms < power_holdoff_ms)
+			st54spi->gap_avg_ms = (3 * st54spi->gap_avg_ms +
+					       gap_ms) / 4;
+		else
+			st54spi->gap_avg_ms /= 2;
+
+		if (st54spi->power_off_pending) {
+			cancel_delayed_work(&st54spi->power_work);
+			st54spi->power_off_pending = false;
+			st54spi->pstats.warm_hits++;
+			st54spi->pstats.holdoff_ms += gap_ms;
+		}
+	}
+
+	if (st54spi->se_is_poweron == 0)
+		st54spi_power_on(st54spi);
+}
+
+/* Called with power_lock held when the SE may not be needed anymore */
+static void st54spi_power_release(struct st54spi_data *st54spi)
+{
+	unsigned int holdoff;
+
+	if (st54spi->se_is_poweron == 0 || st54spi->nfcc_needs_poweron ||
+	    st54spi->sehal_needs_poweron)
+		return;
+
+	st54spi->release_ts = ktime_get();
+	holdoff = st54spi_power_holdoff(st54spi);
+	if (!holdoff) {
+		st54spi_power_off(st54spi);
+		return;
+	}
+
+	st54spi->power_off_pending = true;
+	mod_delayed_work(system_wq, &st54spi->power_work,
+			 msecs_to_jiffies(holdoff));
+}
+
+static void st54spi_power_work(struct work_struct *work)
+{
+	struct st54spi_data *st54spi = container_of(to_delayed_work(work),
+			struct st54spi_data, power_work);
+
+	mutex_lock(&st54spi->power_lock);
+	if (st54spi->power_off_pending) {
+		st54spi->power_off_pending = false;
+		st54spi->pstats.holdoff_ms +=
+			ktime_ms_delta(ktime_get(), st54spi->release_ts);
+		// we don t need power anymore
+		st54spi_power_off(st54spi);
+	}
+	mutex_unlock(&st54spi->power_lock);
+}
+
+/*
+ * Do not leave the SE powered when the device goes away in its hold-off,
+ * the work is a no-op when no power-off is pending.
+ */
+static void st54spi_power_flush(struct st54spi_data *st54spi)
+{
+	mod_delayed_work(system_wq, &st54spi->power_work, 0);
+	flush_delayed_work(&st54spi->power_work);
 }
 
 static void st54spi_power_set(struct st54spi_data *st54spi, int val)
@@ -468,18 +862,41 @@ static void st54spi_power_set(struct st54spi_data *st54spi, int val)
 	if (debug_enabled)
 		dev_info(&st54spi->spi->dev, "st54spi sehal pwr_req: %d\n", val);
 
+	mutex_lock(&st54spi->power_lock);
 	if (val) {
 		st54spi->sehal_needs_poweron = 1;
-		if (st54spi->se_is_poweron == 0)
-			st54spi_power_on(st54spi);
+		st54spi_power_acquire(st54spi);
 	} else {
 		st54spi->sehal_needs_poweron = 0;
-		if ((st54spi->se_is_poweron == 1) &&
-			(st54spi->nfcc_needs_poweron == 0))
-			// we don t need power anymore
-			st54spi_power_off(st54spi);
+		st54spi_power_release(st54spi);
 	}
+	mutex_unlock(&st54spi->power_lock);
+}
+
+static int st54spi_power_show(struct seq_file *s, void *unused)
+{
+	struct st54spi_data *st54spi = s->private;
+	struct st54spi_power_stats st;
+	unsigned int holdoff;
+	u64 on_ms;
+
+	mutex_lock(&st54spi->power_lock);
+	st = st54spi->pstats;
+	on_ms = st.on_ms;
+	if (st54spi->se_is_poweron)
+		on_ms += ktime_ms_delta(ktime_get(), st54spi->power_on_ts);
+	holdoff = st54spi_power_holdoff(st54spi);
+	mutex_unlock(&st54spi->power_lock);
+
+	seq_printf(s, "power_on: %llu\n", st.power_on);
+	seq_printf(s, "power_off: %llu\n", st.power_off);
+	seq_printf(s, "warm_hits: %llu\n", st.warm_hits);
+	seq_printf(s, "on_ms: %llu\n", on_ms);
+	seq_printf(s, "holdoff_ms: %llu\n", st.holdoff_ms);
+	seq_printf(s, "current_holdoff_ms: %u\n", holdoff);
+	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(st54spi_power);
 
 static int st54spi_power_get(struct st54spi_data *st54spi)
 {
@@ -640,11 +1057,15 @@ static long st54spi_ioctl(
 			dev_dbg(&spi->dev, "SE_POWER_REQ/SE_NRESET set: %d\n", tmp);
 		}
 		break;
+	case ST54SPI_IOC_BATCH:
+		retval = st54spi_batch(st54spi,
+			(const struct st54spi_ioc_batch __user *)arg);
+		break;
 
 	default:
 		/* segmented and/or full-duplex I/O request */
 		/* Check message and copy into scratch area */
-		ioc = st54spi_get_ioc_message(
+		ioc = st54spi_get_ioc_message(st54spi,
 			cmd, (struct spi_ioc_transfer __user *)arg, &n_ioc);
 		if (IS_ERR(ioc)) {
 			retval = PTR_ERR(ioc);
@@ -655,7 +1076,7 @@ static long st54spi_ioctl(
 
 		/* translate to spi_message, execute */
 		retval = st54spi_message(st54spi, ioc, n_ioc);
-		kfree(ioc);
+		st54spi_put_ioc_message(st54spi, ioc);
 		break;
 	}
 
@@ -699,7 +1120,7 @@ static long st54spi_compat_ioc_message(
 	mutex_lock(&st54spi->buf_lock);
 
 	/* Check message and copy into scratch area */
-	ioc = st54spi_get_ioc_message(cmd, u_ioc, &n_ioc);
+	ioc = st54spi_get_ioc_message(st54spi, cmd, u_ioc, &n_ioc);
 	if (IS_ERR(ioc)) {
 		retval = PTR_ERR(ioc);
 		goto done;
@@ -715,7 +1136,7 @@ static long st54spi_compat_ioc_message(
 
 	/* translate to spi_message, execute */
 	retval = st54spi_message(st54spi, ioc, n_ioc);
-	kfree(ioc);
+	st54spi_put_ioc_message(st54spi, ioc);
 
 done:
 	mutex_unlock(&st54spi->buf_lock);
@@ -768,24 +1189,6 @@ static int st54spi_open(struct inode *inode, struct file *filp)
 	if (debug_enabled)
 		dev_info(&st54spi->spi->dev, "st54spi: open\n");
 
-	if (!st54spi->tx_buffer) {
-		st54spi->tx_buffer = kmalloc(bufsiz, GFP_KERNEL);
-		if (!st54spi->tx_buffer) {
-			// dev_dbg(&st54spi->spi->dev, "open/ENOMEM\n");
-			status = -ENOMEM;
-			goto err_find_dev;
-		}
-	}
-
-	if (!st54spi->rx_buffer) {
-		st54spi->rx_buffer = kmalloc(bufsiz, GFP_KERNEL);
-		if (!st54spi->rx_buffer) {
-			// dev_dbg(&st54spi->spi->dev, "open/ENOMEM\n");
-			status = -ENOMEM;
-			goto err_alloc_rx_buf;
-		}
-	}
-
 	st54spi->users++;
 	filp->private_data = st54spi;
 	nonseekable_open(inode, filp);
@@ -797,9 +1200,6 @@ static int st54spi_open(struct inode *inode, struct file *filp)
 	st54spi_power_set(st54spi, 1);
 	return 0;
 
-err_alloc_rx_buf:
-	kfree(st54spi->tx_buffer);
-	st54spi->tx_buffer = NULL;
 err_find_dev:
 	mutex_unlock(&device_list_lock);
 	return status;
@@ -826,12 +1226,6 @@ static int st54spi_release(struct inode *inode, struct file *filp)
 
 		st54spi_power_set(st54spi, 0);
 
-		kfree(st54spi->tx_buffer);
-		st54spi->tx_buffer = NULL;
-
-		kfree(st54spi->rx_buffer);
-		st54spi->rx_buffer = NULL;
-
 		spin_lock_irq(&st54spi->spi_lock);
 		if (st54spi->spi)
 			st54spi->speed_hz = st54spi->spi->max_speed_hz;
@@ -842,7 +1236,7 @@ static int st54spi_release(struct inode *inode, struct file *filp)
 		spin_unlock_irq(&st54spi->spi_lock);
 
 		if (dofree)
-			kfree(st54spi);
+			st54spi_free(st54spi);
 	}
 	mutex_unlock(&device_list_lock);
 
@@ -991,8 +1385,14 @@ static void st54spi_st21nfc_cb(int dir, void *data)
 		return;
 	dev_info(&st54spi->spi->dev, "%s : dir %d data %p\n", __func__, dir, st54spi);
 
+	mutex_lock(&st54spi->power_lock);
 	switch (dir) {
 	case ST54SPI_CB_RESET_START:
+		// the CLF reset powers the SE down, no point in holding it
+		if (st54spi->power_off_pending) {
+			cancel_delayed_work(&st54spi->power_work);
+			st54spi->power_off_pending = false;
+		}
 		if (st54spi->se_is_poweron)
 			st54spi_power_off(st54spi);
 		break;
@@ -1006,18 +1406,15 @@ static void st54spi_st21nfc_cb(int dir, void *data)
 
 	case ST54SPI_CB_ESE_USED:
 		st54spi->nfcc_needs_poweron = 1;
-		if (st54spi->se_is_poweron == 0)
-			st54spi_power_on(st54spi);
+		st54spi_power_acquire(st54spi);
 		break;
 
 	case ST54SPI_CB_ESE_NOT_USED:
 		st54spi->nfcc_needs_poweron = 0;
-		if ((st54spi->se_is_poweron == 1) &&
-			(st54spi->sehal_needs_poweron == 0))
-			// we don t need power anymore
-			st54spi_power_off(st54spi);
+		st54spi_power_release(st54spi);
 		break;
 	}
+	mutex_unlock(&st54spi->power_lock);
 }
 #endif  // !MODULE
 
@@ -1050,6 +1447,25 @@ static int st54spi_probe(struct spi_device *spi)
 	if (!st54spi)
 		return -ENOMEM;
 
+	mutex_init(&st54spi->power_lock);
+	INIT_DELAYED_WORK(&st54spi->power_work, st54spi_power_work);
+	st54spi->gap_avg_ms = power_holdoff_ms / 2;
+	spin_lock_init(&st54spi->lat_lock);
+
+	st54spi->tx_buffer = kmalloc(bufsiz, GFP_KERNEL);
+	st54spi->rx_buffer = kmalloc(bufsiz, GFP_KERNEL);
+	st54spi->ioc = kmalloc_array(ST54SPI_MAX_XFERS, sizeof(*st54spi->ioc),
+				     GFP_KERNEL);
+	st54spi->xfers = kmalloc_array(ST54SPI_MAX_XFERS,
+				       sizeof(*st54spi->xfers), GFP_KERNEL);
+	st54spi->frames = kmalloc_array(ST54SPI_MAX_FRAMES,
+					sizeof(*st54spi->frames), GFP_KERNEL);
+	if (!st54spi->tx_buffer || !st54spi->rx_buffer || !st54spi->ioc ||
+	    !st54spi->xfers || !st54spi->frames) {
+		st54spi_free(st54spi);
+		return -ENOMEM;
+	}
+
 	/* Initialize the driver data */
 	st54spi->spi = spi;
 	spin_lock_init(&st54spi->spi_lock);
@@ -1106,10 +1522,15 @@ static int st54spi_probe(struct spi_device *spi)
 		spi->controller_data = spi_param;
 	}
 
-	if (status == 0)
+	if (status == 0) {
 		spi_set_drvdata(spi, st54spi);
-	else
-		kfree(st54spi);
+		st54spi->power_dentry = debugfs_create_file("power", 0440,
+			st54spi_debugfs_dir, st54spi, &st54spi_power_fops);
+		st54spi->lat_dentry = debugfs_create_file("latency", 0640,
+			st54spi_debugfs_dir, st54spi, &st54spi_lat_fops);
+	} else {
+		st54spi_free(st54spi);
+	}
 
 	(void)st54spi_parse_dt(&spi->dev, st54spi);
 
@@ -1158,6 +1579,10 @@ static int st54spi_remove(struct spi_device *spi)
 		st21nfc_unregister_st54spi_cb();
 #endif
 	}
+	debugfs_remove(st54spi->power_dentry);
+	debugfs_remove(st54spi->lat_dentry);
+	st54spi_power_flush(st54spi);
+
     /* make sure ops on existing fds can abort cleanly */
 	spin_lock_irq(&st54spi->spi_lock);
 	st54spi->spi = NULL;
@@ -1170,7 +1595,7 @@ static int st54spi_remove(struct spi_device *spi)
 	device_destroy(st54spi_class, st54spi->devt);
 	clear_bit(MINOR(st54spi->devt), minors);
 	if (st54spi->users == 0)
-		kfree(st54spi);
+		st54spi_free(st54spi);
 
 	mutex_unlock(&device_list_lock);
 
@@ -1206,6 +1631,8 @@ static int __init st54spi_init(void)
 	 * the driver which manages those device numbers.
 	 */
 	BUILD_BUG_ON(N_SPI_MINORS > 256);
+	st54spi_debugfs_dir = debugfs_create_dir("st54spi", NULL);
+
 	spidev_major = __register_chrdev(0, 0, N_SPI_MINORS,
 		"spi", &st54spi_fops);
 	pr_info("Loading st54spi driver, major: %d\n", spidev_major);
@@ -1213,6 +1640,7 @@ static int __init st54spi_init(void)
 	st54spi_class = class_create(THIS_MODULE, "eSE");
 	if (IS_ERR(st54spi_class)) {
 		unregister_chrdev(spidev_major, st54spi_spi_driver.driver.name);
+		debugfs_remove_recursive(st54spi_debugfs_dir);
 		return PTR_ERR(st54spi_class);
 	}
 
@@ -1220,6 +1648,7 @@ static int __init st54spi_init(void)
 	if (status < 0) {
 		class_destroy(st54spi_class);
 		unregister_chrdev(spidev_major, st54spi_spi_driver.driver.name);
+		debugfs_remove_recursive(st54spi_debugfs_dir);
 	}
 	pr_info("Loading st54spi driver: %d\n", status);
 	return status;
@@ -1228,6 +1657,7 @@ module_init(st54spi_init);
 
 static void __exit st54spi_exit(void)
 {
+	debugfs_remove_recursive(st54spi_debugfs_dir);
 	spi_unregister_driver(&st54spi_spi_driver);
 	class_destroy(st54spi_class);
 	unregister_chrdev(spidev_major, st54spi_spi_driver.driver.name);
@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM st54spi
+
+#if !defined(_ST54SPI_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _ST54SPI_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(st54spi_xfer,
+	    TP_PROTO(unsigned int len, int status, u64 delta_ns, u64 idle_ns),
+	    TP_ARGS(len, status, delta_ns, idle_ns),
+	    TP_STRUCT__entry(__field(unsigned int, len)
+			     __field(int, status)
+			     __field(u64, delta_ns)
+			     __field(u64, idle_ns)),
+	    TP_fast_assign(__entry->len = len;
+			   __entry->status = status;
+			   __entry->delta_ns = delta_ns;
+			   __entry->idle_ns = idle_ns;),
+	    TP_printk("len %u status %d took %llu ns after %llu ns idle",
+		      __entry->len, __entry->status, __entry->delta_ns,
+		      __entry->idle_ns));
+
+TRACE_EVENT(st54spi_power,
+	    TP_PROTO(bool on, u64 delta_ns),
+	    TP_ARGS(on, delta_ns),
+	    TP_STRUCT__entry(__field(bool, on)
+			     __field(u64, delta_ns)),
+	    TP_fast_assign(__entry->on = on;
+			   __entry->delta_ns = delta_ns;),
+	    TP_printk("power %s took %llu ns", __entry->on ? "on" : "off",
+		      __entry->delta_ns));
+
+#endif /* _ST54SPI_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../../../motorola/kernel/modules/drivers/ese/st54x
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE st54spi_trace
+#include <trace/define_trace.h>
@@ -37,6 +37,10 @@
 #include <linux/pinctrl/pinctrl.h>
 #include <linux/pinctrl/pinconf-generic.h>
 #include <linux/of_gpio.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdomain.h>
+#include <linux/mutex.h>
 
 #define PCAL6408_DBG(msg, ...) \
 	pr_debug("pcal6048: [%s] "msg, __func__, ##__VA_ARGS__)
@@ -50,12 +54,24 @@
 #define PCAL6408_ADDR_CONFIG	0x03
 #define PCAL6408_ADDR_PULL_EN	0x43
 #define PCAL6408_ADDR_PULL_CFG	0x44
+#define PCAL6408_ADDR_INT_MASK	0x45
+#define PCAL6408_ADDR_INT_STAT	0x46
 
+#define TCA6418_ADDR_CFG		0x01
+#define TCA6418_ADDR_CFG_INT_STAT	0x02
+#define TCA6418_ADDR_INT_STAT	0x11
 #define TCA6418_ADDR_INPUT		0x14
 #define TCA6418_ADDR_OUTPUT		0x17
+#define TCA6418_ADDR_INT_EN		0x1A
 #define TCA6418_ADDR_CONFIG		0x23
+#define TCA6418_ADDR_INT_LVL	0x26
 #define TCA6418_ADDR_PULL_CFG	0x2C
 
+#define TCA6418_GPI_INT		BIT(1)
+
+/* Registers per function, tca6418e has 18 gpios */
+#define PCAL6048_MAX_BANKS	3
+
 #define BIAS_PULL_UP	0
 #define BIAS_PULL_DOWN	1
 #define BIAS_NO_PULL	2
@@ -74,6 +90,13 @@ struct pcal6048_config {
 	int (*set_pullup)(int, struct pcal6048_dev *);
 	int (*set_nopull)(int, struct pcal6048_dev *);
 	int (*get_pull)(int, struct pcal6048_dev *);
+	bool (*volatile_reg)(unsigned int);
+	int irq_mask;	/* 0 if there is no interrupt support */
+	int irq_mask_val;
+	int irq_status;
+	int irq_level;	/* 0 if the edge is not programmable */
+	int (*irq_init)(struct pcal6048_dev *);
+	int (*irq_ack)(struct pcal6048_dev *);
 };
 
 struct pcal6048_dev {
@@ -87,6 +110,16 @@ struct pcal6048_dev {
 	struct pinctrl_dev *pctl_dev;
 	struct pinctrl_gpio_range grange;
 	int	reset_gpio;
+
+	/* Interrupt controller, per bank and in register bit order */
+	struct irq_chip		irq_chip;
+	struct irq_domain	*irq_domain;
+	struct mutex		irq_lock;
+	u8			irq_enabled[PCAL6048_MAX_BANKS];
+	u8			irq_enabled_hw[PCAL6048_MAX_BANKS];
+	u8			irq_rise[PCAL6048_MAX_BANKS];
+	u8			irq_fall[PCAL6048_MAX_BANKS];
+	u8			irq_input[PCAL6048_MAX_BANKS];
 };
 
 static int pcal6048_set_reg(struct pcal6048_dev *chip, int gpio, int reg);
@@ -160,6 +193,10 @@ static const struct pcal6048_config pcal6408a_conf = {
 	.direction = PCAL6408_ADDR_CONFIG,
 	.output = PCAL6408_ADDR_OUTPUT,
 	.input = PCAL6408_ADDR_INPUT,
+	/* Interrupts on any change, cleared by reading the input port */
+	.irq_mask = PCAL6408_ADDR_INT_MASK,
+	.irq_mask_val = 1, /* Set 1 to mask the interrupt */
+	.irq_status = PCAL6408_ADDR_INT_STAT,
 };
 
 static int tca6418_get_bit(int gpio)
@@ -204,6 +241,25 @@ static int tca6418_get_pull(int gpio, struct pcal6048_dev *chip)
 		return BIAS_NO_PULL;
 }
 
+static bool tca6418_volatile_reg(unsigned int reg)
+{
+	return reg == TCA6418_ADDR_CFG_INT_STAT;
+}
+
+static int tca6418_irq_init(struct pcal6048_dev *chip)
+{
+	/* Route gpio interrupts to the INT pin */
+	return regmap_update_bits(chip->regmap, TCA6418_ADDR_CFG,
+			TCA6418_GPI_INT, TCA6418_GPI_INT);
+}
+
+static int tca6418_irq_ack(struct pcal6048_dev *chip)
+{
+	/* Write 1 to clear, the per gpio status is cleared on read */
+	return regmap_write(chip->regmap, TCA6418_ADDR_CFG_INT_STAT,
+			TCA6418_GPI_INT);
+}
+
 static const struct pcal6048_config tca6418e_conf = {
 	.name = "tca6418e_conf",
 	.nr_gpio = 18,
@@ -216,6 +272,14 @@ static const struct pcal6048_config tca6418e_conf = {
 	.direction = TCA6418_ADDR_CONFIG,
 	.output = TCA6418_ADDR_OUTPUT,
 	.input = TCA6418_ADDR_INPUT,
+	.volatile_reg = tca6418_volatile_reg,
+	/* One edge per gpio, picked by the level register */
+	.irq_mask = TCA6418_ADDR_INT_EN,
+	.irq_mask_val = 0, /* Set 0 to mask the interrupt */
+	.irq_status = TCA6418_ADDR_INT_STAT,
+	.irq_level = TCA6418_ADDR_INT_LVL,
+	.irq_init = tca6418_irq_init,
+	.irq_ack = tca6418_irq_ack,
 };
 
 static int pcal6048_read_reg(struct pcal6048_dev *chip, int gpio, int reg)
@@ -245,7 +309,8 @@ static int pcal6048_set_reg(struct pcal6048_dev *chip, int gpio, int reg)
 	PCAL6408_DBG("%s (gpio %d), set bit %d in 0x%x\n",
 		chip->conf->name, gpio, bit_num, reg + reg_off);
 
-	return regmap_write_bits(chip->regmap, reg + reg_off, bit, bit);
+	/* Cached, so this is one write, or none if the bit is already set */
+	return regmap_update_bits(chip->regmap, reg + reg_off, bit, bit);
 }
 
 static int pcal6048_clear_reg(struct pcal6048_dev *chip, int gpio, int reg)
@@ -257,7 +322,7 @@ static int pcal6048_clear_reg(struct pcal6048_dev *chip, int gpio, int reg)
 	PCAL6408_DBG("%s (gpio %d), clear bit %d in 0x%x\n",
 		chip->conf->name, gpio, bit_num, reg + reg_off);
 
-	return regmap_write_bits(chip->regmap, reg + reg_off, bit, 0);
+	return regmap_update_bits(chip->regmap, reg + reg_off, bit, 0);
 }
 
 static int pcal6048_direction_in(struct gpio_chip *gc, unsigned offset)
@@ -288,7 +353,11 @@ static int pcal6048_direction_out(struct gpio_chip *gc, unsigned offset, int val
 	struct pcal6048_dev *chip = gpiochip_get_data(gc);
 	int ret;
 
-	ret = pcal6048_set_reg(chip, offset, chip->conf->output);
+	/* Latch the level first so the pin never drives a stale one */
+	if (value)
+		ret = pcal6048_set_reg(chip, offset, chip->conf->output);
+	else
+		ret = pcal6048_clear_reg(chip, offset, chip->conf->output);
 	if (ret)
 		return ret;
 
@@ -297,8 +366,6 @@ static int pcal6048_direction_out(struct gpio_chip *gc, unsigned offset, int val
 	else
 		ret = pcal6048_clear_reg(chip, offset, chip->conf->direction);
 
-	pcal6048_set_gpio(gc, offset, value);
-
 	return ret;
 }
 
@@ -322,6 +389,61 @@ static int pcal6048_get_gpio(struct gpio_chip *gc, unsigned offset)
 	return pcal6048_read_reg(chip, offset, chip->conf->input);
 }
 
+/* One register access per bank instead of one per gpio */
+static int pcal6048_get_multiple(struct gpio_chip *gc, unsigned long *mask,
+		unsigned long *bits)
+{
+	struct pcal6048_dev *chip = gpiochip_get_data(gc);
+	unsigned int val[PCAL6048_MAX_BANKS] = { 0 };
+	unsigned long read = 0;
+	int gpio, bank, ret;
+
+	for_each_set_bit(gpio, mask, gc->ngpio) {
+		bank = gpio / 8;
+		if (!test_bit(bank, &read)) {
+			ret = regmap_read(chip->regmap,
+					chip->conf->input + bank, &val[bank]);
+			if (ret < 0)
+				return ret;
+			__set_bit(bank, &read);
+		}
+
+		if (val[bank] & BIT(chip->conf->get_bit(gpio)))
+			__set_bit(gpio, bits);
+		else
+			__clear_bit(gpio, bits);
+	}
+
+	return 0;
+}
+
+static void pcal6048_set_multiple(struct gpio_chip *gc, unsigned long *mask,
+		unsigned long *bits)
+{
+	struct pcal6048_dev *chip = gpiochip_get_data(gc);
+	u8 bank_mask[PCAL6048_MAX_BANKS] = { 0 };
+	u8 bank_val[PCAL6048_MAX_BANKS] = { 0 };
+	int gpio, bank;
+	u8 bit;
+
+	for_each_set_bit(gpio, mask, gc->ngpio) {
+		bank = gpio / 8;
+		bit = BIT(chip->conf->get_bit(gpio));
+		bank_mask[bank] |= bit;
+		if (test_bit(gpio, bits))
+			bank_val[bank] |= bit;
+	}
+
+	for (bank = 0; bank < PCAL6048_MAX_BANKS; bank++) {
+		if (!bank_mask[bank])
+			continue;
+
+		if (regmap_update_bits(chip->regmap, chip->conf->output + bank,
+				bank_mask[bank], bank_val[bank]))
+			PCAL6408_ERR("Failed to set bank %d\n", bank);
+	}
+}
+
 static int pcal6048_set_config(struct gpio_chip *gc, unsigned int offset, unsigned long config)
 {
 	struct pcal6048_dev *chip = gpiochip_get_data(gc);
@@ -413,11 +535,241 @@ static void pcal6048_setup_gpio_chip(struct pcal6048_dev *chip)
 	gc->get_direction = pcal6048_get_direction;
 	gc->get	= pcal6048_get_gpio;
 	gc->set	= pcal6048_set_gpio;
+	gc->get_multiple = pcal6048_get_multiple;
+	gc->set_multiple = pcal6048_set_multiple;
 	gc->set_config = pcal6048_set_config;
 	gc->dbg_show = pcal6048_dbg_show;
 	gc->can_sleep = true;
 }
 
+static void pcal6048_irq_mask(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+	int gpio = irqd_to_hwirq(d);
+
+	chip->irq_enabled[gpio / 8] &= ~BIT(chip->conf->get_bit(gpio));
+}
+
+static void pcal6048_irq_unmask(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+	int gpio = irqd_to_hwirq(d);
+
+	chip->irq_enabled[gpio / 8] |= BIT(chip->conf->get_bit(gpio));
+}
+
+static int pcal6048_irq_set_type(struct irq_data *d, unsigned int type)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+	int gpio = irqd_to_hwirq(d);
+	int bank = gpio / 8;
+	u8 bit = BIT(chip->conf->get_bit(gpio));
+
+	type &= IRQ_TYPE_SENSE_MASK;
+	if (!(type & IRQ_TYPE_EDGE_BOTH) || (type & IRQ_TYPE_LEVEL_MASK))
+		return -EINVAL;
+
+	/* The level register picks a single edge */
+	if (chip->conf->irq_level && type == IRQ_TYPE_EDGE_BOTH)
+		return -EINVAL;
+
+	if (type & IRQ_TYPE_EDGE_RISING)
+		chip->irq_rise[bank] |= bit;
+	else
+		chip->irq_rise[bank] &= ~bit;
+
+	if (type & IRQ_TYPE_EDGE_FALLING)
+		chip->irq_fall[bank] |= bit;
+	else
+		chip->irq_fall[bank] &= ~bit;
+
+	return 0;
+}
+
+static void pcal6048_irq_bus_lock(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+
+	mutex_lock(&chip->irq_lock);
+}
+
+/* Mask and edge changes are written here, where sleeping is allowed */
+static void pcal6048_irq_bus_sync_unlock(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+	const struct pcal6048_config *conf = chip->conf;
+	int bank, nbanks = DIV_ROUND_UP(conf->nr_gpio, 8);
+	unsigned int val;
+	u8 mask;
+
+	for (bank = 0; bank < nbanks; bank++) {
+		if (conf->irq_level)
+			regmap_update_bits(chip->regmap, conf->irq_level + bank,
+					0xFF, chip->irq_rise[bank]);
+
+		/* Newly enabled pins report changes from their current level */
+		if ((chip->irq_enabled[bank] & ~chip->irq_enabled_hw[bank]) &&
+		    !regmap_read(chip->regmap, conf->input + bank, &val))
+			chip->irq_input[bank] = val;
+
+		mask = conf->irq_mask_val ? ~chip->irq_enabled[bank] :
+				chip->irq_enabled[bank];
+		regmap_update_bits(chip->regmap, conf->irq_mask + bank, 0xFF, mask);
+		chip->irq_enabled_hw[bank] = chip->irq_enabled[bank];
+	}
+
+	mutex_unlock(&chip->irq_lock);
+}
+
+static int pcal6048_irq_reqres(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+
+	return gpiochip_lock_as_irq(&chip->gpio_chip, irqd_to_hwirq(d));
+}
+
+static void pcal6048_irq_relres(struct irq_data *d)
+{
+	struct pcal6048_dev *chip = irq_data_get_irq_chip_data(d);
+
+	gpiochip_unlock_as_irq(&chip->gpio_chip, irqd_to_hwirq(d));
+}
+
+static irqreturn_t pcal6048_irq_thread(int irq, void *data)
+{
+	struct pcal6048_dev *chip = data;
+	const struct pcal6048_config *conf = chip->conf;
+	int bank, nbanks = DIV_ROUND_UP(conf->nr_gpio, 8);
+	u8 input[PCAL6048_MAX_BANKS], pending[PCAL6048_MAX_BANKS];
+	u8 hw_edge[PCAL6048_MAX_BANKS];
+	u8 rise[PCAL6048_MAX_BANKS], fall[PCAL6048_MAX_BANKS];
+	unsigned int val, status;
+	int gpio, high;
+	u8 bit;
+
+	mutex_lock(&chip->irq_lock);
+	for (bank = 0; bank < nbanks; bank++) {
+		status = 0;
+		if (conf->irq_status &&
+		    regmap_read(chip->regmap, conf->irq_status + bank, &status))
+			status = 0;
+		if (regmap_read(chip->regmap, conf->input + bank, &val))
+			val = chip->irq_input[bank];
+
+		input[bank] = val;
+		pending[bank] = (status | (val ^ chip->irq_input[bank])) &
+				chip->irq_enabled_hw[bank];
+		/* With a level register the chip already matched the edge */
+		hw_edge[bank] = conf->irq_level ? status : 0;
+		rise[bank] = chip->irq_rise[bank];
+		fall[bank] = chip->irq_fall[bank];
+		chip->irq_input[bank] = val;
+	}
+	mutex_unlock(&chip->irq_lock);
+
+	if (conf->irq_ack && conf->irq_ack(chip))
+		PCAL6408_ERR("Failed to ack interrupt\n");
+
+	for (gpio = 0; gpio < conf->nr_gpio; gpio++) {
+		bank = gpio / 8;
+		bit = BIT(conf->get_bit(gpio));
+		if (!(pending[bank] & bit))
+			continue;
+
+		high = input[bank] & bit;
+		if (!(hw_edge[bank] & bit) &&
+		    !(high ? rise[bank] & bit : fall[bank] & bit))
+			continue;
+
+		handle_nested_irq(irq_find_mapping(chip->irq_domain, gpio));
+	}
+
+	return IRQ_HANDLED;
+}
+
+static int pcal6048_irq_map(struct irq_domain *domain, unsigned int irq,
+		irq_hw_number_t hwirq)
+{
+	struct pcal6048_dev *chip = domain->host_data;
+
+	irq_set_chip_data(irq, chip);
+	irq_set_chip_and_handler(irq, &chip->irq_chip, handle_simple_irq);
+	irq_set_nested_thread(irq, 1);
+	irq_set_noprobe(irq);
+
+	return 0;
+}
+
+static const struct irq_domain_ops pcal6048_irq_domain_ops = {
+	.map = pcal6048_irq_map,
+	.xlate = irq_domain_xlate_twocell,
+};
+
+static int pcal6048_to_irq(struct gpio_chip *gc, unsigned offset)
+{
+	struct pcal6048_dev *chip = gpiochip_get_data(gc);
+
+	return irq_create_mapping(chip->irq_domain, offset);
+}
+
+static int pcal6048_setup_irq(struct pcal6048_dev *chip)
+{
+	const struct pcal6048_config *conf = chip->conf;
+	struct irq_chip *ic = &chip->irq_chip;
+	int bank, nbanks = DIV_ROUND_UP(conf->nr_gpio, 8);
+	unsigned int val;
+	int rc;
+
+	if (chip->client->irq <= 0 || !conf->irq_mask ||
+	    !of_property_read_bool(chip->dev->of_node, "interrupt-controller"))
+		return 0;
+
+	mutex_init(&chip->irq_lock);
+
+	/* Start with every pin masked */
+	for (bank = 0; bank < nbanks; bank++) {
+		rc = regmap_write(chip->regmap, conf->irq_mask + bank,
+				conf->irq_mask_val ? 0xFF : 0);
+		if (rc)
+			return rc;
+		if (!regmap_read(chip->regmap, conf->input + bank, &val))
+			chip->irq_input[bank] = val;
+	}
+
+	if (conf->irq_init) {
+		rc = conf->irq_init(chip);
+		if (rc)
+			return rc;
+	}
+
+	ic->name = conf->name;
+	ic->irq_mask = pcal6048_irq_mask;
+	ic->irq_unmask = pcal6048_irq_unmask;
+	ic->irq_set_type = pcal6048_irq_set_type;
+	ic->irq_bus_lock = pcal6048_irq_bus_lock;
+	ic->irq_bus_sync_unlock = pcal6048_irq_bus_sync_unlock;
+	ic->irq_request_resources = pcal6048_irq_reqres;
+	ic->irq_release_resources = pcal6048_irq_relres;
+	ic->flags = IRQCHIP_SKIP_SET_WAKE;
+
+	chip->irq_domain = irq_domain_add_linear(chip->dev->of_node,
+			conf->nr_gpio, &pcal6048_irq_domain_ops, chip);
+	if (!chip->irq_domain)
+		return -ENOMEM;
+
+	rc = devm_request_threaded_irq(chip->dev, chip->client->irq, NULL,
+			pcal6048_irq_thread, IRQF_ONESHOT, chip->name, chip);
+	if (rc) {
+		irq_domain_remove(chip->irq_domain);
+		chip->irq_domain = NULL;
+		return rc;
+	}
+
+	chip->gpio_chip.to_irq = pcal6048_to_irq;
+
+	return 0;
+}
+
 static int pcal6048_pinconf_get(struct pinctrl_dev *pctldev,
 			unsigned pin, unsigned long *config)
 {
@@ -506,10 +858,29 @@ static int pcal6048_register_pinctrl(struct pcal6048_dev *chip)
 	return 0;
 }
 
+static bool pcal6048_volatile_reg(struct device *dev, unsigned int reg)
+{
+	struct pcal6048_dev *chip = dev_get_drvdata(dev);
+	const struct pcal6048_config *conf = chip->conf;
+	unsigned int nbanks = DIV_ROUND_UP(conf->nr_gpio, 8);
+
+	if (reg >= conf->input && reg < conf->input + nbanks)
+		return true;
+
+	if (conf->irq_status && reg >= conf->irq_status &&
+	    reg < conf->irq_status + nbanks)
+		return true;
+
+	return conf->volatile_reg && conf->volatile_reg(reg);
+}
+
+/* Output, direction, pull and mask only change through this driver */
 static const struct regmap_config pcal6048_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
 	.max_register = 0xFF,
+	.volatile_reg = pcal6048_volatile_reg,
+	.cache_type = REGCACHE_RBTREE,
 };
 
 static const struct of_device_id pcal6048_match_table[] = {
@@ -557,14 +928,6 @@ static int pcal6048_probe(struct i2c_client *client,
 	chip->dev = &client->dev;
 	chip->name = "pcal6048";
 
-	chip->regmap = regmap_init_i2c(client, &pcal6048_regmap_config);
-	if (IS_ERR(chip->regmap)) {
-		PCAL6408_ERR("Couldn't initialize register regmap rc = %ld\n",
-				PTR_ERR(chip->regmap));
-		rc = PTR_ERR(chip->regmap);
-		goto free_mem;
-	}
-
 	match = of_match_device(pcal6048_match_table, chip->dev);
 	if (!match || !match->data) {
 		PCAL6408_ERR("Missing config data!\n");
@@ -574,12 +937,27 @@ static int pcal6048_probe(struct i2c_client *client,
 	chip->conf = match->data;
 	PCAL6408_DBG("Using config %s\n", chip->conf->name);
 
+	/* The regmap cache looks the config up to find volatile registers */
 	i2c_set_clientdata(client, chip);
 	dev_set_drvdata(chip->dev, chip);
 
+	chip->regmap = regmap_init_i2c(client, &pcal6048_regmap_config);
+	if (IS_ERR(chip->regmap)) {
+		PCAL6408_ERR("Couldn't initialize register regmap rc = %ld\n",
+				PTR_ERR(chip->regmap));
+		rc = PTR_ERR(chip->regmap);
+		goto free_mem;
+	}
+
 	pcal6048_setup_gpio_chip(chip);
 	pcal6048_config_reset(chip);
 
+	rc = pcal6048_setup_irq(chip);
+	if (rc) {
+		PCAL6408_ERR("Couldn't set up interrupts rc=%d\n", rc);
+		rc = 0;
+	}
+
 	rc = devm_gpiochip_add_data(chip->dev, &chip->gpio_chip, chip);
 	if (rc) {
 		PCAL6408_ERR("Couldn't add gpio chip rc=%d\n", rc);
@@ -597,6 +975,17 @@ free_mem:
 
 static int pcal6048_remove(struct i2c_client *client)
 {
+	struct pcal6048_dev *chip = i2c_get_clientdata(client);
+	int gpio;
+
+	if (chip->irq_domain) {
+		devm_free_irq(chip->dev, client->irq, chip);
+		for (gpio = 0; gpio < chip->conf->nr_gpio; gpio++)
+			irq_dispose_mapping(irq_find_mapping(chip->irq_domain,
+					gpio));
+		irq_domain_remove(chip->irq_domain);
+	}
+
 	return 0;
 }
 
@@ -25,6 +25,9 @@
 #endif
 #include <net/sock.h>		/* sockfd_lookup */
 #include <linux/file.h>		/* fput */
+#include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include "mc_user.h"
 #include "mc_admin.h"
@@ -61,6 +64,27 @@ struct tee_client {
 	struct list_head	list;
 	/* task_struct for the client application, if going through a proxy */
 	struct task_struct	*task;
+	/* Asynchronous notifications, allocated on first use */
+	struct client_async	*async;
+};
+
+/* Size of the completion ring, must be a power of 2 */
+#define CLIENT_ASYNC_CQ_SIZE	256
+
+/*
+ * Completion ring of asynchronous notifications. A slot is reserved at
+ * submission so that completions posted by the notification worker never
+ * overflow.
+ */
+struct client_async {
+	spinlock_t		lock;		/* Ring and counters */
+	wait_queue_head_t	wq;		/* Reapers and pollers */
+	u32			head;		/* Next entry to reap */
+	u32			tail;		/* Next entry to post */
+	u32			inflight;	/* Submitted, not yet completed */
+	u64			submitted;
+	u64			completed;
+	struct mc_ioctl_async_cqe cqes[CLIENT_ASYNC_CQ_SIZE];
 };
 
 /* Context */
@@ -428,6 +452,7 @@ static void client_release(struct kref *kref)
 	if (client->task)
 		put_task_struct(client->task);
 
+	kfree(client->async);
 	kfree(client);
 	/* Decrement debug counter */
 	atomic_dec(&g_ctx.c_clients);
@@ -774,6 +799,215 @@ int client_notify_session(struct tee_client *client, u32 session_id)
 	return ret;
 }
 
+static struct client_async *client_async_get(struct tee_client *client)
+{
+	struct client_async *async = READ_ONCE(client->async);
+
+	if (async)
+		return async;
+
+	async = kzalloc(sizeof(*async), GFP_KERNEL);
+	if (!async)
+		return NULL;
+
+	spin_lock_init(&async->lock);
+	init_waitqueue_head(&async->wq);
+	if (cmpxchg(&client->async, NULL, async)) {
+		/* Someone else was faster */
+		kfree(async);
+		async = client->async;
+	}
+
+	return async;
+}
+
+static inline u32 client_async_ready(struct client_async *async)
+{
+	u32 ready;
+
+	spin_lock(&async->lock);
+	ready = async->tail - async->head;
+	spin_unlock(&async->lock);
+	return ready;
+}
+
+static bool client_async_reserve(struct client_async *async)
+{
+	bool ret = false;
+
+	spin_lock(&async->lock);
+	if (async->inflight + async->tail - async->head < CLIENT_ASYNC_CQ_SIZE) {
+		async->inflight++;
+		ret = true;
+	}
+	spin_unlock(&async->lock);
+	return ret;
+}
+
+static void client_async_unreserve(struct client_async *async)
+{
+	spin_lock(&async->lock);
+	async->inflight--;
+	spin_unlock(&async->lock);
+}
+
+/*
+ * Called from the notification worker, post the completion of a session
+ * submitted by client_async_submit.
+ */
+void client_async_complete(struct tee_client *client, u32 session_id,
+			   int result, u64 user_data)
+{
+	struct client_async *async = client->async;
+	struct mc_ioctl_async_cqe *cqe;
+
+	spin_lock(&async->lock);
+	cqe = &async->cqes[async->tail & (CLIENT_ASYNC_CQ_SIZE - 1)];
+	cqe->sid = session_id;
+	cqe->result = result;
+	cqe->user_data = user_data;
+	async->tail++;
+	async->inflight--;
+	async->completed++;
+	spin_unlock(&async->lock);
+	wake_up_interruptible(&async->wq);
+	mc_dev_devel("session %x, completed with %d", session_id, result);
+}
+
+/*
+ * Notify TAs, their next notification is posted to the completion ring.
+ * Entries are processed in order until the first failure.
+ * @return number of entries submitted, or driver error code if none
+ */
+int client_async_submit(struct tee_client *client,
+			const struct mc_ioctl_async_sqe *sqes, int nr)
+{
+	struct tee_session *sessions[MC_ASYNC_BATCH_MAX];
+	struct client_async *async;
+	int i, n = 0, ret = 0;
+
+	if (nr <= 0 || nr > MC_ASYNC_BATCH_MAX)
+		return -EINVAL;
+
+	async = client_async_get(client);
+	if (!async)
+		return -ENOMEM;
+
+	for (i = 0; i < nr; i++) {
+		struct tee_session *session;
+
+		if (sqes[i].rfu) {
+			ret = -EINVAL;
+			break;
+		}
+
+		if (!client_async_reserve(async)) {
+			ret = -EBUSY;
+			break;
+		}
+
+		session = client_get_session(client, sqes[i].sid);
+		if (!session) {
+			client_async_unreserve(async);
+			ret = -ENXIO;
+			break;
+		}
+
+		ret = session_mc_async_arm(session, sqes[i].user_data);
+		if (ret) {
+			session_put(session);
+			client_async_unreserve(async);
+			break;
+		}
+
+		sessions[n++] = session;
+	}
+
+	if (n) {
+		/* One SWd schedule request for the whole batch */
+		ret = session_mc_notify_batch(sessions, n);
+		for (i = 0; i < n; i++) {
+			if (ret && session_mc_async_disarm(sessions[i]))
+				client_async_unreserve(async);
+
+			session_put(sessions[i]);
+		}
+
+		if (ret)
+			n = 0;
+	}
+
+	spin_lock(&async->lock);
+	async->submitted += n;
+	spin_unlock(&async->lock);
+	mc_dev_devel("submitted %d/%d, exit with %d", n, nr, ret);
+	return n ? n : ret;
+}
+
+/*
+ * Get completions, waiting for at least min_complete of them.
+ * @return number of entries reaped, or driver error code
+ */
+int client_async_reap(struct tee_client *client,
+		      struct mc_ioctl_async_cqe *cqes, int nr,
+		      u32 min_complete, s32 timeout)
+{
+	struct client_async *async;
+	long ret;
+	int i, n;
+
+	if (nr <= 0 || nr > MC_ASYNC_BATCH_MAX || min_complete > nr)
+		return -EINVAL;
+
+	async = client_async_get(client);
+	if (!async)
+		return -ENOMEM;
+
+	if (min_complete) {
+		if (timeout < 0) {
+			ret = wait_event_interruptible(async->wq,
+				client_async_ready(async) >= min_complete);
+		} else {
+			ret = wait_event_interruptible_timeout(async->wq,
+				client_async_ready(async) >= min_complete,
+				msecs_to_jiffies(timeout));
+			if (!ret)
+				return -ETIME;
+
+			if (ret > 0)
+				ret = 0;
+		}
+
+		if (ret)
+			return ret;
+	}
+
+	spin_lock(&async->lock);
+	n = min_t(u32, async->tail - async->head, nr);
+	for (i = 0; i < n; i++)
+		cqes[i] = async->cqes[(async->head + i) &
+				      (CLIENT_ASYNC_CQ_SIZE - 1)];
+
+	async->head += n;
+	spin_unlock(&async->lock);
+	return n;
+}
+
+__poll_t client_async_poll(struct tee_client *client, struct file *file,
+			   struct poll_table_struct *wait)
+{
+	struct client_async *async = READ_ONCE(client->async);
+
+	if (!async)
+		return 0;
+
+	poll_wait(file, &async->wq, wait);
+	if (client_async_ready(async))
+		return EPOLLIN | EPOLLRDNORM;
+
+	return 0;
+}
+
 /*
  * Wait for a notification from TA
  * @return driver error code
@@ -1403,6 +1637,24 @@ static int client_debug_structs(struct kasnprintf_buf *buf,
 	if (ret < 0)
 		return ret;
 
+	if (client->async) {
+		struct client_async *async = client->async;
+		u32 inflight, ready;
+		u64 submitted, completed;
+
+		spin_lock(&async->lock);
+		inflight = async->inflight;
+		ready = async->tail - async->head;
+		submitted = async->submitted;
+		completed = async->completed;
+		spin_unlock(&async->lock);
+		ret = kasnprintf(buf,
+				 "\tasync: inflight %u ready %u submitted %llu completed %llu\n",
+				 inflight, ready, submitted, completed);
+		if (ret < 0)
+			return ret;
+	}
+
 	/* Buffers */
 	mutex_lock(&client->cbufs_lock);
 	if (list_empty(&client->cbufs))
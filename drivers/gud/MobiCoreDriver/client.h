@@ -25,6 +25,8 @@ struct tee_client;
 struct mcp_open_info;
 struct tee_mmu;
 struct interworld_session;
+struct file;
+struct poll_table_struct;
 
 /* Client */
 struct tee_client *client_create(bool is_from_kernel);
@@ -47,6 +49,17 @@ int client_remove_session(struct tee_client *client, u32 session_id);
 int client_notify_session(struct tee_client *client, u32 session_id);
 int client_waitnotif_session(struct tee_client *client, u32 session_id,
 			     s32 timeout, bool silent_expiry);
+
+/* MC asynchronous notifications */
+int client_async_submit(struct tee_client *client,
+			const struct mc_ioctl_async_sqe *sqes, int nr);
+int client_async_reap(struct tee_client *client,
+		      struct mc_ioctl_async_cqe *cqes, int nr,
+		      u32 min_complete, s32 timeout);
+void client_async_complete(struct tee_client *client, u32 session_id,
+			   int result, u64 user_data);
+__poll_t client_async_poll(struct tee_client *client, struct file *file,
+			   struct poll_table_struct *wait);
 int client_get_session_exitcode(struct tee_client *client, u32 session_id,
 				s32 *exit_code);
 int client_mc_map(struct tee_client *client, u32 session_id,
@@ -0,0 +1,468 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Simulated secure world
+ *
+ * Replaces fastcall.c when built with MC_SIMULATED_SWD=y. Instead of issuing
+ * SMCs, the fastcalls below play the part of the TEE: they consume the NWd
+ * notification queue, answer MCP commands in the MCP buffer, complete IWP
+ * operations in the interworld session buffer and echo TCI notifications back
+ * as if the TA had processed them. The S-SIQ is raised in software.
+ *
+ * Latencies can be injected through debugfs (all in microseconds):
+ *   sim_switch_latency_us  cost of each world switch (N-SIQ or yield)
+ *   sim_mcp_latency_us     cost of processing one MCP command
+ *   sim_cmd_latency_us     cost of one TA command (TCI or IWP)
+ *
+ * sim_log_msgs makes the SWd write that many synthetic log messages into the
+ * trace buffer on each world switch, to measure the log drain throughput.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>	/* local_clock */
+#include <linux/version.h>
+#if KERNEL_VERSION(4, 11, 0) <= LINUX_VERSION_CODE
+#include <linux/sched/clock.h>	/* local_clock */
+#endif
+
+#include "tee_client_api.h"	/* GP error codes/origins */
+#include "mc_user.h"		/* struct mc_version_info */
+
+#include "mcifc.h"
+#include "mciiwp.h"
+#include "mcimcp.h"
+#include "mcinq.h"
+
+#include "main.h"
+#include "logging.h"	/* struct mc_trace_buf */
+#include "nq.h"
+#include "fastcall.h"
+
+/* First session ID handed out, must not clash with SID_MCP or IWP IDs */
+#define SIM_FIRST_SID		0x100
+#define SIM_MAX_SID		0xffff
+
+static struct {
+	struct mutex		lock;		/* Serialises SWd "execution" */
+	/* MCI, as set up by fc_init and the first N-SIQ */
+	struct notification_queue *in;		/* NWd tx queue */
+	struct notification_queue *out;		/* NWd rx queue */
+	struct mcp_buffer	*mcp_buffer;
+	struct interworld_session *iws;
+	u32			iws_size;
+	u32			state;		/* MC_STATUS_* */
+	bool			init_done;	/* init_values consumed */
+	/* Trace buffer, registered by fc_trace_init */
+	phys_addr_t		trace_buffer;
+	u32			trace_size;
+	/* Sessions */
+	u32			next_sid;
+	u16			next_handle;
+	/* Injected latencies */
+	u32			switch_latency_us;
+	u32			mcp_latency_us;
+	u32			cmd_latency_us;
+	/* Synthetic log messages per world switch */
+	u32			log_msgs;
+	/* Counters */
+	u64			c_nsiq;
+	u64			c_yield;
+	u64			c_mcp_cmds;
+	u64			c_iwp_cmds;
+	u64			c_tci_cmds;
+	u64			c_notifs_in;
+	u64			c_notifs_out;
+	u64			c_notifs_dropped;
+	u64			c_log_msgs;
+	u64			busy_ns;	/* Time spent in "SWd" */
+} sim_ctx = {
+	.lock = __MUTEX_INITIALIZER(sim_ctx.lock),
+	.state = MC_STATUS_NOT_INITIALIZED,
+	.next_sid = SIM_FIRST_SID,
+	.next_handle = 1,
+};
+
+static inline void sim_delay(u32 us)
+{
+	if (!us)
+		return;
+
+	if (us < 10)
+		udelay(us);
+	else
+		usleep_range(us, us + us / 8 + 1);
+}
+
+static bool sim_notif_push(u32 session_id, u32 payload)
+{
+	struct notification_queue *q = sim_ctx.out;
+	u32 i;
+
+	if ((q->hdr.write_cnt - q->hdr.read_cnt) >= q->hdr.queue_size) {
+		/* The real SWd would retry later, we just count it */
+		sim_ctx.c_notifs_dropped++;
+		return false;
+	}
+
+	i = q->hdr.write_cnt % q->hdr.queue_size;
+	q->notification[i].session_id = session_id;
+	q->notification[i].payload = payload;
+	/* Ensure notification[] is written before we update the counter */
+	smp_mb();
+	q->hdr.write_cnt++;
+	sim_ctx.c_notifs_out++;
+	return true;
+}
+
+static u32 sim_new_sid(void)
+{
+	u32 sid = sim_ctx.next_sid++;
+
+	if (sim_ctx.next_sid > SIM_MAX_SID)
+		sim_ctx.next_sid = SIM_FIRST_SID;
+
+	return sid;
+}
+
+static enum mcp_result sim_mcp_version(struct rsp_get_version *rsp)
+{
+	struct mc_version_info *info = &rsp->version_info;
+
+	memset(info, 0, sizeof(*info));
+	strscpy(info->product_id, "t-base-SIMULATED", sizeof(info->product_id));
+	info->version_mci = MC_VERSION(1, 7);
+	info->version_so = MC_VERSION(2, 0);
+	info->version_mclf = MC_VERSION(2, 0);
+	info->version_container = MC_VERSION(2, 0);
+	info->version_mc_config = MC_VERSION(0, 2);
+	info->version_tl_api = MC_VERSION(1, 0);
+	info->version_dr_api = MC_VERSION(1, 0);
+	return MC_MCP_RET_OK;
+}
+
+/* Answer the MCP command found in the MCP buffer */
+static void sim_mcp_cmd(void)
+{
+	union mcp_message *msg = &sim_ctx.mcp_buffer->message;
+	enum cmd_id cmd_id = msg->cmd_header.cmd_id;
+	enum mcp_result result = MC_MCP_RET_OK;
+
+	sim_ctx.c_mcp_cmds++;
+	sim_delay(sim_ctx.mcp_latency_us);
+	switch (cmd_id) {
+	case MC_MCP_CMD_OPEN_SESSION:
+		msg->rsp_open.session_id = sim_new_sid();
+		break;
+	case MC_MCP_CMD_MAP:
+		/* Any non-zero page aligned VA will do */
+		msg->rsp_map.secure_va = 0x100000 + msg->cmd_map.ofs_buffer;
+		break;
+	case MC_MCP_CMD_GET_MOBICORE_VERSION:
+		result = sim_mcp_version(&msg->rsp_get_version);
+		break;
+	case MC_MCP_CMD_SUSPEND:
+		sim_ctx.mcp_buffer->flags.sleep_mode.ready_to_sleep =
+			MC_STATE_READY_TO_SLEEP;
+		break;
+	case MC_MCP_CMD_RESUME:
+		sim_ctx.mcp_buffer->flags.sleep_mode.ready_to_sleep =
+			MC_STATE_NORMAL_EXECUTION;
+		break;
+	case MC_MCP_CMD_CLOSE_SESSION:
+	case MC_MCP_CMD_UNMAP:
+	case MC_MCP_CMD_CLOSE_MCP:
+	case MC_MCP_CMD_LOAD_TOKEN:
+	case MC_MCP_CMD_CHECK_LOAD_TA:
+	case MC_MCP_CMD_LOAD_SYSENC_KEY_SO:
+		break;
+	default:
+		result = MC_MCP_RET_ERR_UNKNOWN_COMMAND;
+	}
+
+	msg->rsp_header.rsp_id = cmd_id | FLAG_RESPONSE;
+	msg->rsp_header.result = result;
+	sim_notif_push(SID_MCP, 0);
+}
+
+/* Complete the IWP operation found in the given slot */
+static void sim_iwp_cmd(u32 id, u32 slot)
+{
+	struct interworld_session *iws;
+
+	if (!sim_ctx.iws || slot + sizeof(*iws) > sim_ctx.iws_size) {
+		mc_dev_err(-EINVAL, "bad IWP slot 0x%x", slot);
+		return;
+	}
+
+	iws = (struct interworld_session *)((uintptr_t)sim_ctx.iws + slot);
+	sim_ctx.c_iwp_cmds++;
+	if (id != SID_CANCEL_OPERATION)
+		sim_delay(sim_ctx.cmd_latency_us);
+
+	if (id == SID_OPEN_SESSION || id == SID_OPEN_TA) {
+		iws->session_handle = sim_ctx.next_handle++;
+		if (!sim_ctx.next_handle)
+			sim_ctx.next_handle = 1;
+	}
+
+	iws->status = TEEC_SUCCESS;
+	iws->return_origin = TEEC_ORIGIN_TRUSTED_APP;
+	sim_notif_push(id, slot);
+}
+
+/* The TA has processed its TCI and notifies back */
+static void sim_tci_cmd(u32 session_id)
+{
+	sim_ctx.c_tci_cmds++;
+	sim_delay(sim_ctx.cmd_latency_us);
+	sim_notif_push(session_id, 0);
+}
+
+/*
+ * Synthetic TA logging: alternate "sim " strings and decimal counters, one line
+ * every two messages.
+ */
+static void sim_log_produce(void)
+{
+	struct mc_trace_buf *tb;
+	u32 head, i;
+
+	if (!sim_ctx.trace_buffer || !sim_ctx.log_msgs)
+		return;
+
+	tb = phys_to_virt(sim_ctx.trace_buffer);
+	head = tb->head;
+	for (i = 0; i < sim_ctx.log_msgs; i++) {
+		struct mc_logmsg *msg = (struct mc_logmsg *)&tb->buff[head];
+
+		msg->source = 0x5a;
+		if (i & 1) {
+			msg->ctrl = LOG_TYPE_INTEGER | LOG_INTEGER_DECIMAL |
+				    LOG_EOL | (8 << LOG_LENGTH_SHIFT);
+			msg->log_data = (u32)sim_ctx.c_log_msgs;
+		} else {
+			msg->ctrl = LOG_TYPE_CHAR;
+			msg->log_data = 's' | 'i' << 8 | 'm' << 16 | ' ' << 24;
+		}
+
+		sim_ctx.c_log_msgs++;
+		head += sizeof(*msg);
+		if (head + sizeof(*msg) > tb->length)
+			head = 0;
+	}
+
+	/* Ensure messages are written before the NWd sees the new head */
+	smp_wmb();
+	WRITE_ONCE(tb->head, head);
+}
+
+static void sim_init_values(void)
+{
+	struct init_values *iv = &sim_ctx.mcp_buffer->message.init_values;
+
+	if (iv->flags & MC_IV_FLAG_IWP) {
+		sim_ctx.iws = (void *)((uintptr_t)sim_ctx.in +
+				       iv->iws_buf_ofs);
+		sim_ctx.iws_size = iv->iws_buf_size;
+	}
+
+	sim_ctx.init_done = true;
+	sim_ctx.state = MC_STATUS_INITIALIZED;
+}
+
+/* Run the "SWd": consume all pending notifications */
+static int sim_run(void)
+{
+	struct notification_queue *q = sim_ctx.in;
+	u64 start = local_clock();
+	u64 pushed;
+
+	if (!q)
+		return -EINVAL;
+
+	sim_delay(sim_ctx.switch_latency_us);
+	if (!sim_ctx.init_done) {
+		/* First N-SIQ: MCP buffer holds the init values */
+		sim_init_values();
+		goto out;
+	}
+
+	pushed = sim_ctx.c_notifs_out;
+	while ((q->hdr.write_cnt - q->hdr.read_cnt) > 0) {
+		struct notification nf;
+
+		nf = q->notification[q->hdr.read_cnt % q->hdr.queue_size];
+		/* Ensure read_cnt writing happens after buffer read */
+		smp_mb();
+		q->hdr.read_cnt++;
+		sim_ctx.c_notifs_in++;
+
+		if (nf.session_id == SID_MCP)
+			sim_mcp_cmd();
+		else if (nf.session_id & SID_IWP_NOTIFICATION)
+			sim_iwp_cmd(nf.session_id, nf.payload);
+		else
+			sim_tci_cmd(nf.session_id);
+	}
+
+	sim_log_produce();
+
+	/* Raise the S-SIQ if we have anything for the NWd */
+	if (sim_ctx.c_notifs_out != pushed)
+		nq_simulated_ssiq();
+
+out:
+	/* Nothing left to do until the next notification */
+	sim_ctx.mcp_buffer->flags.schedule = MC_FLAG_SCHEDULE_IDLE;
+	sim_ctx.mcp_buffer->flags.timeout_ms = -1;
+	if (sim_ctx.mcp_buffer->flags.sleep_mode.sleep_req ==
+	    MC_FLAG_REQ_TO_SLEEP)
+		sim_ctx.mcp_buffer->flags.sleep_mode.ready_to_sleep =
+			MC_STATE_READY_TO_SLEEP;
+
+	sim_ctx.busy_ns += local_clock() - start;
+	return 0;
+}
+
+static ssize_t debug_sim_read(struct file *file, char __user *user_buf,
+			      size_t count, loff_t *ppos)
+{
+	return debug_generic_read(file, user_buf, count, ppos,
+				  mc_fastcall_debug_smclog);
+}
+
+static const struct file_operations debug_sim_ops = {
+	.read = debug_sim_read,
+	.llseek = default_llseek,
+	.open = debug_generic_open,
+	.release = debug_generic_release,
+};
+
+int fc_init(uintptr_t addr, ptrdiff_t off, size_t q_len, size_t buf_len)
+{
+	struct notification_queue *in;
+
+	mutex_lock(&sim_ctx.lock);
+	if (sim_ctx.in) {
+		mutex_unlock(&sim_ctx.lock);
+		return -EBUSY;
+	}
+
+	/* Addresses come from virt_to_phys(), we run in the same world */
+	sim_ctx.in = phys_to_virt((phys_addr_t)addr);
+	in = sim_ctx.in;
+	sim_ctx.out = (void *)((uintptr_t)in +
+			       sizeof(struct notification_queue_header) +
+			       in->hdr.queue_size *
+			       sizeof(struct notification));
+	sim_ctx.mcp_buffer = (void *)((uintptr_t)in + off);
+	mutex_unlock(&sim_ctx.lock);
+
+	debugfs_create_file("sim_swd", 0400, g_ctx.debug_dir, NULL,
+			    &debug_sim_ops);
+	debugfs_create_u32("sim_switch_latency_us", 0600, g_ctx.debug_dir,
+			   &sim_ctx.switch_latency_us);
+	debugfs_create_u32("sim_mcp_latency_us", 0600, g_ctx.debug_dir,
+			   &sim_ctx.mcp_latency_us);
+	debugfs_create_u32("sim_cmd_latency_us", 0600, g_ctx.debug_dir,
+			   &sim_ctx.cmd_latency_us);
+	debugfs_create_u32("sim_log_msgs", 0600, g_ctx.debug_dir,
+			   &sim_ctx.log_msgs);
+	mc_dev_info("simulated SWd, q_len %zu mcp_len %zu", q_len, buf_len);
+	return 0;
+}
+
+int fc_info(u32 ext_info_id, u32 *state, u32 *ext_info)
+{
+	if (state)
+		*state = sim_ctx.state;
+
+	if (ext_info)
+		*ext_info = 0;
+
+	return 0;
+}
+
+int fc_trace_init(phys_addr_t buffer, u32 size)
+{
+	mutex_lock(&sim_ctx.lock);
+	sim_ctx.trace_buffer = buffer;
+	sim_ctx.trace_size = size;
+	if (buffer) {
+		struct mc_trace_buf *tb = phys_to_virt(buffer);
+
+		tb->length = size - sizeof(*tb);
+		tb->head = 0;
+		tb->version = MC_LOG_VERSION;
+	}
+
+	mutex_unlock(&sim_ctx.lock);
+	return 0;
+}
+
+int fc_trace_deinit(void)
+{
+	return fc_trace_init(0, 0);
+}
+
+int fc_nsiq(u32 session_id, u32 payload)
+{
+	int ret;
+
+	mutex_lock(&sim_ctx.lock);
+	sim_ctx.c_nsiq++;
+	ret = sim_run();
+	mutex_unlock(&sim_ctx.lock);
+	return ret;
+}
+
+int fc_yield(u32 timeslice)
+{
+	int ret;
+
+	mutex_lock(&sim_ctx.lock);
+	sim_ctx.c_yield++;
+	ret = sim_run();
+	mutex_unlock(&sim_ctx.lock);
+	return ret;
+}
+
+int mc_fastcall_debug_smclog(struct kasnprintf_buf *buf)
+{
+	int ret;
+
+	mutex_lock(&sim_ctx.lock);
+	ret = kasnprintf(buf,
+			 "simulated SWd\n"
+			 "  n-siq          %llu\n"
+			 "  yield          %llu\n"
+			 "  mcp commands   %llu\n"
+			 "  iwp commands   %llu\n"
+			 "  tci commands   %llu\n"
+			 "  notifs in      %llu\n"
+			 "  notifs out     %llu\n"
+			 "  notifs dropped %llu\n"
+			 "  log messages   %llu\n"
+			 "  busy (ns)      %llu\n",
+			 sim_ctx.c_nsiq, sim_ctx.c_yield, sim_ctx.c_mcp_cmds,
+			 sim_ctx.c_iwp_cmds, sim_ctx.c_tci_cmds,
+			 sim_ctx.c_notifs_in, sim_ctx.c_notifs_out,
+			 sim_ctx.c_notifs_dropped, sim_ctx.c_log_msgs,
+			 sim_ctx.busy_ns);
+	mutex_unlock(&sim_ctx.lock);
+	return ret;
+}
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/string.h>
+
+#include "main.h"
+#include "latency.h"
+
+#define CREATE_TRACE_POINTS
+#include "mc_trace.h"
+
+struct mc_lat_hist mc_lat_hists[MC_LAT_NR];
+
+static const char *const mc_lat_names[MC_LAT_NR] = {
+	[MC_LAT_FC_NSIQ] = "fc_nsiq",
+	[MC_LAT_FC_YIELD] = "fc_yield",
+	[MC_LAT_NQ_QUEUED] = "nq_queued",
+	[MC_LAT_MCP_WAIT] = "mcp_wait",
+};
+
+static struct {
+	struct mutex		lock;	/* Protects nr_tas */
+	int			nr_tas;
+	/* Last entry collects all TAs once the table is full */
+	struct mc_lat_ta	tas[MC_LAT_MAX_TA];
+} lat_ctx = {
+	.lock = __MUTEX_INITIALIZER(lat_ctx.lock),
+};
+
+void mc_lat_hist_add(struct mc_lat_hist *hist, u64 delta_ns)
+{
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	s64 max;
+
+	atomic64_inc(&hist->buckets[mmi_lat_hist_bucket(us)]);
+	atomic64_inc(&hist->count);
+	atomic64_add(us, &hist->sum_us);
+	max = atomic64_read(&hist->max_us);
+	while ((u64)max < us) {
+		s64 old = atomic64_cmpxchg(&hist->max_us, max, us);
+
+		if (old == max)
+			break;
+
+		max = old;
+	}
+}
+
+struct mc_lat_ta *mc_lat_ta_get(const struct mc_uuid_t *uuid)
+{
+	struct mc_lat_ta *ta;
+	int i;
+
+	mutex_lock(&lat_ctx.lock);
+	for (i = 0; i < lat_ctx.nr_tas; i++) {
+		ta = &lat_ctx.tas[i];
+		if (!memcmp(&ta->uuid, uuid, sizeof(*uuid)))
+			goto end;
+	}
+
+	if (lat_ctx.nr_tas < MC_LAT_MAX_TA - 1) {
+		ta = &lat_ctx.tas[lat_ctx.nr_tas++];
+		ta->uuid = *uuid;
+	} else {
+		ta = &lat_ctx.tas[MC_LAT_MAX_TA - 1];
+	}
+
+end:
+	mutex_unlock(&lat_ctx.lock);
+	return ta;
+}
+
+static void mc_lat_hist_reset(struct mc_lat_hist *hist)
+{
+	int i;
+
+	atomic64_set(&hist->count, 0);
+	atomic64_set(&hist->sum_us, 0);
+	atomic64_set(&hist->max_us, 0);
+	for (i = 0; i < MMI_LAT_HIST_BUCKETS; i++)
+		atomic64_set(&hist->buckets[i], 0);
+}
+
+void mc_lat_reset(void)
+{
+	int i;
+
+	for (i = 0; i < MC_LAT_NR; i++)
+		mc_lat_hist_reset(&mc_lat_hists[i]);
+
+	mutex_lock(&lat_ctx.lock);
+	for (i = 0; i < MC_LAT_MAX_TA; i++)
+		mc_lat_hist_reset(&lat_ctx.tas[i].wait);
+	mutex_unlock(&lat_ctx.lock);
+}
+
+static int mc_lat_hist_show(struct kasnprintf_buf *buf, const char *name,
+			    struct mc_lat_hist *hist)
+{
+	u64 count = atomic64_read(&hist->count);
+	int i, ret;
+
+	ret = kasnprintf(buf, MMI_LAT_HIST_FMT, name, count,
+			 count ? div64_u64(atomic64_read(&hist->sum_us), count) :
+			 0, (u64)atomic64_read(&hist->max_us));
+	if (ret < 0 || !count)
+		return ret;
+
+	for (i = 0; i < MMI_LAT_HIST_BUCKETS; i++) {
+		u64 n = atomic64_read(&hist->buckets[i]);
+
+		if (!n)
+			continue;
+
+		ret = kasnprintf(buf, MMI_LAT_HIST_BUCKET_FMT,
+				 mmi_lat_hist_floor(i), n);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+int mc_lat_debug(struct kasnprintf_buf *buf)
+{
+	char name[48];
+	int i, nr_tas, ret;
+
+	for (i = 0; i < MC_LAT_NR; i++) {
+		ret = mc_lat_hist_show(buf, mc_lat_names[i], &mc_lat_hists[i]);
+		if (ret < 0)
+			return ret;
+	}
+
+	mutex_lock(&lat_ctx.lock);
+	nr_tas = lat_ctx.nr_tas;
+	mutex_unlock(&lat_ctx.lock);
+	for (i = 0; i < nr_tas; i++) {
+		snprintf(name, sizeof(name), "mcp_wait %16phN",
+			 lat_ctx.tas[i].uuid.value);
+		ret = mc_lat_hist_show(buf, name, &lat_ctx.tas[i].wait);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (nr_tas == MC_LAT_MAX_TA - 1)
+		return mc_lat_hist_show(buf, "mcp_wait others",
+					&lat_ctx.tas[MC_LAT_MAX_TA - 1].wait);
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _MC_LATENCY_H_
+#define _MC_LATENCY_H_
+
+#include <linux/atomic.h>
+#include <linux/mmi_lat_hist.h>
+#include <linux/types.h>
+
+#include "mc_user.h"	/* struct mc_uuid_t */
+
+/* Number of TAs tracked separately, others are accounted together */
+#define MC_LAT_MAX_TA		32
+
+struct kasnprintf_buf;
+
+/* Lockless flavour of struct mmi_lat_hist, updated from atomic context */
+struct mc_lat_hist {
+	atomic64_t	count;
+	atomic64_t	sum_us;
+	atomic64_t	max_us;
+	atomic64_t	buckets[MMI_LAT_HIST_BUCKETS];
+};
+
+/* Always-on histograms */
+enum mc_lat_id {
+	MC_LAT_FC_NSIQ,		/* fc_nsiq duration */
+	MC_LAT_FC_YIELD,	/* fc_yield duration */
+	MC_LAT_NQ_QUEUED,	/* Time spent in the NQ overflow list */
+	MC_LAT_MCP_WAIT,	/* mcp_wait, all sessions */
+	MC_LAT_NR,
+};
+
+/* Per-TA histograms, never freed */
+struct mc_lat_ta {
+	struct mc_uuid_t	uuid;
+	struct mc_lat_hist	wait;	/* mcp_wait */
+};
+
+void mc_lat_hist_add(struct mc_lat_hist *hist, u64 delta_ns);
+struct mc_lat_ta *mc_lat_ta_get(const struct mc_uuid_t *uuid);
+int mc_lat_debug(struct kasnprintf_buf *buf);
+void mc_lat_reset(void);
+
+extern struct mc_lat_hist mc_lat_hists[MC_LAT_NR];
+
+static inline void mc_lat_record(enum mc_lat_id id, u64 delta_ns)
+{
+	mc_lat_hist_add(&mc_lat_hists[id], delta_ns);
+}
+
+#endif /* _MC_LATENCY_H_ */
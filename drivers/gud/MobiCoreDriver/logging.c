@@ -18,51 +18,29 @@
 #include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/debugfs.h>
+#include <linux/ratelimit.h>
+#include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/sched.h>	/* local_clock */
+#if KERNEL_VERSION(4, 11, 0) <= LINUX_VERSION_CODE
+#include <linux/sched/clock.h>	/* local_clock */
+#endif
 
 #include "main.h"
 #include "logging.h"
 
-/* Supported log buffer version */
-#define MC_LOG_VERSION			2
-
 /* Default length of the log ring buffer 256KiB */
 #define LOG_BUF_ORDER			6
 
 /* Max Len of a log line for printing */
 #define LOG_LINE_SIZE			256
 
-/* Definitions for log version 2 */
-#define LOG_TYPE_MASK			(0x0007)
-#define LOG_TYPE_CHAR			0
-#define LOG_TYPE_INTEGER		1
-
-/* Field length */
-#define LOG_LENGTH_MASK			(0x00F8)
-#define LOG_LENGTH_SHIFT		3
-
-/* Extra attributes */
-#define LOG_EOL				(0x0100)
-#define LOG_INTEGER_DECIMAL		(0x0200)
-#define LOG_INTEGER_SIGNED		(0x0400)
+/* Binary copy of the log for userspace, same size as the trace buffer */
+#define LOG_BIN_ORDER			LOG_BUF_ORDER
 
-/* active cpu id */
-#define LOG_CPUID_MASK            (0xF000)
-#define LOG_CPUID_SHIFT           12
-
-struct mc_logmsg {
-	u16	ctrl;		/* Type and format of data */
-	u16	source;		/* Unique value for each event source */
-	u32	log_data;	/* Value, if any */
-};
-
-/* MobiCore internal trace buffer structure. */
-struct mc_trace_buf {
-	u32	version;	/* version of trace buffer */
-	u32	length;		/* length of buff */
-	u32	head;		/* last write position */
-	u8	buff[];		/* start of the log buffer */
-};
+/* Text rendering budget: lines per second */
+#define LOG_TEXT_BURST			200
 
 static struct logging_ctx {
 	struct kthread_work work;
@@ -83,6 +61,25 @@ static struct logging_ctx {
 	bool	enabled;		/* Log can be disabled via debugfs */
 #endif
 	bool	dead;
+	/* In-kernel text rendering, rate-limited */
+#if KERNEL_VERSION(4, 4, 0) > LINUX_VERSION_CODE
+	u32	text;
+#else
+	bool	text;
+#endif
+	struct ratelimit_state text_rs;
+	/* Binary ring of raw struct mc_logmsg, read from debugfs swd_log_bin */
+	struct mutex bin_mutex;		/* Protects bin_head */
+	wait_queue_head_t bin_wq;
+	u8	*bin;
+	u64	bin_head;		/* Total bytes ever written */
+	/* Statistics */
+	u64	c_msgs;			/* Messages drained */
+	u64	c_runs;			/* Worker runs */
+	u64	c_lines;		/* Text lines printed */
+	u64	c_lines_dropped;	/* Text lines not printed */
+	u64	c_bin_lost;		/* Bytes overwritten before being read */
+	u64	drain_ns;		/* Time spent draining */
 } log_ctx;
 
 static inline void log_eol(u16 source, u32 cpuid)
@@ -90,6 +87,12 @@ static inline void log_eol(u16 source, u32 cpuid)
 	if (!log_ctx.line_len)
 		return;
 
+	if (!__ratelimit(&log_ctx.text_rs)) {
+		log_ctx.c_lines_dropped++;
+		goto out;
+	}
+
+	log_ctx.c_lines++;
 	if (log_ctx.prev_source)
 		/* TEE user-space */
 		dev_info(g_ctx.mcd, "%03x(%u)|%s\n", log_ctx.prev_source,
@@ -97,6 +100,7 @@ static inline void log_eol(u16 source, u32 cpuid)
 	else
 		/* TEE kernel */
 		dev_info(g_ctx.mcd, "mtk(%u)|%s\n", cpuid, log_ctx.line);
+out:
 	log_ctx.line[0] = '\0';
 	log_ctx.line_len = 0;
 }
@@ -134,19 +138,17 @@ static inline void log_string(u32 ch, u16 source, u32 cpuid)
 static inline void log_number(u32 format, u32 value, u16 source, u32 cpuid)
 {
 	int width = (format & LOG_LENGTH_MASK) >> LOG_LENGTH_SHIFT;
-	char fmt[16];
 	char buffer[32];
 	const char *reader = buffer;
 
 	if (format & LOG_INTEGER_DECIMAL)
 		if (format & LOG_INTEGER_SIGNED)
-			snprintf(fmt, sizeof(fmt), "%%%ud", width);
+			snprintf(buffer, sizeof(buffer), "%*d", width, value);
 		else
-			snprintf(fmt, sizeof(fmt), "%%%uu", width);
+			snprintf(buffer, sizeof(buffer), "%*u", width, value);
 	else
-		snprintf(fmt, sizeof(fmt), "%%0%ux", width);
+		snprintf(buffer, sizeof(buffer), "%0*x", width, value);
 
-	snprintf(buffer, sizeof(buffer), fmt, value);
 	while (*reader)
 		log_char(*reader++, source, cpuid);
 }
@@ -171,25 +173,76 @@ static inline int log_msg(void *data)
 	return sizeof(*msg);
 }
 
+/* Append a chunk of raw messages to the binary ring */
+static void log_bin_write(const u8 *data, u32 len)
+{
+	u32 size = BIT(LOG_BIN_ORDER) * PAGE_SIZE;
+	u32 off, first;
+
+	mutex_lock(&log_ctx.bin_mutex);
+	off = (u32)(log_ctx.bin_head & (size - 1));
+	first = min(len, size - off);
+	memcpy(&log_ctx.bin[off], data, first);
+	memcpy(log_ctx.bin, data + first, len - first);
+	log_ctx.bin_head += len;
+	mutex_unlock(&log_ctx.bin_mutex);
+}
+
+/* Process messages in [tail, end), end not wrapping */
+static void log_drain_chunk(u32 end)
+{
+	u8 *chunk = &log_ctx.trace_buf->buff[log_ctx.tail];
+	u32 len = end - log_ctx.tail;
+	u32 off;
+
+	if (!len)
+		return;
+
+	log_bin_write(chunk, len);
+	if (log_ctx.text)
+		for (off = 0; off < len; off += sizeof(struct mc_logmsg))
+			log_msg(&chunk[off]);
+
+	log_ctx.c_msgs += len / sizeof(struct mc_logmsg);
+	log_ctx.tail = end;
+}
+
 static void logging_worker(struct kthread_work *work)
 {
 	static DEFINE_MUTEX(local_mutex);
+	u64 start = local_clock();
+	u32 wrap, head;
 
 	mutex_lock(&local_mutex);
-	while (log_ctx.trace_buf->head != log_ctx.tail) {
-		if (log_ctx.trace_buf->version != MC_LOG_VERSION) {
-			mc_dev_err(-EINVAL, "Bad log data v%d (exp. v%d), stop",
-				   log_ctx.trace_buf->version, MC_LOG_VERSION);
+	log_ctx.c_runs++;
+	if (log_ctx.trace_buf->version != MC_LOG_VERSION) {
+		mc_dev_err(-EINVAL, "Bad log data v%d (exp. v%d), stop",
+			   log_ctx.trace_buf->version, MC_LOG_VERSION);
+		log_ctx.dead = true;
+		goto out;
+	}
+
+	/* The SWd wraps when there is no space left for a complete message */
+	wrap = log_ctx.trace_buf->length -
+		log_ctx.trace_buf->length % sizeof(struct mc_logmsg);
+	while ((head = READ_ONCE(log_ctx.trace_buf->head)) != log_ctx.tail) {
+		if (head > wrap) {
+			mc_dev_err(-EINVAL, "Bad log head %u, stop", head);
 			log_ctx.dead = true;
 			break;
 		}
 
-		log_ctx.tail += log_msg(&log_ctx.trace_buf->buff[log_ctx.tail]);
-		/* Wrap over if no space left for a complete message */
-		if ((log_ctx.tail + sizeof(struct mc_logmsg)) >
-						log_ctx.trace_buf->length)
+		if (head > log_ctx.tail) {
+			log_drain_chunk(head);
+		} else {
+			log_drain_chunk(wrap);
 			log_ctx.tail = 0;
+		}
 	}
+
+	wake_up_interruptible(&log_ctx.bin_wq);
+out:
+	log_ctx.drain_ns += local_clock() - start;
 	mutex_unlock(&local_mutex);
 }
 
@@ -209,6 +262,116 @@ void logging_run(void)
 #endif
 }
 
+/*
+ * Binary log: each reader gets the raw struct mc_logmsg stream, starting from
+ * the oldest record still in the ring. Records overwritten before being read
+ * are skipped and accounted for in the statistics.
+ */
+static int debug_log_bin_open(struct inode *inode, struct file *file)
+{
+	u64 *pos = kzalloc(sizeof(*pos), GFP_KERNEL);
+	u64 size = BIT(LOG_BIN_ORDER) * PAGE_SIZE;
+
+	if (!pos)
+		return -ENOMEM;
+
+	mutex_lock(&log_ctx.bin_mutex);
+	if (log_ctx.bin_head > size)
+		*pos = log_ctx.bin_head - size;
+	mutex_unlock(&log_ctx.bin_mutex);
+	file->private_data = pos;
+	return nonseekable_open(inode, file);
+}
+
+static int debug_log_bin_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t debug_log_bin_read(struct file *file, char __user *user_buf,
+				  size_t count, loff_t *ppos)
+{
+	u64 *pos = file->private_data;
+	u32 size = BIT(LOG_BIN_ORDER) * PAGE_SIZE;
+	u32 off, len, first;
+	ssize_t ret;
+
+	/* Only hand out complete records */
+	count = round_down(count, sizeof(struct mc_logmsg));
+	if (!count)
+		return -EINVAL;
+
+	mutex_lock(&log_ctx.bin_mutex);
+	while (*pos == log_ctx.bin_head) {
+		mutex_unlock(&log_ctx.bin_mutex);
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+
+		ret = wait_event_interruptible(log_ctx.bin_wq,
+					       *pos != READ_ONCE(log_ctx.bin_head));
+		if (ret)
+			return ret;
+
+		mutex_lock(&log_ctx.bin_mutex);
+	}
+
+	if (log_ctx.bin_head - *pos > size) {
+		log_ctx.c_bin_lost += log_ctx.bin_head - size - *pos;
+		*pos = log_ctx.bin_head - size;
+	}
+
+	len = (u32)min_t(u64, count, log_ctx.bin_head - *pos);
+	off = (u32)(*pos & (size - 1));
+	first = min(len, size - off);
+	ret = -EFAULT;
+	if (copy_to_user(user_buf, &log_ctx.bin[off], first) ||
+	    copy_to_user(user_buf + first, log_ctx.bin, len - first))
+		goto end;
+
+	*pos += len;
+	ret = len;
+end:
+	mutex_unlock(&log_ctx.bin_mutex);
+	return ret;
+}
+
+static const struct file_operations debug_log_bin_ops = {
+	.open = debug_log_bin_open,
+	.read = debug_log_bin_read,
+	.release = debug_log_bin_release,
+	.llseek = no_llseek,
+};
+
+static int debug_log_stats(struct kasnprintf_buf *buf)
+{
+	return kasnprintf(buf,
+			  "runs          %llu\n"
+			  "messages      %llu\n"
+			  "drain (ns)    %llu\n"
+			  "lines         %llu\n"
+			  "lines dropped %llu\n"
+			  "binary bytes  %llu\n"
+			  "binary lost   %llu\n",
+			  log_ctx.c_runs, log_ctx.c_msgs, log_ctx.drain_ns,
+			  log_ctx.c_lines, log_ctx.c_lines_dropped,
+			  log_ctx.bin_head, log_ctx.c_bin_lost);
+}
+
+static ssize_t debug_log_stats_read(struct file *file, char __user *user_buf,
+				    size_t count, loff_t *ppos)
+{
+	return debug_generic_read(file, user_buf, count, ppos,
+				  debug_log_stats);
+}
+
+static const struct file_operations debug_log_stats_ops = {
+	.read = debug_log_stats_read,
+	.llseek = default_llseek,
+	.open = debug_generic_open,
+	.release = debug_generic_release,
+};
+
 /*
  * Setup MobiCore kernel log. It assumes it's running on CORE 0!
  * The fastcall will complain if that is not the case!
@@ -227,6 +390,17 @@ int logging_init(phys_addr_t *buffer, u32 *size)
 	*buffer = virt_to_phys((void *)(log_ctx.trace_page));
 	*size = BIT(LOG_BUF_ORDER) * PAGE_SIZE;
 
+	log_ctx.bin = (u8 *)__get_free_pages(GFP_KERNEL, LOG_BIN_ORDER);
+	if (!log_ctx.bin) {
+		free_pages(log_ctx.trace_page, LOG_BUF_ORDER);
+		return -ENOMEM;
+	}
+
+	mutex_init(&log_ctx.bin_mutex);
+	init_waitqueue_head(&log_ctx.bin_wq);
+	ratelimit_state_init(&log_ctx.text_rs, HZ, LOG_TEXT_BURST);
+	ratelimit_set_flags(&log_ctx.text_rs, RATELIMIT_MSG_ON_RELEASE);
+
 	/* Logging thread */
 #if KERNEL_VERSION(4, 9, 0) > LINUX_VERSION_CODE
 	init_kthread_work(&log_ctx.work, logging_worker);
@@ -237,8 +411,11 @@ int logging_init(phys_addr_t *buffer, u32 *size)
 #endif
 	log_ctx.thread = kthread_create(kthread_worker_fn, &log_ctx.worker,
 					"tee_log");
-	if (IS_ERR(log_ctx.thread))
+	if (IS_ERR(log_ctx.thread)) {
+		free_pages((unsigned long)log_ctx.bin, LOG_BIN_ORDER);
+		free_pages(log_ctx.trace_page, LOG_BUF_ORDER);
 		return PTR_ERR(log_ctx.thread);
+	}
 
 	wake_up_process(log_ctx.thread);
 
@@ -246,6 +423,14 @@ int logging_init(phys_addr_t *buffer, u32 *size)
 	log_ctx.enabled = true;
 	debugfs_create_bool("swd_debug", 0600, g_ctx.debug_dir,
 			    &log_ctx.enabled);
+	/* Text rendering can be turned off when swd_log_bin is used */
+	log_ctx.text = true;
+	debugfs_create_bool("swd_log_text", 0600, g_ctx.debug_dir,
+			    &log_ctx.text);
+	debugfs_create_file("swd_log_bin", 0400, g_ctx.debug_dir, NULL,
+			    &debug_log_bin_ops);
+	debugfs_create_file("swd_log_stats", 0400, g_ctx.debug_dir, NULL,
+			    &debug_log_stats_ops);
 	return 0;
 }
 
@@ -258,4 +443,6 @@ void logging_exit(bool buffer_busy)
 	kthread_stop(log_ctx.thread);
 	if (!buffer_busy)
 		free_pages(log_ctx.trace_page, LOG_BUF_ORDER);
+
+	free_pages((unsigned long)log_ctx.bin, LOG_BIN_ORDER);
 }
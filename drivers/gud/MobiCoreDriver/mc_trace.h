@@ -0,0 +1,75 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM trustonic_tee
+
+#if !defined(_MC_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _MC_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(mc_fastcall,
+	    TP_PROTO(const char *name, u32 arg, int ret, u64 delta_ns),
+	    TP_ARGS(name, arg, ret, delta_ns),
+	    TP_STRUCT__entry(__string(name, name)
+			     __field(u32, arg)
+			     __field(int, ret)
+			     __field(u64, delta_ns)),
+	    TP_fast_assign(__assign_str(name, name);
+			   __entry->arg = arg;
+			   __entry->ret = ret;
+			   __entry->delta_ns = delta_ns;),
+	    TP_printk("%s(0x%x) ret=%d took %llu ns", __get_str(name),
+		      __entry->arg, __entry->ret, __entry->delta_ns));
+
+TRACE_EVENT(mc_nq_flush,
+	    TP_PROTO(u32 session_id, u32 payload, u64 queued_ns),
+	    TP_ARGS(session_id, payload, queued_ns),
+	    TP_STRUCT__entry(__field(u32, session_id)
+			     __field(u32, payload)
+			     __field(u64, queued_ns)),
+	    TP_fast_assign(__entry->session_id = session_id;
+			   __entry->payload = payload;
+			   __entry->queued_ns = queued_ns;),
+	    TP_printk("session 0x%x payload 0x%x queued for %llu ns",
+		      __entry->session_id, __entry->payload,
+		      __entry->queued_ns));
+
+TRACE_EVENT(mc_session_wait,
+	    TP_PROTO(u32 session_id, const u8 *uuid, int ret, u64 delta_ns),
+	    TP_ARGS(session_id, uuid, ret, delta_ns),
+	    TP_STRUCT__entry(__field(u32, session_id)
+			     __array(u8, uuid, 16)
+			     __field(int, ret)
+			     __field(u64, delta_ns)),
+	    TP_fast_assign(__entry->session_id = session_id;
+			   if (uuid)
+				   memcpy(__entry->uuid, uuid, 16);
+			   else
+				   memset(__entry->uuid, 0, 16);
+			   __entry->ret = ret;
+			   __entry->delta_ns = delta_ns;),
+	    TP_printk("session 0x%x uuid %16phN ret=%d waited %llu ns",
+		      __entry->session_id, __entry->uuid, __entry->ret,
+		      __entry->delta_ns));
+
+#endif /* _MC_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../../../motorola/kernel/modules/drivers/gud/MobiCoreDriver
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mc_trace
+#include <trace/define_trace.h>
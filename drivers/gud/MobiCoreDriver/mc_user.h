@@ -146,6 +146,47 @@ struct mc_ioctl_geterr {
 	__s32		value;		/* error value (out) */
 };
 
+/*
+ * Asynchronous notification: submission and completion queue entries.
+ * A submitted session gets notified, its next notification from the TA is
+ * posted as a completion instead of waking a thread blocked in MC_IO_WAIT.
+ */
+struct mc_ioctl_async_sqe {
+	__u32		sid;		/* session id */
+	__u32		rfu;		/* must be 0 */
+	__u64		user_data;	/* returned as is in the completion */
+};
+
+struct mc_ioctl_async_cqe {
+	__u32		sid;		/* session id */
+	__s32		result;		/* 0, or same error as MC_IO_WAIT */
+	__u64		user_data;	/* from the submission */
+};
+
+/* Maximum number of entries per MC_IO_ASYNC_SUBMIT/REAP call */
+#define MC_ASYNC_BATCH_MAX	32
+
+/*
+ * Data exchange structure of the MC_IO_ASYNC_SUBMIT ioctl command.
+ * All entries are notified with a single secure world schedule request.
+ */
+struct mc_ioctl_async_submit {
+	__u64		sqes;		/* mc_ioctl_async_sqe array pointer */
+	__u32		nr;		/* number of entries */
+	__u32		submitted;	/* number of entries submitted (out) */
+};
+
+/*
+ * Data exchange structure of the MC_IO_ASYNC_REAP ioctl command.
+ */
+struct mc_ioctl_async_reap {
+	__u64		cqes;		/* mc_ioctl_async_cqe array pointer */
+	__u32		nr;		/* number of entries available */
+	__u32		min_complete;	/* entries to wait for, 0 to poll */
+	__s32		timeout;	/* in ms, -1 to wait forever */
+	__u32		reaped;		/* number of entries filled (out) */
+};
+
 /*
  * Global MobiCore Version Information.
  */
@@ -289,6 +330,10 @@ struct mc_ioctl_gp_request_cancellation {
 	_IO(MC_IOC_MAGIC, 8)
 #define MC_IO_VERSION \
 	_IOR(MC_IOC_MAGIC, 9, struct mc_version_info)
+#define MC_IO_ASYNC_SUBMIT \
+	_IOWR(MC_IOC_MAGIC, 10, struct mc_ioctl_async_submit)
+#define MC_IO_ASYNC_REAP \
+	_IOWR(MC_IOC_MAGIC, 11, struct mc_ioctl_async_reap)
 #define MC_IO_GP_INITIALIZE_CONTEXT \
 	_IOW(MC_IOC_MAGIC, 20, struct mc_ioctl_gp_initialize_context)
 #define MC_IO_GP_REGISTER_SHARED_MEM \
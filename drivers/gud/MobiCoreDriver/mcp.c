@@ -47,7 +47,9 @@
 #include "mmu.h"		/* MMU for 'blob' */
 #include "nq.h"
 #include "xen_fe.h"
+#include "latency.h"
 #include "mcp.h"
+#include "mc_trace.h"
 
 /* respond timeout for MCP notification, in secs */
 #define MCP_TIMEOUT		10
@@ -135,6 +137,19 @@ static const char *state_to_string(enum mcp_session_state state)
 	return "error";
 }
 
+/* Must be called with l_ctx.sessions_lock taken */
+static void mcp_async_complete(struct mcp_session *session, int result)
+{
+	void (*cb)(struct mcp_session *session, u64 user_data, int result);
+
+	cb = session->async_cb;
+	if (!cb)
+		return;
+
+	session->async_cb = NULL;
+	cb(session, session->async_data, result);
+}
+
 static inline void mark_mcp_dead(void)
 {
 	struct mcp_session *session;
@@ -142,8 +157,12 @@ static inline void mark_mcp_dead(void)
 	l_ctx.mcp_dead = true;
 	complete(&l_ctx.complete);
 	/* Signal all potential waiters that SWd is going away */
-	list_for_each_entry(session, &l_ctx.sessions, list)
+	mutex_lock(&l_ctx.sessions_lock);
+	list_for_each_entry(session, &l_ctx.sessions, list) {
 		complete(&session->completion);
+		mcp_async_complete(session, -EHOSTUNREACH);
+	}
+	mutex_unlock(&l_ctx.sessions_lock);
 }
 
 static int tee_stop_notifier_fn(struct notifier_block *nb, unsigned long event,
@@ -164,6 +183,9 @@ void mcp_session_init(struct mcp_session *session)
 	session->exit_code = 0;
 	session->state = MCP_SESSION_RUNNING;
 	session->notif_count = 0;
+	session->lat_ta = NULL;
+	session->async_cb = NULL;
+	session->async_data = 0;
 }
 
 static inline bool mcp_session_isrunning(struct mcp_session *session)
@@ -184,6 +206,7 @@ int mcp_wait(struct mcp_session *session, s32 timeout, int silent_expiry)
 {
 	s32 err = 0;
 	int ret = 0;
+	u64 start = 0;
 
 	mutex_lock(&session->notif_wait_lock);
 #ifdef TRUSTONIC_XEN_DOMU
@@ -204,12 +227,25 @@ int mcp_wait(struct mcp_session *session, s32 timeout, int silent_expiry)
 		goto end;
 	}
 
+	/*
+	 * An armed callback consumes the notification and never completes
+	 * session->completion. mcp_async_arm checks notif_wait_lock under the
+	 * same lock, so either side sees the other.
+	 */
+	mutex_lock(&l_ctx.sessions_lock);
+	if (session->async_cb)
+		ret = -EBUSY;
+	mutex_unlock(&l_ctx.sessions_lock);
+	if (ret)
+		goto end;
+
 	mcp_get_err(session, &err);
 	if (err) {
 		ret = -ECOMM;
 		goto end;
 	}
 
+	start = local_clock();
 	if (timeout < 0) {
 		ret = wait_for_completion_interruptible(&session->completion);
 		if (ret)
@@ -247,10 +283,24 @@ int mcp_wait(struct mcp_session *session, s32 timeout, int silent_expiry)
 	}
 
 end:
+	if (start) {
+		u64 delta_ns = local_clock() - start;
+
+		trace_mc_session_wait(session->sid, session->lat_ta ?
+				      session->lat_ta->uuid.value : NULL,
+				      ret, delta_ns);
+		if (!ret) {
+			mc_lat_record(MC_LAT_MCP_WAIT, delta_ns);
+			if (session->lat_ta)
+				mc_lat_hist_add(&session->lat_ta->wait,
+						delta_ns);
+		}
+	}
+
 	if (!ret)
 		nq_session_state_update(&session->nq_session,
 					NQ_NOTIF_CONSUMED);
-	else if (ret != -ERESTARTSYS)
+	else if (ret != -ERESTARTSYS && ret != -EBUSY)
 		nq_session_state_update(&session->nq_session, NQ_NOTIF_DEAD);
 
 	mutex_unlock(&session->notif_wait_lock);
@@ -649,6 +699,7 @@ int mcp_open_session(struct mcp_session *session, struct mcp_open_info *info,
 
 	if (!ret) {
 		session->sid = cmd.rsp_open.session_id;
+		session->lat_ta = mc_lat_ta_get(&header->mclf_header_v2.uuid);
 		/* Add to list of sessions */
 		mutex_lock(&l_ctx.sessions_lock);
 		list_add_tail(&session->list, &l_ctx.sessions);
@@ -712,6 +763,7 @@ int mcp_close_session(struct mcp_session *session)
 		session->state = MCP_SESSION_CLOSED;
 		list_del(&session->list);
 		nq_session_exit(&session->nq_session);
+		mcp_async_complete(session, -ENXIO);
 	} else {
 		/* Something is not right, assume session is still running */
 		session->state = MCP_SESSION_CLOSE_FAILED;
@@ -731,6 +783,7 @@ void mcp_cleanup_session(struct mcp_session *session)
 	session->state = MCP_SESSION_CLOSED;
 	list_del(&session->list);
 	nq_session_exit(&session->nq_session);
+	mcp_async_complete(session, -EHOSTUNREACH);
 	mutex_unlock(&l_ctx.sessions_lock);
 }
 
@@ -795,6 +848,56 @@ static int mcp_close(void)
 	return mcp_cmd(&cmd, 0, NULL, NULL);
 }
 
+/*
+ * Have the next notification from the TA call cb instead of waking a thread
+ * in mcp_wait. cb is called once, from the notification worker, with
+ * l_ctx.sessions_lock held: it must not sleep or call back into MCP.
+ */
+int mcp_async_arm(struct mcp_session *session,
+		  void (*cb)(struct mcp_session *session, u64 user_data,
+			     int result),
+		  u64 user_data)
+{
+	s32 err = 0;
+	int ret = 0;
+
+	if (is_xen_domu())
+		return -EOPNOTSUPP;
+
+	if (l_ctx.mcp_dead)
+		return -EHOSTUNREACH;
+
+	mcp_get_err(session, &err);
+	if (err)
+		return -ECOMM;
+
+	mutex_lock(&l_ctx.sessions_lock);
+	if (session->state != MCP_SESSION_RUNNING) {
+		ret = -ENXIO;
+	} else if (session->async_cb ||
+		   mutex_is_locked(&session->notif_wait_lock)) {
+		/* Only one waiter at a time, sync or async */
+		ret = -EBUSY;
+	} else {
+		session->async_cb = cb;
+		session->async_data = user_data;
+	}
+	mutex_unlock(&l_ctx.sessions_lock);
+	return ret;
+}
+
+/* Returns true if the session was still armed */
+bool mcp_async_disarm(struct mcp_session *session)
+{
+	bool armed;
+
+	mutex_lock(&l_ctx.sessions_lock);
+	armed = session->async_cb != NULL;
+	session->async_cb = NULL;
+	mutex_unlock(&l_ctx.sessions_lock);
+	return armed;
+}
+
 int mcp_notify(struct mcp_session *session)
 {
 	if (l_ctx.mcp_dead)
@@ -815,6 +918,28 @@ int mcp_notify(struct mcp_session *session)
 				 ++session->notif_count);
 }
 
+/* Notify several sessions with a single SWd schedule request */
+int mcp_notify_batch(struct mcp_session **sessions, int nr)
+{
+	struct nq_notif notifs[MC_ASYNC_BATCH_MAX];
+	int i;
+
+	if (nr > MC_ASYNC_BATCH_MAX)
+		return -EINVAL;
+
+	if (l_ctx.mcp_dead)
+		return -EHOSTUNREACH;
+
+	for (i = 0; i < nr; i++) {
+		mc_dev_devel("notify session %x", sessions[i]->sid);
+		notifs[i].session = &sessions[i]->nq_session;
+		notifs[i].id = sessions[i]->sid;
+		notifs[i].payload = ++sessions[i]->notif_count;
+	}
+
+	return nq_session_notify_batch(notifs, nr);
+}
+
 static inline void session_notif_handler(struct mcp_session *session, u32 id,
 					 u32 payload)
 {
@@ -833,8 +958,12 @@ static inline void session_notif_handler(struct mcp_session *session, u32 id,
 		nq_session_state_update(&session->nq_session,
 					NQ_NOTIF_RECEIVED);
 
-		/* Unblock waiter */
-		complete(&session->completion);
+		if (session->async_cb)
+			/* Post completion, nobody sleeps on this session */
+			mcp_async_complete(session, payload ? -ECOMM : 0);
+		else
+			/* Unblock waiter */
+			complete(&session->completion);
 	}
 	mutex_unlock(&l_ctx.sessions_lock);
 
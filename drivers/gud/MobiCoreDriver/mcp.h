@@ -20,6 +20,7 @@
 #include "nq.h"
 
 struct tee_mmu;
+struct mc_lat_ta;
 
 /* Structure to hold the TA/driver information at open */
 struct mcp_open_info {
@@ -84,6 +85,12 @@ struct mcp_session {
 	}			state;
 	/* Notification counter */
 	u32			notif_count;
+	/* Wait latency histogram of the TA, set at open */
+	struct mc_lat_ta	*lat_ta;
+	/* Asynchronous waiter, replaces completion (protected by sessions_lock) */
+	void			(*async_cb)(struct mcp_session *session,
+					    u64 user_data, int result);
+	u64			async_data;
 };
 
 /* Init for the mcp_session structure */
@@ -103,6 +110,12 @@ int mcp_map(u32 session_id, struct tee_mmu *mmu, u32 *sva);
 int mcp_unmap(u32 session_id, const struct mcp_buffer_map *map);
 int mcp_notify(struct mcp_session *mcp_session);
 int mcp_wait(struct mcp_session *session, s32 timeout, int silent_expiry);
+int mcp_async_arm(struct mcp_session *session,
+		  void (*cb)(struct mcp_session *session, u64 user_data,
+			     int result),
+		  u64 user_data);
+bool mcp_async_disarm(struct mcp_session *session);
+int mcp_notify_batch(struct mcp_session **sessions, int nr);
 int mcp_get_err(struct mcp_session *session, s32 *err);
 
 /* Initialisation/cleanup */
@@ -44,8 +44,10 @@
 #include "main.h"
 #include "clock.h"
 #include "fastcall.h"
+#include "latency.h"
 #include "logging.h"
 #include "nq.h"
+#include "mc_trace.h"
 
 #define NQ_NUM_ELEMS		64
 #define SCHEDULING_FREQ		5	/**< N-SIQ every n-th time */
@@ -186,10 +188,15 @@ static inline bool nq_notifications_flush(void)
 
 	while (!list_empty(&l_ctx.notifications) && !notif_queue_full()) {
 		struct nq_session *session;
+		u64 queued_ns;
 
 		session = list_first_entry(&l_ctx.notifications,
 					   struct nq_session, list);
 		mc_dev_devel("pop %x", session->id);
+		/* cpu_clk was set when the session got queued */
+		queued_ns = local_clock() - session->cpu_clk;
+		mc_lat_record(MC_LAT_NQ_QUEUED, queued_ns);
+		trace_mc_nq_flush(session->id, session->payload, queued_ns);
 		notif_queue_push(session->id, session->payload);
 		session_state_update_internal(session, NQ_NOTIF_SENT);
 		list_del_init(&session->list);
@@ -238,6 +245,33 @@ static inline void nq_update_time(void)
 	mutex_unlock(&l_ctx.mcp_time_mutex);
 }
 
+/* World switches, timed */
+static int nq_fc_nsiq(u32 session_id, u32 payload)
+{
+	u64 start = local_clock();
+	u64 delta_ns;
+	int ret;
+
+	ret = fc_nsiq(session_id, payload);
+	delta_ns = local_clock() - start;
+	mc_lat_record(MC_LAT_FC_NSIQ, delta_ns);
+	trace_mc_fastcall("nsiq", session_id, ret, delta_ns);
+	return ret;
+}
+
+static int nq_fc_yield(u32 timeslice)
+{
+	u64 start = local_clock();
+	u64 delta_ns;
+	int ret;
+
+	ret = fc_yield(timeslice);
+	delta_ns = local_clock() - start;
+	mc_lat_record(MC_LAT_FC_YIELD, delta_ns);
+	trace_mc_fastcall("yield", timeslice, ret, delta_ns);
+	return ret;
+}
+
 static inline void nq_notif_handler(u32 id, u32 payload)
 {
 	mc_dev_devel("NQ notif for id %x payload %x", id, payload);
@@ -298,6 +332,14 @@ static irqreturn_t irq_handler(int intr, void *arg)
 	return IRQ_HANDLED;
 }
 
+#ifdef MC_SIMULATED_SWD
+/* The simulated SWd has no interrupt line, it calls us directly */
+void nq_simulated_ssiq(void)
+{
+	irq_handler(0, NULL);
+}
+#endif
+
 void nq_session_init(struct nq_session *session, bool is_gp)
 {
 	session->id = SID_INVALID;
@@ -326,18 +368,20 @@ void nq_session_state_update(struct nq_session *session,
 	session_state_update_internal(session, state);
 }
 
-int nq_session_notify(struct nq_session *session, u32 id, u32 payload)
+/*
+ * Must be called with l_ctx.notifications_mutex taken.
+ * Returns the scheduler command needed to get the notification through.
+ */
+static enum sched_command nq_session_queue(struct nq_session *session, u32 id,
+					   u32 payload, int *ret)
 {
-	int ret = 0;
-
-	mutex_lock(&l_ctx.notifications_mutex);
 	session->id = id;
 	session->payload = payload;
 	if (!list_empty(&l_ctx.notifications) || notif_queue_full()) {
 		if (!list_empty(&session->list)) {
-			ret = -EAGAIN;
+			*ret = -EAGAIN;
 			if (payload != session->payload) {
-				mc_dev_err(ret,
+				mc_dev_err(*ret,
 					   "skip %x payload change %x -> %x",
 					   session->id, session->payload,
 					   payload);
@@ -354,17 +398,52 @@ int nq_session_notify(struct nq_session *session, u32 id, u32 payload)
 		}
 
 		nq_notifications_flush();
+		return YIELD;
+	}
 
-		if (nq_scheduler_command(YIELD))
-			ret = -EPROTO;
-	} else {
-		mc_dev_devel("send %x payload %x", session->id, payload);
-		notif_queue_push(session->id, payload);
-		session_state_update_internal(session, NQ_NOTIF_SENT);
-		if (nq_scheduler_command(NSIQ))
-			ret = -EPROTO;
+	mc_dev_devel("send %x payload %x", session->id, payload);
+	notif_queue_push(session->id, payload);
+	session_state_update_internal(session, NQ_NOTIF_SENT);
+	return NSIQ;
+}
+
+int nq_session_notify(struct nq_session *session, u32 id, u32 payload)
+{
+	enum sched_command command;
+	int ret = 0;
+
+	mutex_lock(&l_ctx.notifications_mutex);
+	command = nq_session_queue(session, id, payload, &ret);
+	if (nq_scheduler_command(command))
+		ret = -EPROTO;
+
+	mutex_unlock(&l_ctx.notifications_mutex);
+	return ret;
+}
+
+/*
+ * Queue several notifications at once and wake the scheduler only once.
+ * Sessions already queued are skipped, as for nq_session_notify.
+ */
+int nq_session_notify_batch(const struct nq_notif *notifs, int nr)
+{
+	enum sched_command command = NONE;
+	int i, ret = 0;
+
+	mutex_lock(&l_ctx.notifications_mutex);
+	for (i = 0; i < nr; i++) {
+		enum sched_command cmd;
+		int skipped = 0;
+
+		cmd = nq_session_queue(notifs[i].session, notifs[i].id,
+				       notifs[i].payload, &skipped);
+		if (command < cmd)
+			command = cmd;
 	}
 
+	if (nr && nq_scheduler_command(command))
+		ret = -EPROTO;
+
 	mutex_unlock(&l_ctx.notifications_mutex);
 	return ret;
 }
@@ -420,6 +499,29 @@ static const struct file_operations debug_smclog_ops = {
 	.release = debug_generic_release,
 };
 
+static ssize_t debug_latency_read(struct file *file, char __user *user_buf,
+				  size_t count, loff_t *ppos)
+{
+	return debug_generic_read(file, user_buf, count, ppos, mc_lat_debug);
+}
+
+/* Any write resets the histograms */
+static ssize_t debug_latency_write(struct file *file,
+				   const char __user *user_buf, size_t count,
+				   loff_t *ppos)
+{
+	mc_lat_reset();
+	return count;
+}
+
+static const struct file_operations debug_latency_ops = {
+	.read = debug_latency_read,
+	.write = debug_latency_write,
+	.llseek = default_llseek,
+	.open = debug_generic_open,
+	.release = debug_generic_release,
+};
+
 static void nq_dump_status(void)
 {
 	static const struct {
@@ -691,7 +793,7 @@ static int nq_boot_tee(void)
 		MAX_IW_SESSION * sizeof(struct interworld_session);
 
 	/* First empty N-SIQ to setup of the MCI structure */
-	ret = fc_nsiq(0, 0);
+	ret = nq_fc_nsiq(0, 0);
 	logging_run();
 	if (ret)
 		return ret;
@@ -714,7 +816,7 @@ static int nq_boot_tee(void)
 			/* Switch to the TEE to give it more CPU time. */
 			ret = EAGAIN;
 			for (timeslice = 0; timeslice < 10; timeslice++) {
-				int tmp_ret = fc_yield(timeslice);
+				int tmp_ret = nq_fc_yield(timeslice);
 
 				logging_run();
 				if (tmp_ret)
@@ -868,10 +970,10 @@ static int tee_scheduler(void *arg)
 			swd_notify = false;
 
 			/* Call SWd scheduler */
-			fc_nsiq(session_id, payload);
+			nq_fc_nsiq(session_id, payload);
 		} else {
 			/* Resume SWd from where it was */
-			fc_yield(0);
+			nq_fc_yield(0);
 		}
 
 		/* Always flush log buffer after the SWd has run */
@@ -950,6 +1052,7 @@ int nq_resume(void)
 int nq_start(void)
 {
 	int ret;
+#ifndef MC_SIMULATED_SWD
 	/* Make sure we have the interrupt before going on */
 #if defined(CONFIG_OF)
 	l_ctx.irq = irq_of_parse_and_map(g_ctx.mcd->of_node, 0);
@@ -969,6 +1072,7 @@ int nq_start(void)
 			  "trustonic", NULL);
 	if (ret)
 		return ret;
+#endif /* !MC_SIMULATED_SWD */
 
 	/*
 	 * Initialize the time structure for SWd
@@ -977,6 +1081,9 @@ int nq_start(void)
 	 */
 	nq_update_time();
 
+	debugfs_create_file("latency", 0600, g_ctx.debug_dir, NULL,
+			    &debug_latency_ops);
+
 	/* Setup S-SIQ interrupt handler and its bottom-half */
 	l_ctx.irq_bh_thread_run = true;
 	l_ctx.irq_bh_thread = kthread_run(irq_bh_worker, NULL, "tee_irq_bh");
@@ -1019,7 +1126,9 @@ void nq_stop(void)
 	l_ctx.irq_bh_thread_run = false;
 	complete(&l_ctx.irq_bh_complete);
 	kthread_stop(l_ctx.irq_bh_thread);
+#ifndef MC_SIMULATED_SWD
 	free_irq(l_ctx.irq, NULL);
+#endif
 }
 
 void add_core_to_mask(unsigned int cpu_id)
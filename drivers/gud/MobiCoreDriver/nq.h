@@ -50,12 +50,20 @@ struct nq_session {
 	int			is_gp;
 };
 
+/* One entry of a batched notification */
+struct nq_notif {
+	struct nq_session	*session;
+	u32			id;
+	u32			payload;
+};
+
 /* Notification queue channel */
 void nq_session_init(struct nq_session *session, bool is_gp);
 void nq_session_exit(struct nq_session *session);
 void nq_session_state_update(struct nq_session *session,
 			     enum nq_notif_state state);
 int nq_session_notify(struct nq_session *session, u32 id, u32 payload);
+int nq_session_notify_batch(const struct nq_notif *notifs, int nr);
 const char *nq_session_state(const struct nq_session *session, u64 *cpu_clk);
 
 /* Services */
@@ -76,6 +84,11 @@ int nq_cpu_off(unsigned int cpu);
 int nq_suspend(void);
 int nq_resume(void);
 
+#ifdef MC_SIMULATED_SWD
+/* S-SIQ raised by the simulated SWd */
+void nq_simulated_ssiq(void);
+#endif
+
 /* Start/stop TEE */
 int nq_start(void);
 void nq_stop(void);
@@ -27,6 +27,10 @@
 #define USE_SHM_BRIDGE
 #endif
 
+/*
+ * Simulated SWd (fastcall_sim.c): no SMC, no S-SIQ line, no QTEE clocks
+ */
+#ifndef MC_SIMULATED_SWD
 #if KERNEL_VERSION(5, 4, 0) <= LINUX_VERSION_CODE
 #include <linux/qcom_scm.h>
 #include <soc/qcom/qseecomi.h>
@@ -122,6 +126,7 @@ static inline int smc_fastcall(void *fc_generic, size_t size)
 #endif
 }
 #endif
+#endif /* !MC_SIMULATED_SWD */
 
 /*
  * Do not start the TEE at driver init
@@ -135,7 +140,7 @@ static inline int smc_fastcall(void *fc_generic, size_t size)
  *	 "core_clk"
  *	 "iface_clk"
  */
-#ifndef RSU_INTERNAL_CLOCK
+#if !defined(RSU_INTERNAL_CLOCK) && !defined(MC_SIMULATED_SWD)
 #define MC_CRYPTO_CLOCK_MANAGEMENT
 #endif
 /*
@@ -654,6 +654,51 @@ int session_mc_wait(struct tee_session *session, s32 timeout,
 	return mcp_wait(&session->mcp_session, timeout, silent_expiry);
 }
 
+/*
+ * Asynchronous notification: the TA answer is posted to the client completion
+ * ring from the notification worker.
+ */
+static void session_mc_async_done(struct mcp_session *mcp_session,
+				  u64 user_data, int result)
+{
+	struct tee_session *session =
+		container_of(mcp_session, struct tee_session, mcp_session);
+
+	client_async_complete(session->client, mcp_session->sid, result,
+			      user_data);
+}
+
+int session_mc_async_arm(struct tee_session *session, u64 user_data)
+{
+	if (session->is_gp)
+		return -EINVAL;
+
+	return mcp_async_arm(&session->mcp_session, session_mc_async_done,
+			     user_data);
+}
+
+bool session_mc_async_disarm(struct tee_session *session)
+{
+	return mcp_async_disarm(&session->mcp_session);
+}
+
+/*
+ * Send a notification to several TAs at once
+ */
+int session_mc_notify_batch(struct tee_session **sessions, int nr)
+{
+	struct mcp_session *mcp_sessions[MC_ASYNC_BATCH_MAX];
+	int i;
+
+	if (nr > MC_ASYNC_BATCH_MAX)
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++)
+		mcp_sessions[i] = &sessions[i]->mcp_session;
+
+	return mcp_notify_batch(mcp_sessions, nr);
+}
+
 /*
  * Share buffers with SWd and add corresponding WSM objects to session.
  * This may involve some re-use or cleanup of inactive mappings.
@@ -84,6 +84,9 @@ int session_mc_cleanup_session(struct tee_session *session);
 int session_mc_notify(struct tee_session *session);
 int session_mc_wait(struct tee_session *session, s32 timeout,
 		    int silent_expiry);
+int session_mc_async_arm(struct tee_session *session, u64 user_data);
+bool session_mc_async_disarm(struct tee_session *session);
+int session_mc_notify_batch(struct tee_session **sessions, int nr);
 int session_mc_map(struct tee_session *session, struct tee_mmu *mmu,
 		   struct mc_ioctl_buffer *bufs);
 int session_mc_unmap(struct tee_session *session,
@@ -18,6 +18,8 @@
 #include <linux/export.h>
 #include <linux/fs.h>
 #include <linux/mm_types.h>	/* struct vm_area_struct */
+#include <linux/poll.h>
+#include <linux/slab.h>
 #include <linux/uaccess.h>
 
 #include "mc_user.h"
@@ -271,6 +273,77 @@ static long user_ioctl(struct file *file, unsigned int id, unsigned long arg)
 
 		break;
 	}
+	case MC_IO_ASYNC_SUBMIT: {
+		struct mc_ioctl_async_submit submit;
+		struct mc_ioctl_async_sqe *sqes;
+
+		if (copy_from_user(&submit, uarg, sizeof(submit))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (!submit.nr || submit.nr > MC_ASYNC_BATCH_MAX) {
+			ret = -EINVAL;
+			break;
+		}
+
+		sqes = memdup_user((void __user *)(uintptr_t)submit.sqes,
+				   submit.nr * sizeof(*sqes));
+		if (IS_ERR(sqes)) {
+			ret = PTR_ERR(sqes);
+			break;
+		}
+
+		ret = client_async_submit(client, sqes, submit.nr);
+		kfree(sqes);
+		if (ret < 0)
+			break;
+
+		submit.submitted = ret;
+		ret = 0;
+		if (copy_to_user(uarg, &submit, sizeof(submit)))
+			ret = -EFAULT;
+
+		break;
+	}
+	case MC_IO_ASYNC_REAP: {
+		struct mc_ioctl_async_reap reap;
+		struct mc_ioctl_async_cqe *cqes;
+
+		if (copy_from_user(&reap, uarg, sizeof(reap))) {
+			ret = -EFAULT;
+			break;
+		}
+
+		if (!reap.nr || reap.nr > MC_ASYNC_BATCH_MAX) {
+			ret = -EINVAL;
+			break;
+		}
+
+		cqes = kmalloc_array(reap.nr, sizeof(*cqes), GFP_KERNEL);
+		if (!cqes) {
+			ret = -ENOMEM;
+			break;
+		}
+
+		ret = client_async_reap(client, cqes, reap.nr,
+					reap.min_complete, reap.timeout);
+		if (ret < 0) {
+			kfree(cqes);
+			break;
+		}
+
+		reap.reaped = ret;
+		ret = 0;
+		/* Completions are consumed, a fault here loses them */
+		if (copy_to_user((void __user *)(uintptr_t)reap.cqes, cqes,
+				 reap.reaped * sizeof(cqes[0])) ||
+		    copy_to_user(uarg, &reap, sizeof(reap)))
+			ret = -EFAULT;
+
+		kfree(cqes);
+		break;
+	}
 	case MC_IO_GP_INITIALIZE_CONTEXT: {
 		struct mc_ioctl_gp_initialize_context context;
 
@@ -405,6 +478,17 @@ static int user_mmap(struct file *file, struct vm_area_struct *vmarea)
 				  NULL, vmarea);
 }
 
+static __poll_t user_poll(struct file *file, poll_table *wait)
+{
+	struct tee_client *client = get_client(file);
+
+	if (!client)
+		return EPOLLERR;
+
+	/* Readable when asynchronous notifications have completed */
+	return client_async_poll(client, file, wait);
+}
+
 static const struct file_operations mc_user_fops = {
 	.owner = THIS_MODULE,
 	.open = user_open,
@@ -414,6 +498,7 @@ static const struct file_operations mc_user_fops = {
 	.compat_ioctl = user_ioctl,
 #endif
 	.mmap = user_mmap,
+	.poll = user_poll,
 };
 
 int mc_user_init(struct cdev *cdev)
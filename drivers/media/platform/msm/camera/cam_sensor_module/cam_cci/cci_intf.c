@@ -17,15 +17,55 @@
 #include <linux/module.h>
 #include <linux/miscdevice.h>
 #include <linux/version.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
 #include <cam_cci_dev.h>
 #include <media/v4l2-ioctl.h>
 #include <media/cci_intf.h>
 
+/* Per open file, the register table is reused by every write */
+struct cci_intf_file {
+	struct mutex lock;
+	bool session_open;
+	struct msm_cci_intf_session session;
+	struct cam_sensor_cci_client cci_info;
+	struct cam_sensor_i2c_reg_array reg_tbl[MSM_CCI_INTF_MAX_SCRIPT];
+	struct msm_cci_intf_script_entry script[MSM_CCI_INTF_MAX_SCRIPT];
+};
+
+static struct v4l2_subdev *cci_intf_subdev(unsigned short cci_device)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
+	return cam_cci_get_subdev(cci_device);
+#else
+	return cam_cci_get_subdev();
+#endif
+}
+
+static int32_t cci_intf_cfg(unsigned short cci_device,
+		struct cam_cci_ctrl *cci_ctrl)
+{
+	return v4l2_subdev_call(cci_intf_subdev(cci_device),
+			core, ioctl, VIDIOC_MSM_CCI_CFG, cci_ctrl);
+}
+
+static bool cci_intf_session_holds(struct cci_intf_file *cf,
+		struct msm_cci_intf_xfer *xfer)
+{
+	return cf->session_open &&
+		cf->session.cci_device == xfer->cci_device &&
+		cf->session.cci_bus == xfer->cci_bus;
+}
+
 static int32_t cci_intf_xfer(
+		struct cci_intf_file *cf,
 		struct msm_cci_intf_xfer *xfer,
 		unsigned int cmd)
 {
 	int32_t rc, rc2;
+	bool held = cci_intf_session_holds(cf, xfer);
 	uint16_t addr;
 	struct cam_sensor_cci_client cci_info = {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
@@ -57,17 +97,14 @@ static int32_t cci_intf_xfer(
 			xfer->data.count > MSM_CCI_INTF_MAX_XFER)
 		return -EINVAL;
 
-	/* init */
-	cci_ctrl.cmd = MSM_CCI_INIT;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
-	rc = v4l2_subdev_call(cam_cci_get_subdev(xfer->cci_device),
-#else
-	rc = v4l2_subdev_call(cam_cci_get_subdev(),
-#endif
-			core, ioctl, VIDIOC_MSM_CCI_CFG, &cci_ctrl);
-	if (rc < 0) {
-		pr_err("%s: cci init fail (%d)\n", __func__, rc);
-		return rc;
+	/* init, unless the session already did */
+	if (!held) {
+		cci_ctrl.cmd = MSM_CCI_INIT;
+		rc = cci_intf_cfg(xfer->cci_device, &cci_ctrl);
+		if (rc < 0) {
+			pr_err("%s: cci init fail (%d)\n", __func__, rc);
+			return rc;
+		}
 	}
 
 	switch (cmd) {
@@ -95,13 +132,9 @@ static int32_t cci_intf_xfer(
 		break;
 	case MSM_CCI_INTF_WRITE:
 		/* write */
-		reg_conf_tbl = kzalloc(xfer->data.count *
-				sizeof(struct cam_sensor_i2c_reg_array),
-				GFP_KERNEL);
-		if (!reg_conf_tbl) {
-			rc = -ENOMEM;
-			goto release;
-		}
+		reg_conf_tbl = cf->reg_tbl;
+		memset(reg_conf_tbl, 0, xfer->data.count *
+				sizeof(struct cam_sensor_i2c_reg_array));
 		addr = xfer->reg.addr;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
 		for (i = 0; i < xfer->data.count; i += xfer->data.width) {
@@ -148,7 +181,6 @@ static int32_t cci_intf_xfer(
 		rc = v4l2_subdev_call(cam_cci_get_subdev(),
 #endif
 				core, ioctl, VIDIOC_MSM_CCI_CFG, &cci_ctrl);
-		kfree(reg_conf_tbl);
 		if (rc < 0) {
 			pr_err("%s: cci write fail (%d)\n", __func__, rc);
 			goto release;
@@ -162,14 +194,12 @@ static int32_t cci_intf_xfer(
 	}
 
 release:
+	if (held)
+		return rc;
+
 	/* release */
 	cci_ctrl.cmd = MSM_CCI_RELEASE;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
-	rc2 = v4l2_subdev_call(cam_cci_get_subdev(xfer->cci_device),
-#else
-	rc2 = v4l2_subdev_call(cam_cci_get_subdev(),
-#endif
-			core, ioctl, VIDIOC_MSM_CCI_CFG, &cci_ctrl);
+	rc2 = cci_intf_cfg(xfer->cci_device, &cci_ctrl);
 	if (rc2 < 0) {
 		pr_err("%s: cci release fail (%d)\n", __func__, rc2);
 		return rc2;
@@ -178,11 +208,209 @@ release:
 	return rc;
 }
 
+static int32_t cci_intf_session_open(struct cci_intf_file *cf,
+		struct msm_cci_intf_session *session)
+{
+	struct cam_cci_ctrl cci_ctrl = {
+		.cci_info = &cf->cci_info,
+		.cmd = MSM_CCI_INIT,
+	};
+	int32_t rc;
+
+	pr_debug("%s bus:%d devaddr:%02x regw:%d dataw:%d\n", __func__,
+			session->cci_bus, session->slave_addr,
+			session->reg_width, session->data_width);
+
+	if (cf->session_open)
+		return -EBUSY;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,19,0)
+	if (session->cci_device > 1 || session->data_width < 1 ||
+			session->data_width > 4 || session->data_width == 3 ||
+#else
+	if (session->data_width != 1 ||
+#endif
+			session->cci_bus > 1 || session->slave_addr > 0x7F ||
+			session->reg_width < 1 || session->reg_width > 2)
+		return -EINVAL;
+
+	cf->cci_info.cci_subdev = cci_intf_subdev(session->cci_device);
+	cf->cci_info.cci_i2c_master = session->cci_bus;
+	cf->cci_info.sid = session->slave_addr;
+
+	rc = cci_intf_cfg(session->cci_device, &cci_ctrl);
+	if (rc < 0) {
+		pr_err("%s: cci init fail (%d)\n", __func__, rc);
+		return rc;
+	}
+
+	cf->session = *session;
+	cf->session_open = true;
+	return 0;
+}
+
+static int32_t cci_intf_session_close(struct cci_intf_file *cf)
+{
+	struct cam_cci_ctrl cci_ctrl = {
+		.cci_info = &cf->cci_info,
+		.cmd = MSM_CCI_RELEASE,
+	};
+	int32_t rc;
+
+	if (!cf->session_open)
+		return -EINVAL;
+
+	cf->session_open = false;
+	rc = cci_intf_cfg(cf->session.cci_device, &cci_ctrl);
+	if (rc < 0)
+		pr_err("%s: cci release fail (%d)\n", __func__, rc);
+
+	return rc;
+}
+
+/* One CCI burst for the first count entries of the register table */
+static int32_t cci_intf_script_write(struct cci_intf_file *cf, int count)
+{
+	struct cam_cci_ctrl cci_ctrl = {
+		.cci_info = &cf->cci_info,
+		.cmd = MSM_CCI_I2C_WRITE,
+	};
+	int32_t rc;
+
+	cci_ctrl.cfg.cci_i2c_write_cfg.reg_setting = cf->reg_tbl;
+	cci_ctrl.cfg.cci_i2c_write_cfg.addr_type =
+		(cf->session.reg_width == 1 ?
+			CAMERA_SENSOR_I2C_TYPE_BYTE :
+			CAMERA_SENSOR_I2C_TYPE_WORD);
+	cci_ctrl.cfg.cci_i2c_write_cfg.data_type = cf->session.data_width;
+	cci_ctrl.cfg.cci_i2c_write_cfg.size = count;
+
+	rc = cci_intf_cfg(cf->session.cci_device, &cci_ctrl);
+	if (rc < 0) {
+		pr_err("%s: cci write fail (%d)\n", __func__, rc);
+		return rc;
+	}
+
+	return cci_ctrl.status;
+}
+
+static int32_t cci_intf_script_read(struct cci_intf_file *cf,
+		struct msm_cci_intf_script_entry *entry)
+{
+	struct cam_cci_ctrl cci_ctrl = {
+		.cci_info = &cf->cci_info,
+		.cmd = MSM_CCI_I2C_READ,
+	};
+	uint8_t buf[4];
+	int32_t rc;
+	int i;
+
+	cci_ctrl.cfg.cci_i2c_read_cfg.addr = entry->addr;
+	cci_ctrl.cfg.cci_i2c_read_cfg.addr_type =
+		(cf->session.reg_width == 1 ?
+			CAMERA_SENSOR_I2C_TYPE_BYTE :
+			CAMERA_SENSOR_I2C_TYPE_WORD);
+	cci_ctrl.cfg.cci_i2c_read_cfg.data = buf;
+	cci_ctrl.cfg.cci_i2c_read_cfg.num_byte = cf->session.data_width;
+
+	rc = cci_intf_cfg(cf->session.cci_device, &cci_ctrl);
+	if (rc < 0) {
+		pr_err("%s: cci read fail (%d)\n", __func__, rc);
+		return rc;
+	}
+
+	entry->data = 0;
+	for (i = 0; i < cf->session.data_width; i++)
+		entry->data = (entry->data << 8) | buf[i];
+
+	return cci_ctrl.status;
+}
+
+static void cci_intf_script_delay(uint32_t delay_us)
+{
+	if (!delay_us)
+		return;
+
+	if (delay_us < 20000)
+		usleep_range(delay_us, delay_us + delay_us / 8 + 10);
+	else
+		msleep(DIV_ROUND_UP(delay_us, 1000));
+}
+
+static int32_t cci_intf_script(struct cci_intf_file *cf,
+		struct msm_cci_intf_script *scr)
+{
+	struct msm_cci_intf_script_entry *entry;
+	void __user *entries = u64_to_user_ptr(scr->entries);
+	uint32_t reg_max;
+	int32_t rc = 0;
+	ktime_t start;
+	int i, n = 0;
+
+	if (!cf->session_open)
+		return -EINVAL;
+
+	if (scr->count < 1 || scr->count > MSM_CCI_INTF_MAX_SCRIPT)
+		return -EINVAL;
+
+	if (copy_from_user(cf->script, entries,
+			scr->count * sizeof(*entry)))
+		return -EFAULT;
+
+	/* Check the whole script before anything goes on the bus */
+	reg_max = (1 << (8 * cf->session.reg_width)) - 1;
+	for (i = 0; i < scr->count; i++) {
+		entry = &cf->script[i];
+		if (entry->addr > reg_max ||
+				entry->delay_us > MSM_CCI_INTF_MAX_DELAY_US ||
+				(entry->op != MSM_CCI_INTF_OP_WRITE &&
+				 entry->op != MSM_CCI_INTF_OP_READ))
+			return -EINVAL;
+	}
+
+	scr->done = 0;
+	scr->bursts = 0;
+	start = ktime_get();
+	for (i = 0; i < scr->count; i++) {
+		entry = &cf->script[i];
+		if (entry->op == MSM_CCI_INTF_OP_WRITE) {
+			cf->reg_tbl[n].reg_addr = entry->addr;
+			cf->reg_tbl[n].reg_data = entry->data;
+			cf->reg_tbl[n].delay = 0;
+			cf->reg_tbl[n].data_mask = 0;
+			n++;
+			/* Coalesce with the next write unless we wait here */
+			if (!entry->delay_us && i + 1 < scr->count &&
+				cf->script[i + 1].op == MSM_CCI_INTF_OP_WRITE)
+				continue;
+			rc = cci_intf_script_write(cf, n);
+			n = 0;
+		} else {
+			rc = cci_intf_script_read(cf, entry);
+		}
+		if (rc < 0)
+			break;
+
+		scr->bursts++;
+		scr->done = i + 1;
+		cci_intf_script_delay(entry->delay_us);
+	}
+	scr->elapsed_us = ktime_us_delta(ktime_get(), start);
+
+	if (copy_to_user(entries, cf->script, scr->count * sizeof(*entry)))
+		return -EFAULT;
+
+	return rc;
+}
+
 static long cci_intf_ioctl(struct file *file, unsigned int cmd,
 		unsigned long arg)
 {
+	struct cci_intf_file *cf = file->private_data;
 	struct msm_cci_intf_xfer xfer;
-	int rc;
+	struct msm_cci_intf_session session;
+	struct msm_cci_intf_script scr;
+	long rc;
 
 	pr_debug("%s cmd=%x arg=%lx\n", __func__, cmd, arg);
 
@@ -191,10 +419,34 @@ static long cci_intf_ioctl(struct file *file, unsigned int cmd,
 	case MSM_CCI_INTF_WRITE:
 		if (copy_from_user(&xfer, (void __user *)arg, sizeof(xfer)))
 			return -EFAULT;
-		rc = cci_intf_xfer(&xfer, cmd);
+		mutex_lock(&cf->lock);
+		rc = cci_intf_xfer(cf, &xfer, cmd);
+		mutex_unlock(&cf->lock);
 		if (copy_to_user((void __user *)arg, &xfer, sizeof(xfer)))
 			return -EFAULT;
 		return rc;
+	case MSM_CCI_INTF_SESSION_OPEN:
+		if (copy_from_user(&session, (void __user *)arg,
+				sizeof(session)))
+			return -EFAULT;
+		mutex_lock(&cf->lock);
+		rc = cci_intf_session_open(cf, &session);
+		mutex_unlock(&cf->lock);
+		return rc;
+	case MSM_CCI_INTF_SESSION_CLOSE:
+		mutex_lock(&cf->lock);
+		rc = cci_intf_session_close(cf);
+		mutex_unlock(&cf->lock);
+		return rc;
+	case MSM_CCI_INTF_SCRIPT:
+		if (copy_from_user(&scr, (void __user *)arg, sizeof(scr)))
+			return -EFAULT;
+		mutex_lock(&cf->lock);
+		rc = cci_intf_script(cf, &scr);
+		mutex_unlock(&cf->lock);
+		if (copy_to_user((void __user *)arg, &scr, sizeof(scr)))
+			return -EFAULT;
+		return rc;
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -213,6 +465,10 @@ static long cci_intf_ioctl_compat(struct file *file, unsigned int cmd,
 	case MSM_CCI_INTF_WRITE32:
 		cmd = MSM_CCI_INTF_WRITE;
 		break;
+	case MSM_CCI_INTF_SESSION_OPEN:
+	case MSM_CCI_INTF_SESSION_CLOSE:
+	case MSM_CCI_INTF_SCRIPT:
+		break;
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -220,8 +476,34 @@ static long cci_intf_ioctl_compat(struct file *file, unsigned int cmd,
 }
 #endif
 
+static int cci_intf_open(struct inode *inode, struct file *file)
+{
+	struct cci_intf_file *cf;
+
+	BUILD_BUG_ON(MSM_CCI_INTF_MAX_XFER > MSM_CCI_INTF_MAX_SCRIPT);
+	cf = kzalloc(sizeof(*cf), GFP_KERNEL);
+	if (!cf)
+		return -ENOMEM;
+
+	mutex_init(&cf->lock);
+	file->private_data = cf;
+	return 0;
+}
+
+static int cci_intf_release(struct inode *inode, struct file *file)
+{
+	struct cci_intf_file *cf = file->private_data;
+
+	if (cf->session_open)
+		cci_intf_session_close(cf);
+	kfree(cf);
+	return 0;
+}
+
 static const struct file_operations cci_intf_fops = {
 	.owner = THIS_MODULE,
+	.open = cci_intf_open,
+	.release = cci_intf_release,
 	.unlocked_ioctl = cci_intf_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = cci_intf_ioctl_compat,
@@ -15,8 +15,10 @@
 #include <linux/fcntl.h>
 #include <linux/fs.h>
 #include <linux/file.h>
+#include <linux/hashtable.h>
 #include <linux/ioctl.h>
 #include <linux/input.h>
+#include <linux/jhash.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/module.h>
@@ -38,6 +40,7 @@
 #include <linux/workqueue.h>
 #include <linux/version.h>
 #include <linux/blk_types.h>
+#include <linux/crc32.h>
 
 #define MAX_UTAG_SIZE 1024
 #define MAX_UTAG_NAME 32
@@ -49,6 +52,7 @@
 #define DRVNAME "utags"
 #define DEFAULT_ROOT "config"
 #define HW_ROOT "hw"
+#define UTAG_HASH_BITS 6
 
 struct ctrl;
 
@@ -70,6 +74,7 @@ struct utag {
 	void *payload;
 	struct utag *next;
 	struct utag *prev;
+	struct hlist_node hnode; /* entry in ctrl->index by name */
 };
 
 struct frozen_utag {
@@ -82,6 +87,24 @@ struct frozen_utag {
 
 #define UTAG_MIN_TAG_SIZE   (sizeof(struct frozen_utag))
 
+/*
+ * Commit record kept in the payload of the head utag. The crc covers
+ * the image from the first utag after the head up to the util size,
+ * so an interrupted write leaves a copy that fails the check.
+ */
+#define UTAG_COMMIT_MAGIC 0x55434d54 /* UCMT */
+/* first page of a copy whose other pages are being written */
+#define UTAG_COMMIT_PENDING 0x55504e44 /* UPND */
+
+struct utag_commit {
+	uint32_t magic;
+	uint32_t seq;
+	uint32_t crc;
+};
+
+#define UTAG_COMMIT_START \
+	(UTAG_MIN_TAG_SIZE + ROUNDUP(sizeof(struct utag_commit), 4))
+
 enum utag_output {
 	OUT_ASCII = 0,
 	OUT_RAW,
@@ -121,6 +144,9 @@ struct blkdev {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0) || defined(CONFIG_MMI_UTAG_RW_BIO)
 	struct block_device *bdev;
 #endif
+	void *image; /* last image known to be on this copy */
+	size_t image_size;
+	uint32_t seq;
 };
 
 struct ctrl {
@@ -146,6 +172,16 @@ struct ctrl {
 	struct work_struct store_work;
 	struct utag *head;
 	int store_work_result;
+	/* resident tags: head list indexed by full name, valid while head set */
+	DECLARE_HASHTABLE(index, UTAG_HASH_BITS);
+	uint64_t loads;
+	uint64_t hits;
+	/* commit sequence, the copy with the highest valid one is loaded */
+	uint32_t seq;
+	struct blkdev *loaded;
+	uint64_t commits;
+	uint64_t pages_written;
+	uint64_t recovered;
 };
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0) || defined(CONFIG_MMI_UTAG_RW_BIO)
@@ -170,7 +206,8 @@ static struct page *addr_to_page(void *addr)
 #define NR_BIO_MAX_PAGES BIO_MAX_PAGES
 #endif
 
-static int utags_submit_bio(struct block_device *bdev, void *buf, int pages, int opf)
+static int utags_submit_bio(struct block_device *bdev, void *buf, int pages,
+	sector_t start, int opf)
 {
 	int i, ret;
 	struct bio *bio;
@@ -188,7 +225,8 @@ static int utags_submit_bio(struct block_device *bdev, void *buf, int pages, int
 		if (!bio)
 			return -ENOMEM;
 
-		bio->bi_iter.bi_sector = (pages - left_pages) * (PAGE_SIZE >> 9);
+		bio->bi_iter.bi_sector = start +
+			(pages - left_pages) * (PAGE_SIZE >> 9);
 		bio->bi_opf = opf;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(6, 1, 0)
 		bio_set_dev(bio, bdev);
@@ -212,17 +250,20 @@ static int utags_submit_bio(struct block_device *bdev, void *buf, int pages, int
 	return ret;
 }
 
-static ssize_t rw_bdev(struct block_device *bdev, void *buf, size_t count, int opf)
+static ssize_t rw_bdev(struct block_device *bdev, void *buf, size_t count,
+	loff_t pos, int opf)
 {
 	int ret;
 
-	ret = utags_submit_bio(bdev, buf, 1 << get_order(count), opf);
+	/* only whole pages of the buffer, pos is page aligned */
+	ret = utags_submit_bio(bdev, buf, DIV_ROUND_UP(count, PAGE_SIZE),
+		pos >> 9, opf);
 	return  ret < 0 ? ret : count;
 }
 
 static ssize_t kernel_read_stub(struct blkdev* cb, void *buf, size_t count)
 {
-	return rw_bdev(cb->bdev, buf, count, REQ_OP_READ);
+	return rw_bdev(cb->bdev, buf, count, 0, REQ_OP_READ);
 }
 #elif LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 static inline ssize_t kernel_read_stub(struct blkdev* cb, void *addr, size_t count)
@@ -238,20 +279,22 @@ static inline ssize_t kernel_read_stub(struct blkdev* cb, void *addr, size_t cou
 #endif
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0) || defined(CONFIG_MMI_UTAG_RW_BIO)
-static ssize_t kernel_write_stub(struct blkdev* cb, void *buf, size_t count)
+static ssize_t kernel_write_stub(struct blkdev* cb, void *buf, size_t count,
+	loff_t pos)
 {
-	return rw_bdev(cb->bdev, buf, count, REQ_OP_WRITE | REQ_SYNC);
+	return rw_bdev(cb->bdev, buf, count, pos,
+		REQ_OP_WRITE | REQ_SYNC | REQ_FUA);
 }
 #elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
-static inline ssize_t kernel_write_stub(struct blkdev* cb, void *addr, size_t count)
+static inline ssize_t kernel_write_stub(struct blkdev* cb, void *addr, size_t count,
+	loff_t pos)
 {
-	loff_t pos = 0;
 	return kernel_write(cb->filep, addr, count, &pos);
 }
 #else
-static inline ssize_t kernel_write_stub(struct blkdev* cb, void *addr, size_t count)
+static inline ssize_t kernel_write_stub(struct blkdev* cb, void *addr, size_t count,
+	loff_t pos)
 {
-	loff_t pos = 0;
 	return vfs_write(cb->filep, addr, count, &pos);
 }
 #endif
@@ -268,8 +311,10 @@ static ssize_t new_utag(struct file *file, const char __user *buffer,
 static ssize_t delete_utag(struct file *file, const char __user *buffer,
 	   size_t count, loff_t *pos);
 static int add_utag_tail(struct utag *head, char *utag_name, char *utag_type);
+static inline void free_tags(struct utag *tags);
 
 static int lock_open(struct inode *inode, struct file *file);
+static int stats_open(struct inode *inode, struct file *file);
 static int partition_open(struct inode *inode, struct file *file);
 
 #if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
@@ -293,6 +338,13 @@ static const struct proc_ops lock_fops = {
 	.proc_release = single_release,
 };
 
+static const struct proc_ops stats_fops = {
+	.proc_open = stats_open,
+	.proc_read = seq_read,
+	.proc_lseek = seq_lseek,
+	.proc_release = single_release,
+};
+
 static const struct proc_ops delete_fops = {
 	.proc_read = NULL,
 	.proc_write = delete_utag,
@@ -319,6 +371,13 @@ static const struct file_operations lock_fops = {
 	.release = single_release,
 };
 
+static const struct file_operations stats_fops = {
+	.open = stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static const struct file_operations delete_fops = {
 	.read = NULL,
 	.write = delete_utag,
@@ -404,7 +463,8 @@ static int init_empty(struct ctrl *ctrl)
 	ctrl->head = htag;
 	queue_work(ctrl->store_queue, &ctrl->store_work);
 	wait_for_completion(&ctrl->store_comp);
-	kfree(htag);
+	ctrl->head = NULL;
+	free_tags(htag);
 	return 0;
 }
 
@@ -687,6 +747,7 @@ static int add_utag_tail(struct utag *head, char *utag_name, char *utag_type)
 		return -ENOMEM;
 
 	strlcpy(new->name, utag, MAX_UTAG_NAME);
+	strlcpy(new->name_only, utag_name, MAX_UTAG_NAME);
 	new->size = new->flags = new->util = 0;
 
 	if (!tail->prev) { /* tail is in fact the head */
@@ -704,29 +765,73 @@ static int add_utag_tail(struct utag *head, char *utag_name, char *utag_type)
 	return 0;
 }
 
+static inline u32 utag_hash(const char *name)
+{
+	return jhash(name, strnlen(name, MAX_UTAG_NAME), 0);
+}
+
 /*
  * Find first instance of utag by specified name
  */
 
-static struct utag *find_first_utag(const struct utag *head, const char *name)
+static struct utag *find_first_utag(struct ctrl *ctrl, const char *name)
 {
 	struct utag *cur;
 
-	if (!head)
-		return NULL;
-
-	cur = head->next;	/* skip HEAD */
-	while (cur) {
-		/* skip TAIL */
-		if (cur->next == NULL)
-			break;
+	hash_for_each_possible(ctrl->index, cur, hnode, utag_hash(name)) {
 		if (names_match(name, cur->name))
 			return cur;
-		cur = cur->next;
 	}
 	return NULL;
 }
 
+/*
+ * Rebuild the name index of the tags list. Tags are added from
+ * the tail so a bucket keeps duplicate names in list order.
+ */
+
+static void index_tags(struct ctrl *ctrl, struct utag *head)
+{
+	struct utag *cur;
+
+	hash_init(ctrl->index);
+	if (head) {
+		for (cur = head; cur->next; cur = cur->next)
+			;
+		/* skip TAIL and HEAD */
+		for (cur = cur->prev; cur && cur->prev; cur = cur->prev)
+			hash_add(ctrl->index, &cur->hnode,
+				utag_hash(cur->name));
+	}
+
+	/* Save pointer to the root attributes UTAG if present */
+	if (ctrl->hwtag) {
+		ctrl->attrib = find_first_utag(ctrl, ".attributes");
+		pr_debug(" .attributes %s\n", ctrl->attrib ?
+			"found" : "not found");
+		ctrl->features = find_first_utag(ctrl, ".features");
+		pr_debug(" .features %s\n", ctrl->features ?
+			 "found" : "not found");
+	}
+}
+
+/*
+ * Unlink a tag from the list and the index and free it
+ */
+
+static void remove_utag(struct ctrl *ctrl, struct utag *utag)
+{
+	utag->prev->next = utag->next;
+	utag->next->prev = utag->prev;
+	hash_del(&utag->hnode);
+	if (ctrl->attrib == utag)
+		ctrl->attrib = NULL;
+	if (ctrl->features == utag)
+		ctrl->features = NULL;
+	kfree(utag->payload);
+	kfree(utag);
+}
+
 /*
  * Create, initialize add to the list procfs utag file node
  */
@@ -799,6 +904,11 @@ static int proc_utag_util(struct ctrl *ctrl)
 		return -EIO;
 	}
 
+	if (!proc_create_data("stats", 0440, dir, &stats_fops, ctrl)) {
+		pr_err("Failed to create stats entry\n");
+		return -EIO;
+	}
+
 	if (!proc_create_data(".delete", 0220, dir, &delete_fops, ctrl)) {
 		pr_err("Failed to create delete entry\n");
 		return -EIO;
@@ -997,7 +1107,8 @@ static void *freeze_tags(size_t block_size, struct utag *tags,
 		return NULL;
 	}
 
-	ptr = buf = vmalloc(frozen_size);
+	/* page padded, the block layer writes whole pages */
+	ptr = buf = vzalloc(PAGE_ALIGN(frozen_size));
 	if (!buf)
 		return NULL;
 
@@ -1047,6 +1158,142 @@ static void *freeze_tags(size_t block_size, struct utag *tags,
 	return buf;
 }
 
+/*
+ * Put a commit record for seq in the head utag, the crc is filled
+ * in by seal_image() once the tags are frozen
+ */
+static int seal_tags(struct utag *head, uint32_t seq)
+{
+	struct utag_commit *commit = head->payload;
+
+	if (head->size != sizeof(*commit)) {
+		commit = kzalloc(sizeof(*commit) + 1, GFP_KERNEL);
+		if (!commit)
+			return -ENOMEM;
+		kfree(head->payload);
+		head->payload = commit;
+		head->size = sizeof(*commit);
+	}
+
+	commit->magic = htonl(UTAG_COMMIT_MAGIC);
+	commit->seq = htonl(seq);
+	commit->crc = 0;
+	return 0;
+}
+
+static void seal_image(void *buf, size_t size)
+{
+	struct frozen_utag *frozen = buf;
+	struct utag_commit *commit = (struct utag_commit *)frozen->payload;
+
+	commit->crc = htonl(crc32(0, buf + UTAG_COMMIT_START,
+		size - UTAG_COMMIT_START));
+}
+
+/*
+ * Check the commit record of an image read from a copy
+ * Return: 0 if the image can be used, seq is 0 for images written
+ * without a commit record. -EBADMSG if the crc doesn't match a complete
+ * commit record, the image was edited afterwards, seq is the record's.
+ */
+static int check_image(void *buf, size_t bytes, uint32_t *seq)
+{
+	struct frozen_utag *frozen = buf;
+	struct utag_commit *commit = (struct utag_commit *)frozen->payload;
+	size_t size;
+
+	*seq = 0;
+	if (bytes < UTAG_COMMIT_START ||
+	    strncmp(frozen->name, UTAG_HEAD, MAX_UTAG_NAME))
+		return -EIO;
+
+	if (ntohl(frozen->size) != sizeof(*commit))
+		return 0;
+
+	/* torn by a power loss while the other pages were written */
+	if (ntohl(commit->magic) == UTAG_COMMIT_PENDING)
+		return -EIO;
+
+	if (ntohl(commit->magic) != UTAG_COMMIT_MAGIC)
+		return 0;
+
+	size = ntohl(frozen->util);
+	if (size < UTAG_COMMIT_START || size > bytes)
+		return -EIO;
+
+	*seq = ntohl(commit->seq);
+	if (ntohl(commit->crc) != crc32(0, buf + UTAG_COMMIT_START,
+			size - UTAG_COMMIT_START))
+		return -EBADMSG;
+
+	return 0;
+}
+
+static void set_image(struct blkdev *cb, void *image, size_t size)
+{
+	vfree(cb->image);
+	cb->image = image;
+	cb->image_size = size;
+}
+
+/*
+ * Remember the tags part of a good image read from a copy
+ */
+static void keep_image(struct blkdev *cb, void *buf, size_t bytes)
+{
+	struct frozen_utag *frozen = buf;
+	size_t size = ntohl(frozen->util);
+	void *image;
+
+	if (!size || size > bytes)
+		return;
+
+	image = vmalloc(size);
+	if (!image)
+		return;
+
+	memcpy(image, buf, size);
+	set_image(cb, image, size);
+}
+
+/*
+ * Read a whole copy into memory
+ */
+static void *read_copy(struct blkdev *cb, size_t bytes)
+{
+	void *data;
+	ssize_t ret_bytes;
+
+	data = vmalloc(bytes);
+	if (!data)
+		return NULL;
+
+	ret_bytes = kernel_read_stub(cb, data, bytes);
+	if (bytes != ret_bytes) {
+		pr_err("(%s) read failed ret %zd\n", cb->name, ret_bytes);
+		vfree(data);
+		return NULL;
+	}
+
+	return data;
+}
+
+/*
+ * Size of the image recorded in the head utag of a copy, the whole
+ * copy if the head can't tell
+ */
+static size_t image_size(struct blkdev *cb)
+{
+	struct utag htag;
+
+	memset(&htag, 0, sizeof(struct utag));
+	if (read_head(cb, &htag) || htag.util < UTAG_MIN_TAG_SIZE ||
+	    htag.util > cb->size)
+		return cb->size;
+
+	return htag.util;
+}
+
 /*
  * Try to load utags into memory from a partition on secondary storage.
  *
@@ -1054,15 +1301,23 @@ static void *freeze_tags(size_t block_size, struct utag *tags,
  */
 static struct utag *load_utags(struct blkdev *cb)
 {
-	size_t bytes;
-	int ret_bytes;
-	void *data;
+	size_t bytes, bbytes = 0;
+	void *data, *bdata = NULL;
+	bool main_ok, backup_ok = false, edited, recommit = false;
+	int main_rc;
 	struct utag *head = NULL;
 	struct ctrl *ctrl = container_of(cb, struct ctrl, main);
+	struct blkdev *bb = &ctrl->backup;
 
 	if (open_utags(cb))
 		return NULL;
 
+	ctrl->loads++;
+	/* copies are rewritten in full until their content is known */
+	set_image(cb, NULL, 0);
+	set_image(bb, NULL, 0);
+	cb->seq = bb->seq = 0;
+
 	bytes = data_size(cb);
 
 	/*
@@ -1078,31 +1333,83 @@ static struct utag *load_utags(struct blkdev *cb)
 		bytes = UTAG_MIN_TAG_SIZE * 2;
 	}
 
-	data = vmalloc(bytes);
+	data = read_copy(cb, bytes);
 	if (!data)
 		return NULL;
+	main_rc = check_image(data, bytes, &cb->seq);
+	main_ok = !main_rc;
 
-	ret_bytes = kernel_read_stub(cb, data, bytes);
-	if (bytes != ret_bytes) {
-		pr_err("(%s) read failed ret %d\n", cb->name, ret_bytes);
-		goto free_data;
+	if (bb->name && !open_utags(bb)) {
+		bbytes = image_size(bb);
+		bdata = read_copy(bb, bbytes);
+		backup_ok = bdata && !check_image(bdata, bbytes, &bb->seq);
+	}
+
+	/*
+	 * Pages are only written once the first page carries a pending
+	 * record, so a main copy failing the crc of a complete record was
+	 * edited afterwards. The bootloader does that, it rewrites tags
+	 * and keeps the head. Unless the backup holds a later commit, the
+	 * edit is the newest content: load it if it parses.
+	 */
+	edited = main_rc == -EBADMSG && (!backup_ok || cb->seq >= bb->seq);
+	if (edited) {
+		head = thaw_tags(bytes, data);
+		if (head) {
+			pr_info("[%s] main copy edited after seq %u, loading it\n",
+				ctrl->dir_name, cb->seq);
+			ctrl->loaded = cb;
+			recommit = true;
+		}
+	}
+
+	/*
+	 * The main copy is written first, so the backup only wins when
+	 * the main copy is torn or older. A main copy without a commit
+	 * record was written by somebody else, the bootloader for
+	 * instance, and is taken as is.
+	 */
+	if (!head && backup_ok &&
+	    (!main_ok || (cb->seq && bb->seq > cb->seq))) {
+		pr_err("[%s] main copy %s, loading backup seq %u\n",
+			ctrl->dir_name, main_ok ? "stale" : "corrupted",
+			bb->seq);
+		head = thaw_tags(bbytes, bdata);
+		if (head) {
+			ctrl->loaded = bb;
+			ctrl->recovered++;
+			recommit = true;
+		}
+	}
+
+	if (!head) {
+		head = thaw_tags(bytes, data);
+		ctrl->loaded = cb;
 	}
 
-	head = thaw_tags(bytes, data);
 	if (!head && ctrl->hwtag)
 		init_empty(ctrl);
 
-	/* Save pointer to the root attributes UTAG if present */
-	if (ctrl->hwtag) {
-		ctrl->attrib = find_first_utag(head, ".attributes");
-		pr_debug(" .attributes %s\n", ctrl->attrib ?
-			"found" : "not found");
-		ctrl->features = find_first_utag(head, ".features");
-		pr_debug(" .features %s\n", ctrl->features ?
-			 "found" : "not found");
+	if (head) {
+		ctrl->seq = max(cb->seq, bb->seq);
+		if (main_ok)
+			keep_image(cb, data, bytes);
+		if (backup_ok)
+			keep_image(bb, bdata, bbytes);
+
+		/*
+		 * The bootloader only parses the main copy: repair it right
+		 * away instead of at the next write, and bring the backup
+		 * in line with an edited main copy
+		 */
+		if (recommit && store_utags(ctrl, head))
+			pr_err("[%s] failed to rewrite copies\n",
+				ctrl->dir_name);
 	}
 
- free_data:
+	index_tags(ctrl, head);
+
+	vfree(bdata);
 	vfree(data);
 	return head;
 }
@@ -1119,6 +1426,53 @@ void load_work_func(struct work_struct *work)
 	complete(&ctrl->load_comp);
 }
 
+/*
+ * Return the resident tags, the main partition is only read on
+ * first use and after drop_tags()
+ *
+ * Call with access_lock held
+ */
+static struct utag *get_tags(struct ctrl *ctrl)
+{
+	if (ctrl->head) {
+		ctrl->hits++;
+		return ctrl->head;
+	}
+
+	queue_work(ctrl->load_queue, &ctrl->load_work);
+	wait_for_completion(&ctrl->load_comp);
+	return ctrl->head;
+}
+
+/*
+ * Forget the resident tags, next access reloads the partition
+ *
+ * Call with access_lock held
+ */
+static void drop_tags(struct ctrl *ctrl)
+{
+	hash_init(ctrl->index);
+	free_tags(ctrl->head);
+	ctrl->head = NULL;
+	ctrl->attrib = NULL;
+	ctrl->features = NULL;
+}
+
+/*
+ * Write the resident tags back, drop them if the partition
+ * may not match anymore
+ *
+ * Call with access_lock held
+ */
+static int commit_tags(struct ctrl *ctrl)
+{
+	queue_work(ctrl->store_queue, &ctrl->store_work);
+	wait_for_completion(&ctrl->store_comp);
+	if (ctrl->store_work_result)
+		drop_tags(ctrl);
+	return ctrl->store_work_result;
+}
+
 static int full_utag_name(struct proc_node *pnode, char *tag)
 {
 	int i, subdir, blen;
@@ -1164,7 +1518,7 @@ static int full_utag_name(struct proc_node *pnode, char *tag)
 	return blen;
 }
 
-static int check_utag_range(char *tag, struct utag *head, char *data,
+static int check_utag_range(char *tag, struct ctrl *ctrl, char *data,
 	size_t count)
 {
 	char rtag[MAX_UTAG_NAME];
@@ -1186,8 +1540,8 @@ static int check_utag_range(char *tag, struct utag *head, char *data,
 
 	pr_debug("utag range check [%s]\n", rtag);
 
-	/* walk the thawed list to find the range */
-	range = find_first_utag(head, rtag);
+	/* look the range up in the resident tags */
+	range = find_first_utag(ctrl, rtag);
 	if (!range) {
 		pr_debug("full name [%s] no .range\n", rtag);
 		return 0;
@@ -1245,14 +1599,14 @@ static int check_utag_range(char *tag, struct utag *head, char *data,
 	return 0;
 }
 
-static int replace_first_utag(struct utag *head, char *name,
+static int replace_first_utag(struct ctrl *ctrl, char *name,
 		void *payload, size_t size)
 {
 	struct utag *utag;
 	void *oldpayload;
 
 	/* search for the first occurrence of specified type of tag */
-	utag = find_first_utag(head, name);
+	utag = find_first_utag(ctrl, name);
 	if (!utag)
 		return 0;
 
@@ -1274,11 +1628,111 @@ static int replace_first_utag(struct utag *head, char *name,
 	return 0;
 }
 
+static bool page_changed(struct blkdev *cb, void *buf, size_t size,
+	size_t off)
+{
+	size_t len = min_t(size_t, PAGE_SIZE, size - off);
+
+	if (!cb->image || off + len > cb->image_size)
+		return true;
+
+	return memcmp(buf + off, cb->image + off, len) != 0;
+}
+
+/*
+ * Put the first page of a sealed image on a copy with a pending
+ * commit record, before any other page is written. A copy torn by a
+ * power loss then fails with it and is never taken for one edited by
+ * the bootloader, a page write being atomic.
+ */
+static ssize_t mark_pending(struct blkdev *cb, void *buf, size_t size)
+{
+	struct utag_commit *commit;
+	size_t len = min_t(size_t, PAGE_SIZE, size);
+	void *page;
+	ssize_t written;
+
+	page = vzalloc(PAGE_SIZE);
+	if (!page)
+		return -ENOMEM;
+
+	memcpy(page, buf, len);
+	commit = (struct utag_commit *)((struct frozen_utag *)page)->payload;
+	commit->magic = htonl(UTAG_COMMIT_PENDING);
+	written = kernel_write_stub(cb, page, len, 0);
+	vfree(page);
+	return written < (ssize_t)len ? -EIO : written;
+}
+
+/*
+ * Write a sealed image to a copy. Only the pages that differ from
+ * what the copy holds are written, the first page with the commit
+ * record is marked pending first and completed last, so the copy only
+ * turns valid once complete.
+ */
+static int write_copy(struct ctrl *ctrl, struct blkdev *cb, void *buf,
+	size_t size, uint32_t seq)
+{
+	size_t off, end, len;
+	ssize_t written;
+	bool pending = false;
+	void *image;
+
+	if (open_utags(cb))
+		return -EIO;
+
+	for (off = PAGE_SIZE; off < size; off = end) {
+		if (!page_changed(cb, buf, size, off)) {
+			end = off + PAGE_SIZE;
+			continue;
+		}
+
+		if (!pending) {
+			written = mark_pending(cb, buf, size);
+			if (written < 0)
+				goto err;
+			ctrl->pages_written++;
+			pending = true;
+		}
+
+		/* coalesce the run of changed pages into one write */
+		for (end = off + PAGE_SIZE; end < size; end += PAGE_SIZE)
+			if (!page_changed(cb, buf, size, end))
+				break;
+
+		len = min(end, size) - off;
+		written = kernel_write_stub(cb, buf + off, len, off);
+		if (written < (ssize_t)len)
+			goto err;
+		ctrl->pages_written += DIV_ROUND_UP(len, PAGE_SIZE);
+	}
+
+	len = min_t(size_t, PAGE_SIZE, size);
+	written = kernel_write_stub(cb, buf, len, 0);
+	if (written < (ssize_t)len)
+		goto err;
+	ctrl->pages_written++;
+
+	/* diff the next commit against this one */
+	image = vmalloc(size);
+	if (image)
+		memcpy(image, buf, size);
+	set_image(cb, image, image ? size : 0);
+	cb->seq = seq;
+	return 0;
+
+err:
+	pr_err("failed to write file (%s), rc=%zd\n", cb->name, written);
+	/* content unknown, rewrite it in full next time */
+	set_image(cb, NULL, 0);
+	return -EIO;
+}
+
 static int store_utags(struct ctrl *ctrl, struct utag *tags)
 {
-	size_t written;
 	size_t tags_size;
 	char *datap = NULL;
+	uint32_t seq = ctrl->seq + 1;
 	int rc = 0;
 	struct blkdev *cb = &ctrl->main;
 
@@ -1290,41 +1744,32 @@ static int store_utags(struct ctrl *ctrl, struct utag *tags)
 
 	pr_debug("[%s] utags partition blk_sz=%zu\n", ctrl->dir_name, cb->size);
 
-	datap = freeze_tags(cb->size, tags, &tags_size);
-	if (!datap) {
+	if (!tags || seal_tags(tags, seq)) {
 		rc = -EIO;
 		goto out;
 	}
 
-	if (open_utags(cb)) {
+	datap = freeze_tags(cb->size, tags, &tags_size);
+	if (!datap) {
 		rc = -EIO;
-		goto err_free;
+		goto out;
 	}
+	seal_image(datap, tags_size);
 
-	written = kernel_write_stub(cb, datap, tags_size);
-	if (written < tags_size) {
-		pr_err("failed to write file (%s), rc=%zu\n",
-			cb->name, written);
+	/*
+	 * Copies are written one after the other, whichever is torn by
+	 * a power loss fails its crc and the other one is loaded
+	 */
+	if (write_copy(ctrl, cb, datap, tags_size, seq))
 		rc = -EIO;
-	}
 
 	/* Only try to use backup partition if it is configured */
-	if (ctrl->backup.name) {
-		cb = &ctrl->backup;
-		if (open_utags(cb)) {
-			rc = -EIO;
-			goto err_free;
-		}
-
-		written = kernel_write_stub(cb, datap, tags_size);
-		if (written < tags_size) {
-			pr_err("failed to write file (%s), rc=%zu\n",
-				cb->name, written);
-			rc = -EIO;
-		}
-	}
+	if (ctrl->backup.name &&
+	    write_copy(ctrl, &ctrl->backup, datap, tags_size, seq))
+		rc = -EIO;
 
-err_free:
+	ctrl->seq = seq;
+	ctrl->commits++;
 	vfree(datap);
 out:
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 15, 0)
@@ -1361,9 +1806,7 @@ static int read_utag(struct seq_file *file, void *v)
 	int rc = 0;
 
 	mutex_lock(&ctrl->access_lock);
-	queue_work(ctrl->load_queue, &ctrl->load_work);
-	wait_for_completion(&ctrl->load_comp);
-	tags = ctrl->head;
+	tags = get_tags(ctrl);
 	if (NULL == tags) {
 		pr_err("load utags error\n");
 		mutex_unlock(&ctrl->access_lock);
@@ -1375,19 +1818,19 @@ static int read_utag(struct seq_file *file, void *v)
 	if (!error) {
 		seq_puts(file, "cannot find utag associated with this file\n");
 		rc = -EINVAL;
-		goto free_tags_exit;
+		goto unlock_exit;
 	}
 
-	tag = find_first_utag(tags, utag_name);
+	tag = find_first_utag(ctrl, utag_name);
 	if (NULL == tag) {
 		seq_printf(file, "utag [%s] not found\n", utag_name);
 		rc = -EINVAL;
-		goto free_tags_exit;
+		goto unlock_exit;
 	}
 
 	if (tag->payload == NULL) {
 		pr_err("utag [%s] payload is empty\n", utag_name);
-		goto free_tags_exit;
+		goto unlock_exit;
 	}
 
 	switch (proc->mode) {
@@ -1406,8 +1849,7 @@ static int read_utag(struct seq_file *file, void *v)
 	}
 	seq_puts(file, "\n");
 
-free_tags_exit:
-	free_tags(tags);
+unlock_exit:
 	mutex_unlock(&ctrl->access_lock);
 	return rc;
 }
@@ -1466,9 +1908,7 @@ static ssize_t write_utag(struct file *file, const char __user *buffer,
 	}
 
 	mutex_lock(&ctrl->access_lock);
-	queue_work(ctrl->load_queue, &ctrl->load_work);
-	wait_for_completion(&ctrl->load_comp);
-	tags = ctrl->head;
+	tags = get_tags(ctrl);
 	if (NULL == tags) {
 		pr_err("[%s] load error\n", ctrl->dir_name);
 		count = -EIO;
@@ -1478,7 +1918,7 @@ static ssize_t write_utag(struct file *file, const char __user *buffer,
 	if (ctrl->lock) {
 		pr_err("[%s] [%s] is locked\n", proc->name, ctrl->dir_name);
 		count = -EACCES;
-		goto free_tags_exit;
+		goto free_temp_exit;
 	}
 
 	/* traverse back all parent directories up to root */
@@ -1486,31 +1926,28 @@ static ssize_t write_utag(struct file *file, const char __user *buffer,
 	if (!error) {
 		pr_err("cannot find utag associated with this file\n");
 		count = -EIO;
-		goto free_tags_exit;
+		goto free_temp_exit;
 	}
 
 	/* check if this utag has .range child only for hwtags */
 	if (ctrl->hwtag && length) {
-		error = check_utag_range(utag, tags, payload, length);
+		error = check_utag_range(utag, ctrl, payload, length);
 		if (error) {
 			count = -EINVAL;
-			goto free_tags_exit;
+			goto free_temp_exit;
 		}
 	}
 
-	error = replace_first_utag(tags, utag, payload, length);
+	error = replace_first_utag(ctrl, utag, payload, length);
 	if (error) {
 		pr_err("error storing [%s] new payload\n", utag);
 		count = -EIO;
-		goto free_tags_exit;
+		goto free_temp_exit;
 	}
 
-	queue_work(ctrl->store_queue, &ctrl->store_work);
-	wait_for_completion(&ctrl->store_comp);
-	if (ctrl->store_work_result)
-		count = ctrl->store_work_result;
-free_tags_exit:
-	free_tags(tags);
+	error = commit_tags(ctrl);
+	if (error)
+		count = error;
 free_temp_exit:
 	kfree(payload);
 	mutex_unlock(&ctrl->access_lock);
@@ -1535,6 +1972,7 @@ static ssize_t delete_utag(struct file *file, const char __user *buffer,
 	struct utag *tags, *cur, *next;
 	struct inode *inode = file_inode(file);
 	struct ctrl *ctrl = PDE_DATA(inode);
+	int rc;
 
 	if ((MAX_UTAG_NAME < count) || (0 == count)) {
 		pr_err("invalid utag name %zu\n", count);
@@ -1557,9 +1995,7 @@ static ssize_t delete_utag(struct file *file, const char __user *buffer,
 		return -EINVAL;
 
 	mutex_lock(&ctrl->access_lock);
-	queue_work(ctrl->load_queue, &ctrl->load_work);
-	wait_for_completion(&ctrl->load_comp);
-	tags = ctrl->head;
+	tags = get_tags(ctrl);
 	if (NULL == tags) {
 		pr_err("[%s] load error\n", ctrl->dir_name);
 		mutex_unlock(&ctrl->access_lock);
@@ -1572,17 +2008,14 @@ static ssize_t delete_utag(struct file *file, const char __user *buffer,
 		goto just_leave;
 	}
 
-	cur = find_first_utag(tags, expendable);
+	cur = find_first_utag(ctrl, expendable);
 	if (!cur) {
 		pr_err("cannot find utag %s\n", expendable);
 		count = -EINVAL;
 		goto just_leave;
 	}
 
-	/* update pointers */
-	cur->prev->next = cur->next;
-	cur->next->prev = cur->prev;
-	kfree(cur);
+	remove_utag(ctrl, cur);
 	pr_debug("deleted utag [%s]\n", expendable);
 
 	/* remove all utags beneath */
@@ -1592,9 +2025,7 @@ static ssize_t delete_utag(struct file *file, const char __user *buffer,
 		if ((pattern == cur->name) && (cur->name[count-1] == '/')) {
 			pr_debug("deleting utag [%s]\n", cur->name);
 			next = cur->next;
-			cur->prev->next = cur->next;
-			cur->next->prev = cur->prev;
-			kfree(cur);
+			remove_utag(ctrl, cur);
 			cur = next;
 			continue;
 		}
@@ -1602,13 +2033,11 @@ static ssize_t delete_utag(struct file *file, const char __user *buffer,
 	}
 
 	/* Store changed partition */
-	queue_work(ctrl->store_queue, &ctrl->store_work);
-	wait_for_completion(&ctrl->store_comp);
-	if (ctrl->store_work_result)
-		count = ctrl->store_work_result;
+	rc = commit_tags(ctrl);
+	if (rc)
+		count = rc;
 	rebuild_utags_directory(ctrl);
 just_leave:
-	free_tags(tags);
 	mutex_unlock(&ctrl->access_lock);
 	return count;
 }
@@ -1626,6 +2055,28 @@ static int lock_show(struct seq_file *file, void *v)
 	return 0;
 }
 
+static int stats_show(struct seq_file *file, void *v)
+{
+	struct ctrl *ctrl = (struct ctrl *)file->private;
+
+	if (!ctrl) {
+		pr_err("no control data set\n");
+		return -EIO;
+	}
+
+	mutex_lock(&ctrl->access_lock);
+	seq_printf(file, "partition loads: %llu\n", ctrl->loads);
+	seq_printf(file, "resident hits: %llu\n", ctrl->hits);
+	seq_printf(file, "resident: %s\n", ctrl->head ? "yes" : "no");
+	seq_printf(file, "loaded copy: %s seq %u\n",
+		ctrl->loaded == &ctrl->backup ? "backup" : "main", ctrl->seq);
+	seq_printf(file, "recovered loads: %llu\n", ctrl->recovered);
+	seq_printf(file, "commits: %llu\n", ctrl->commits);
+	seq_printf(file, "pages written: %llu\n", ctrl->pages_written);
+	mutex_unlock(&ctrl->access_lock);
+	return 0;
+}
+
 /* Check utag  name againts valid range saved in vld utag  payload */
 
 static int check_hwtag(struct ctrl *ctrl, char *attr, struct utag *vld)
@@ -1719,9 +2170,7 @@ static ssize_t new_utag(struct file *file, const char __user *buffer,
 	pr_debug("adding [%s] utag\n", expendable);
 
 	mutex_lock(&ctrl->access_lock);
-	queue_work(ctrl->load_queue, &ctrl->load_work);
-	wait_for_completion(&ctrl->load_comp);
-	tags = ctrl->head;
+	tags = get_tags(ctrl);
 	if (NULL == tags) {
 		pr_err("[%s] load error\n", ctrl->dir_name);
 		mutex_unlock(&ctrl->access_lock);
@@ -1735,7 +2184,7 @@ static ssize_t new_utag(struct file *file, const char __user *buffer,
 	}
 
 	/* Ignore request if utag name already in use */
-	cur = find_first_utag(tags, expendable);
+	cur = find_first_utag(ctrl, expendable);
 	if (NULL != cur) {
 		pr_err("cannot create [%s]; already in use\n", expendable);
 		ret = -EINVAL;
@@ -1795,14 +2244,13 @@ static ssize_t new_utag(struct file *file, const char __user *buffer,
 
 	walk_dir_nodes(ctrl);
 	walk_proc_nodes(ctrl);
+	index_tags(ctrl, tags);
 
 	/* Store changed partition */
-	queue_work(ctrl->store_queue, &ctrl->store_work);
-	wait_for_completion(&ctrl->store_comp);
-	if (ctrl->store_work_result)
-		ret = ctrl->store_work_result;
+	error = commit_tags(ctrl);
+	if (error)
+		ret = error;
 just_leave:
-	free_tags(tags);
 	mutex_unlock(&ctrl->access_lock);
 	return ret;
 }
@@ -1852,6 +2300,7 @@ static ssize_t reload_write(struct file *file, const char __user *buffer,
 		current->comm, current->pid, ctrl->dir_name, ctrl->reload);
 
 	if (UTAG_STATUS_RELOAD == ctrl->reload) {
+		drop_tags(ctrl);
 		if (rebuild_utags_directory(ctrl))
 			ctrl->reload = UTAG_STATUS_FAILED;
 	}
@@ -1865,6 +2314,11 @@ static int lock_open(struct inode *inode, struct file *file)
 	return single_open(file, lock_show, PDE_DATA(inode));
 }
 
+static int stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, stats_show, PDE_DATA(inode));
+}
+
 static int reload_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, reload_show, PDE_DATA(inode));
@@ -1901,9 +2355,7 @@ static int build_utags_directory(struct ctrl *ctrl)
 	int rc = 0;
 
 	/* try to load utags from primary partition */
-	queue_work(ctrl->load_queue, &ctrl->load_work);
-	wait_for_completion(&ctrl->load_comp);
-	tags = ctrl->head;
+	tags = get_tags(ctrl);
 	if (NULL == tags) {
 		pr_err("[%s] load error\n", ctrl->dir_name);
 		return -EIO;
@@ -1955,7 +2407,6 @@ stop_building_utags:
 	walk_dir_nodes(ctrl);
 	walk_proc_nodes(ctrl);
 
-	free_tags(tags);
 	if (!rc)
 		ctrl->reload = UTAG_STATUS_LOADED;
 	return rc;
@@ -2154,6 +2605,7 @@ static int utags_probe(struct platform_device *pdev)
 	ctrl->pdev = pdev;
 	ctrl->reload = UTAG_STATUS_NOT_READY;
 	mutex_init(&ctrl->access_lock);
+	hash_init(ctrl->index);
 
 	init_completion(&ctrl->load_comp);
 	init_completion(&ctrl->store_comp);
@@ -2220,6 +2672,9 @@ static int utags_remove(struct platform_device *pdev)
 	remove_proc_subtree(ctrl->dir_name, NULL);
 	destroy_workqueue(ctrl->load_queue);
 	destroy_workqueue(ctrl->store_queue);
+	drop_tags(ctrl);
+	set_image(&ctrl->main, NULL, 0);
+	set_image(&ctrl->backup, NULL, 0);
 	if (ctrl->main.filep)
 		filp_close(ctrl->main.filep, NULL);
 	if (ctrl->backup.filep)
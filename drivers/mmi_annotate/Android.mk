@@ -9,4 +9,5 @@ LOCAL_MODULE_PATH := $(TARGET_OUT_VENDOR)/lib/modules/
 else
 LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
 endif
+LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/mmi_qcom_minidump.ko
 include $(DLKM_DIR)/AndroidKernelModule.mk
@@ -31,15 +31,20 @@
 #include <linux/mmi_annotate.h>
 #include <linux/seq_file.h>
 #include <linux/fs.h>
-#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
-#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
-#include <soc/qcom/minidump.h>
-#endif
-#endif
+#include <linux/atomic.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/mmi_crash_bundle.h>
 
 #define MAX_USER_STR 1024
 #define DEFAULT_MEM_SIZE 4096
 #define PERSIST_MAGIC_NUM 0xABCD1234
+#define MAX_LINE_LEN 512
+#define MAX_BIN_LEN 64
+#define REC_ALIGN 8
+#define RING_DUMP_MAGIC 0x414e5247 /* ANRG */
 
 struct platform_data {
 	phys_addr_t	mem_address;
@@ -59,23 +64,215 @@ struct persist_data_t {
 	unsigned char contents[];
 };
 
-static DEFINE_MUTEX(persist_lock);
-static DEFINE_MUTEX(mem_lock);
+enum rec_type {
+	REC_TEXT,
+	REC_BIN,
+};
+
+/* Record header, the payload follows and the record is REC_ALIGN padded */
+struct rec_hdr {
+	u64 seq;
+	u16 len;
+	u16 type;
+	u32 id;
+};
+
+#define REC_SIZE(len) ALIGN(sizeof(struct rec_hdr) + (len), REC_ALIGN)
+
+/*
+ * What each ring buffer starts with, the minidump region ANNOT_CPU<n>
+ * holds one and decodes on its own: records run from tail to head,
+ * positions taken modulo size in data. A record is a struct rec_hdr in
+ * CPU byte order, then len bytes of payload, padded to REC_ALIGN. The
+ * payload of a REC_TEXT record is the annotation text, the one of a
+ * REC_BIN record the raw bytes annotated under id. The records of all
+ * CPUs merge by seq.
+ */
+struct ring_dump {
+	u32 magic;
+	u32 size;
+	u64 head;
+	u64 tail;
+	char data[];
+};
+
+/*
+ * Annotations of the current boot go to a ring of the annotating CPU.
+ * The writer owns its ring with interrupts off and never waits, when
+ * full the oldest records are dropped. Readers copy the rings under
+ * the seqcount and merge the records by their global sequence.
+ */
+struct annotate_ring {
+	seqcount_t seq;
+	unsigned long head;
+	unsigned long tail;
+	size_t size;
+	char *buf;
+	struct ring_dump *dump;
+};
+
+struct rec_ref {
+	u64 seq;
+	unsigned int cpu;
+	unsigned long pos;
+};
 
 static struct proc_dir_entry *procfs_file;
 static struct persist_data_t *persist_data;
 static struct mem_data_t mem_data;
 static int persist_unsupported = 0;
+static struct annotate_ring __percpu *rings;
+static atomic64_t rec_seq = ATOMIC64_INIT(0);
+static DEFINE_MUTEX(show_lock);
+
+static void ring_copy_in(struct annotate_ring *ring, unsigned long pos,
+			const void *src, size_t len)
+{
+	size_t off = pos % ring->size;
+	size_t first = min(len, ring->size - off);
+
+	memcpy(ring->buf + off, src, first);
+	memcpy(ring->buf, src + first, len - first);
+}
+
+static void ring_copy_out(const char *buf, size_t size, unsigned long pos,
+			void *dst, size_t len)
+{
+	size_t off = pos % size;
+	size_t first = min(len, size - off);
+
+	memcpy(dst, buf + off, first);
+	memcpy(dst + first, buf, len - first);
+}
+
+static void annotate_append(enum rec_type type, u32 id, const void *data,
+			size_t len)
+{
+	struct annotate_ring __percpu *pcpu = READ_ONCE(rings);
+	struct annotate_ring *ring;
+	struct rec_hdr hdr;
+	unsigned long flags;
+	size_t need = REC_SIZE(len);
+
+	if (!pcpu)
+		return;
+
+	local_irq_save(flags);
+	ring = this_cpu_ptr(pcpu);
+	if (need > ring->size)
+		goto out;
+
+	hdr.seq = atomic64_inc_return(&rec_seq);
+	hdr.len = len;
+	hdr.type = type;
+	hdr.id = id;
+
+	raw_write_seqcount_begin(&ring->seq);
+	while (ring->head + need - ring->tail > ring->size) {
+		struct rec_hdr old;
+
+		ring_copy_out(ring->buf, ring->size, ring->tail,
+				&old, sizeof(old));
+		ring->tail += REC_SIZE(old.len);
+	}
+	ring_copy_in(ring, ring->head, &hdr, sizeof(hdr));
+	ring_copy_in(ring, ring->head + sizeof(hdr), data, len);
+	ring->head += need;
+	WRITE_ONCE(ring->dump->tail, ring->tail);
+	WRITE_ONCE(ring->dump->head, ring->head);
+	raw_write_seqcount_end(&ring->seq);
+out:
+	local_irq_restore(flags);
+}
+
+static int rec_ref_cmp(const void *a, const void *b)
+{
+	const struct rec_ref *ra = a, *rb = b;
+
+	if (ra->seq == rb->seq)
+		return 0;
+	return ra->seq < rb->seq ? -1 : 1;
+}
+
+/* Print the records of all CPUs in the order they were annotated */
+static int mmi_annotate_show_rings(struct seq_file *f)
+{
+	size_t size = mem_data.size;
+	struct rec_ref *refs;
+	unsigned long *head, *tail;
+	char *snap, line[MAX_LINE_LEN];
+	size_t i, nr = 0, nr_max = nr_cpu_ids * (size / REC_SIZE(0) + 1);
+	unsigned int cpu, start;
+
+	snap = vmalloc(nr_cpu_ids * size);
+	head = kcalloc(nr_cpu_ids, sizeof(*head), GFP_KERNEL);
+	tail = kcalloc(nr_cpu_ids, sizeof(*tail), GFP_KERNEL);
+	refs = kvmalloc_array(nr_max, sizeof(*refs), GFP_KERNEL);
+	if (!snap || !head || !tail || !refs)
+		goto out;
+
+	for_each_possible_cpu(cpu) {
+		struct annotate_ring *ring = per_cpu_ptr(rings, cpu);
+		char *buf = snap + cpu * size;
+		unsigned long pos;
+		struct rec_hdr hdr;
+
+		do {
+			start = read_seqcount_begin(&ring->seq);
+			head[cpu] = ring->head;
+			tail[cpu] = ring->tail;
+			memcpy(buf, ring->buf, size);
+		} while (read_seqcount_retry(&ring->seq, start));
+
+		for (pos = tail[cpu]; pos < head[cpu] && nr < nr_max;
+		     pos += REC_SIZE(hdr.len)) {
+			ring_copy_out(buf, size, pos, &hdr, sizeof(hdr));
+			refs[nr].seq = hdr.seq;
+			refs[nr].cpu = cpu;
+			refs[nr].pos = pos;
+			nr++;
+		}
+	}
+
+	sort(refs, nr, sizeof(*refs), rec_ref_cmp, NULL);
+
+	for (i = 0; i < nr; i++) {
+		char *buf = snap + refs[i].cpu * size;
+		struct rec_hdr hdr;
+
+		ring_copy_out(buf, size, refs[i].pos, &hdr, sizeof(hdr));
+		ring_copy_out(buf, size, refs[i].pos + sizeof(hdr), line,
+				min_t(size_t, hdr.len, sizeof(line)));
+		if (hdr.type == REC_BIN)
+			seq_printf(f, "<%08x> %*phN\n", hdr.id,
+				min_t(int, hdr.len, MAX_BIN_LEN), line);
+		else
+			seq_write(f, line, min_t(size_t, hdr.len, sizeof(line)));
+	}
+
+out:
+	kvfree(refs);
+	kfree(tail);
+	kfree(head);
+	vfree(snap);
+	return nr;
+}
 
 static int mmi_annotate_seq_show(struct seq_file *f, void *ptr)
 {
-	mutex_lock(&mem_lock);
+	int shown = 0;
+
+	mutex_lock(&show_lock);
+	/* previous boot, restored from the persistent area */
 	if (mem_data.contents && mem_data.cur_off > 0) {
 		seq_printf(f, "%s", mem_data.contents);
-	} else {
-		seq_printf(f, "No annotated data.\n");
+		shown = 1;
 	}
-	mutex_unlock(&mem_lock);
+	if (rings && mmi_annotate_show_rings(f))
+		shown = 1;
+	if (!shown)
+		seq_printf(f, "No annotated data.\n");
+	mutex_unlock(&show_lock);
 
 	return 0;
 }
@@ -162,17 +359,70 @@ static void* mmi_annotate_ram_vmap(phys_addr_t start, size_t size)
 }
 #endif
 
+static void mmi_annotate_free_rings(struct annotate_ring __percpu *pcpu)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		kfree(per_cpu_ptr(pcpu, cpu)->dump);
+	free_percpu(pcpu);
+}
+
+static struct annotate_ring __percpu *mmi_annotate_alloc_rings(size_t size)
+{
+	struct annotate_ring __percpu *pcpu;
+	unsigned int cpu;
+
+	pcpu = alloc_percpu(struct annotate_ring);
+	if (!pcpu)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		struct annotate_ring *ring = per_cpu_ptr(pcpu, cpu);
+
+		seqcount_init(&ring->seq);
+		ring->size = size;
+		ring->dump = kzalloc(sizeof(*ring->dump) + size, GFP_KERNEL);
+		if (!ring->dump) {
+			mmi_annotate_free_rings(pcpu);
+			return NULL;
+		}
+		ring->dump->magic = RING_DUMP_MAGIC;
+		ring->dump->size = size;
+		ring->buf = ring->dump->data;
+	}
+
+	return pcpu;
+}
+
+/*
+ * cur_off is advanced before the copy, so a crash can leave a hole of
+ * zeros (the area is cleared at probe) in the last writes. Keep what
+ * comes before the first hole, cut back to the last full line.
+ */
+static size_t persist_restore_len(const struct persist_data_t *pd)
+{
+	size_t len = strnlen((const char *)pd->contents, pd->cur_off);
+
+	if (len == pd->cur_off)
+		return len;
+
+	while (len && pd->contents[len - 1] != '\n')
+		len--;
+
+	return len;
+}
+
 static int mmi_annotate_probe(struct platform_device *pdev)
 {
 	struct device *dev = &pdev->dev;
 	struct platform_data *pdata;
 	struct resource res;
 	struct device_node *node;
-#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
-#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
-	struct md_region md_entry;
-#endif
-#endif
+	char name[MMI_CRASH_NAME_LEN];
+	unsigned int cpu;
+	struct annotate_ring __percpu *pcpu;
+	size_t len;
 	int err = 0;
 
 	pdata = devm_kzalloc(&pdev->dev, sizeof(*pdata), GFP_KERNEL);
@@ -245,36 +495,56 @@ static int mmi_annotate_probe(struct platform_device *pdev)
 	persist_data->size = pdata->mem_size - sizeof(struct persist_data_t);
 	if(persist_data->magic_num == PERSIST_MAGIC_NUM &&
 		persist_data->cur_off <= persist_data->size) {
-		memcpy(mem_data.contents,
-				persist_data->contents,
-				persist_data->cur_off);
-		mem_data.cur_off += persist_data->cur_off;
+		len = min_t(size_t, persist_restore_len(persist_data),
+				mem_data.size - 1);
+		memcpy(mem_data.contents, persist_data->contents, len);
+		mem_data.cur_off += len;
 	}
 	else
 		persist_data->magic_num = PERSIST_MAGIC_NUM;
 	persist_data->cur_off = 0;
+	/* A write cut short by the next crash must leave zeros behind */
+	memset(persist_data->contents, 0, persist_data->size);
+
+	/* Each CPU can hold as much of this boot as the shared area did */
+	pcpu = mmi_annotate_alloc_rings(mem_data.size);
+	if (!pcpu) {
+		dev_err(dev, "Cannot allocate per cpu buffers of size %x\n",
+				mem_data.size);
+		err = -ENOMEM;
+		goto err;
+	}
+	WRITE_ONCE(rings, pcpu);
 
 	/* Create the procfs file at /proc/driver/mmi_annotate */
 	procfs_file = proc_create("driver/mmi_annotate",
 		0444, NULL, &mmi_annotate_operations);
 
-#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
-#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
 	/*Register annotate to minidump */
-	strlcpy(md_entry.name, "ANNOTATE", sizeof(md_entry.name));
-	if (!persist_unsupported) {
-		md_entry.virt_addr = (uintptr_t)phys_to_virt(pdata->mem_address);
-		md_entry.phys_addr = pdata->mem_address;
-		md_entry.size = pdata->mem_size;
-	} else {
-		md_entry.virt_addr = (uintptr_t)mem_data.contents;
-		md_entry.phys_addr = virt_to_phys((void*)mem_data.contents);
-		md_entry.size = mem_data.size;
-	}
-	if (msm_minidump_add_region(&md_entry) < 0)
+	if (!persist_unsupported)
+		err = mmi_crash_region_add("ANNOTATE",
+				phys_to_virt(pdata->mem_address),
+				pdata->mem_address, pdata->mem_size,
+				MMI_CRASH_PRIO_HIGH);
+	else
+		err = mmi_crash_region_add("ANNOTATE", mem_data.contents,
+				virt_to_phys((void *)mem_data.contents),
+				mem_data.size, MMI_CRASH_PRIO_HIGH);
+	if (err < 0)
 		pr_err("Failed to add annotate in Minidump\n");
-#endif
-#endif
+
+	/* mmi_annotate() of this boot only lives in the per cpu rings */
+	for_each_possible_cpu(cpu) {
+		struct ring_dump *dump = per_cpu_ptr(pcpu, cpu)->dump;
+
+		scnprintf(name, sizeof(name), "ANNOT_CPU%u", cpu);
+		if (mmi_crash_region_add(name, dump, virt_to_phys(dump),
+				sizeof(*dump) + mem_data.size,
+				MMI_CRASH_PRIO_HIGH) < 0)
+			pr_err("Failed to add annotate cpu%u in Minidump\n",
+				cpu);
+	}
+	err = 0;
 err:
 	return err;
 }
@@ -283,42 +553,63 @@ int mmi_annotate(const char *fmt, ...)
 {
 	va_list args;
 	int len = 0;
-	char line_buf[512];
+	char line_buf[MAX_LINE_LEN];
 
 	va_start(args, fmt);
 	len += vsnprintf(line_buf, sizeof(line_buf), fmt, args);
 	va_end(args);
 
-	mutex_lock(&mem_lock);
-	if(mem_data.contents && mem_data.cur_off + len < mem_data.size) {
-		memcpy(mem_data.contents + mem_data.cur_off, line_buf, len);
-		mem_data.cur_off += len;
-	}
-	mutex_unlock(&mem_lock);
+	annotate_append(REC_TEXT, 0, line_buf,
+			min_t(size_t, len, sizeof(line_buf) - 1));
 
 	return 0;
 }
 EXPORT_SYMBOL(mmi_annotate);
 
+/*
+ * Annotate len bytes of data as is, they are only turned into hex
+ * when read. Safe from any context.
+ */
+int mmi_annotate_bin(u32 id, const void *data, size_t len)
+{
+	annotate_append(REC_BIN, id, data, min_t(size_t, len, MAX_BIN_LEN));
+
+	return 0;
+}
+EXPORT_SYMBOL(mmi_annotate_bin);
+
+/*
+ * The persistent area is parsed as a flat string by the next boot,
+ * reserve room in it with a cmpxchg and copy without a lock. cur_off
+ * may run ahead of the copies, see persist_restore_len().
+ */
+static void persist_append(const char *buf, size_t len)
+{
+	size_t off;
+
+	do {
+		off = READ_ONCE(persist_data->cur_off);
+		if (off + len >= persist_data->size)
+			return;
+	} while (cmpxchg(&persist_data->cur_off, off, off + len) != off);
+
+	memcpy(persist_data->contents + off, buf, len);
+}
+
 int mmi_annotate_persist(const char *fmt, ...)
 {
 	va_list args;
 	int len = 0;
-	char line_buf[512];
+	char line_buf[MAX_LINE_LEN];
 
 	va_start(args, fmt);
 	len += vsnprintf(line_buf, sizeof(line_buf), fmt, args);
 	va_end(args);
 
 	if (!persist_unsupported) {
-		mutex_lock(&persist_lock);
-		if(persist_data &&
-			persist_data->cur_off + len < persist_data->size) {
-			memcpy(persist_data->contents + persist_data->cur_off,
-				line_buf, len);
-			persist_data->cur_off += len;
-		}
-		mutex_unlock(&persist_lock);
+		if (persist_data)
+			persist_append(line_buf,
+				min_t(size_t, len, sizeof(line_buf) - 1));
 	} else {
 		mmi_annotate("%s", line_buf);
 	}
@@ -329,8 +620,24 @@ EXPORT_SYMBOL(mmi_annotate_persist);
 
 static int mmi_annotate_remove(struct platform_device *pdev)
 {
+	struct annotate_ring __percpu *pcpu = rings;
+	char name[MMI_CRASH_NAME_LEN];
+	unsigned int cpu;
+
+	mmi_crash_region_remove("ANNOTATE");
+	for_each_possible_cpu(cpu) {
+		scnprintf(name, sizeof(name), "ANNOT_CPU%u", cpu);
+		mmi_crash_region_remove(name);
+	}
+
 	if (procfs_file)
 		remove_proc_entry("driver/mmi_annotate", NULL);
+	if (pcpu) {
+		WRITE_ONCE(rings, NULL);
+		/* writers run with interrupts off */
+		synchronize_rcu();
+		mmi_annotate_free_rings(pcpu);
+	}
 	if(mem_data.contents)
 		kfree(mem_data.contents);
 	return 0;
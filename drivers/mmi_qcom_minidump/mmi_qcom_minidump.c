@@ -12,29 +12,390 @@
  *
  */
 
+#include <linux/crc32.h>
 #include <linux/errno.h>
+#include <linux/io.h>
 #include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/platform_device.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/version.h>
+#include <linux/mmi_crash_bundle.h>
 #if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
 #if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
 #include <soc/qcom/minidump.h>
 #endif
 #endif
 
-static int add_cpusys_to_minidump(const struct device_node *np)
+#if IS_ENABLED(CONFIG_MMI_CRASH_BUNDLE)
+struct crash_region {
+	struct list_head list;
+	struct mmi_crash_bundle_entry e;
+	void *vaddr;
+};
+
+/* Registered regions, by priority then registration order */
+static LIST_HEAD(crash_regions);
+static DEFINE_MUTEX(crash_lock);
+/* Index in reserved memory, NULL until probe */
+static struct mmi_crash_bundle_hdr *bundle;
+static size_t bundle_size;
+/* Index left by the previous boot */
+static struct mmi_crash_bundle_hdr *last_bundle;
+static u64 crash_budget;
+static u32 crash_seq;
+static struct proc_dir_entry *procfs_file;
+
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
+static void crash_region_md_entry(struct crash_region *r,
+				  struct md_region *md_entry)
+{
+	memset(md_entry, 0, sizeof(*md_entry));
+	strscpy(md_entry->name, r->e.name, sizeof(md_entry->name));
+	md_entry->virt_addr = (uintptr_t)r->vaddr;
+	md_entry->phys_addr = r->e.paddr;
+	md_entry->size = r->e.size;
+}
+#endif
+#endif
+
+static void crash_region_minidump(struct crash_region *r)
 {
-	struct resource res;
-	struct device_node *node;
 #if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
 #if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
 	struct md_region md_entry;
+
+	if (!r->vaddr || (r->e.flags & MMI_CRASH_F_MINIDUMP))
+		return;
+
+	crash_region_md_entry(r, &md_entry);
+	if (msm_minidump_add_region(&md_entry) < 0) {
+		pr_err("Failed to add %s in Minidump\n", r->e.name);
+		return;
+	}
+	r->e.flags |= MMI_CRASH_F_MINIDUMP;
 #endif
 #endif
+}
+
+/* Take a region evicted by the budget or being freed out of the minidump */
+static void crash_region_unminidump(struct crash_region *r)
+{
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
+	struct md_region md_entry;
+
+	if (!(r->e.flags & MMI_CRASH_F_MINIDUMP))
+		return;
+
+	crash_region_md_entry(r, &md_entry);
+	if (msm_minidump_remove_region(&md_entry) < 0) {
+		pr_err("Failed to remove %s from Minidump\n", r->e.name);
+		return;
+	}
+	r->e.flags &= ~MMI_CRASH_F_MINIDUMP;
+#endif
+#endif
+}
+
+/*
+ * Fit the regions in the budget by priority and rewrite the index. The
+ * magic is cleared while the entries change, a reader never sees a
+ * half written index.
+ */
+static void crash_bundle_update(void)
+{
+	struct mmi_crash_bundle_entry *out = NULL;
+	struct crash_region *r;
+	u32 nr = 0, nr_max = 0;
+	u64 total = 0;
+
+	if (bundle) {
+		out = (struct mmi_crash_bundle_entry *)(bundle + 1);
+		nr_max = (bundle_size - sizeof(*bundle)) / sizeof(*out);
+		WRITE_ONCE(bundle->magic, 0);
+		wmb();
+	}
+
+	list_for_each_entry(r, &crash_regions, list) {
+		if ((crash_budget && total + r->e.size > crash_budget) ||
+				(bundle && nr >= nr_max)) {
+			r->e.flags &= ~MMI_CRASH_F_INDEXED;
+			crash_region_unminidump(r);
+			continue;
+		}
+		total += r->e.size;
+		r->e.flags |= MMI_CRASH_F_INDEXED;
+		crash_region_minidump(r);
+		if (out)
+			memcpy(&out[nr], &r->e, sizeof(*out));
+		nr++;
+	}
+
+	if (!bundle)
+		return;
+
+	bundle->version = MMI_CRASH_BUNDLE_VERSION;
+	bundle->hdr_size = sizeof(*bundle);
+	bundle->entry_size = sizeof(*out);
+	bundle->nr_entries = nr;
+	bundle->budget = crash_budget;
+	bundle->total = total;
+	bundle->seq = ++crash_seq;
+	bundle->crc = crc32(0, out, nr * sizeof(*out));
+	wmb();
+	WRITE_ONCE(bundle->magic, MMI_CRASH_BUNDLE_MAGIC);
+}
+
+static struct crash_region *crash_region_find(const char *name)
+{
+	struct crash_region *r;
+
+	list_for_each_entry(r, &crash_regions, list)
+		if (!strncmp(r->e.name, name, sizeof(r->e.name)))
+			return r;
+	return NULL;
+}
+
+int mmi_crash_region_add(const char *name, void *vaddr, phys_addr_t paddr,
+			 size_t size, int prio)
+{
+	struct crash_region *r, *pos;
+	int err = 0;
+
+	if (!name || !size || prio < 0)
+		return -EINVAL;
+
+	r = kzalloc(sizeof(*r), GFP_KERNEL);
+	if (!r)
+		return -ENOMEM;
+
+	strscpy(r->e.name, name, sizeof(r->e.name));
+	r->e.prio = prio;
+	r->e.paddr = paddr;
+	r->e.size = size;
+	r->vaddr = vaddr;
+
+	mutex_lock(&crash_lock);
+	if (crash_region_find(r->e.name)) {
+		mutex_unlock(&crash_lock);
+		kfree(r);
+		return -EEXIST;
+	}
+	list_for_each_entry(pos, &crash_regions, list)
+		if (pos->e.prio > r->e.prio)
+			break;
+	list_add_tail(&r->list, &pos->list);
+	crash_bundle_update();
+	if (!(r->e.flags & MMI_CRASH_F_INDEXED)) {
+		pr_warn("%s does not fit in the crash budget\n", r->e.name);
+		err = -ENOSPC;
+	}
+	mutex_unlock(&crash_lock);
+
+	return err;
+}
+EXPORT_SYMBOL(mmi_crash_region_add);
+
+/* Call before freeing the region, it is taken out of the minidump */
+void mmi_crash_region_remove(const char *name)
+{
+	struct crash_region *r;
+
+	mutex_lock(&crash_lock);
+	r = crash_region_find(name);
+	if (r) {
+		crash_region_unminidump(r);
+		list_del(&r->list);
+		kfree(r);
+		crash_bundle_update();
+	}
+	mutex_unlock(&crash_lock);
+}
+EXPORT_SYMBOL(mmi_crash_region_remove);
+
+void mmi_crash_bundle_set_reason(u32 reason)
+{
+	struct mmi_crash_bundle_hdr *hdr = READ_ONCE(bundle);
+
+	if (hdr)
+		WRITE_ONCE(hdr->reason, reason);
+}
+EXPORT_SYMBOL(mmi_crash_bundle_set_reason);
+
+/* Keep the index of the previous boot if it is sane */
+static void crash_bundle_load_last(void)
+{
+	struct mmi_crash_bundle_hdr hdr;
+	size_t len;
+
+	memcpy(&hdr, bundle, sizeof(hdr));
+	if (hdr.magic != MMI_CRASH_BUNDLE_MAGIC ||
+			hdr.version != MMI_CRASH_BUNDLE_VERSION ||
+			hdr.hdr_size != sizeof(hdr) ||
+			hdr.entry_size != sizeof(struct mmi_crash_bundle_entry) ||
+			hdr.nr_entries > (bundle_size - sizeof(hdr)) /
+				sizeof(struct mmi_crash_bundle_entry))
+		return;
+
+	len = sizeof(hdr) + hdr.nr_entries * hdr.entry_size;
+	last_bundle = kmalloc(len, GFP_KERNEL);
+	if (!last_bundle)
+		return;
+	memcpy(last_bundle, bundle, len);
+	if (crc32(0, last_bundle + 1, hdr.nr_entries * hdr.entry_size) !=
+			hdr.crc) {
+		pr_err("crash bundle of the last boot is corrupted\n");
+		kfree(last_bundle);
+		last_bundle = NULL;
+	}
+}
+
+static void crash_bundle_show_one(struct seq_file *f, const char *label,
+				  struct mmi_crash_bundle_hdr *hdr)
+{
+	struct mmi_crash_bundle_entry *e =
+		(struct mmi_crash_bundle_entry *)(hdr + 1);
+	u32 i;
+
+	seq_printf(f, "%s: seq %u reason %u total %llu budget %llu\n", label,
+		   hdr->seq, hdr->reason, hdr->total, hdr->budget);
+	for (i = 0; i < hdr->nr_entries; i++, e++)
+		seq_printf(f, "%-16.16s prio %2u flags %x addr 0x%llx size 0x%llx\n",
+			   e->name, e->prio, e->flags, e->paddr, e->size);
+}
+
+static int crash_bundle_seq_show(struct seq_file *f, void *ptr)
+{
+	if (last_bundle)
+		crash_bundle_show_one(f, "last", last_bundle);
+
+	mutex_lock(&crash_lock);
+	if (bundle && READ_ONCE(bundle->magic) == MMI_CRASH_BUNDLE_MAGIC)
+		crash_bundle_show_one(f, "current", bundle);
+	mutex_unlock(&crash_lock);
+	return 0;
+}
+
+static int crash_bundle_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, crash_bundle_seq_show, NULL);
+}
+
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+static const struct proc_ops crash_bundle_operations = {
+	.proc_open		= crash_bundle_open,
+	.proc_read		= seq_read,
+	.proc_lseek		= seq_lseek,
+	.proc_release	= single_release,
+};
+#else
+static const struct file_operations crash_bundle_operations = {
+	.open		= crash_bundle_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
+static int crash_bundle_init(struct device *dev)
+{
+	struct resource res;
+	struct device_node *node;
+	struct mmi_crash_bundle_hdr *hdr;
+	u32 budget = 0;
+	int err;
+
+	of_property_read_u32(dev->of_node, "mmi,crash-budget", &budget);
+
+	/* Without reserved memory regions are still budgeted into minidump */
+	node = of_parse_phandle(dev->of_node, "bundle-mem", 0);
+	if (!node) {
+		mutex_lock(&crash_lock);
+		crash_budget = budget;
+		crash_bundle_update();
+		mutex_unlock(&crash_lock);
+		return 0;
+	}
+
+	err = of_address_to_resource(node, 0, &res);
+	of_node_put(node);
+	if (err) {
+		pr_err("No memory address assigned to the bundle region\n");
+		return err;
+	}
+
+	if (resource_size(&res) < sizeof(*hdr)) {
+		pr_err("bundle region too small\n");
+		return -EINVAL;
+	}
+
+	hdr = memremap(res.start, resource_size(&res), MEMREMAP_WC);
+	if (!hdr) {
+		pr_err("Cannot remap the bundle region\n");
+		return -ENOMEM;
+	}
+
+	mutex_lock(&crash_lock);
+	bundle = hdr;
+	bundle_size = resource_size(&res);
+	crash_bundle_load_last();
+	memset(bundle, 0, sizeof(*bundle));
+	crash_budget = budget;
+	crash_bundle_update();
+	mutex_unlock(&crash_lock);
+
+	mmi_crash_region_add("CRASH_BUNDLE", hdr, res.start, bundle_size,
+			     MMI_CRASH_PRIO_CRITICAL);
+
+	/* Create the procfs file at /proc/driver/crash_bundle */
+	procfs_file = proc_create("driver/crash_bundle",
+		0444, NULL, &crash_bundle_operations);
+
+	return 0;
+}
+
+/* The regions of the other modules stay registered */
+static void crash_bundle_exit(void)
+{
+	if (procfs_file)
+		remove_proc_entry("driver/crash_bundle", NULL);
+	procfs_file = NULL;
+
+	mmi_crash_region_remove("CRASH_BUNDLE");
+	mutex_lock(&crash_lock);
+	if (bundle) {
+		WRITE_ONCE(bundle->magic, 0);
+		memunmap(bundle);
+		bundle = NULL;
+	}
+	mutex_unlock(&crash_lock);
+	kfree(last_bundle);
+	last_bundle = NULL;
+}
+#else
+static int crash_bundle_init(struct device *dev)
+{
+	return 0;
+}
+
+static void crash_bundle_exit(void)
+{
+}
+#endif
+
+static int add_cpusys_to_minidump(const struct device_node *np)
+{
+	struct resource res;
+	struct device_node *node;
 	int err = 0;
 
 	/* Get cpusys memory rigion */
@@ -52,21 +413,14 @@ static int add_cpusys_to_minidump(const struct device_node *np)
 	}
 
 	//add cpusys region to minidump
-#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
-#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
-	strscpy(md_entry.name, "CPUSYS", sizeof(md_entry.name));
-	md_entry.virt_addr = (uintptr_t)phys_to_virt(res.start);
-	md_entry.phys_addr = res.start;
-	md_entry.size = resource_size(&res);
-	if (msm_minidump_add_region(&md_entry) < 0){
+	if (mmi_crash_region_add("CPUSYS", phys_to_virt(res.start), res.start,
+				 resource_size(&res), MMI_CRASH_PRIO_HIGH) < 0) {
 		pr_err("Failed to add CPUSYS section in Minidump\n");
 		err = -EINVAL;
 		goto err;
 	}
-	pr_info("cpusys_dump initialized, addr:0x%llx size:0x%llx\n",md_entry.phys_addr,
-				md_entry.size);
-#endif
-#endif
+	pr_info("cpusys_dump initialized, addr:0x%llx size:0x%llx\n",
+		(u64)res.start, (u64)resource_size(&res));
 err:
 	return err;
 }
@@ -76,15 +430,27 @@ static int mmi_qcom_minidump_probe(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	int error = 0;
 
+	/* index of the crash artifacts */
+	error = crash_bundle_init(dev);
+	if (error)
+		return error;
+
 	/* add cpusys memory rigion */
 	error = add_cpusys_to_minidump(dev->of_node);
 	if (error) {
+		crash_bundle_exit();
 		return error;
 	}
 
 	return 0;
 }
 
+static int mmi_qcom_minidump_remove(struct platform_device *pdev)
+{
+	crash_bundle_exit();
+	return 0;
+}
+
 static const struct of_device_id mmi_qcom_minidump_match_table[] = {
 	{ .compatible = "moto,mmi_qcom_minidump" },
 	{ }
@@ -93,6 +459,7 @@ MODULE_DEVICE_TABLE(of, mmi_qcom_minidump_match_table);
 
 static struct platform_driver mmi_qcom_minidump_driver = {
 	.probe  = mmi_qcom_minidump_probe,
+	.remove = mmi_qcom_minidump_remove,
 	.driver = {
 		   .name = "mmi_qcom_minidump",
 		   .of_match_table = mmi_qcom_minidump_match_table,
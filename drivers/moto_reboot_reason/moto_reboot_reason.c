@@ -31,6 +31,7 @@
 #include <linux/of_address.h>
 #include <linux/nvmem-consumer.h>
 #include <linux/panic_notifier.h>
+#include <linux/mmi_crash_bundle.h>
 
 #define RESET_EXTRA_SW_BOOT_REASON     BIT(7)
 #define RESET_EXTRA_PANIC_REASON       BIT(3)
@@ -65,6 +66,7 @@ static int moto_reboot_reason_panic(struct notifier_block *this,
 
 	nvmem_cell_write(reboot->nvmem_oem_cell, &val,
 			sizeof(val));
+	mmi_crash_bundle_set_reason(MMI_CRASH_REASON_PANIC);
 	pr_err("%s: save panic flag\n", __func__);
 
 	return NOTIFY_OK;
@@ -81,6 +83,7 @@ static int moto_reboot_reason_reboot(struct notifier_block *this,
 
 	nvmem_cell_write(reboot->nvmem_oem_cell, &val,
 			sizeof(val));
+	mmi_crash_bundle_set_reason(MMI_CRASH_REASON_SW_REBOOT);
 
 	reboot->reboot_notify_status = 1;
 
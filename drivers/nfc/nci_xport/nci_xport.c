@@ -0,0 +1,489 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/nci_xport.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define CREATE_TRACE_POINTS
+#include "nci_xport_trace.h"
+
+/*
+ * The fifo holds the packets read on one IRQ: the header and the payload
+ * are read back to back, then the next packet while the controller keeps
+ * its IRQ line high. Userspace reads are served from there, whatever the
+ * size it asks for, without waiting or touching the bus again.
+ */
+struct nci_xport_rec {
+	ktime_t ts;	/* IRQ or previous packet, for the latency */
+	u16 len;
+};
+
+#define NCI_XPORT_REC_SIZE(len) \
+	ALIGN(sizeof(struct nci_xport_rec) + (len), sizeof(ktime_t))
+
+static struct dentry *nci_xport_root;
+
+static const char *const nci_xport_lat_names[NCI_XPORT_LAT_NR] = {
+	[NCI_XPORT_LAT_IRQ_WAIT] = "irq_wait",
+	[NCI_XPORT_LAT_XFER] = "xfer",
+	[NCI_XPORT_LAT_DELIVER] = "deliver",
+	[NCI_XPORT_LAT_TURNAROUND] = "turnaround",
+	[NCI_XPORT_LAT_WRITE] = "write",
+	[NCI_XPORT_LAT_POWER] = "power",
+	[NCI_XPORT_LAT_ESE_RESET] = "ese_reset",
+};
+
+/**
+ * nci_xport_lat_add() - account one phase of a transaction
+ * @xp: the transport
+ * @id: the phase
+ * @start: when the phase started, it ends now
+ */
+void nci_xport_lat_add(struct nci_xport *xp, enum nci_xport_lat_id id,
+		       ktime_t start)
+{
+	s64 delta_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	if (delta_ns < 0)
+		delta_ns = 0;
+
+	trace_nci_xport_lat(xp->name, nci_xport_lat_names[id], delta_ns);
+
+	spin_lock_irqsave(&xp->lat_lock, flags);
+	mmi_lat_hist_add(&xp->lat[id], div_u64(delta_ns, NSEC_PER_USEC));
+	spin_unlock_irqrestore(&xp->lat_lock, flags);
+}
+EXPORT_SYMBOL_GPL(nci_xport_lat_add);
+
+/**
+ * nci_xport_write_begin() - to be called before a packet goes on the bus
+ * @xp: the transport
+ *
+ * Accounts the time the stack took to answer the last packet it read.
+ *
+ * Return: the start time to give to nci_xport_write_end().
+ */
+ktime_t nci_xport_write_begin(struct nci_xport *xp)
+{
+	ktime_t now = ktime_get();
+	unsigned long flags;
+	ktime_t last_rx;
+
+	spin_lock_irqsave(&xp->lat_lock, flags);
+	last_rx = xp->last_rx;
+	xp->last_rx = 0;
+	spin_unlock_irqrestore(&xp->lat_lock, flags);
+
+	/* A write long after the last packet is not an answer to it */
+	if (last_rx && ktime_ms_delta(now, last_rx) < NCI_XPORT_TURNAROUND_MAX_MS)
+		nci_xport_lat_add(xp, NCI_XPORT_LAT_TURNAROUND, last_rx);
+
+	return now;
+}
+EXPORT_SYMBOL_GPL(nci_xport_write_begin);
+
+/**
+ * nci_xport_write_end() - to be called once a packet went on the bus
+ * @xp: the transport
+ * @start: as returned by nci_xport_write_begin()
+ */
+void nci_xport_write_end(struct nci_xport *xp, ktime_t start)
+{
+	nci_xport_lat_add(xp, NCI_XPORT_LAT_WRITE, start);
+}
+EXPORT_SYMBOL_GPL(nci_xport_write_end);
+
+/**
+ * nci_xport_irq() - to be called by the chip IRQ handler
+ * @xp: the transport
+ *
+ * The handler still disarms its IRQ and wakes up &nci_xport.wq itself.
+ */
+void nci_xport_irq(struct nci_xport *xp)
+{
+	xp->irq_ts = ktime_get();
+	WRITE_ONCE(xp->irq_fired, true);
+}
+EXPORT_SYMBOL_GPL(nci_xport_irq);
+
+/**
+ * nci_xport_wait_irq() - wait for the controller to raise its IRQ line
+ * @xp: the transport
+ * @timeout_ms: timeout of each wait, 0 to wait forever
+ *
+ * Interrupts that find the line low again are counted as spurious and
+ * waited again, unless the controller has been powered off.
+ *
+ * Return: 0 with the line high, -ETIMEDOUT, -EINTR, -ERESTARTSYS, or -EIO
+ * when powered off.
+ */
+int nci_xport_wait_irq(struct nci_xport *xp, int timeout_ms)
+{
+	const struct nci_xport_ops *ops = xp->ops;
+	ktime_t start = ktime_get();
+	bool waited = false;
+	long ret = 0;
+
+	while (!ops->irq_level(xp)) {
+		waited = true;
+		WRITE_ONCE(xp->irq_fired, false);
+		ops->enable_irq(xp);
+		if (!ops->irq_level(xp)) {
+			if (timeout_ms) {
+				ret = wait_event_interruptible_timeout(*xp->wq,
+					READ_ONCE(xp->irq_fired),
+					msecs_to_jiffies(timeout_ms));
+				if (!ret)
+					ret = -ETIMEDOUT;
+			} else {
+				ret = wait_event_interruptible(*xp->wq,
+					READ_ONCE(xp->irq_fired));
+				if (ret)
+					ret = -EINTR;
+			}
+		}
+		ops->disable_irq(xp);
+
+		if (ret < 0) {
+			pr_err("%s: timeout/error %ld\n", __func__, ret);
+			break;
+		}
+		ret = 0;
+
+		if (ops->irq_level(xp))
+			break;
+
+		if (!ops->powered(xp)) {
+			pr_info("%s: releasing read\n", __func__);
+			ret = -EIO;
+			break;
+		}
+
+		/* Stats are best effort here, the callers may not hold lock */
+		xp->stats.spurious++;
+		pr_warn("%s: spurious interrupt detected\n", __func__);
+	}
+
+	if (waited)
+		nci_xport_lat_add(xp, NCI_XPORT_LAT_IRQ_WAIT, start);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(nci_xport_wait_irq);
+
+static int nci_xport_recv_pkt(struct nci_xport *xp, u8 *pkt, size_t *len)
+{
+	const struct nci_xport_ops *ops = xp->ops;
+	int ret;
+
+	ret = ops->recv(xp, pkt, NCI_XPORT_HDR_LEN);
+	if (ret < 0)
+		return ret;
+
+	*len = NCI_XPORT_HDR_LEN + pkt[NCI_XPORT_PAYLOAD_LEN_IDX];
+	if (*len == NCI_XPORT_HDR_LEN)
+		return 0;
+
+	ret = ops->recv(xp, pkt + NCI_XPORT_HDR_LEN, *len - NCI_XPORT_HDR_LEN);
+	return ret < 0 ? ret : 0;
+}
+
+/* Called with xp->lock held and an empty fifo */
+static int nci_xport_fill(struct nci_xport *xp, bool nonblock)
+{
+	const struct nci_xport_ops *ops = xp->ops;
+	struct nci_xport_rec *rec;
+	ktime_t ts, start;
+	int ret, nr = 0;
+	size_t len;
+
+	xp->fifo_len = 0;
+	xp->rd = 0;
+	xp->pkt_off = 0;
+
+	if (ops->irq_level(xp)) {
+		ts = ktime_get();
+	} else {
+		if (nonblock)
+			return -EAGAIN;
+
+		ret = nci_xport_wait_irq(xp, 0);
+		if (ret)
+			return ret;
+
+		ts = xp->irq_ts;
+	}
+
+	do {
+		if (xp->fifo_len + NCI_XPORT_REC_SIZE(NCI_XPORT_MAX_PKT_LEN) >
+		    NCI_XPORT_FIFO_SIZE)
+			break;
+
+		rec = (struct nci_xport_rec *)(xp->fifo + xp->fifo_len);
+		start = ktime_get();
+		ret = nci_xport_recv_pkt(xp, (u8 *)(rec + 1), &len);
+		if (ret) {
+			xp->stats.errors++;
+			pr_err("%s: read failed %d\n", __func__, ret);
+			/* Hand over what was read before */
+			return xp->fifo_len ? 0 : ret;
+		}
+
+		nci_xport_lat_add(xp, NCI_XPORT_LAT_XFER, start);
+		trace_nci_xport_rx(xp->name, (u8 *)(rec + 1), len, nr);
+		if (nr++)
+			xp->stats.batched++;
+
+		if (ops->filter && ops->filter(xp, (u8 *)(rec + 1), len)) {
+			xp->stats.filtered++;
+		} else {
+			rec->ts = ts;
+			rec->len = len;
+			xp->fifo_len += NCI_XPORT_REC_SIZE(len);
+		}
+
+		ts = ktime_get();
+	} while (ops->irq_level(xp));
+
+	/* What was read after a flush is not stale */
+	WRITE_ONCE(xp->flushed, false);
+	return 0;
+}
+
+/**
+ * nci_xport_read() - read from the current NCI packet
+ * @xp: the transport
+ * @buf: userspace buffer
+ * @count: size of @buf
+ * @nonblock: do not wait for the IRQ
+ *
+ * A read never spans two packets, so the usual header then payload reads
+ * of the HALs, as well as whole packet reads, get what they expect.
+ *
+ * Return: bytes read, 0 if the packets were consumed by the filter, or
+ * -errno.
+ */
+ssize_t nci_xport_read(struct nci_xport *xp, char __user *buf, size_t count,
+		       bool nonblock)
+{
+	struct nci_xport_rec *rec;
+	ssize_t ret;
+	size_t len;
+
+	mutex_lock(&xp->lock);
+	if (READ_ONCE(xp->flushed)) {
+		WRITE_ONCE(xp->flushed, false);
+		xp->fifo_len = 0;
+		xp->rd = 0;
+		xp->pkt_off = 0;
+	}
+
+	if (xp->rd >= xp->fifo_len) {
+		ret = nci_xport_fill(xp, nonblock);
+		if (ret || !xp->fifo_len)
+			goto out;
+	}
+
+	rec = (struct nci_xport_rec *)(xp->fifo + xp->rd);
+	if (!xp->pkt_off)
+		nci_xport_lat_add(xp, NCI_XPORT_LAT_DELIVER, rec->ts);
+
+	len = min_t(size_t, count, rec->len - xp->pkt_off);
+	if (copy_to_user(buf, (u8 *)(rec + 1) + xp->pkt_off, len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	xp->stats.bytes += len;
+	xp->pkt_off += len;
+	if (xp->pkt_off == rec->len) {
+		spin_lock_irq(&xp->lat_lock);
+		xp->last_rx = ktime_get();
+		spin_unlock_irq(&xp->lat_lock);
+		xp->stats.packets++;
+		xp->rd += NCI_XPORT_REC_SIZE(rec->len);
+		xp->pkt_off = 0;
+	}
+	ret = len;
+
+out:
+	mutex_unlock(&xp->lock);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(nci_xport_read);
+
+/**
+ * nci_xport_has_data() - check for a packet to read
+ * @xp: the transport
+ *
+ * Return: true if a packet is buffered or the IRQ line is high.
+ */
+bool nci_xport_has_data(struct nci_xport *xp)
+{
+	return READ_ONCE(xp->rd) < READ_ONCE(xp->fifo_len) ||
+	       xp->ops->irq_level(xp);
+}
+EXPORT_SYMBOL_GPL(nci_xport_has_data);
+
+/**
+ * nci_xport_flush() - drop the buffered packets
+ * @xp: the transport
+ *
+ * Does not take the lock, as a reader may hold it while it waits for the
+ * IRQ: the next read drops the packets instead.
+ */
+void nci_xport_flush(struct nci_xport *xp)
+{
+	WRITE_ONCE(xp->flushed, true);
+}
+EXPORT_SYMBOL_GPL(nci_xport_flush);
+
+static int nci_xport_stats_show(struct seq_file *s, void *unused)
+{
+	struct nci_xport *xp = s->private;
+	/* No lock, a reader holds it while it waits for the IRQ */
+	struct nci_xport_stats st = xp->stats;
+
+	seq_printf(s, "packets: %llu\n", st.packets);
+	seq_printf(s, "bytes: %llu\n", st.bytes);
+	seq_printf(s, "batched: %llu\n", st.batched);
+	seq_printf(s, "filtered: %llu\n", st.filtered);
+	seq_printf(s, "spurious: %llu\n", st.spurious);
+	seq_printf(s, "errors: %llu\n", st.errors);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nci_xport_stats);
+
+static int nci_xport_latency_show(struct seq_file *s, void *unused)
+{
+	struct nci_xport *xp = s->private;
+	struct mmi_lat_hist *hist;
+	int i;
+
+	hist = kmalloc_array(NCI_XPORT_LAT_NR, sizeof(*hist), GFP_KERNEL);
+	if (!hist)
+		return -ENOMEM;
+
+	spin_lock_irq(&xp->lat_lock);
+	memcpy(hist, xp->lat, sizeof(xp->lat));
+	spin_unlock_irq(&xp->lat_lock);
+
+	for (i = 0; i < NCI_XPORT_LAT_NR; i++)
+		mmi_lat_hist_show(s, nci_xport_lat_names[i], &hist[i]);
+
+	kfree(hist);
+	return 0;
+}
+
+static int nci_xport_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nci_xport_latency_show, inode->i_private);
+}
+
+/* Any write resets the histograms */
+static ssize_t nci_xport_latency_write(struct file *file,
+				       const char __user *buf, size_t count,
+				       loff_t *ppos)
+{
+	struct nci_xport *xp = file_inode(file)->i_private;
+
+	spin_lock_irq(&xp->lat_lock);
+	memset(xp->lat, 0, sizeof(xp->lat));
+	spin_unlock_irq(&xp->lat_lock);
+	return count;
+}
+
+static const struct file_operations nci_xport_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = nci_xport_latency_open,
+	.read = seq_read,
+	.write = nci_xport_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/**
+ * nci_xport_init() - set up a transport
+ * @xp: the transport
+ * @name: debugfs directory name, must outlive the transport
+ * @ops: chip callbacks
+ * @wq: queue woken up by the chip IRQ handler
+ * @priv: chip driver data
+ *
+ * Return: 0 or -ENOMEM
+ */
+int nci_xport_init(struct nci_xport *xp, const char *name,
+		   const struct nci_xport_ops *ops, wait_queue_head_t *wq,
+		   void *priv)
+{
+	xp->fifo = kzalloc(NCI_XPORT_FIFO_SIZE, GFP_KERNEL);
+	if (!xp->fifo)
+		return -ENOMEM;
+
+	xp->name = name;
+	xp->ops = ops;
+	xp->priv = priv;
+	xp->wq = wq;
+	xp->fifo_len = 0;
+	xp->rd = 0;
+	xp->pkt_off = 0;
+	xp->flushed = false;
+	memset(&xp->stats, 0, sizeof(xp->stats));
+	memset(xp->lat, 0, sizeof(xp->lat));
+	xp->last_rx = 0;
+	mutex_init(&xp->lock);
+	spin_lock_init(&xp->lat_lock);
+
+	xp->dir = debugfs_create_dir(name, nci_xport_root);
+	debugfs_create_file("stats", 0440, xp->dir, xp,
+			    &nci_xport_stats_fops);
+	debugfs_create_file("latency", 0640, xp->dir, xp,
+			    &nci_xport_latency_fops);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nci_xport_init);
+
+void nci_xport_deinit(struct nci_xport *xp)
+{
+	debugfs_remove_recursive(xp->dir);
+	xp->dir = NULL;
+	mutex_destroy(&xp->lock);
+	kfree(xp->fifo);
+	xp->fifo = NULL;
+}
+EXPORT_SYMBOL_GPL(nci_xport_deinit);
+
+static int __init nci_xport_module_init(void)
+{
+	nci_xport_root = debugfs_create_dir("nci_xport", NULL);
+	return 0;
+}
+module_init(nci_xport_module_init);
+
+static void __exit nci_xport_module_exit(void)
+{
+	debugfs_remove_recursive(nci_xport_root);
+}
+module_exit(nci_xport_module_exit);
+
+MODULE_DESCRIPTION("NCI transport shared by the NFC controller drivers");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Self test of the NCI transport against a stub controller.
+ *
+ * The i2c-stub bus only speaks SMBus, so the stub sits one layer up: it
+ * implements the nci_xport_ops over an in-memory byte stream, with the
+ * IRQ line high while bytes are pending. No chip driver is involved.
+ *
+ *	cat /sys/kernel/debug/nci_xport_test/run
+ */
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/mman.h>
+#include <linux/module.h>
+#include <linux/nci_xport.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define STUB_RX_SIZE	(4 * NCI_XPORT_FIFO_SIZE)
+#define STUB_FILTER_GID	0x6F
+
+/* What the stub does each time the transport arms its IRQ */
+enum stub_arm {
+	STUB_ARM_NONE,		/* nothing, the wait times out */
+	STUB_ARM_SPURIOUS,	/* IRQ with the line still low */
+	STUB_ARM_DATA,		/* IRQ with the pending packet queued */
+	STUB_ARM_POWER_OFF,	/* controller switched off */
+};
+
+#define STUB_ARM_MAX	4
+
+struct nci_xport_stub {
+	struct nci_xport xp;
+	wait_queue_head_t wq;
+	char __user *ubuf;
+	u8 rx[STUB_RX_SIZE];
+	size_t rx_len;
+	size_t rx_off;
+	u8 pending[NCI_XPORT_MAX_PKT_LEN];
+	size_t pending_len;
+	bool powered;
+	bool filter;
+	int recv_err;
+	int recv_err_after;
+	enum stub_arm arm[STUB_ARM_MAX];
+	int nr_arm;
+	int irq_enabled;
+};
+
+static struct dentry *nci_xport_test_dir;
+
+static int stub_recv(struct nci_xport *xp, u8 *buf, size_t len)
+{
+	struct nci_xport_stub *st = xp->priv;
+
+	/* The bus keeps failing once the error kicked in */
+	if (st->recv_err) {
+		if (st->recv_err_after <= 0)
+			return st->recv_err;
+		st->recv_err_after--;
+	}
+
+	if (len > st->rx_len - st->rx_off)
+		return -EIO;
+
+	memcpy(buf, st->rx + st->rx_off, len);
+	st->rx_off += len;
+	return len;
+}
+
+static int stub_irq_level(struct nci_xport *xp)
+{
+	struct nci_xport_stub *st = xp->priv;
+
+	return st->rx_off < st->rx_len;
+}
+
+static bool stub_powered(struct nci_xport *xp)
+{
+	struct nci_xport_stub *st = xp->priv;
+
+	return st->powered;
+}
+
+static void stub_queue(struct nci_xport_stub *st, const u8 *pkt, size_t len)
+{
+	if (st->rx_off == st->rx_len)
+		st->rx_off = st->rx_len = 0;
+
+	if (WARN_ON(st->rx_len + len > STUB_RX_SIZE))
+		return;
+
+	memcpy(st->rx + st->rx_len, pkt, len);
+	st->rx_len += len;
+}
+
+/* Build a packet of group @gid with a @plen bytes payload counting from @seed */
+static size_t stub_make_pkt(u8 *pkt, u8 gid, u8 plen, u8 seed)
+{
+	int i;
+
+	pkt[0] = gid;
+	pkt[1] = 0x00;
+	pkt[2] = plen;
+	for (i = 0; i < plen; i++)
+		pkt[NCI_XPORT_HDR_LEN + i] = seed + i;
+
+	return NCI_XPORT_HDR_LEN + plen;
+}
+
+static void stub_queue_pkt(struct nci_xport_stub *st, u8 gid, u8 plen, u8 seed)
+{
+	u8 pkt[NCI_XPORT_MAX_PKT_LEN];
+
+	stub_queue(st, pkt, stub_make_pkt(pkt, gid, plen, seed));
+}
+
+static void stub_enable_irq(struct nci_xport *xp)
+{
+	struct nci_xport_stub *st = xp->priv;
+	enum stub_arm arm = STUB_ARM_NONE;
+
+	st->irq_enabled++;
+	if (st->nr_arm < STUB_ARM_MAX)
+		arm = st->arm[st->nr_arm++];
+
+	switch (arm) {
+	case STUB_ARM_NONE:
+		return;
+	case STUB_ARM_DATA:
+		stub_queue(st, st->pending, st->pending_len);
+		break;
+	case STUB_ARM_POWER_OFF:
+		st->powered = false;
+		break;
+	case STUB_ARM_SPURIOUS:
+		break;
+	}
+
+	nci_xport_irq(xp);
+	wake_up_interruptible(&st->wq);
+}
+
+static void stub_disable_irq(struct nci_xport *xp)
+{
+	struct nci_xport_stub *st = xp->priv;
+
+	st->irq_enabled--;
+}
+
+static bool stub_filter(struct nci_xport *xp, const u8 *pkt, size_t len)
+{
+	struct nci_xport_stub *st = xp->priv;
+
+	return st->filter && pkt[0] == STUB_FILTER_GID;
+}
+
+static const struct nci_xport_ops stub_ops = {
+	.recv = stub_recv,
+	.irq_level = stub_irq_level,
+	.powered = stub_powered,
+	.enable_irq = stub_enable_irq,
+	.disable_irq = stub_disable_irq,
+	.filter = stub_filter,
+};
+
+static ssize_t stub_read(struct nci_xport_stub *st, u8 *out, size_t count,
+			 bool nonblock)
+{
+	ssize_t ret;
+
+	ret = nci_xport_read(&st->xp, st->ubuf, count, nonblock);
+	if (ret > 0 && copy_from_user(out, st->ubuf, ret))
+		return -EFAULT;
+
+	return ret;
+}
+
+#define STUB_EXPECT(cond)						\
+	do {								\
+		if (!(cond)) {						\
+			pr_err("%s:%d: expected %s\n", __func__,	\
+			       __LINE__, #cond);			\
+			return -EINVAL;					\
+		}							\
+	} while (0)
+
+/* Read a whole packet and check it against what stub_make_pkt() built */
+static int stub_expect_pkt(struct nci_xport_stub *st, u8 gid, u8 plen, u8 seed,
+			   bool nonblock)
+{
+	u8 want[NCI_XPORT_MAX_PKT_LEN], got[NCI_XPORT_MAX_PKT_LEN];
+	size_t len = stub_make_pkt(want, gid, plen, seed);
+
+	STUB_EXPECT(stub_read(st, got, sizeof(got), nonblock) == len);
+	STUB_EXPECT(!memcmp(got, want, len));
+	return 0;
+}
+
+static int test_header_then_payload(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	stub_queue_pkt(st, 0x60, 5, 0x10);
+
+	STUB_EXPECT(stub_read(st, buf, NCI_XPORT_HDR_LEN, true) == 3);
+	STUB_EXPECT(buf[0] == 0x60 && buf[2] == 5);
+	STUB_EXPECT(st->xp.stats.packets == 0);
+	STUB_EXPECT(stub_read(st, buf, buf[2], true) == 5);
+	STUB_EXPECT(buf[0] == 0x10 && buf[4] == 0x14);
+	STUB_EXPECT(st->xp.stats.packets == 1);
+	STUB_EXPECT(st->xp.stats.bytes == 8);
+	return 0;
+}
+
+static int test_no_payload(struct nci_xport_stub *st)
+{
+	stub_queue_pkt(st, 0x40, 0, 0);
+
+	return stub_expect_pkt(st, 0x40, 0, 0, true);
+}
+
+static int test_batched(struct nci_xport_stub *st)
+{
+	int i;
+
+	for (i = 0; i < 3; i++)
+		stub_queue_pkt(st, 0x60 + i, 4 + i, i);
+
+	for (i = 0; i < 3; i++)
+		if (stub_expect_pkt(st, 0x60 + i, 4 + i, i, true))
+			return -EINVAL;
+
+	STUB_EXPECT(st->xp.stats.packets == 3);
+	STUB_EXPECT(st->xp.stats.batched == 2);
+	STUB_EXPECT(!stub_irq_level(&st->xp));
+	return 0;
+}
+
+static int test_no_span(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	stub_queue_pkt(st, 0x61, 1, 0);
+	stub_queue_pkt(st, 0x62, 2, 0);
+
+	/* A read never runs into the next packet, even with room for it */
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == 4);
+	STUB_EXPECT(stub_read(st, buf, 1, true) == 1);
+	STUB_EXPECT(buf[0] == 0x62);
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == 4);
+	return 0;
+}
+
+static int test_fifo_full(struct nci_xport_stub *st)
+{
+	int i, nr = 2 * NCI_XPORT_FIFO_SIZE / NCI_XPORT_MAX_PKT_LEN;
+
+	/* More than the fifo holds, the rest stays on the bus */
+	for (i = 0; i < nr; i++)
+		stub_queue_pkt(st, 0x60, NCI_XPORT_MAX_PAYLOAD_LEN, i);
+
+	for (i = 0; i < nr; i++)
+		if (stub_expect_pkt(st, 0x60, NCI_XPORT_MAX_PAYLOAD_LEN, i,
+				    true))
+			return -EINVAL;
+
+	STUB_EXPECT(st->xp.stats.packets == nr);
+	return 0;
+}
+
+static int test_nonblock_empty(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == -EAGAIN);
+	STUB_EXPECT(!nci_xport_has_data(&st->xp));
+	STUB_EXPECT(st->irq_enabled == 0);
+	return 0;
+}
+
+static int test_blocking_wait(struct nci_xport_stub *st)
+{
+	st->pending_len = stub_make_pkt(st->pending, 0x61, 3, 0x20);
+	st->arm[0] = STUB_ARM_DATA;
+
+	if (stub_expect_pkt(st, 0x61, 3, 0x20, false))
+		return -EINVAL;
+
+	STUB_EXPECT(st->nr_arm == 1);
+	STUB_EXPECT(st->irq_enabled == 0);
+	STUB_EXPECT(st->xp.stats.spurious == 0);
+	return 0;
+}
+
+static int test_spurious(struct nci_xport_stub *st)
+{
+	st->pending_len = stub_make_pkt(st->pending, 0x61, 3, 0x30);
+	st->arm[0] = STUB_ARM_SPURIOUS;
+	st->arm[1] = STUB_ARM_SPURIOUS;
+	st->arm[2] = STUB_ARM_DATA;
+
+	if (stub_expect_pkt(st, 0x61, 3, 0x30, false))
+		return -EINVAL;
+
+	STUB_EXPECT(st->nr_arm == 3);
+	STUB_EXPECT(st->xp.stats.spurious == 2);
+	STUB_EXPECT(st->irq_enabled == 0);
+	return 0;
+}
+
+static int test_power_off(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	st->arm[0] = STUB_ARM_SPURIOUS;
+	st->arm[1] = STUB_ARM_POWER_OFF;
+
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), false) == -EIO);
+	STUB_EXPECT(st->xp.stats.spurious == 1);
+	STUB_EXPECT(st->irq_enabled == 0);
+	return 0;
+}
+
+static int test_wait_timeout(struct nci_xport_stub *st)
+{
+	STUB_EXPECT(nci_xport_wait_irq(&st->xp, 10) == -ETIMEDOUT);
+	STUB_EXPECT(st->irq_enabled == 0);
+
+	stub_queue_pkt(st, 0x60, 0, 0);
+	STUB_EXPECT(nci_xport_wait_irq(&st->xp, 10) == 0);
+	STUB_EXPECT(st->nr_arm == 1);
+	return 0;
+}
+
+static int test_filter(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	st->filter = true;
+	stub_queue_pkt(st, STUB_FILTER_GID, 2, 0);
+	stub_queue_pkt(st, 0x60, 2, 0x40);
+
+	if (stub_expect_pkt(st, 0x60, 2, 0x40, true))
+		return -EINVAL;
+	STUB_EXPECT(st->xp.stats.filtered == 1);
+
+	/* Nothing left once the filter took every packet */
+	stub_queue_pkt(st, STUB_FILTER_GID, 2, 0);
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == 0);
+	STUB_EXPECT(st->xp.stats.filtered == 2);
+	STUB_EXPECT(st->xp.stats.packets == 1);
+	return 0;
+}
+
+static int test_flush(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	stub_queue_pkt(st, 0x60, 2, 0);
+	stub_queue_pkt(st, 0x61, 2, 0);
+	STUB_EXPECT(stub_read(st, buf, NCI_XPORT_HDR_LEN, true) == 3);
+
+	/* The rest of the first packet and the second one are stale */
+	nci_xport_flush(&st->xp);
+	stub_queue_pkt(st, 0x62, 2, 0x50);
+
+	if (stub_expect_pkt(st, 0x62, 2, 0x50, true))
+		return -EINVAL;
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == -EAGAIN);
+	return 0;
+}
+
+static int test_recv_error(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	st->recv_err = -EREMOTEIO;
+	stub_queue_pkt(st, 0x60, 2, 0);
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == -EREMOTEIO);
+	STUB_EXPECT(st->xp.stats.errors == 1);
+	return 0;
+}
+
+static int test_recv_error_batch(struct nci_xport_stub *st)
+{
+	u8 buf[NCI_XPORT_MAX_PKT_LEN];
+
+	/* Header and payload of the first packet go through */
+	st->recv_err = -EREMOTEIO;
+	st->recv_err_after = 2;
+	stub_queue_pkt(st, 0x60, 2, 0x60);
+	stub_queue_pkt(st, 0x61, 2, 0);
+
+	/* What was read before the error is handed over */
+	if (stub_expect_pkt(st, 0x60, 2, 0x60, true))
+		return -EINVAL;
+	STUB_EXPECT(st->xp.stats.errors == 1);
+	STUB_EXPECT(stub_read(st, buf, sizeof(buf), true) == -EREMOTEIO);
+	STUB_EXPECT(st->xp.stats.errors == 2);
+	return 0;
+}
+
+struct nci_xport_test {
+	const char *name;
+	int (*run)(struct nci_xport_stub *st);
+};
+
+static const struct nci_xport_test nci_xport_tests[] = {
+	{ "header_then_payload", test_header_then_payload },
+	{ "no_payload", test_no_payload },
+	{ "batched", test_batched },
+	{ "no_span", test_no_span },
+	{ "fifo_full", test_fifo_full },
+	{ "nonblock_empty", test_nonblock_empty },
+	{ "blocking_wait", test_blocking_wait },
+	{ "spurious", test_spurious },
+	{ "power_off", test_power_off },
+	{ "wait_timeout", test_wait_timeout },
+	{ "filter", test_filter },
+	{ "flush", test_flush },
+	{ "recv_error", test_recv_error },
+	{ "recv_error_batch", test_recv_error_batch },
+};
+
+static int nci_xport_test_run_show(struct seq_file *s, void *unused)
+{
+	struct nci_xport_stub *st;
+	unsigned long addr;
+	int i, ret, failed = 0;
+
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!st)
+		return -ENOMEM;
+
+	/* nci_xport_read() copies to userspace, give it a user buffer */
+	addr = vm_mmap(NULL, 0, PAGE_SIZE, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (IS_ERR_VALUE(addr)) {
+		kfree(st);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(nci_xport_tests); i++) {
+		memset(st, 0, sizeof(*st));
+		init_waitqueue_head(&st->wq);
+		st->ubuf = (char __user *)addr;
+		st->powered = true;
+
+		ret = nci_xport_init(&st->xp, "stub", &stub_ops, &st->wq, st);
+		if (!ret) {
+			ret = nci_xport_tests[i].run(st);
+			nci_xport_deinit(&st->xp);
+		}
+
+		seq_printf(s, "%-20s %s\n", nci_xport_tests[i].name,
+			   ret ? "FAIL" : "pass");
+		if (ret)
+			failed++;
+	}
+
+	seq_printf(s, "%zu/%zu passed\n", ARRAY_SIZE(nci_xport_tests) - failed,
+		   ARRAY_SIZE(nci_xport_tests));
+
+	vm_munmap(addr, PAGE_SIZE);
+	kfree(st);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nci_xport_test_run);
+
+static int __init nci_xport_test_init(void)
+{
+	nci_xport_test_dir = debugfs_create_dir("nci_xport_test", NULL);
+	debugfs_create_file("run", 0400, nci_xport_test_dir, NULL,
+			    &nci_xport_test_run_fops);
+	return 0;
+}
+module_init(nci_xport_test_init);
+
+static void __exit nci_xport_test_exit(void)
+{
+	debugfs_remove_recursive(nci_xport_test_dir);
+}
+module_exit(nci_xport_test_exit);
+
+MODULE_DESCRIPTION("NCI transport self test against a stub controller");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM nci_xport
+
+#if !defined(_NCI_XPORT_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _NCI_XPORT_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(nci_xport_rx,
+	    TP_PROTO(const char *name, const u8 *pkt, size_t len, int nr),
+	    TP_ARGS(name, pkt, len, nr),
+	    TP_STRUCT__entry(__string(name, name)
+			     __array(u8, hdr, 3)
+			     __field(u16, len)
+			     __field(int, nr)),
+	    TP_fast_assign(__assign_str(name, name);
+			   memcpy(__entry->hdr, pkt, 3);
+			   __entry->len = len;
+			   __entry->nr = nr;),
+	    TP_printk("%s hdr %3phN len %u nr %d in batch", __get_str(name),
+		      __entry->hdr, __entry->len, __entry->nr));
+
+TRACE_EVENT(nci_xport_lat,
+	    TP_PROTO(const char *name, const char *phase, u64 delta_ns),
+	    TP_ARGS(name, phase, delta_ns),
+	    TP_STRUCT__entry(__string(name, name)
+			     __string(phase, phase)
+			     __field(u64, delta_ns)),
+	    TP_fast_assign(__assign_str(name, name);
+			   __assign_str(phase, phase);
+			   __entry->delta_ns = delta_ns;),
+	    TP_printk("%s %s took %llu ns", __get_str(name),
+		      __get_str(phase), __entry->delta_ns));
+
+#endif /* _NCI_XPORT_TRACE_H_ */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH ../../../../motorola/kernel/modules/drivers/nfc/nci_xport
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE nci_xport_trace
+#include <trace/define_trace.h>
@@ -62,6 +62,7 @@ struct sec_nfc_i2c_info {};
 #include <linux/poll.h>
 #include <linux/sched.h>
 #include <linux/i2c.h>
+#include <linux/nci_xport.h>
 #include "sec_nfc.h"
 
 #define SEC_NFC_GET_INFO(dev) i2c_get_clientdata(to_i2c_client(dev))
@@ -79,6 +80,7 @@ struct sec_nfc_i2c_info {
 	wait_queue_head_t read_wait;
 	size_t buflen;
 	u8 *buf;
+	struct nci_xport xport;	/* NCI reads in SEC_NFC_MODE_FIRMWARE */
 };
 #endif
 
@@ -135,6 +137,8 @@ static irqreturn_t sec_nfc_irq_thread_fn(int irq, void *dev_id)
 	info->i2c_info.read_irq += SEC_NFC_READ_TIMES;
 	mutex_unlock(&info->i2c_info.read_mutex);
 
+	nci_xport_irq(&info->i2c_info.xport);
+
 	wake_up_interruptible(&info->i2c_info.read_wait);
 #ifdef CONFIG_SEC_NFC_WAKE_LOCK
 	wake_lock_timeout(&info->nfc_wake_lock, 2 * HZ);
@@ -143,6 +147,73 @@ static irqreturn_t sec_nfc_irq_thread_fn(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+static int sec_nfc_xport_recv(struct nci_xport *xp, u8 *buf, size_t len)
+{
+	struct sec_nfc_info *info = xp->priv;
+	int ret;
+
+	ret = i2c_master_recv(info->i2c_info.i2c_dev, buf, len);
+	if (ret < 0)
+		return ret;
+
+	return ret == len ? ret : -EIO;
+}
+
+static int sec_nfc_xport_irq_level(struct nci_xport *xp)
+{
+	struct sec_nfc_info *info = xp->priv;
+
+	return gpio_get_value(info->pdata->irq) > 0;
+}
+
+/*
+ * VEN stays high in deep standby, so a blocked NCI reader is released on
+ * any switch out of the firmware mode instead.
+ */
+static bool sec_nfc_xport_powered(struct nci_xport *xp)
+{
+	struct sec_nfc_info *info = xp->priv;
+
+	return READ_ONCE(info->mode) == SEC_NFC_MODE_FIRMWARE;
+}
+
+/* The edge triggered IRQ stays armed, the handler only counts it */
+static void sec_nfc_xport_irq_nop(struct nci_xport *xp)
+{
+}
+
+static const struct nci_xport_ops sec_nfc_xport_ops = {
+	.recv = sec_nfc_xport_recv,
+	.irq_level = sec_nfc_xport_irq_level,
+	.powered = sec_nfc_xport_powered,
+	.enable_irq = sec_nfc_xport_irq_nop,
+	.disable_irq = sec_nfc_xport_irq_nop,
+};
+
+static ssize_t sec_nfc_nci_read(struct sec_nfc_info *info,
+				char __user *buf, size_t count, bool nonblock)
+{
+	enum sec_nfc_irq irq;
+	ssize_t ret;
+
+	/* The HAL reads 0 bytes after a header without payload */
+	if (!count)
+		return 0;
+
+	/* Nothing is read until the first write after a power switch */
+	mutex_lock(&info->i2c_info.read_mutex);
+	irq = info->i2c_info.read_irq;
+	mutex_unlock(&info->i2c_info.read_mutex);
+	if (irq == SEC_NFC_SKIP)
+		return nonblock ? -EAGAIN : 0;
+
+	ret = nci_xport_read(&info->i2c_info.xport, buf, count, nonblock);
+	if (ret == -EREMOTEIO)
+		ret = -ERESTART;
+
+	return ret;
+}
+
 static ssize_t sec_nfc_read(struct file *file, char __user *buf,
                             size_t count, loff_t *ppos)
 {
@@ -161,6 +232,16 @@ static ssize_t sec_nfc_read(struct file *file, char __user *buf,
 		goto out;
 	}
 
+	/*
+	 * Bootloader frames are not NCI, they keep the raw path. A blocking
+	 * NCI read must not hold info->mutex, set_mode releases it.
+	 */
+	if (info->mode == SEC_NFC_MODE_FIRMWARE) {
+		mutex_unlock(&info->mutex);
+		return sec_nfc_nci_read(info, buf, count,
+					file->f_flags & O_NONBLOCK);
+	}
+
 	mutex_lock(&info->i2c_info.read_mutex);
 	if (count == 0) {
 		if (info->i2c_info.read_irq >= SEC_NFC_INT)
@@ -234,6 +315,7 @@ static ssize_t sec_nfc_write(struct file *file, const char __user *buf,
 {
 	struct sec_nfc_info *info = container_of(file->private_data,
                                             struct sec_nfc_info, miscdev);
+	ktime_t start;
 	int ret = 0;
 
 	dev_dbg(info->dev, "%s: info: %p, count %d\n", __func__,
@@ -266,7 +348,9 @@ static ssize_t sec_nfc_write(struct file *file, const char __user *buf,
 	 * It is released after first write
 	 */
 	mutex_lock(&info->i2c_info.read_mutex);
+	start = nci_xport_write_begin(&info->i2c_info.xport);
 	ret = i2c_master_send(info->i2c_info.i2c_dev, info->i2c_info.buf, count);
+	nci_xport_write_end(&info->i2c_info.xport, start);
 	if (info->i2c_info.read_irq == SEC_NFC_SKIP)
 		info->i2c_info.read_irq = SEC_NFC_NONE;
 	mutex_unlock(&info->i2c_info.read_mutex);
@@ -312,8 +396,13 @@ static unsigned int sec_nfc_poll(struct file *file, poll_table *wait)
 
 	mutex_lock(&info->i2c_info.read_mutex);
 	irq = info->i2c_info.read_irq;
-	if (irq == SEC_NFC_READ_TIMES)
+	if (info->mode == SEC_NFC_MODE_FIRMWARE) {
+		if (irq != SEC_NFC_SKIP &&
+		    nci_xport_has_data(&info->i2c_info.xport))
+			ret = (POLLIN | POLLRDNORM);
+	} else if (irq == SEC_NFC_READ_TIMES) {
 		ret = (POLLIN | POLLRDNORM);
+	}
 	mutex_unlock(&info->i2c_info.read_mutex);
 
 out:
@@ -353,6 +442,14 @@ int sec_nfc_i2c_probe(struct i2c_client *client)
 
 	info->dev = dev;
 
+	ret = nci_xport_init(&info->i2c_info.xport, dev_name(dev),
+			     &sec_nfc_xport_ops, &info->i2c_info.read_wait,
+			     info);
+	if (ret) {
+		kfree(info->i2c_info.buf);
+		return ret;
+	}
+
 	ret = gpio_request(pdata->irq, "nfc_int");
 	if (ret) {
 		pr_err("GPIO request is failed to register IRQ\n");
@@ -365,6 +462,7 @@ int sec_nfc_i2c_probe(struct i2c_client *client)
 		IRQF_TRIGGER_RISING | IRQF_ONESHOT, SEC_NFC_DRIVER_NAME, info);
 	if (ret < 0) {
 		pr_err("failed to register IRQ handler\n");
+		nci_xport_deinit(&info->i2c_info.xport);
 		kfree(info->i2c_info.buf);
 		return ret;
 	}
@@ -373,6 +471,7 @@ int sec_nfc_i2c_probe(struct i2c_client *client)
 	return 0;
 
 err_irq_req:
+	nci_xport_deinit(&info->i2c_info.xport);
 	return ret;
 }
 
@@ -383,6 +482,7 @@ void sec_nfc_i2c_remove(struct device *dev)
 	struct sec_nfc_platform_data *pdata = info->pdata;
 	free_irq(client->irq, info);
 	gpio_free(pdata->irq);
+	nci_xport_deinit(&info->i2c_info.xport);
 }
 #endif /* CONFIG_SEC_NFC_IF_I2C */
 
@@ -511,6 +611,11 @@ static void sec_nfc_set_mode(struct sec_nfc_info *info,
 #endif
 	info->i2c_info.read_irq = SEC_NFC_SKIP;
 	mutex_unlock(&info->i2c_info.read_mutex);
+	/* What was read before the power switch is stale */
+	nci_xport_flush(&info->i2c_info.xport);
+	/* Release a blocked NCI reader, it sees the new mode */
+	nci_xport_irq(&info->i2c_info.xport);
+	wake_up_interruptible(&info->i2c_info.read_wait);
 #endif
 
 #ifdef CONFIG_SEC_ESE_COLDRESET
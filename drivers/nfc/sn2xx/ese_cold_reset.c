@@ -135,6 +135,38 @@ error:
 	return ret;
 }
 
+/**
+ * cold_reset_rsp_received() - Take the cold reset response from a packet.
+ * @nfc_dev: NFC device handle.
+ * @pkt: NCI packet read by the nfc read thread.
+ * @len: length of the packet.
+ *
+ * NFC HAL process shouldn't receive this response as the command was
+ * sent by the eSE process.
+ *
+ * Return: true if the packet was the pending cold reset response.
+ */
+bool cold_reset_rsp_received(struct nfc_dev *nfc_dev, const u8 *pkt,
+			     size_t len)
+{
+	struct cold_reset *cold_rst = &nfc_dev->cold_reset;
+
+	if (!cold_rst->rsp_pending || !cold_rst->cmd_buf ||
+		(pkt[0] != PROP_NCI_RSP_GID) ||
+		(pkt[1] != cold_rst->cmd_buf[1]))
+		return false;
+
+	if (len <= NCI_PAYLOAD_IDX || len > cold_rst->rsp_len)
+		dev_err(nfc_dev->nfc_device,
+			"%s: - invalid cold reset rsp length %zu\n",
+			__func__, len);
+	else
+		cold_rst->status = pkt[NCI_PAYLOAD_IDX];
+
+	cold_rst->rsp_pending = false;
+	wake_up_interruptible(&cold_rst->read_wq);
+	return true;
+}
 
 /**
  * ese_cold_reset_ioctl() - This function handles the eSE cold reset ioctls.
@@ -149,6 +181,7 @@ int ese_cold_reset_ioctl(struct nfc_dev *nfc_dev, unsigned long arg)
 	int ret;
 	struct ese_ioctl_arg ioctl_arg;
 	struct ese_cold_reset_arg *cold_reset_arg = NULL;
+	ktime_t start;
 
 	if (!arg) {
 		dev_err(nfc_dev->nfc_device, "arg is invalid\n");
@@ -271,6 +304,7 @@ int ese_cold_reset_ioctl(struct nfc_dev *nfc_dev, unsigned long arg)
 				nfc_dev->cold_reset.cmd_buf[1],
 				nfc_dev->cold_reset.cmd_buf[2]);
 
+	start = ktime_get();
 	ret = send_ese_cmd(nfc_dev);
 	if (ret <= 0) {
 		pr_err("failed to send ese command\n");
@@ -332,6 +366,7 @@ int ese_cold_reset_ioctl(struct nfc_dev *nfc_dev, unsigned long arg)
 	} else
 		pr_debug("ese cmd is %d\n", cold_reset_arg->sub_cmd);
 
+	nci_xport_lat_add(&nfc_dev->xport, NCI_XPORT_LAT_ESE_RESET, start);
 	ret = nfc_dev->cold_reset.status;
 
 err:
@@ -76,5 +76,7 @@ struct cold_reset {
 struct nfc_dev;
 int ese_cold_reset_ioctl(struct nfc_dev *nfc_dev, unsigned long arg);
 int read_cold_reset_rsp(struct nfc_dev *nfc_dev, char *header);
+bool cold_reset_rsp_received(struct nfc_dev *nfc_dev, const u8 *pkt,
+			     size_t len);
 
 #endif
@@ -230,14 +230,19 @@ int get_valid_gpio(int gpio)
 void gpio_set_ven(struct nfc_dev *nfc_dev, int value)
 {
 	struct platform_gpio *nfc_gpio = &nfc_dev->configs.gpio;
+	ktime_t start;
 
 	if (gpio_get_value(nfc_gpio->ven) != value) {
 		pr_debug("%s: value %d\n", __func__, value);
+		start = ktime_get();
 
 		gpio_set_value(nfc_gpio->ven, value);
+		/* packets read before are not relevant anymore */
+		nci_xport_flush(&nfc_dev->xport);
 		/* hardware dependent delay */
 		usleep_range(NFC_GPIO_SET_WAIT_TIME_USEC,
 			     NFC_GPIO_SET_WAIT_TIME_USEC + 100);
+		nci_xport_lat_add(&nfc_dev->xport, NCI_XPORT_LAT_POWER, start);
 	}
 }
 
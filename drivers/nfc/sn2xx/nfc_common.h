@@ -41,6 +41,7 @@
 #include <linux/nfcinfo.h>
 #include <linux/regulator/consumer.h>
 #include <linux/ipc_logging.h>
+#include <linux/nci_xport.h>
 #include "nfc_i2c_drv.h"
 #include "ese_cold_reset.h"
 
@@ -310,6 +311,8 @@ struct nfc_dev {
 	struct platform_configs configs;
 	struct cold_reset cold_reset;
 	struct regulator *reg;
+	/* NCI packets for the nfc read thread */
+	struct nci_xport xport;
 
 	/* read buffer*/
 	size_t kbuflen;
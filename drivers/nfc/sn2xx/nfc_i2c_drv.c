@@ -90,17 +90,68 @@ static irqreturn_t i2c_irq_handler(int irq, void *dev_id)
 	if (device_may_wakeup(&i2c_dev->client->dev))
 		pm_wakeup_event(&i2c_dev->client->dev, WAKEUP_SRC_TIMEOUT);
 
+	nci_xport_irq(&nfc_dev->xport);
 	i2c_disable_irq(nfc_dev);
 	wake_up(&nfc_dev->read_wq);
 
 	return IRQ_HANDLED;
 }
 
+static int i2c_xport_recv(struct nci_xport *xp, u8 *buf, size_t len)
+{
+	struct nfc_dev *nfc_dev = xp->priv;
+	int ret;
+
+	ret = i2c_master_recv(nfc_dev->i2c_dev.client, buf, len);
+	NFCLOG_IPC(nfc_dev, false, "%s of %zu bytes, ret %d", __func__, len,
+								ret);
+	if (ret < 0)
+		return ret;
+
+	return ret == len ? ret : -EIO;
+}
+
+static int i2c_xport_irq_level(struct nci_xport *xp)
+{
+	struct nfc_dev *nfc_dev = xp->priv;
+
+	return gpio_get_value(nfc_dev->configs.gpio.irq);
+}
+
+static bool i2c_xport_powered(struct nci_xport *xp)
+{
+	struct nfc_dev *nfc_dev = xp->priv;
+
+	return gpio_get_value(nfc_dev->configs.gpio.ven);
+}
+
+static void i2c_xport_enable_irq(struct nci_xport *xp)
+{
+	i2c_enable_irq(xp->priv);
+}
+
+static void i2c_xport_disable_irq(struct nci_xport *xp)
+{
+	i2c_disable_irq(xp->priv);
+}
+
+static bool i2c_xport_filter(struct nci_xport *xp, const u8 *pkt, size_t len)
+{
+	return cold_reset_rsp_received(xp->priv, pkt, len);
+}
+
+static const struct nci_xport_ops i2c_xport_ops = {
+	.recv = i2c_xport_recv,
+	.irq_level = i2c_xport_irq_level,
+	.powered = i2c_xport_powered,
+	.enable_irq = i2c_xport_enable_irq,
+	.disable_irq = i2c_xport_disable_irq,
+	.filter = i2c_xport_filter,
+};
+
 int i2c_read(struct nfc_dev *nfc_dev, char *buf, size_t count, int timeout)
 {
 	int ret;
-	struct i2c_dev *i2c_dev = &nfc_dev->i2c_dev;
-	struct platform_gpio *nfc_gpio = &nfc_dev->configs.gpio;
 	uint16_t i = 0;
 	uint16_t disp_len = GET_IPCLOG_MAX_PKT_LEN(count);
 
@@ -112,44 +163,9 @@ int i2c_read(struct nfc_dev *nfc_dev, char *buf, size_t count, int timeout)
 	if (count > MAX_BUFFER_SIZE)
 		count = MAX_BUFFER_SIZE;
 
-	if (!gpio_get_value(nfc_gpio->irq)) {
-		while (1) {
-			ret = 0;
-			if (!i2c_dev->irq_enabled) {
-				i2c_dev->irq_enabled = true;
-				enable_irq(i2c_dev->client->irq);
-			}
-			if (!gpio_get_value(nfc_gpio->irq)) {
-				if (timeout) {
-					ret = wait_event_interruptible_timeout(nfc_dev->read_wq,
-						 !i2c_dev->irq_enabled, msecs_to_jiffies(timeout));
-
-					if (ret <= 0) {
-						pr_err("%s timeout/error in read\n", __func__);
-						goto err;
-					}
-				} else {
-					ret = wait_event_interruptible(nfc_dev->read_wq,
-						!i2c_dev->irq_enabled);
-					if (ret) {
-						pr_err("%s error wakeup of read wq\n", __func__);
-						ret = -EINTR;
-						goto err;
-					}
-				}
-			}
-			i2c_disable_irq(nfc_dev);
-
-			if (gpio_get_value(nfc_gpio->irq))
-				break;
-			if (!gpio_get_value(nfc_gpio->ven)) {
-				pr_info("%s: releasing read\n", __func__);
-				ret = -EIO;
-				goto err;
-			}
-			pr_warn("%s: spurious interrupt detected\n", __func__);
-		}
-	}
+	ret = nci_xport_wait_irq(&nfc_dev->xport, timeout);
+	if (ret)
+		goto err;
 
 	memset(buf, 0x00, count);
 	/* Read data */
@@ -229,6 +245,14 @@ ssize_t nfc_i2c_dev_read(struct file *filp, char __user *buf,
 	struct nfc_dev *nfc_dev = (struct nfc_dev *)filp->private_data;
 
 	mutex_lock(&nfc_dev->read_mutex);
+	if (nfc_dev->nfc_state == NFC_STATE_NCI) {
+		/* whole packets, straight to user space */
+		ret = nci_xport_read(&nfc_dev->xport, buf, count,
+				     filp->f_flags & O_NONBLOCK);
+		mutex_unlock(&nfc_dev->read_mutex);
+		return ret;
+	}
+
 	if (filp->f_flags & O_NONBLOCK) {
 		ret = i2c_master_recv(nfc_dev->i2c_dev.client, nfc_dev->read_kbuf, count);
 		pr_debug("%s: NONBLOCK read ret = %d\n", __func__, ret);
@@ -250,6 +274,7 @@ ssize_t nfc_i2c_dev_write(struct file *filp, const char __user *buf,
 {
 	int ret;
 	struct nfc_dev *nfc_dev = (struct nfc_dev *)filp->private_data;
+	ktime_t start;
 
 	if (count > MAX_DL_BUFFER_SIZE)
 		count = MAX_DL_BUFFER_SIZE;
@@ -263,7 +288,9 @@ ssize_t nfc_i2c_dev_write(struct file *filp, const char __user *buf,
 		mutex_unlock(&nfc_dev->write_mutex);
 		return -EFAULT;
 	}
+	start = nci_xport_write_begin(&nfc_dev->xport);
 	ret = i2c_write(nfc_dev, nfc_dev->write_kbuf, count, NO_RETRY);
+	nci_xport_write_end(&nfc_dev->xport, start);
 	mutex_unlock(&nfc_dev->write_mutex);
 	return ret;
 }
@@ -319,6 +346,10 @@ int nfc_i2c_dev_probe(struct i2c_client *client, const struct i2c_device_id *id)
 		ret = -ENOMEM;
 		goto err_free_read_kbuf;
 	}
+	ret = nci_xport_init(&nfc_dev->xport, dev_name(&client->dev),
+			     &i2c_xport_ops, &nfc_dev->read_wq, nfc_dev);
+	if (ret)
+		goto err_free_write_kbuf;
 	nfc_dev->interface = PLATFORM_IF_I2C;
 	nfc_dev->nfc_state = NFC_STATE_NCI;
 	nfc_dev->i2c_dev.client = client;
@@ -332,7 +363,7 @@ int nfc_i2c_dev_probe(struct i2c_client *client, const struct i2c_device_id *id)
 	if (ret) {
 		pr_err("%s: unable to request nfc reset gpio [%d]\n",
 			__func__, nfc_gpio->ven);
-		goto err_free_write_kbuf;
+		goto err_xport_deinit;
 	}
 	ret = configure_gpio(nfc_gpio->irq, GPIO_IRQ);
 	if (ret <= 0) {
@@ -420,6 +451,8 @@ err_free_dwl_req:
 	gpio_free(nfc_gpio->irq);
 err_free_ven:
 	gpio_free(nfc_gpio->ven);
+err_xport_deinit:
+	nci_xport_deinit(&nfc_dev->xport);
 err_free_write_kbuf:
 	kfree(nfc_dev->write_kbuf);
 err_free_read_kbuf:
@@ -476,6 +509,7 @@ int nfc_i2c_dev_remove(struct i2c_client *client)
 	if (gpio_is_valid(nfc_dev->configs.gpio.ven))
 		gpio_free(nfc_dev->configs.gpio.ven);
 
+	nci_xport_deinit(&nfc_dev->xport);
 	kfree(nfc_dev->read_kbuf);
 	kfree(nfc_dev->write_kbuf);
 	kfree(nfc_dev);
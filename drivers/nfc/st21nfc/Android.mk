@@ -6,4 +6,5 @@ LOCAL_MODULE := st21nfc.ko
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
 LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/mmi_info.ko
+LOCAL_ADDITIONAL_DEPENDENCIES += $(KERNEL_MODULES_OUT)/nci_xport.ko
 include $(DLKM_DIR)/AndroidKernelModule.mk
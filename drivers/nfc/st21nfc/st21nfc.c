@@ -35,6 +35,7 @@
 #include <linux/gpio.h>
 #include <linux/poll.h>
 #include <linux/miscdevice.h>
+#include <linux/nci_xport.h>
 #include <linux/spinlock.h>
 #include <linux/st21nfc.h>
 #include <linux/of_gpio.h>
@@ -96,6 +97,7 @@ struct st21nfc_dev {
 	struct	clk		*s_clk;
 	u8 *read_buf;
 	u8 *write_buf;
+	struct nci_xport xport;
 };
 
 /*
@@ -232,6 +234,7 @@ static irqreturn_t st21nfc_dev_irq_handler(int irq, void *dev_id)
 	if (device_may_wakeup(&st21nfc_dev->platform_data.client->dev))
 		pm_wakeup_event(&st21nfc_dev->platform_data.client->dev,
 			WAKEUP_SRC_TIMEOUT);
+	nci_xport_irq(&st21nfc_dev->xport);
 	st21nfc_disable_irq(st21nfc_dev);
 
 	/* Wake up waiting readers */
@@ -240,6 +243,53 @@ static irqreturn_t st21nfc_dev_irq_handler(int irq, void *dev_id)
 	return IRQ_HANDLED;
 }
 
+static int st21nfc_xport_recv(struct nci_xport *xp, u8 *buf, size_t len)
+{
+	struct st21nfc_dev *st21nfc_dev = xp->priv;
+	int ret;
+
+	ret = i2c_master_recv(st21nfc_dev->platform_data.client, buf, len);
+	if (ret < 0)
+		return ret;
+
+	return ret == len ? ret : -EIO;
+}
+
+static int st21nfc_xport_irq_level(struct nci_xport *xp)
+{
+	struct st21nfc_dev *st21nfc_dev = xp->priv;
+
+	return gpio_get_value(st21nfc_dev->platform_data.irq_gpio) > 0;
+}
+
+static bool st21nfc_xport_powered(struct nci_xport *xp)
+{
+	struct st21nfc_dev *st21nfc_dev = xp->priv;
+
+	/* Without a reset line the CLF is always on */
+	if (!st21nfc_dev->platform_data.reset_gpio)
+		return true;
+
+	return gpio_get_value(st21nfc_dev->platform_data.reset_gpio);
+}
+
+static void st21nfc_xport_enable_irq(struct nci_xport *xp)
+{
+	st21nfc_enable_irq(xp->priv);
+}
+
+static void st21nfc_xport_disable_irq(struct nci_xport *xp)
+{
+	st21nfc_disable_irq(xp->priv);
+}
+
+static const struct nci_xport_ops st21nfc_xport_ops = {
+	.recv = st21nfc_xport_recv,
+	.irq_level = st21nfc_xport_irq_level,
+	.powered = st21nfc_xport_powered,
+	.enable_irq = st21nfc_xport_enable_irq,
+	.disable_irq = st21nfc_xport_disable_irq,
+};
 
 static ssize_t st21nfc_dev_read(struct file *filp, char __user *buf,
 				size_t count, loff_t *offset)
@@ -248,43 +298,29 @@ static ssize_t st21nfc_dev_read(struct file *filp, char __user *buf,
 						       struct st21nfc_dev,
 						       st21nfc_device);
 	char *tmp = NULL;
-	int ret;
+	ssize_t ret;
 
 	if (count > MAX_BUFFER_SIZE)
 		count = MAX_BUFFER_SIZE;
 
-	tmp = st21nfc_dev->read_buf;
-	memset(tmp, 0x00, count);
-
 	pr_debug("reading %zu bytes.\n", count);
 
-	ret = gpio_get_value(st21nfc_dev->platform_data.irq_gpio);
-	if (ret <= 0) {
-		/* The CLF has nothing to send */
-		memset(tmp, 0x7E, count);
-		ret = count;
-	} else {
-		mutex_lock(&st21nfc_dev->platform_data.read_mutex);
-
-		/* Read data */
-		ret = i2c_master_recv(st21nfc_dev->platform_data.client, tmp, count);
-		mutex_unlock(&st21nfc_dev->platform_data.read_mutex);
-
-		if (ret < 0) {
-			pr_err("i2c_master_recv returned %d\n", ret);
-			return ret;
-		}
-		if (ret > count) {
-			pr_err("received too many bytes from i2c (%d)\n", ret);
-			return -EIO;
-		}
+	/* The HAL polls first, a read never waits for the CLF */
+	ret = nci_xport_read(&st21nfc_dev->xport, buf, count, true);
+	if (ret != -EAGAIN) {
+		if (ret < 0)
+			pr_err("nci_xport_read returned %zd\n", ret);
+		return ret;
 	}
 
-	if (copy_to_user(buf, tmp, ret)) {
+	/* The CLF has nothing to send */
+	tmp = st21nfc_dev->read_buf;
+	memset(tmp, 0x7E, count);
+	if (copy_to_user(buf, tmp, count)) {
 		pr_warn("failed to copy to user space\n");
 		return -EFAULT;
 	}
-	return ret;
+	return count;
 }
 
 #define MAX_RETRY_COUNT                        3
@@ -296,6 +332,7 @@ static ssize_t st21nfc_dev_write(struct file *filp, const char __user *buf,
 	char *tmp = NULL;
 	int ret = count;
 	int retry_cnt;
+	ktime_t start;
 
 	st21nfc_dev = container_of(filp->private_data,
 				   struct st21nfc_dev, st21nfc_device);
@@ -313,6 +350,7 @@ static ssize_t st21nfc_dev_write(struct file *filp, const char __user *buf,
 	}
 
 	pr_debug("writing %zu bytes.\n", count);
+	start = nci_xport_write_begin(&st21nfc_dev->xport);
 	/* Write data */
 	for (retry_cnt = 1; retry_cnt <= MAX_RETRY_COUNT; retry_cnt++) {
 			ret = i2c_master_send(st21nfc_dev->platform_data.client, tmp, count);
@@ -322,6 +360,7 @@ static ssize_t st21nfc_dev_write(struct file *filp, const char __user *buf,
 			} else if (ret == count)
 					break;
 	}
+	nci_xport_write_end(&st21nfc_dev->xport, start);
 	if (ret != count) {
 		pr_err("i2c_master_send returned %d instead of %zu\n", ret, count);
 		ret = -EIO;
@@ -450,6 +489,8 @@ static long st21nfc_dev_ioctl(struct file *filp, unsigned int cmd,
 			1);
 			msleep(20);
 			pr_info("done Double Pulse Request\n");
+			/* What was read before the reset is stale */
+			nci_xport_flush(&st21nfc_dev->xport);
 			if (st21nfc_st54spi_cb != 0)
 				(*st21nfc_st54spi_cb)(ST54SPI_CB_RESET_END,
 					st21nfc_st54spi_data);
@@ -512,6 +553,7 @@ static long st21nfc_dev_ioctl(struct file *filp, unsigned int cmd,
 		gpio_set_value(st21nfc_dev->platform_data.irq_gpio, 0);
 		msleep(20);
 		pr_info("Recovery procedure finished\n");
+		nci_xport_flush(&st21nfc_dev->xport);
 		ret = gpio_direction_input(st21nfc_dev->platform_data.irq_gpio);
 		if (ret) {
 			pr_err("gpio_direction_input failed\n");
@@ -547,7 +589,7 @@ static unsigned int st21nfc_poll(struct file *file, poll_table *wait)
 	/* wait for Wake_up_pin == high  */
 	poll_wait(file, &st21nfc_dev->read_wq, wait);
 
-	pinlev = gpio_get_value(st21nfc_dev->platform_data.irq_gpio);
+	pinlev = nci_xport_has_data(&st21nfc_dev->xport);
 
 	if (pinlev > 0) {
 		pr_debug("return ready\n");
@@ -862,6 +904,13 @@ static int st21nfc_probe(struct i2c_client *client,
 	init_waitqueue_head(&st21nfc_dev->read_wq);
 	mutex_init(&st21nfc_dev->platform_data.read_mutex);
 	spin_lock_init(&st21nfc_dev->irq_enabled_lock);
+	ret = nci_xport_init(&st21nfc_dev->xport, dev_name(&client->dev),
+			     &st21nfc_xport_ops, &st21nfc_dev->read_wq,
+			     st21nfc_dev);
+	if (ret) {
+		pr_err("nci_xport_init failed\n");
+		goto err_xport_init;
+	}
 	pr_debug("debug irq_gpio = %d, client-irq =  %d\n", platform_data->irq_gpio, client->irq);
 	st21nfc_dev->st21nfc_device.minor = MISC_DYNAMIC_MINOR;
 	st21nfc_dev->st21nfc_device.name = "st21nfc";
@@ -984,6 +1033,8 @@ static int st21nfc_probe(struct i2c_client *client,
 err_request_irq_failed:
 	misc_deregister(&st21nfc_dev->st21nfc_device);
 err_misc_register:
+	nci_xport_deinit(&st21nfc_dev->xport);
+err_xport_init:
 	mutex_destroy(&st21nfc_dev->platform_data.read_mutex);
 err_reset_gpio:
 	if (gpio_is_valid(platform_data->reset_gpio))
@@ -1016,6 +1067,7 @@ static void st21nfc_remove(struct i2c_client *client)
 	st_clock_deselect(st21nfc_dev);
 	free_irq(client->irq, st21nfc_dev);
 	misc_deregister(&st21nfc_dev->st21nfc_device);
+	nci_xport_deinit(&st21nfc_dev->xport);
 	mutex_destroy(&st21nfc_dev->platform_data.read_mutex);
 	if (gpio_is_valid(st21nfc_dev->platform_data.reset_gpio))
 		gpio_free(st21nfc_dev->platform_data.reset_gpio);
@@ -10,4 +10,5 @@ else
 LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
 endif
 LOCAL_ADDITIONAL_DEPENDENCIES := $(KERNEL_MODULES_OUT)/mmi_info.ko
+LOCAL_ADDITIONAL_DEPENDENCIES += $(KERNEL_MODULES_OUT)/mmi_qcom_minidump.ko
 include $(DLKM_DIR)/AndroidKernelModule.mk
@@ -18,7 +18,10 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/string.h>
 #include <linux/types.h>
 #include <linux/uaccess.h>
@@ -31,6 +34,7 @@
 #include <soc/qcom/memory_dump.h>
 #include <soc/qcom/mmi_boot_info.h>
 #include <linux/mmi_annotate.h>
+#include <linux/mmi_crash_bundle.h>
 #include <linux/version.h>
 
 /* Check memory_dump.h to verify this is not going over the max or
@@ -50,6 +54,9 @@
 #define TZBSP_NONCE_LEN 12
 #define TZBSP_TAG_LEN 16
 
+/* Annotations are formatted in a 512 byte buffer */
+#define TZLOG_ANNOTATE_CHUNK 480
+
 struct tzdbg_vmid_t {
 	uint8_t vmid;
 	uint8_t desc[TZBSP_DIAG_VMID_DESC_LEN];
@@ -123,7 +130,16 @@ struct tz_dump_platform_data {
 	size_t		mem_size;
 };
 
+/* Decoded text of the dump, kept for procfs once the region is cleared */
+struct tzlog_text {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
 static struct tzdbg_t *tzdbg_data;
+static struct tzlog_text tzlog;
+static struct proc_dir_entry *procfs_file;
 
 #define MSMDBG(fmt, args...) mmi_annotate(fmt, ##args)
 
@@ -132,24 +148,50 @@ static struct tzdbg_t *tzdbg_data;
 		MSMDBG(fmt, ##args); \
 } while (0)
 
-static void tzlog_dump_show_boot_info(void)
+static __printf(1, 2) void tzlog_printf(const char *fmt, ...)
 {
-	int cpu;
+	va_list args;
+
+	if (tzlog.len + 1 >= tzlog.size)
+		return;
+
+	va_start(args, fmt);
+	tzlog.len += vscnprintf(tzlog.buf + tzlog.len, tzlog.size - tzlog.len,
+			fmt, args);
+	va_end(args);
+}
+
+static void tzlog_write(const char *s, size_t n)
+{
+	n = min(n, tzlog.size - tzlog.len - 1);
+	memcpy(tzlog.buf + tzlog.len, s, n);
+	tzlog.len += n;
+	tzlog.buf[tzlog.len] = 0;
+}
+
+static void tzlog_dump_show_boot_info(const struct tzdbg_t *tz, size_t size)
+{
+	int cpu, cpu_count;
 	int power_collapsed;
-	struct tzdbg_boot_info_t *ptr;
+	const struct tzdbg_boot_info_t *ptr;
+
+	cpu_count = min_t(u32, tz->cpu_count, TZBSP_MAX_CPU_COUNT);
+	if (tz->boot_info_off > size ||
+	    size - tz->boot_info_off < cpu_count * sizeof(*ptr))
+		return;
 
-	ptr = (struct tzdbg_boot_info_t *)
-			((u8 *)tzdbg_data + tzdbg_data->boot_info_off);
+	ptr = (const struct tzdbg_boot_info_t *)
+			((const u8 *)tz + tz->boot_info_off);
 
-	MSMWDTD_IFWDOG("\n--- TZ Power Collapse Counters\n");
-	MSMWDTD_IFWDOG("     | WarmEntry : WarmExit : TermEntry :");
-	MSMWDTD_IFWDOG(" TermExit : PsciEntry : PsciExit : JumpAddr |\n");
-	for (cpu = 0; cpu < tzdbg_data->cpu_count; cpu++) {
+	tzlog_printf("\n--- TZ Power Collapse Counters\n"
+		"     | WarmEntry : WarmExit : TermEntry :"
+		" TermExit : PsciEntry : PsciExit : JumpAddr |\n");
+	for (cpu = 0; cpu < cpu_count; cpu++) {
 		power_collapsed = ptr->wb_entry_cnt +
 				ptr->pc_exit_cnt - ptr->pc_entry_cnt;
 		if (cpu)
 			power_collapsed--;
-		MSMWDTD_IFWDOG("CPU%d |  %8x : %8x : %8x : %8x : %8x : %8x :      "
+		tzlog_printf("CPU%d |  %8x : %8x : %8x : %8x : %8x : %8x :      "
 			"%llx | %sPC\n",
 			cpu,
 			ptr->wb_entry_cnt,
@@ -164,51 +206,145 @@ static void tzlog_dump_show_boot_info(void)
 	}
 }
 
-static void tzlog_dump_show_log(void)
+/*
+ * Copy the runs of printable characters of the ring, each run ends
+ * a line. in_line carries an open line over the wrap point.
+ */
+static void tzlog_decode_ring(const char *p, size_t len, bool *in_line)
 {
-	struct tzdbg_log_t *log_ptr;
-	const char *log_buf, *p, *start;
+	const char *end = p + len, *run;
+
+	while (p < end) {
+		for (run = p; p < end && isprint(*p); p++)
+			;
+		if (p > run) {
+			tzlog_write(run, p - run);
+			*in_line = true;
+		}
+
+		for (; p < end && !isprint(*p); p++) {
+			if (*in_line) {
+				tzlog_write("\n", 1);
+				*in_line = false;
+			}
+		}
+	}
+}
 
-	log_buf = (const char *)tzdbg_data + tzdbg_data->ring_off;
-	log_ptr = (struct tzdbg_log_t *)(log_buf -
+static void tzlog_dump_show_log(const struct tzdbg_t *tz, size_t size)
+{
+	const struct tzdbg_log_t *log_ptr;
+	const char *log_buf;
+	bool in_line = false;
+
+	if (tz->ring_off < offsetof(struct tzdbg_log_t, log_buf) ||
+	    tz->ring_off > size || tz->ring_len > size - tz->ring_off)
+		return;
+
+	log_buf = (const char *)tz + tz->ring_off;
+	log_ptr = (const struct tzdbg_log_t *)(log_buf -
 				offsetof(struct tzdbg_log_t, log_buf));
 
-	if (log_ptr->log_pos.offset >= tzdbg_data->ring_len)
+	if (log_ptr->log_pos.offset >= tz->ring_len)
 		return;
-	MSMWDTD_IFWDOG("--- TZ Log start ---\n");
-	if (log_ptr->log_pos.wrap) {
-		for (start = log_buf + log_ptr->log_pos.offset, p = start;
-				p < (log_buf + tzdbg_data->ring_len); p++) {
-			if (isprint(*p))
-				MSMWDTD_IFWDOG("%c", *p);
-			else if ((p > start) && isprint(*(p-1)))
-				MSMWDTD_IFWDOG("\n");
-		}
+	tzlog_printf("--- TZ Log start ---\n");
+	if (log_ptr->log_pos.wrap)
+		tzlog_decode_ring(log_buf + log_ptr->log_pos.offset,
+			tz->ring_len - log_ptr->log_pos.offset, &in_line);
+	tzlog_decode_ring(log_buf, log_ptr->log_pos.offset, &in_line);
+	tzlog_printf("\n--- TZ Log end ---\n");
+}
+
+/*
+ * Decode a copy of the dump region into tzlog, the region is device
+ * memory and only read once in bulk
+ */
+static int tzlog_dump_decode(size_t size)
+{
+	struct tzdbg_t *tz;
+
+	tzlog.size = size * 2 + PAGE_SIZE;
+	tzlog.buf = vmalloc(tzlog.size);
+	tz = vmalloc(size);
+	if (!tzlog.buf || !tz) {
+		vfree(tzlog.buf);
+		vfree(tz);
+		tzlog.buf = NULL;
+		tzlog.size = 0;
+		return -ENOMEM;
 	}
-	for (start = log_buf, p = start;
-			p < (log_buf + log_ptr->log_pos.offset); p++) {
-		if (isprint(*p))
-			MSMWDTD_IFWDOG("%c", *p);
-		else if ((p > start) && isprint(*(p-1)))
-			MSMWDTD_IFWDOG("\n");
+
+	memcpy_fromio(tz, (const void __iomem *)tzdbg_data, size);
+	tzlog.len = 0;
+	tzlog.buf[0] = 0;
+
+	if (tz->magic_num != TZBSP_MAGIC_NUMBER) {
+		tzlog_printf("No valid backup\n");
+	} else {
+		tzlog_dump_show_boot_info(tz, size);
+		tzlog_dump_show_log(tz, size);
 	}
-	MSMWDTD_IFWDOG("\n--- TZ Log end ---\n");
+
+	vfree(tz);
+	return 0;
 }
 
+/* Annotate the decoded text in as few chunks of whole lines as fit */
 static int tzlog_dump_annotate(void)
 {
-	if (!tzdbg_data ||
-		tzdbg_data->magic_num != TZBSP_MAGIC_NUMBER) {
+	const char *p = tzlog.buf, *end = tzlog.buf + tzlog.len, *cut, *nl;
+
+	if (!tzdbg_data || !tzlog.buf) {
 		MSMWDTD_IFWDOG("No valid backup\n");
 		return 0;
 	}
 
-	tzlog_dump_show_boot_info();
-	tzlog_dump_show_log();
+	if (bi_powerup_reason() != PU_REASON_WDOG_AP_RESET)
+		return 0;
+
+	while (p < end) {
+		cut = p + min_t(size_t, end - p, TZLOG_ANNOTATE_CHUNK);
+		if (cut < end) {
+			for (nl = cut; nl > p && nl[-1] != '\n'; nl--)
+				;
+			if (nl > p)
+				cut = nl;
+		}
+		MSMDBG("%.*s", (int)(cut - p), p);
+		p = cut;
+	}
 
 	return 0;
 }
 
+static int tzlog_dump_seq_show(struct seq_file *f, void *ptr)
+{
+	if (tzlog.buf)
+		seq_write(f, tzlog.buf, tzlog.len);
+	return 0;
+}
+
+static int tzlog_dump_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tzlog_dump_seq_show, NULL);
+}
+
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+static const struct proc_ops tzlog_dump_operations = {
+	.proc_open		= tzlog_dump_open,
+	.proc_read		= seq_read,
+	.proc_lseek		= seq_lseek,
+	.proc_release	= single_release,
+};
+#else
+static const struct file_operations tzlog_dump_operations = {
+	.open		= tzlog_dump_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static void tzlog_dump_table_register(struct device *dev,
 	struct tz_dump_platform_data *pdata)
 {
@@ -286,6 +422,8 @@ static int tzlog_dump_probe(struct platform_device *pdev)
 	}
 
 	tzlog_dump_table_register(dev, pdata);
+	mmi_crash_region_add("TZLOG", NULL, pdata->mem_address,
+			pdata->mem_size, MMI_CRASH_PRIO_NORMAL);
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,4,0)
 	tzdbg_data = ioremap_wc(pdata->mem_address, pdata->mem_size);
@@ -301,14 +439,24 @@ static int tzlog_dump_probe(struct platform_device *pdev)
 		goto err;
 	}
 
+	tzlog_dump_decode(pdata->mem_size);
 	tzlog_dump_annotate();
 	memset_io(tzdbg_data, 0, pdata->mem_size);
+
+	/* Create the procfs file at /proc/driver/tzlog_dump */
+	procfs_file = proc_create("driver/tzlog_dump",
+		0444, NULL, &tzlog_dump_operations);
 err:
 	return err;
 }
 
 static int tzlog_dump_remove(struct platform_device *pdev)
 {
+	mmi_crash_region_remove("TZLOG");
+	if (procfs_file)
+		remove_proc_entry("driver/tzlog_dump", NULL);
+	vfree(tzlog.buf);
+	tzlog.buf = NULL;
 	return 0;
 }
 
@@ -50,6 +50,17 @@ ifeq ($(TCPC_RT1711H),true)
 	include $(DLKM_DIR)/AndroidKernelModule.mk
 endif
 
+ifeq ($(TCPC_VSIM),true)
+	KERNEL_CFLAGS += CONFIG_TCPC_VSIM=y
+	KBUILD_OPTIONS += CONFIG_TCPC_VSIM=y
+
+	include $(CLEAR_VARS)
+	LOCAL_MODULE_TAGS := optional
+	LOCAL_MODULE := tcpc_vsim.ko
+	LOCAL_MODULE_PATH := $(KERNEL_MODULES_OUT)
+	include $(DLKM_DIR)/AndroidKernelModule.mk
+endif
+
 #ifeq ($(TCPC_CLASS),true)
 #	KERNEL_CFLAGS += CONFIG_TCPC_CLASS=y
 #	KBUILD_OPTIONS += CONFIG_TCPC_CLASS=y
@@ -426,12 +426,25 @@ struct tcpc_device {
 #endif /* CONFIG_DUAL_ROLE_USB_INTF */
 
 #ifdef CONFIG_USB_POWER_DELIVERY
-	/* Event */
+	/* Event, the ring is guarded by pd_event_lock, not access_lock */
+	spinlock_t pd_event_lock;
 	uint8_t pd_event_count;
 	uint8_t pd_event_head_index;
+	uint8_t pd_event_max_depth;	/* high watermark of pd_event_count */
 	uint8_t pd_msg_buffer_allocated;
+	uint32_t pd_event_overflow;
+	uint32_t pd_event_dequeued;
+	uint32_t pd_event_latency_max_us;	/* put to policy engine get */
+	uint64_t pd_event_latency_total_us;
+	uint32_t timer_start_count;	/* under timer_lock */
 
 	uint8_t pd_last_vdm_msg_id;
+	/*
+	 * pd_pending_vdm_event and pd_vdm_event are written under both
+	 * access_lock and pd_vdm_lock, pd_postpone_vdm_timeout under
+	 * pd_vdm_lock
+	 */
+	spinlock_t pd_vdm_lock;
 	bool pd_pending_vdm_event;
 	bool pd_pending_vdm_reset;
 	bool pd_pending_vdm_good_crc;
@@ -445,6 +458,7 @@ struct tcpc_device {
 
 	struct pd_msg pd_msg_buffer[PD_MSG_BUF_SIZE];
 	struct pd_event pd_event_ring_buffer[PD_EVENT_BUF_SIZE];
+	ktime_t pd_event_ts[PD_EVENT_BUF_SIZE];
 
 	uint8_t tcp_event_count;
 	uint8_t tcp_event_head_index;
@@ -3,6 +3,7 @@
  * Copyright (c) 2020 MediaTek Inc.
  */
 
+#include <linux/atomic.h>
 #include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/err.h>
@@ -10,11 +11,14 @@
 #include <linux/i2c.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/semaphore.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/sysfs.h>
 #include <linux/uaccess.h>
@@ -25,6 +29,10 @@
 
 #define ERR_MSG_SIZE		128
 #define MAX_BYTE_SIZE		32
+/* Widest address span served by the direct mapped index */
+#define RT_INDEX_MAX_SPAN	1024
+/* Time one lookup out of this many, a power of 2 */
+#define RT_INDEX_SAMPLE		64
 
 struct rt_regmap_ops {
 	int (*regmap_block_write)(struct rt_regmap_device *rd, u32 reg,
@@ -47,6 +55,7 @@ enum {
 	RT_DBG_IO_LOG,
 	RT_DBG_CACHE_MODE,
 	RT_DBG_REG_SIZE,
+	RT_DBG_INDEX_STATS,
 	RT_DBG_MAX,
 };
 
@@ -91,6 +100,18 @@ struct rt_regmap_device {
 	unsigned char error_occurred:1;
 	unsigned char regval[MAX_BYTE_SIZE];
 
+	/* index of every address in [rio_base, rio_base + rio_len) */
+	struct reg_index_offset *rio_map;
+	u32 rio_base;
+	u32 rio_len;
+	/* lookups run with and without the semaphore held */
+	atomic64_t lookups;
+	atomic64_t lookup_misses;
+	spinlock_t lookup_lock;	/* the sampled timings below */
+	u64 lookup_samples;
+	u64 lookup_ns;
+	u64 lookup_max_ns;
+
 	int (*rt_block_write[4])(struct rt_regmap_device *rd,
 				 const struct rt_register *rm, int size,
 				 const unsigned char *wdata, int count,
@@ -105,7 +126,7 @@ struct rt_regmap_device {
 #endif /* CONFIG_DEBUG_FS */
 };
 
-static struct reg_index_offset find_register_index(
+static struct reg_index_offset scan_register_index(
 		const struct rt_regmap_device *rd, u32 reg)
 {
 	int i = 0, j = 0, unit = RT_1BYTE_MODE;
@@ -135,6 +156,66 @@ static struct reg_index_offset find_register_index(
 	return rio;
 }
 
+static struct reg_index_offset find_register_index(
+		struct rt_regmap_device *rd, u32 reg)
+{
+	struct reg_index_offset rio = {-1, -1};
+	bool sample = !(atomic64_inc_return(&rd->lookups) &
+			(RT_INDEX_SAMPLE - 1));
+	unsigned long flags;
+	u64 start = 0, ns = 0;
+
+	if (sample)
+		start = ktime_get_ns();
+
+	if (!rd->rio_map)
+		rio = scan_register_index(rd, reg);
+	else if (reg - rd->rio_base < rd->rio_len)
+		rio = rd->rio_map[reg - rd->rio_base];
+
+	if (rio.index < 0)
+		atomic64_inc(&rd->lookup_misses);
+	if (sample) {
+		ns = ktime_get_ns() - start;
+		spin_lock_irqsave(&rd->lookup_lock, flags);
+		rd->lookup_samples++;
+		rd->lookup_ns += ns;
+		if (ns > rd->lookup_max_ns)
+			rd->lookup_max_ns = ns;
+		spin_unlock_irqrestore(&rd->lookup_lock, flags);
+	}
+	return rio;
+}
+
+/* Resolve every address of the map once, lookups become a table read */
+static void rt_regmap_index_init(struct rt_regmap_device *rd)
+{
+	const rt_register_map_t *rm = rd->props.rm;
+	u32 lo = U32_MAX, hi = 0, reg = 0;
+	int i = 0;
+
+	for (i = 0; i < rd->props.register_num; i++) {
+		lo = min(lo, rm[i]->addr);
+		hi = max(hi, rm[i]->addr + max(rm[i]->size, 1U));
+	}
+
+	if (lo >= hi || hi - lo > RT_INDEX_MAX_SPAN) {
+		dev_info(&rd->dev, "%s span too wide, scan the map\n",
+			 __func__);
+		return;
+	}
+
+	rd->rio_map = devm_kcalloc(&rd->dev, hi - lo, sizeof(*rd->rio_map),
+				   GFP_KERNEL);
+	if (!rd->rio_map)
+		return;
+
+	for (reg = lo; reg < hi; reg++)
+		rd->rio_map[reg - lo] = scan_register_index(rd, reg);
+	rd->rio_base = lo;
+	rd->rio_len = hi - lo;
+}
+
 static int rt_chip_block_write(struct rt_regmap_device *rd, u32 reg,
 				int bytes, const void *src);
 
@@ -845,6 +926,8 @@ static int rt_regmap_cache_init(struct rt_regmap_device *rd)
 		}
 	}
 
+	rt_regmap_index_init(rd);
+
 	pr_info("%s successfully\n", __func__);
 out:
 	up(&rd->semaphore);
@@ -1016,6 +1099,8 @@ static int general_read(struct seq_file *seq_file, void *_data)
 	struct rt_debug_st *st = seq_file->private;
 	struct rt_regmap_device *rd = st->info;
 	unsigned char data = 0;
+	u64 samples, total_ns, max_ns;
+	unsigned long flags;
 
 	switch (st->id) {
 	case RT_DBG_REG_ADDR:
@@ -1101,6 +1186,27 @@ static int general_read(struct seq_file *seq_file, void *_data)
 		size = rt_get_regsize(rd, rd->dbg_data.reg_addr);
 		seq_printf(seq_file, "%d\n", size);
 		break;
+	case RT_DBG_INDEX_STATS:
+		down(&rd->semaphore);
+		if (rd->rio_map)
+			seq_printf(seq_file, "index: direct 0x%02x-0x%02x\n",
+				   rd->rio_base, rd->rio_base + rd->rio_len - 1);
+		else
+			seq_printf(seq_file, "index: scan %d registers\n",
+				   rd->props.register_num);
+		up(&rd->semaphore);
+		seq_printf(seq_file, "lookups: %lld misses: %lld\n",
+			   (long long)atomic64_read(&rd->lookups),
+			   (long long)atomic64_read(&rd->lookup_misses));
+		spin_lock_irqsave(&rd->lookup_lock, flags);
+		samples = rd->lookup_samples;
+		total_ns = rd->lookup_ns;
+		max_ns = rd->lookup_max_ns;
+		spin_unlock_irqrestore(&rd->lookup_lock, flags);
+		seq_printf(seq_file, "sampled: %llu avg: %llu ns max: %llu ns\n",
+			   samples, samples ? div64_u64(total_ns, samples) : 0,
+			   max_ns);
+		break;
 	}
 	return 0;
 }
@@ -1284,6 +1390,7 @@ static int rt_create_general_debug(struct rt_regmap_device *rd,
 	RT_CREATE_GENERAL_FILE(RT_DBG_IO_LOG, "io_log", 0444);
 	RT_CREATE_GENERAL_FILE(RT_DBG_CACHE_MODE, "cache_mode", 0444);
 	RT_CREATE_GENERAL_FILE(RT_DBG_REG_SIZE, "reg_size", 0444);
+	RT_CREATE_GENERAL_FILE(RT_DBG_INDEX_STATS, "index_stats", 0444);
 
 	return 0;
 }
@@ -1515,6 +1622,7 @@ struct rt_regmap_device *rt_regmap_device_register_ex
 	dev_set_drvdata(&rd->dev, drvdata);
 	rd->client = client;
 	sema_init(&rd->semaphore, 1);
+	spin_lock_init(&rd->lookup_lock);
 	sema_init(&rd->write_mode_lock, 1);
 	INIT_DELAYED_WORK(&rd->rt_work, rt_work_func);
 	rd->dev_addr = dev_addr;
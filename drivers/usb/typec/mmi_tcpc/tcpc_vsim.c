@@ -0,0 +1,843 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * Virtual TCPC with a scripted PD source on the far end
+ *
+ * Registers a tcpc_device whose ops are backed by memory instead of a
+ * chip, so the real Type-C state machine and policy engine run against
+ * a port partner that always behaves the same way: Rp 3.0A on CC1,
+ * VBUS after vbus_on_ms, Source_Capabilities after first_caps_ms,
+ * Accept then PS_RDY after src_transition_ms for every Request, and an
+ * optional partner hard reset hard_reset_ms after the first contract.
+ * Structured VDM requests are NAKed, the partner has no alternate mode,
+ * so a DUT acting as DFP finishes discovery instead of timing out.
+ * PDOs, PPS APDOs included, are written as hex words to "pdos".
+ *
+ *   echo 1 > /sys/kernel/debug/tcpc_vsim/attach
+ *   cat /sys/kernel/debug/tcpc_vsim/stats
+ *
+ * The stats give the attach to PE_READY time, the pd event queue high
+ * watermark and latency to the policy engine, and how many PD/Type-C
+ * timers were started per attach.
+ * The node takes the usual pd-data and dpm_caps children, which is
+ * where the sink PDOs of the device under test come from.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+
+#include "inc/pd_dbg_info.h"
+#include "inc/tcpci.h"
+#include "inc/tcpci_event.h"
+#include "inc/pd_core.h"
+
+#define VSIM_DRV_VERSION	"1.0.0_MMI"
+
+#define VSIM_REPLY_MS		(1)	/* GoodCRC plus tReceive */
+#define VSIM_HRESET_VBUS_OFF_MS	(30)	/* tPSHardReset */
+#define VSIM_SRC_RECOVER_MS	(700)	/* tSrcRecover */
+
+enum vsim_step {
+	VSIM_STEP_NONE,
+	VSIM_STEP_VBUS_ON,
+	VSIM_STEP_SRC_CAP,
+	VSIM_STEP_ACCEPT,
+	VSIM_STEP_PS_RDY,
+	VSIM_STEP_VDM_NAK,
+	VSIM_STEP_HARD_RESET,
+	VSIM_STEP_VBUS_OFF,
+};
+
+struct vsim_stats {
+	u32 attaches;
+	u32 contracts;
+	u32 hard_resets;
+	u32 tx_msgs;
+	u32 rx_msgs;
+	u32 rx_dropped;
+	u32 vdm_naks;
+	u64 last_contract_us;
+	u64 min_contract_us;
+	u64 max_contract_us;
+	u32 max_event_depth;
+	u32 timer_starts;
+	u32 event_latency_max_us;
+};
+
+struct vsim_chip {
+	struct device *dev;
+	struct tcpc_desc *tcpc_desc;
+	struct tcpc_device *tcpc;
+	struct notifier_block pd_nb;
+	struct dentry *dir;
+
+	struct mutex lock; /* emulated registers and partner state */
+	struct work_struct alert_work;
+	struct delayed_work script_work;
+
+	/* Emulated TCPC */
+	uint32_t alert;
+	uint32_t alert_mask;
+	int cc_pull;
+	int polarity;
+	uint8_t rx_enable;
+	bool rx_valid;
+	uint16_t rx_hdr;
+	uint32_t rx_data[PD_DATA_OBJ_SIZE];
+
+	/* Port partner */
+	bool attached;
+	bool vbus;
+	bool hard_reset_done;
+	uint8_t msg_id;
+	enum vsim_step step;
+	enum vsim_step follow;
+	u32 follow_ms;
+	u32 pdos[PD_DATA_OBJ_SIZE];
+	u32 nr_pdos;
+	u32 vbus_on_ms;
+	u32 first_caps_ms;
+	u32 src_transition_ms;
+	u32 hard_reset_ms;
+	u32 last_rdo;
+	u32 vdm_reply;
+
+	ktime_t attach_ts;
+	u32 timer_base;
+	struct vsim_stats stats;
+};
+
+static void vsim_schedule(struct vsim_chip *chip, enum vsim_step step,
+			  u32 ms)
+{
+	chip->step = step;
+	mod_delayed_work(system_wq, &chip->script_work, msecs_to_jiffies(ms));
+}
+
+static void vsim_raise(struct vsim_chip *chip, uint32_t alert)
+{
+	chip->alert |= alert;
+	schedule_work(&chip->alert_work);
+}
+
+static void vsim_send(struct vsim_chip *chip, uint8_t type,
+		      const u32 *data, u32 cnt)
+{
+	if (!chip->attached)
+		return;
+
+	if (!chip->rx_enable || chip->rx_valid) {
+		chip->stats.rx_dropped++;
+		return;
+	}
+
+	chip->rx_hdr = PD_HEADER_SOP(type, PD_REV30, PD_ROLE_SOURCE,
+				     PD_ROLE_DFP, chip->msg_id, cnt, 0);
+	if (cnt)
+		memcpy(chip->rx_data, data, cnt * sizeof(u32));
+	chip->msg_id = (chip->msg_id + 1) & 0x7;
+	chip->rx_valid = true;
+	chip->stats.rx_msgs++;
+	vsim_raise(chip, TCPC_REG_ALERT_RX_STATUS);
+}
+
+static void vsim_alert_work(struct work_struct *work)
+{
+	struct vsim_chip *chip = container_of(work, struct vsim_chip,
+					      alert_work);
+
+	tcpci_lock_typec(chip->tcpc);
+	tcpci_alert(chip->tcpc);
+	tcpci_unlock_typec(chip->tcpc);
+}
+
+static void vsim_script_work(struct work_struct *work)
+{
+	struct vsim_chip *chip = container_of(to_delayed_work(work),
+					      struct vsim_chip, script_work);
+	enum vsim_step step;
+
+	mutex_lock(&chip->lock);
+	step = chip->step;
+	chip->step = VSIM_STEP_NONE;
+
+	switch (step) {
+	case VSIM_STEP_VBUS_ON:
+		chip->vbus = true;
+		chip->msg_id = 0;
+		vsim_raise(chip, TCPC_REG_ALERT_POWER_STATUS);
+		vsim_schedule(chip, VSIM_STEP_SRC_CAP, chip->first_caps_ms);
+		break;
+	case VSIM_STEP_SRC_CAP:
+		vsim_send(chip, PD_DATA_SOURCE_CAP, chip->pdos, chip->nr_pdos);
+		break;
+	case VSIM_STEP_ACCEPT:
+		vsim_send(chip, PD_CTRL_ACCEPT, NULL, 0);
+		if (chip->follow != VSIM_STEP_NONE)
+			vsim_schedule(chip, chip->follow, chip->follow_ms);
+		chip->follow = VSIM_STEP_NONE;
+		break;
+	case VSIM_STEP_PS_RDY:
+		vsim_send(chip, PD_CTRL_PS_RDY, NULL, 0);
+		break;
+	case VSIM_STEP_VDM_NAK:
+		chip->stats.vdm_naks++;
+		vsim_send(chip, PD_DATA_VENDOR_DEF, &chip->vdm_reply, 1);
+		break;
+	case VSIM_STEP_HARD_RESET:
+		chip->stats.hard_resets++;
+		chip->hard_reset_done = true;
+		chip->msg_id = 0;
+		vsim_raise(chip, TCPC_REG_ALERT_RX_HARD_RST);
+		vsim_schedule(chip, VSIM_STEP_VBUS_OFF,
+			      VSIM_HRESET_VBUS_OFF_MS);
+		break;
+	case VSIM_STEP_VBUS_OFF:
+		chip->vbus = false;
+		vsim_raise(chip, TCPC_REG_ALERT_POWER_STATUS);
+		vsim_schedule(chip, VSIM_STEP_VBUS_ON, VSIM_SRC_RECOVER_MS);
+		break;
+	default:
+		break;
+	}
+
+	mutex_unlock(&chip->lock);
+}
+
+/* Source side of a message sent by the device under test */
+static void vsim_partner_recv(struct vsim_chip *chip, uint16_t header,
+			      const uint32_t *data)
+{
+	uint8_t type = PD_HEADER_TYPE(header);
+
+	if (PD_HEADER_CNT(header)) {
+		switch (type) {
+		case PD_DATA_REQUEST:
+			chip->last_rdo = data[0];
+			chip->follow = VSIM_STEP_PS_RDY;
+			chip->follow_ms = chip->src_transition_ms;
+			vsim_schedule(chip, VSIM_STEP_ACCEPT, VSIM_REPLY_MS);
+			break;
+		case PD_DATA_VENDOR_DEF:
+			/* Discover Identity/SVIDs/Modes, Enter Mode... */
+			if (!PD_VDO_SVDM(data[0]) ||
+			    PD_VDO_CMDT(data[0]) != CMDT_INIT ||
+			    PD_VDO_CMD(data[0]) == CMD_ATTENTION)
+				break;
+			chip->vdm_reply = VDO_REPLY(SVDM_REV20, CMDT_RSP_NAK,
+						    data[0]);
+			vsim_schedule(chip, VSIM_STEP_VDM_NAK, VSIM_REPLY_MS);
+			break;
+		default:
+			/* Unstructured VDMs and the rest are left unanswered */
+			break;
+		}
+		return;
+	}
+
+	switch (type) {
+	case PD_CTRL_SOFT_RESET:
+		chip->msg_id = 0;
+		chip->follow = VSIM_STEP_SRC_CAP;
+		chip->follow_ms = VSIM_REPLY_MS;
+		vsim_schedule(chip, VSIM_STEP_ACCEPT, VSIM_REPLY_MS);
+		break;
+	case PD_CTRL_GET_SOURCE_CAP:
+		vsim_schedule(chip, VSIM_STEP_SRC_CAP, VSIM_REPLY_MS);
+		break;
+	default:
+		break;
+	}
+}
+
+static int vsim_init(struct tcpc_device *tcpc, bool sw_reset)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	chip->alert = 0;
+	chip->rx_enable = 0;
+	chip->rx_valid = false;
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_init_alert_mask(struct tcpc_device *tcpc)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	chip->alert_mask = TCPC_REG_ALERT_CC_STATUS |
+			   TCPC_REG_ALERT_POWER_STATUS |
+			   TCPC_REG_ALERT_TXRX_MASK |
+			   TCPC_REG_ALERT_RX_HARD_RST;
+	return 0;
+}
+
+static int vsim_alert_status_clear(struct tcpc_device *tcpc, uint32_t mask)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	chip->alert &= ~mask;
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_fault_status_clear(struct tcpc_device *tcpc, uint8_t status)
+{
+	return 0;
+}
+
+static int vsim_set_alert_mask(struct tcpc_device *tcpc, uint32_t mask)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	chip->alert_mask = mask;
+	return 0;
+}
+
+static int vsim_get_alert_mask(struct tcpc_device *tcpc, uint32_t *mask)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	*mask = chip->alert_mask;
+	return 0;
+}
+
+static int vsim_get_alert_status(struct tcpc_device *tcpc, uint32_t *alert)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	*alert = chip->alert;
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_get_power_status(struct tcpc_device *tcpc,
+				 uint16_t *pwr_status)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	*pwr_status = chip->vbus ? TCPC_REG_POWER_STATUS_VBUS_PRES : 0;
+	return 0;
+}
+
+static int vsim_get_fault_status(struct tcpc_device *tcpc, uint8_t *status)
+{
+	*status = 0;
+	return 0;
+}
+
+static int vsim_get_cc(struct tcpc_device *tcpc, int *cc1, int *cc2)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	/* The partner is a source, so it is only seen through Rd */
+	*cc1 = TYPEC_CC_VOLT_OPEN;
+	*cc2 = TYPEC_CC_VOLT_OPEN;
+	if (chip->attached &&
+	    TYPEC_CC_PULL_GET_RES(chip->cc_pull) == TYPEC_CC_RD)
+		*cc1 = TYPEC_CC_VOLT_SNK_3_0;
+	return 0;
+}
+
+static int vsim_set_cc(struct tcpc_device *tcpc, int pull)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	/* DRP toggling settles on Rd right away against a source */
+	if (TYPEC_CC_PULL_GET_RES(pull) == TYPEC_CC_DRP)
+		pull = TYPEC_CC_RD;
+	chip->cc_pull = pull;
+	return 0;
+}
+
+static int vsim_set_polarity(struct tcpc_device *tcpc, int polarity)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	chip->polarity = polarity;
+	return 0;
+}
+
+static int vsim_set_low_rp_duty(struct tcpc_device *tcpc, bool low_rp)
+{
+	return 0;
+}
+
+static int vsim_set_vconn(struct tcpc_device *tcpc, int enable)
+{
+	return 0;
+}
+
+static int vsim_deinit(struct tcpc_device *tcpc)
+{
+	return 0;
+}
+
+static int vsim_set_msg_header(struct tcpc_device *tcpc,
+			       uint8_t power_role, uint8_t data_role)
+{
+	return 0;
+}
+
+static int vsim_set_rx_enable(struct tcpc_device *tcpc, uint8_t enable)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	chip->rx_enable = enable;
+	if (!enable)
+		chip->rx_valid = false;
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_get_message(struct tcpc_device *tcpc, uint32_t *payload,
+			    uint16_t *head, enum tcpm_transmit_type *type)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+	int ret = 0;
+
+	mutex_lock(&chip->lock);
+	if (chip->rx_valid) {
+		*head = chip->rx_hdr;
+		*type = TCPC_TX_SOP;
+		memcpy(payload, chip->rx_data,
+		       PD_HEADER_CNT(chip->rx_hdr) * sizeof(uint32_t));
+		chip->rx_valid = false;
+	} else {
+		ret = -ENODATA;
+	}
+	mutex_unlock(&chip->lock);
+	return ret;
+}
+
+static int vsim_protocol_reset(struct tcpc_device *tcpc)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	chip->rx_valid = false;
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_transmit(struct tcpc_device *tcpc,
+			 enum tcpm_transmit_type type,
+			 uint16_t header, const uint32_t *data)
+{
+	struct vsim_chip *chip = tcpc_get_dev_data(tcpc);
+
+	mutex_lock(&chip->lock);
+	if (!chip->attached) {
+		vsim_raise(chip, TCPC_REG_ALERT_TX_FAILED);
+		goto out;
+	}
+
+	if (type == TCPC_TX_HARD_RESET) {
+		chip->stats.hard_resets++;
+		chip->msg_id = 0;
+		vsim_raise(chip, TCPC_REG_ALERT_HRESET_SUCCESS);
+		vsim_schedule(chip, VSIM_STEP_VBUS_OFF,
+			      VSIM_HRESET_VBUS_OFF_MS);
+		goto out;
+	}
+
+	chip->stats.tx_msgs++;
+	vsim_raise(chip, TCPC_REG_ALERT_TX_SUCCESS);
+	if (type == TCPC_TX_SOP)
+		vsim_partner_recv(chip, header, data);
+out:
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_set_bist_test_mode(struct tcpc_device *tcpc, bool en)
+{
+	return 0;
+}
+
+static int vsim_set_bist_carrier_mode(struct tcpc_device *tcpc,
+				      uint8_t pattern)
+{
+	return 0;
+}
+
+static struct tcpc_ops vsim_tcpc_ops = {
+	.init = vsim_init,
+	.init_alert_mask = vsim_init_alert_mask,
+	.alert_status_clear = vsim_alert_status_clear,
+	.fault_status_clear = vsim_fault_status_clear,
+	.set_alert_mask = vsim_set_alert_mask,
+	.get_alert_mask = vsim_get_alert_mask,
+	.get_alert_status = vsim_get_alert_status,
+	.get_power_status = vsim_get_power_status,
+	.get_fault_status = vsim_get_fault_status,
+	.get_cc = vsim_get_cc,
+	.set_cc = vsim_set_cc,
+	.set_polarity = vsim_set_polarity,
+	.set_low_rp_duty = vsim_set_low_rp_duty,
+	.set_vconn = vsim_set_vconn,
+	.deinit = vsim_deinit,
+
+#ifdef CONFIG_USB_POWER_DELIVERY
+	.set_msg_header = vsim_set_msg_header,
+	.set_rx_enable = vsim_set_rx_enable,
+	.protocol_reset = vsim_protocol_reset,
+	.get_message = vsim_get_message,
+	.transmit = vsim_transmit,
+	.set_bist_test_mode = vsim_set_bist_test_mode,
+	.set_bist_carrier_mode = vsim_set_bist_carrier_mode,
+#endif	/* CONFIG_USB_POWER_DELIVERY */
+};
+
+static int vsim_pd_notifier_call(struct notifier_block *nb,
+				 unsigned long event, void *data)
+{
+	struct vsim_chip *chip = container_of(nb, struct vsim_chip, pd_nb);
+	struct tcp_notify *noti = data;
+	struct vsim_stats *st = &chip->stats;
+	u64 us;
+
+	if (event != TCP_NOTIFY_PD_STATE)
+		return NOTIFY_OK;
+
+	switch (noti->pd_state.connected) {
+	case PD_CONNECT_PE_READY_SNK:
+	case PD_CONNECT_PE_READY_SNK_PD30:
+	case PD_CONNECT_PE_READY_SNK_APDO:
+		break;
+	default:
+		return NOTIFY_OK;
+	}
+
+	mutex_lock(&chip->lock);
+	us = ktime_us_delta(ktime_get(), chip->attach_ts);
+	st->contracts++;
+	st->last_contract_us = us;
+	if (!st->min_contract_us || us < st->min_contract_us)
+		st->min_contract_us = us;
+	if (us > st->max_contract_us)
+		st->max_contract_us = us;
+	st->max_event_depth = max_t(u32, st->max_event_depth,
+				    chip->tcpc->pd_event_max_depth);
+	st->timer_starts = chip->tcpc->timer_start_count - chip->timer_base;
+	st->event_latency_max_us = max_t(u32, st->event_latency_max_us,
+					 chip->tcpc->pd_event_latency_max_us);
+
+	if (chip->hard_reset_ms && !chip->hard_reset_done)
+		vsim_schedule(chip, VSIM_STEP_HARD_RESET, chip->hard_reset_ms);
+	mutex_unlock(&chip->lock);
+
+	dev_info(chip->dev, "contract in %llu us rdo 0x%08x\n", us,
+		 chip->last_rdo);
+	return NOTIFY_OK;
+}
+
+static void vsim_attach(struct vsim_chip *chip, bool attach)
+{
+	mutex_lock(&chip->lock);
+	if (attach == chip->attached)
+		goto out;
+
+	chip->attached = attach;
+	chip->rx_valid = false;
+	chip->follow = VSIM_STEP_NONE;
+	if (attach) {
+		chip->stats.attaches++;
+		chip->hard_reset_done = false;
+		chip->tcpc->pd_event_max_depth = 0;
+		chip->tcpc->pd_event_latency_max_us = 0;
+		chip->timer_base = chip->tcpc->timer_start_count;
+		chip->attach_ts = ktime_get();
+		vsim_schedule(chip, VSIM_STEP_VBUS_ON, chip->vbus_on_ms);
+	} else {
+		chip->step = VSIM_STEP_NONE;
+		chip->vbus = false;
+	}
+	vsim_raise(chip, TCPC_REG_ALERT_CC_STATUS |
+			 TCPC_REG_ALERT_POWER_STATUS);
+out:
+	mutex_unlock(&chip->lock);
+}
+
+static ssize_t vsim_attach_write(struct file *filp, const char __user *buff,
+				 size_t count, loff_t *off)
+{
+	struct vsim_chip *chip = filp->private_data;
+	bool attach;
+	int ret;
+
+	ret = kstrtobool_from_user(buff, count, &attach);
+	if (ret)
+		return ret;
+
+	vsim_attach(chip, attach);
+	return count;
+}
+
+static const struct file_operations vsim_attach_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.write = vsim_attach_write,
+	.llseek = no_llseek,
+};
+
+static int vsim_pdos_show(struct seq_file *s, void *unused)
+{
+	struct vsim_chip *chip = s->private;
+	u32 i;
+
+	mutex_lock(&chip->lock);
+	for (i = 0; i < chip->nr_pdos; i++)
+		seq_printf(s, "0x%08x\n", chip->pdos[i]);
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_pdos_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vsim_pdos_show, inode->i_private);
+}
+
+static ssize_t vsim_pdos_write(struct file *filp, const char __user *buff,
+			       size_t count, loff_t *off)
+{
+	struct vsim_chip *chip =
+		((struct seq_file *)filp->private_data)->private;
+	u32 pdos[PD_DATA_OBJ_SIZE];
+	char buf[96];
+	int n;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buff, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	n = sscanf(buf, "%x %x %x %x %x %x %x", &pdos[0], &pdos[1],
+		   &pdos[2], &pdos[3], &pdos[4], &pdos[5], &pdos[6]);
+	/* The first PDO is always vSafe5V fixed */
+	if (n <= 0 || PDO_TYPE(pdos[0]) != PDO_TYPE_FIXED)
+		return -EINVAL;
+
+	mutex_lock(&chip->lock);
+	memcpy(chip->pdos, pdos, n * sizeof(u32));
+	chip->nr_pdos = n;
+	mutex_unlock(&chip->lock);
+	return count;
+}
+
+static const struct file_operations vsim_pdos_fops = {
+	.owner = THIS_MODULE,
+	.open = vsim_pdos_open,
+	.read = seq_read,
+	.write = vsim_pdos_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int vsim_stats_show(struct seq_file *s, void *unused)
+{
+	struct vsim_chip *chip = s->private;
+	struct vsim_stats *st = &chip->stats;
+	struct tcpc_device *tcpc = chip->tcpc;
+
+	mutex_lock(&chip->lock);
+	seq_printf(s, "attaches: %u contracts: %u hard resets: %u\n",
+		   st->attaches, st->contracts, st->hard_resets);
+	seq_printf(s, "time to contract: last %llu min %llu max %llu us\n",
+		   st->last_contract_us, st->min_contract_us,
+		   st->max_contract_us);
+	seq_printf(s, "messages: tx %u rx %u rx dropped %u vdm naks %u\n",
+		   st->tx_msgs, st->rx_msgs, st->rx_dropped, st->vdm_naks);
+	seq_printf(s, "event queue max depth: %u/%u overflows: %u\n",
+		   st->max_event_depth, PD_EVENT_BUF_SIZE,
+		   tcpc->pd_event_overflow);
+	seq_printf(s, "event to policy engine: max %u avg %llu us\n",
+		   st->event_latency_max_us,
+		   tcpc->pd_event_dequeued ?
+			div_u64(tcpc->pd_event_latency_total_us,
+				tcpc->pd_event_dequeued) : 0);
+	seq_printf(s, "timers started to contract: %u\n", st->timer_starts);
+	mutex_unlock(&chip->lock);
+	return 0;
+}
+
+static int vsim_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vsim_stats_show, inode->i_private);
+}
+
+static ssize_t vsim_stats_write(struct file *filp, const char __user *buff,
+				size_t count, loff_t *off)
+{
+	struct vsim_chip *chip =
+		((struct seq_file *)filp->private_data)->private;
+
+	mutex_lock(&chip->lock);
+	memset(&chip->stats, 0, sizeof(chip->stats));
+	mutex_unlock(&chip->lock);
+	return count;
+}
+
+static const struct file_operations vsim_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = vsim_stats_open,
+	.read = seq_read,
+	.write = vsim_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void vsim_debugfs_init(struct vsim_chip *chip)
+{
+	chip->dir = debugfs_create_dir("tcpc_vsim", NULL);
+	debugfs_create_file("attach", 0200, chip->dir, chip,
+			    &vsim_attach_fops);
+	debugfs_create_file("pdos", 0600, chip->dir, chip, &vsim_pdos_fops);
+	debugfs_create_file("stats", 0600, chip->dir, chip,
+			    &vsim_stats_fops);
+	debugfs_create_u32("vbus_on_ms", 0600, chip->dir, &chip->vbus_on_ms);
+	debugfs_create_u32("first_caps_ms", 0600, chip->dir,
+			   &chip->first_caps_ms);
+	debugfs_create_u32("src_transition_ms", 0600, chip->dir,
+			   &chip->src_transition_ms);
+	debugfs_create_u32("hard_reset_ms", 0600, chip->dir,
+			   &chip->hard_reset_ms);
+}
+
+static int vsim_tcpcdev_init(struct vsim_chip *chip, struct device *dev)
+{
+	struct tcpc_desc *desc;
+	struct device_node *np = dev->of_node;
+	const char *name = "type_c_port0";
+	u32 val;
+
+	desc = devm_kzalloc(dev, sizeof(*desc), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+
+	desc->role_def = TYPEC_ROLE_SNK;
+	if (of_property_read_u32(np, "vsim-tcpc,role_def", &val) >= 0 &&
+	    val < TYPEC_ROLE_NR)
+		desc->role_def = val;
+	desc->rp_lvl = TYPEC_RP_DFT;
+	desc->vconn_supply = TCPC_VCONN_SUPPLY_NEVER;
+	of_property_read_string(np, "vsim-tcpc,name", &name);
+	desc->name = devm_kstrdup(dev, name, GFP_KERNEL);
+	if (!desc->name)
+		return -ENOMEM;
+
+	chip->tcpc_desc = desc;
+	chip->tcpc = tcpc_device_register(dev, desc, &vsim_tcpc_ops, chip);
+	if (IS_ERR_OR_NULL(chip->tcpc))
+		return -EINVAL;
+
+	chip->tcpc->tcpc_flags = TCPC_FLAGS_ALERT_V10 | TCPC_FLAGS_PD_REV30;
+	return 0;
+}
+
+static int vsim_probe(struct platform_device *pdev)
+{
+	struct vsim_chip *chip;
+	int ret;
+
+	chip = devm_kzalloc(&pdev->dev, sizeof(*chip), GFP_KERNEL);
+	if (!chip)
+		return -ENOMEM;
+
+	chip->dev = &pdev->dev;
+	mutex_init(&chip->lock);
+	INIT_WORK(&chip->alert_work, vsim_alert_work);
+	INIT_DELAYED_WORK(&chip->script_work, vsim_script_work);
+
+	chip->pdos[0] = PDO_FIXED(5000, 3000, PDO_FIXED_COMM_CAP);
+	chip->pdos[1] = PDO_FIXED(9000, 2000, 0);
+	chip->pdos[2] = APDO_PPS(3300, 11000, 3000, 0);
+	chip->nr_pdos = 3;
+	chip->vbus_on_ms = 150;
+	chip->first_caps_ms = 150;
+	chip->src_transition_ms = 50;
+	platform_set_drvdata(pdev, chip);
+
+	ret = vsim_tcpcdev_init(chip, &pdev->dev);
+	if (ret < 0) {
+		dev_err(&pdev->dev, "vsim tcpc dev init fail\n");
+		return ret;
+	}
+
+	chip->pd_nb.notifier_call = vsim_pd_notifier_call;
+	ret = register_tcp_dev_notifier(chip->tcpc, &chip->pd_nb,
+					TCP_NOTIFY_TYPE_USB);
+	if (ret < 0) {
+		dev_err(&pdev->dev, "register tcpc notifier fail(%d)\n", ret);
+		tcpc_device_unregister(chip->dev, chip->tcpc);
+		return ret;
+	}
+
+	vsim_debugfs_init(chip);
+	tcpc_schedule_init_work(chip->tcpc);
+	dev_info(&pdev->dev, "%s probe OK!\n", __func__);
+	return 0;
+}
+
+static int vsim_remove(struct platform_device *pdev)
+{
+	struct vsim_chip *chip = platform_get_drvdata(pdev);
+
+	debugfs_remove_recursive(chip->dir);
+	unregister_tcp_dev_notifier(chip->tcpc, &chip->pd_nb,
+				    TCP_NOTIFY_TYPE_USB);
+	vsim_attach(chip, false);
+	cancel_delayed_work_sync(&chip->script_work);
+	flush_work(&chip->alert_work);
+	tcpc_device_unregister(chip->dev, chip->tcpc);
+	return 0;
+}
+
+static const struct of_device_id vsim_match_table[] = {
+	{.compatible = "mmi,tcpc-vsim",},
+	{},
+};
+MODULE_DEVICE_TABLE(of, vsim_match_table);
+
+static struct platform_driver vsim_driver = {
+	.driver = {
+		.name = "tcpc_vsim",
+		.owner = THIS_MODULE,
+		.of_match_table = vsim_match_table,
+	},
+	.probe = vsim_probe,
+	.remove = vsim_remove,
+};
+
+module_platform_driver(vsim_driver);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Virtual TCPC with scripted PD source");
+MODULE_VERSION(VSIM_DRV_VERSION);
@@ -385,6 +385,10 @@ struct tcpc_device *tcpc_device_register(struct device *parent,
 	mutex_init(&tcpc->mr_lock);
 	sema_init(&tcpc->timer_enable_mask_lock, 1);
 	spin_lock_init(&tcpc->timer_tick_lock);
+#ifdef CONFIG_USB_POWER_DELIVERY
+	spin_lock_init(&tcpc->pd_event_lock);
+	spin_lock_init(&tcpc->pd_vdm_lock);
+#endif	/* CONFIG_USB_POWER_DELIVERY */
 
 	tcpc->dev.class = tcpc_class;
 	tcpc->dev.type = &tcpc_dev_type;
@@ -29,6 +29,27 @@
 #include "inc/pd_policy_engine.h"
 #include "inc/pd_dpm_core.h"
 
+/*
+ * The VDM slot is written under both access_lock and pd_vdm_lock, so
+ * postpone_vdm_event() can check it with pd_vdm_lock alone and the RX
+ * path doesn't wait on the policy engine. Pass NULL to empty the slot.
+ */
+static void __pd_set_vdm_event(struct tcpc_device *tcpc,
+	const struct pd_event *pd_event)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tcpc->pd_vdm_lock, flags);
+	if (pd_event) {
+		tcpc->pd_vdm_event = *pd_event;
+		tcpc->pd_pending_vdm_event = true;
+		tcpc->pd_postpone_vdm_timeout = true;
+	} else {
+		tcpc->pd_pending_vdm_event = false;
+	}
+	spin_unlock_irqrestore(&tcpc->pd_vdm_lock, flags);
+}
+
 #ifdef CONFIG_USB_PD_POSTPONE_VDM
 static void postpone_vdm_event(struct tcpc_device *tcpc)
 {
@@ -38,11 +59,17 @@ static void postpone_vdm_event(struct tcpc_device *tcpc)
 	 */
 
 	struct pd_event *vdm_event = &tcpc->pd_vdm_event;
+	unsigned long flags;
+	bool postpone;
 
-	if (tcpc->pd_pending_vdm_event && vdm_event->pd_msg) {
+	spin_lock_irqsave(&tcpc->pd_vdm_lock, flags);
+	postpone = tcpc->pd_pending_vdm_event && vdm_event->pd_msg;
+	if (postpone)
 		tcpc->pd_postpone_vdm_timeout = false;
+	spin_unlock_irqrestore(&tcpc->pd_vdm_lock, flags);
+
+	if (postpone)
 		tcpc_restart_timer(tcpc, PD_PE_VDM_POSTPONE);
-	}
 }
 #endif	/* CONFIG_USB_PD_POSTPONE_VDM */
 
@@ -109,8 +136,13 @@ void pd_free_event(struct tcpc_device *tcpc, struct pd_event *pd_event)
 
 /*----------------------------------------------------------------------------*/
 
-static bool __pd_get_event(
-	struct tcpc_device *tcpc, struct pd_event *pd_event)
+/*
+ * The event ring has its own spinlock so the alert and timer threads never
+ * wait on access_lock, which the policy engine holds across whole steps.
+ * The ring helpers below run with pd_event_lock held.
+ */
+static bool __pd_event_ring_pop(struct tcpc_device *tcpc,
+	struct pd_event *pd_event, ktime_t *queued)
 {
 	int index = 0;
 
@@ -121,6 +153,8 @@ static bool __pd_get_event(
 
 	*pd_event =
 		tcpc->pd_event_ring_buffer[tcpc->pd_event_head_index];
+	if (queued)
+		*queued = tcpc->pd_event_ts[tcpc->pd_event_head_index];
 
 	if (tcpc->pd_event_count) {
 		index = tcpc->pd_event_head_index + 1;
@@ -130,37 +164,76 @@ static bool __pd_get_event(
 	return true;
 }
 
-bool pd_get_event(struct tcpc_device *tcpc, struct pd_event *pd_event)
+static bool __pd_event_ring_push(struct tcpc_device *tcpc,
+	const struct pd_event *pd_event)
 {
+	int index;
+
+	if (tcpc->pd_event_count >= PD_EVENT_BUF_SIZE) {
+		tcpc->pd_event_overflow++;
+		return false;
+	}
+
+	index = (tcpc->pd_event_head_index + tcpc->pd_event_count);
+	index %= PD_EVENT_BUF_SIZE;
+
+	tcpc->pd_event_count++;
+	if (tcpc->pd_event_count > tcpc->pd_event_max_depth)
+		tcpc->pd_event_max_depth = tcpc->pd_event_count;
+	tcpc->pd_event_ring_buffer[index] = *pd_event;
+	tcpc->pd_event_ts[index] = ktime_get();
+	return true;
+}
+
+static bool __pd_get_event(struct tcpc_device *tcpc,
+	struct pd_event *pd_event, ktime_t *queued)
+{
+	unsigned long flags;
 	bool ret;
 
-	mutex_lock(&tcpc->access_lock);
-	ret = __pd_get_event(tcpc, pd_event);
-	mutex_unlock(&tcpc->access_lock);
+	spin_lock_irqsave(&tcpc->pd_event_lock, flags);
+	ret = __pd_event_ring_pop(tcpc, pd_event, queued);
+	spin_unlock_irqrestore(&tcpc->pd_event_lock, flags);
 	return ret;
 }
 
+bool pd_get_event(struct tcpc_device *tcpc, struct pd_event *pd_event)
+{
+	ktime_t queued;
+	uint32_t us;
+
+	if (!__pd_get_event(tcpc, pd_event, &queued))
+		return false;
+
+	/* Only the policy engine thread gets events, no lock needed */
+	us = ktime_us_delta(ktime_get(), queued);
+	tcpc->pd_event_dequeued++;
+	tcpc->pd_event_latency_total_us += us;
+	if (us > tcpc->pd_event_latency_max_us)
+		tcpc->pd_event_latency_max_us = us;
+	return true;
+}
+
 static bool __pd_put_event(struct tcpc_device *tcpc,
 	const struct pd_event *pd_event, bool from_port_partner)
 {
-	int index;
+	unsigned long flags;
+	bool ret;
 
 #ifdef CONFIG_USB_PD_POSTPONE_OTHER_VDM
 	if (from_port_partner)
 		postpone_vdm_event(tcpc);
 #endif	/* CONFIG_USB_PD_POSTPONE_OTHER_VDM */
 
-	if (tcpc->pd_event_count >= PD_EVENT_BUF_SIZE) {
+	spin_lock_irqsave(&tcpc->pd_event_lock, flags);
+	ret = __pd_event_ring_push(tcpc, pd_event);
+	spin_unlock_irqrestore(&tcpc->pd_event_lock, flags);
+
+	if (!ret) {
 		PD_ERR("pd_put_event failed\n");
 		return false;
 	}
 
-	index = (tcpc->pd_event_head_index + tcpc->pd_event_count);
-	index %= PD_EVENT_BUF_SIZE;
-
-	tcpc->pd_event_count++;
-	tcpc->pd_event_ring_buffer[index] = *pd_event;
-
 	atomic_inc(&tcpc->pending_event);
 	wake_up(&tcpc->event_wait_que);
 	return true;
@@ -169,13 +242,7 @@ static bool __pd_put_event(struct tcpc_device *tcpc,
 bool pd_put_event(struct tcpc_device *tcpc, const struct pd_event *pd_event,
 	bool from_port_partner)
 {
-	bool ret;
-
-	mutex_lock(&tcpc->access_lock);
-	ret = __pd_put_event(tcpc, pd_event, from_port_partner);
-	mutex_unlock(&tcpc->access_lock);
-
-	return ret;
+	return __pd_put_event(tcpc, pd_event, from_port_partner);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -245,7 +312,8 @@ bool pd_get_vdm_event(struct tcpc_device *tcpc, struct pd_event *pd_event)
 	}
 
 	if (tcpc->pd_pending_vdm_event) {
-		if (vdm_event->pd_msg && !tcpc->pd_postpone_vdm_timeout)
+		if (vdm_event->pd_msg &&
+		    !READ_ONCE(tcpc->pd_postpone_vdm_timeout))
 			return false;
 
 		mutex_lock(&tcpc->access_lock);
@@ -257,7 +325,7 @@ bool pd_get_vdm_event(struct tcpc_device *tcpc, struct pd_event *pd_event)
 			tcpc->pd_pending_vdm_reset = false;
 		} else {
 			*pd_event = *vdm_event;
-			tcpc->pd_pending_vdm_event = false;
+			__pd_set_vdm_event(tcpc, NULL);
 		}
 
 		mutex_unlock(&tcpc->access_lock);
@@ -343,6 +411,7 @@ bool pd_put_vdm_event(struct tcpc_device *tcpc,
 				tcpc->pd_pending_vdm_good_crc = true;
 			}
 
+			__pd_set_vdm_event(tcpc, NULL);
 			__pd_free_event(tcpc, &tcpc->pd_vdm_event);
 		}
 	}
@@ -353,9 +422,7 @@ bool pd_put_vdm_event(struct tcpc_device *tcpc,
 		return false;
 	}
 
-	tcpc->pd_vdm_event = *pd_event;
-	tcpc->pd_pending_vdm_event = true;
-	tcpc->pd_postpone_vdm_timeout = true;
+	__pd_set_vdm_event(tcpc, pd_event);
 
 	if (from_port_partner) {
 
@@ -380,7 +447,11 @@ bool pd_put_vdm_event(struct tcpc_device *tcpc,
 bool pd_put_last_vdm_event(struct tcpc_device *tcpc)
 {
 	struct pd_msg *pd_msg = &tcpc->pd_last_vdm_msg;
-	struct pd_event *vdm_event = &tcpc->pd_vdm_event;
+	struct pd_event retry_evt = {
+		.event_type = PD_EVT_HW_MSG,
+		.msg = PD_HW_RETRY_VDM,
+		.pd_msg = NULL,
+	};
 
 	mutex_lock(&tcpc->access_lock);
 
@@ -394,22 +465,20 @@ bool pd_put_last_vdm_event(struct tcpc_device *tcpc)
 		return true;
 	}
 
-	vdm_event->event_type = PD_EVT_HW_MSG;
-	vdm_event->msg = PD_HW_RETRY_VDM;
-
-	if (tcpc->pd_pending_vdm_event)
+	if (tcpc->pd_pending_vdm_event) {
+		__pd_set_vdm_event(tcpc, NULL);
 		__pd_free_event(tcpc, &tcpc->pd_vdm_event);
+	}
 
-	vdm_event->pd_msg = __pd_alloc_msg(tcpc);
+	retry_evt.pd_msg = __pd_alloc_msg(tcpc);
 
-	if (vdm_event->pd_msg == NULL) {
+	if (retry_evt.pd_msg == NULL) {
 		mutex_unlock(&tcpc->access_lock);
 		return false;
 	}
 
-	*vdm_event->pd_msg = *pd_msg;
-	tcpc->pd_pending_vdm_event = true;
-	tcpc->pd_postpone_vdm_timeout = true;
+	*retry_evt.pd_msg = *pd_msg;
+	__pd_set_vdm_event(tcpc, &retry_evt);
 
 #ifdef CONFIG_USB_PD_POSTPONE_RETRY_VDM
 	postpone_vdm_event(tcpc);
@@ -646,17 +715,30 @@ void pd_notify_tcp_event_buf_reset(struct pd_port *pd_port, uint8_t reason)
 
 /*----------------------------------------------------------------------------*/
 
-static void __pd_event_buf_reset(struct tcpc_device *tcpc, uint8_t reason)
+/*
+ * Drop every queued event and, if @put is given, queue it in the same
+ * pd_event_lock hold, so that no timer or GoodCRC event put without
+ * access_lock can land ahead of it.
+ */
+static void __pd_event_buf_reset_and_put(struct tcpc_device *tcpc,
+	uint8_t reason, const struct pd_event *put)
 {
 	struct pd_event pd_event;
+	unsigned long flags;
+	bool queued = false;
 
 	tcpc->pd_hard_reset_event_pending = false;
-	while (__pd_get_event(tcpc, &pd_event))
+
+	spin_lock_irqsave(&tcpc->pd_event_lock, flags);
+	while (__pd_event_ring_pop(tcpc, &pd_event, NULL))
 		__pd_free_event(tcpc, &pd_event);
+	if (put)
+		queued = __pd_event_ring_push(tcpc, put);
+	spin_unlock_irqrestore(&tcpc->pd_event_lock, flags);
 
 	if (tcpc->pd_pending_vdm_event) {
+		__pd_set_vdm_event(tcpc, NULL);
 		__pd_free_event(tcpc, &tcpc->pd_vdm_event);
-		tcpc->pd_pending_vdm_event = false;
 	}
 
 	tcpc->pd_pending_vdm_reset = false;
@@ -666,6 +748,17 @@ static void __pd_event_buf_reset(struct tcpc_device *tcpc, uint8_t reason)
 
 	__tcp_event_buf_reset(tcpc, reason);
 	/* PD_BUG_ON(tcpc->pd_msg_buffer_allocated != 0); */
+
+	if (queued) {
+		atomic_inc(&tcpc->pending_event);
+		wake_up(&tcpc->event_wait_que);
+	}
+}
+
+static inline void __pd_event_buf_reset(
+	struct tcpc_device *tcpc, uint8_t reason)
+{
+	__pd_event_buf_reset_and_put(tcpc, reason, NULL);
 }
 
 void pd_event_buf_reset(struct tcpc_device *tcpc)
@@ -763,6 +856,12 @@ bool pd_put_cc_attached_event(
 
 void pd_put_cc_detached_event(struct tcpc_device *tcpc)
 {
+	struct pd_event evt = {
+		.event_type = PD_EVT_HW_MSG,
+		.msg = PD_HW_CC_DETACHED,
+		.pd_msg = NULL,
+	};
+
 	mutex_lock(&tcpc->access_lock);
 
 #ifdef CONFIG_USB_POWER_DELIVERY
@@ -775,8 +874,7 @@ void pd_put_cc_detached_event(struct tcpc_device *tcpc)
 	tcpci_notify_hard_reset_state(
 		tcpc, TCP_HRESET_RESULT_FAIL);
 
-	__pd_event_buf_reset(tcpc, TCP_DPM_RET_DROP_CC_DETACH);
-	__pd_put_hw_event(tcpc, PD_HW_CC_DETACHED);
+	__pd_event_buf_reset_and_put(tcpc, TCP_DPM_RET_DROP_CC_DETACH, &evt);
 
 	tcpc->pd_wait_pe_idle = true;
 	tcpc->pd_pe_running = false;
@@ -799,6 +897,12 @@ void pd_put_cc_detached_event(struct tcpc_device *tcpc)
 
 void pd_put_recv_hard_reset_event(struct tcpc_device *tcpc)
 {
+	struct pd_event evt = {
+		.event_type = PD_EVT_HW_MSG,
+		.msg = PD_HW_RECV_HARD_RESET,
+		.pd_msg = NULL,
+	};
+
 	mutex_lock(&tcpc->access_lock);
 
 	tcpci_notify_hard_reset_state(
@@ -809,8 +913,8 @@ void pd_put_recv_hard_reset_event(struct tcpc_device *tcpc)
 	if ((!tcpc->pd_hard_reset_event_pending) &&
 		(!tcpc->pd_wait_pe_idle) &&
 		tcpc->pd_pe_running) {
-		__pd_event_buf_reset(tcpc, TCP_DPM_RET_DROP_RECV_HRESET);
-		__pd_put_hw_event(tcpc, PD_HW_RECV_HARD_RESET);
+		__pd_event_buf_reset_and_put(tcpc,
+			TCP_DPM_RET_DROP_RECV_HRESET, &evt);
 		tcpc->pd_bist_mode = PD_BIST_MODE_DISABLE;
 		tcpc->pd_hard_reset_event_pending = true;
 		tcpc->pd_ping_event_pending = false;
@@ -829,15 +933,22 @@ void pd_put_recv_hard_reset_event(struct tcpc_device *tcpc)
 
 void pd_put_sent_hard_reset_event(struct tcpc_device *tcpc)
 {
-	mutex_lock(&tcpc->access_lock);
+	struct pd_event evt = {
+		.event_type = PD_EVT_PE_MSG,
+		.msg = PD_PE_HARD_RESET_COMPLETED,
+		.pd_msg = NULL,
+	};
 
-	if (tcpc->pd_wait_hard_reset_complete)
-		__pd_event_buf_reset(tcpc, TCP_DPM_RET_DROP_SENT_HRESET);
-	else
-		TCPC_DBG2("[HReset] Unattached\n");
+	mutex_lock(&tcpc->access_lock);
 
 	tcpc->pd_transmit_state = PD_TX_STATE_GOOD_CRC;
-	__pd_put_pe_event(tcpc, PD_PE_HARD_RESET_COMPLETED);
+	if (tcpc->pd_wait_hard_reset_complete) {
+		__pd_event_buf_reset_and_put(tcpc,
+			TCP_DPM_RET_DROP_SENT_HRESET, &evt);
+	} else {
+		TCPC_DBG2("[HReset] Unattached\n");
+		__pd_put_event(tcpc, &evt, false);
+	}
 
 	mutex_unlock(&tcpc->access_lock);
 }
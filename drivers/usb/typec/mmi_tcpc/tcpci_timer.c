@@ -371,6 +371,7 @@ static inline void on_pe_timer_timeout(
 	struct pd_event pd_event = {0};
 	int rv = 0;
 	uint32_t chip_id = 0;
+	unsigned long flags;
 
 	pd_event.event_type = PD_EVT_TIMER_MSG;
 	pd_event.msg = timer_id;
@@ -418,7 +419,9 @@ static inline void on_pe_timer_timeout(
 #endif	/* CONFIG_USB_PD_VBUS_PRESENT_TOUT */
 
 	case PD_PE_VDM_POSTPONE:
+		spin_lock_irqsave(&tcpc->pd_vdm_lock, flags);
 		tcpc->pd_postpone_vdm_timeout = true;
+		spin_unlock_irqrestore(&tcpc->pd_vdm_lock, flags);
 		atomic_inc(&tcpc->pending_event);
 		wake_up(&tcpc->event_wait_que);
 		break;
@@ -1253,6 +1256,9 @@ void tcpc_enable_timer(struct tcpc_device *tcpc, uint32_t timer_id)
 		tcpc_reset_timer_range(tcpc, TYPEC_TIMER_START_ID, PD_TIMER_NR);
 
 	tcpc_set_timer_enable_mask(tcpc, timer_id);
+#ifdef CONFIG_USB_POWER_DELIVERY
+	tcpc->timer_start_count++;
+#endif	/* CONFIG_USB_POWER_DELIVERY */
 
 	tout = tcpc_timer_timeout[timer_id];
 
@@ -372,9 +372,21 @@ static int debug_uuid_show(struct seq_file *s, void *unused)
 	return 0;
 }
 
+static int debug_hsspi_stats_show(struct seq_file *s, void *unused)
+{
+	struct debug *debug = (struct debug *)s->private;
+	struct qm35_ctx *qm35_hdl = container_of(debug, struct qm35_ctx, debug);
+
+	hsspi_show_stats(&qm35_hdl->hsspi, s);
+	seq_puts(s, "log:\n");
+	log_layer_show_stats(&qm35_hdl->log_layer, s);
+	return 0;
+}
+
 DEFINE_SHOW_ATTRIBUTE(debug_devid);
 DEFINE_SHOW_ATTRIBUTE(debug_socid);
 DEFINE_SHOW_ATTRIBUTE(debug_uuid);
+DEFINE_SHOW_ATTRIBUTE(debug_hsspi_stats);
 
 void debug_soc_info_available(struct debug *debug)
 {
@@ -445,6 +457,13 @@ int debug_init(struct debug *debug)
 		goto unregister;
 	}
 
+	file = debugfs_create_file("hsspi_stats", 0444, debug->chip_dir, debug,
+				   &debug_hsspi_stats_fops);
+	if (!file) {
+		pr_err("qm35: failed to create /sys/kernel/debug/uwb0/chip/hsspi_stats\n");
+		goto unregister;
+	}
+
 	file = debugfs_create_file("enable", 0644, debug->fw_dir, debug,
 				   &debug_enable_fops);
 	if (!file) {
@@ -28,6 +28,8 @@
 
 #include <linux/kernel.h>
 #include <linux/delay.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 
 #include "qm35-trace.h"
 #include "hsspi.h"
@@ -45,6 +47,9 @@
 
 #define SS_READY_TIMEOUT_MS (250)
 
+/* TX work descriptors preallocated at init, more are allocated on demand */
+#define HSSPI_WORK_POOL_SIZE (32)
+
 #define MAX_SUCCESSIVE_ERRORS (5)
 #define CHIP_RESET_RETRY (3)
 #define SPI_CS_SETUP_DELAY_US (5)
@@ -58,6 +63,8 @@ extern int spi_speed_hz;
 struct hsspi_work {
 	struct list_head list;
 	enum hsspi_work_type type;
+	bool pooled;
+	ktime_t queued;
 	union {
 		struct {
 			struct hsspi_block *blk;
@@ -75,32 +82,83 @@ static inline bool layer_id_is_valid(struct hsspi *hsspi, u8 ul)
 }
 
 /**
- * get_work() - get a work from the list
+ * get_works() - take the control works, or else the first non-empty class
  *
  * @hsspi: &struct hsspi
+ * @batch: list receiving the works, in queuing order
  *
- * Return: a &struct hsspi_work
- * The work can be:
+ * Return: the number of works moved to @batch
+ * A work can be:
  *  - a TX work enqueued by hsspi_send
  *  - a COMPLETION work used for synchronization (always allocated on stack)
+ *
+ * Taking the whole list at once lets the thread send back-to-back TX
+ * without going through the lock and the wait queue for each of them.
+ * Only one class is taken per call so that UCI blocks queued while logs
+ * or a coredump acknowledge are sent don't wait behind them. Control
+ * works go first, no amount of traffic can hold back a stop or a layer
+ * removal.
  */
-static struct hsspi_work *get_work(struct hsspi *hsspi)
+static int get_works(struct hsspi *hsspi, struct list_head *batch)
 {
 	struct hsspi_work *hw;
+	int n = 0;
 
 	spin_lock(&hsspi->lock);
 
-	hw = list_first_entry_or_null(&hsspi->work_list, struct hsspi_work,
+	qm_xport_queue_take(&hsspi->queue, batch);
+
+	spin_unlock(&hsspi->lock);
+
+	list_for_each_entry(hw, batch, list) {
+		trace_hsspi_get_work(&hsspi->spi->dev, hw->type);
+		n++;
+	}
+
+	if (!n)
+		trace_hsspi_get_work(&hsspi->spi->dev, -1);
+
+	return n;
+}
+
+/**
+ * alloc_work() - get a TX work descriptor
+ *
+ * @hsspi: &struct hsspi
+ *
+ * Must be called with hsspi->lock held. Falls back to GFP_ATOMIC
+ * allocation when the pool is exhausted.
+ */
+static struct hsspi_work *alloc_work(struct hsspi *hsspi)
+{
+	struct hsspi_work *hw;
+
+	hw = list_first_entry_or_null(&hsspi->free_works, struct hsspi_work,
 				      list);
-	if (hw)
+	if (hw) {
 		list_del(&hw->list);
+		return hw;
+	}
 
-	spin_unlock(&hsspi->lock);
+	hw = kzalloc(sizeof(*hw), GFP_ATOMIC);
+	if (hw)
+		hsspi->stats.work_allocs++;
 
-	trace_hsspi_get_work(&hsspi->spi->dev, hw ? hw->type : -1);
 	return hw;
 }
 
+static void free_work(struct hsspi *hsspi, struct hsspi_work *hw)
+{
+	if (!hw->pooled) {
+		kfree(hw);
+		return;
+	}
+
+	spin_lock(&hsspi->lock);
+	list_add(&hw->list, &hsspi->free_works);
+	spin_unlock(&hsspi->lock);
+}
+
 /**
  * is_txrx_waiting() - is there something to do
  *
@@ -116,7 +174,7 @@ static bool is_txrx_waiting(struct hsspi *hsspi)
 
 	spin_lock(&hsspi->lock);
 
-	is_empty = list_empty(&hsspi->work_list);
+	is_empty = qm_xport_queue_empty(&hsspi->queue);
 	state = hsspi->state;
 
 	spin_unlock(&hsspi->lock);
@@ -150,9 +208,16 @@ static int hsspi_wait_ss_ready(struct hsspi *hsspi)
 		 * either the fw went to sleep or crashed, in any case
 		 * we need to wait for it to be ready again.
 		 */
-		clear_bit(HSSPI_FLAGS_SS_READY, hsspi->flags);
-		if (gpiod_get_value(hsspi->gpio_ss_rdy)) {
-			return 0;
+		if (!hsspi->gpio_ss_rdy) {
+			/* No gpio to sample, only trust the ss_ready edge */
+			if (test_and_clear_bit(HSSPI_FLAGS_SS_READY,
+					       hsspi->flags))
+				return 0;
+		} else {
+			clear_bit(HSSPI_FLAGS_SS_READY, hsspi->flags);
+			if (gpiod_get_value(hsspi->gpio_ss_rdy)) {
+				return 0;
+			}
 		}
 	}
 
@@ -181,7 +246,7 @@ static int hsspi_wait_ss_ready(struct hsspi *hsspi)
 	 * the ROM code will enter its command mode and we'll end up
 	 * communicating with the ROM code instead of the firmware.
 	 */
-	if (!gpiod_get_value(hsspi->gpio_ss_rdy))
+	if (hsspi->gpio_ss_rdy && !gpiod_get_value(hsspi->gpio_ss_rdy))
 		return -EAGAIN;
 
 	hsspi->waiting_ss_rdy = false;
@@ -227,13 +292,14 @@ static int spi_xfer(struct hsspi *hsspi, const void *tx, void *rx,
 			.speed_hz = spi_speed_hz,
 		},
 	};
-	int ret, retry = 5;
+	int ret, retry = 5, attempts = 0;
 
 	hsspi->soc->flags = 0;
 	hsspi->soc->ul = 0;
 	hsspi->soc->length = 0;
 
 	do {
+		attempts++;
 		ret = hsspi_wait_ss_ready(hsspi);
 		if (ret < 0) {
 			continue;
@@ -249,6 +315,7 @@ static int spi_xfer(struct hsspi *hsspi, const void *tx, void *rx,
 		udelay(HSSPI_MANUAL_CS_SETUP_US);
 #endif
 		ret = spi_sync_transfer(hsspi->spi, xfers, length ? 2 : 1);
+		hsspi->stats.xfers++;
 
 		trace_hsspi_spi_xfer(&hsspi->spi->dev, hsspi->host, hsspi->soc,
 				     ret);
@@ -270,6 +337,8 @@ static int spi_xfer(struct hsspi *hsspi, const void *tx, void *rx,
 		break;
 	} while ((ret == -EAGAIN) && (--retry > 0));
 
+	hsspi->stats.retries += attempts - 1;
+
 	if (!(hsspi->soc->flags & STC_SOC_RDY) || (hsspi->soc->flags & 0x0f)) {
 		dev_err(&hsspi->spi->dev, "FW not ready (flags %#02x)\n",
 			hsspi->soc->flags);
@@ -346,6 +415,11 @@ static int hsspi_rx(struct hsspi *hsspi, u8 ul, u16 length)
 		hsspi->odw_cleared(hsspi);
 
 out:
+	if (ret)
+		hsspi->stats.rx_errors++;
+	else
+		hsspi->stats.rx++;
+
 	if (blk)
 		layer->ops->received(layer, blk, ret);
 
@@ -375,6 +449,10 @@ static int hsspi_tx(struct hsspi *hsspi, struct hsspi_layer *layer,
 		hsspi->host->flags |= STC_HOST_PRD;
 
 	ret = spi_xfer(hsspi, blk->data, NULL, blk->size);
+	if (ret)
+		hsspi->stats.tx_errors++;
+	else
+		hsspi->stats.tx++;
 
 	layer->ops->sent(layer, blk, ret);
 
@@ -408,6 +486,7 @@ static int hsspi_pre_read(struct hsspi *hsspi)
 	hsspi->host->ul = 0;
 	hsspi->host->length = 0;
 
+	hsspi->stats.pre_reads++;
 	ret = spi_xfer(hsspi, NULL, NULL, 0);
 	if (ret)
 		return ret;
@@ -422,6 +501,63 @@ static int hsspi_pre_read(struct hsspi *hsspi)
 		return -1;
 }
 
+/**
+ * hsspi_handle_result() - track successive errors and reset the QM35
+ * @hsspi: the &struct hsspi
+ * @ret: result of the last TX or pre-read
+ * @successive_errors: errors since the last success
+ * @reset_cnt: resets since the last success
+ *
+ */
+static void hsspi_handle_result(struct hsspi *hsspi, int ret,
+				int *successive_errors, int *reset_cnt)
+{
+	if (ret) {
+		(*successive_errors)++;
+
+		if (*successive_errors > MAX_SUCCESSIVE_ERRORS) {
+			dev_err(&hsspi->spi->dev,
+				"Max successive errors %d reached, likely entered ROM code...\n",
+				*successive_errors);
+
+			/* When the device reboots, the ROM code might raise
+			 * ss_ready; if a SPI transfer is requested, the AP
+			 * will initiate the SPI xfer and the ROM code will
+			 * enter its command mode infinite loop...
+			 * No choice but rebooting the device.
+			 */
+			hsspi->reset_qm35(hsspi);
+			*successive_errors = 0;
+			(*reset_cnt)++;
+			if (*reset_cnt >= CHIP_RESET_RETRY) {
+				spin_lock(&hsspi->lock);
+				hsspi->state = HSSPI_STOPPED;
+				spin_unlock(&hsspi->lock);
+				*reset_cnt = 0;
+				dev_err(&hsspi->spi->dev,
+					"No response from FW after multiple resets. Stopping HSSPI.\n");
+			}
+		}
+	} else {
+		*successive_errors = 0;
+		*reset_cnt = 0;
+	}
+}
+
+static void hsspi_account_queued(struct hsspi *hsspi, struct hsspi_work *hw)
+{
+	struct hsspi_stats *st = &hsspi->stats;
+	u64 us = ktime_us_delta(ktime_get(), hw->queued);
+	enum hsspi_prio prio = hw->tx.layer->prio;
+
+	st->tx_queued_us += us;
+	if (us > st->tx_queued_max_us)
+		st->tx_queued_max_us = us;
+	st->tx_prio[prio]++;
+	if (us > st->tx_prio_queued_max_us[prio])
+		st->tx_prio_queued_max_us[prio] = us;
+}
+
 /**
  * hsspi_thread_fn() - the thread that manage all SPI transfers
  * @data: the &struct hsspi
@@ -430,7 +566,7 @@ static int hsspi_pre_read(struct hsspi *hsspi)
 static int hsspi_thread_fn(void *data)
 {
 	struct hsspi *hsspi = data;
-	static int successive_errors;
+	int successive_errors = 0;
 	int reset_cnt = 0;
 
 	/* This is supposed to be a one-time delay which should be cleared after
@@ -440,10 +576,10 @@ static int hsspi_thread_fn(void *data)
 		hsspi->boot_delay_ms = 0;
 	}
 
-	successive_errors = 0;
 	while (1) {
-		struct hsspi_work *hw;
-		int ret;
+		struct hsspi_work *hw, *tmp;
+		LIST_HEAD(batch);
+		int ret, n;
 
 		ret = wait_event_interruptible(hsspi->wq,
 					       is_txrx_waiting(hsspi) ||
@@ -454,56 +590,39 @@ static int hsspi_thread_fn(void *data)
 		if (kthread_should_stop())
 			break;
 
-		hw = get_work(hsspi);
-		if (hw) {
+		n = get_works(hsspi, &batch);
+		if (!n) {
+			/* If there is no work, we are here because
+			 * SS_IRQ is set.
+			 */
+			ret = hsspi_pre_read(hsspi);
+			hsspi_handle_result(hsspi, ret, &successive_errors,
+					    &reset_cnt);
+			continue;
+		}
+
+		if (n > hsspi->stats.batch_max)
+			hsspi->stats.batch_max = n;
+
+		list_for_each_entry_safe(hw, tmp, &batch, list) {
+			list_del(&hw->list);
 			if (hw->type == HSSPI_WORK_COMPLETION) {
 				complete(hw->completion);
 				/* on the stack no need to free */
 				continue;
 			} else if (hw->type == HSSPI_WORK_TX) {
+				hsspi_account_queued(hsspi, hw);
 				ret = hsspi_tx(hsspi, hw->tx.layer, hw->tx.blk);
-				kfree(hw);
+				free_work(hsspi, hw);
 			} else {
 				dev_err(&hsspi->spi->dev,
 					"unknown hsspi_work type: %d\n",
 					hw->type);
 				continue;
 			}
-		} else
-			/* If there is no work, we are here because
-			 * SS_IRQ is set.
-			 */
-			ret = hsspi_pre_read(hsspi);
-
-		if (ret) {
-			successive_errors++;
 
-			if (successive_errors > MAX_SUCCESSIVE_ERRORS) {
-				dev_err(&hsspi->spi->dev,
-					"Max successive errors %d reached, likely entered ROM code...\n",
-					successive_errors);
-
-				/* When the device reboots, the ROM code might raise
-				 * ss_ready; if a SPI transfer is requested, the AP
-				 * will initiate the SPI xfer and the ROM code will
-				 * enter its command mode infinite loop...
-				 * No choice but rebooting the device.
-				 */
-				hsspi->reset_qm35(hsspi);
-				successive_errors = 0;
-				reset_cnt++;
-				if (reset_cnt >= CHIP_RESET_RETRY) {
-					spin_lock(&hsspi->lock);
-					hsspi->state = HSSPI_STOPPED;
-					spin_unlock(&hsspi->lock);
-					reset_cnt = 0;
-					dev_err(&hsspi->spi->dev,
-						"No response from FW after multiple resets. Stopping HSSPI.\n");
-				}
-			}
-		} else {
-			successive_errors = 0;
-			reset_cnt = 0;
+			hsspi_handle_result(hsspi, ret, &successive_errors,
+					    &reset_cnt);
 		}
 	}
 	return 0;
@@ -511,10 +630,24 @@ static int hsspi_thread_fn(void *data)
 
 int hsspi_init(struct hsspi *hsspi, struct spi_device *spi)
 {
+	struct hsspi_work *pool;
+	int i;
+
 	memset(hsspi, 0, sizeof(*hsspi));
 
 	spin_lock_init(&hsspi->lock);
-	INIT_LIST_HEAD(&hsspi->work_list);
+	qm_xport_queue_init(&hsspi->queue);
+	INIT_LIST_HEAD(&hsspi->free_works);
+
+	pool = kcalloc(HSSPI_WORK_POOL_SIZE, sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		return -ENOMEM;
+
+	for (i = 0; i < HSSPI_WORK_POOL_SIZE; i++) {
+		pool[i].pooled = true;
+		list_add_tail(&pool[i].list, &hsspi->free_works);
+	}
+	hsspi->work_pool = pool;
 
 	hsspi->state = HSSPI_STOPPED;
 	hsspi->spi = spi;
@@ -526,8 +659,10 @@ int hsspi_init(struct hsspi *hsspi, struct spi_device *spi)
 	hsspi->soc = kmalloc(sizeof(*(hsspi->soc)), GFP_KERNEL | GFP_DMA);
 
 	hsspi->thread = kthread_create(hsspi_thread_fn, hsspi, "hsspi");
-	if (IS_ERR(hsspi->thread))
+	if (IS_ERR(hsspi->thread)) {
+		kfree(hsspi->work_pool);
 		return PTR_ERR(hsspi->thread);
+	}
 
 	wake_up_process(hsspi->thread);
 
@@ -570,6 +705,7 @@ int hsspi_deinit(struct hsspi *hsspi)
 
 	kfree(hsspi->host);
 	kfree(hsspi->soc);
+	kfree(hsspi->work_pool);
 
 	dev_info(&hsspi->spi->dev, "HSSPI uninitialized\n");
 	return 0;
@@ -579,7 +715,8 @@ int hsspi_register(struct hsspi *hsspi, struct hsspi_layer *layer)
 {
 	int ret = 0;
 
-	if (!layer_id_is_valid(hsspi, layer->id))
+	if (!layer_id_is_valid(hsspi, layer->id) ||
+	    layer->prio >= HSSPI_PRIO_NR)
 		return -EINVAL;
 
 	spin_lock(&hsspi->lock);
@@ -609,6 +746,7 @@ int hsspi_unregister(struct hsspi *hsspi, struct hsspi_layer *layer)
 		.type = HSSPI_WORK_COMPLETION,
 		.completion = &complete,
 	};
+	struct hsspi_work *hw, *tmp;
 	int ret = 0;
 
 	if (!layer_id_is_valid(hsspi, layer->id))
@@ -619,7 +757,15 @@ int hsspi_unregister(struct hsspi *hsspi, struct hsspi_layer *layer)
 	if (hsspi->layers[layer->id] == layer) {
 		hsspi->layers[layer->id] = NULL;
 
-		list_add_tail(&complete_work.list, &hsspi->work_list);
+		/* The blocks this layer queued go out before the completion,
+		 * both ahead of any class.
+		 */
+		list_for_each_entry_safe(hw, tmp,
+					 &hsspi->queue.classes[layer->prio],
+					 list)
+			if (hw->type == HSSPI_WORK_TX && hw->tx.layer == layer)
+				list_move_tail(&hw->list, &hsspi->queue.ctrl);
+		qm_xport_queue_add_ctrl(&hsspi->queue, &complete_work.list);
 	} else
 		ret = -EINVAL;
 
@@ -634,7 +780,7 @@ int hsspi_unregister(struct hsspi *hsspi, struct hsspi_layer *layer)
 	wake_up_interruptible(&hsspi->wq);
 
 	/* when completed there is no more reference to layer in the
-	 * work_list or in the hsspi_thread_fn
+	 * queue or in the hsspi_thread_fn
 	 */
 	wait_for_completion(&complete);
 
@@ -705,20 +851,23 @@ int hsspi_send(struct hsspi *hsspi, struct hsspi_layer *layer,
 	if (!layer_id_is_valid(hsspi, layer->id))
 		return -EINVAL;
 
-	tx_work = kzalloc(sizeof(*tx_work), GFP_KERNEL);
-	if (!tx_work)
-		return -ENOMEM;
-
-	tx_work->type = HSSPI_WORK_TX;
-	tx_work->tx.blk = blk;
-	tx_work->tx.layer = layer;
-
 	spin_lock(&hsspi->lock);
 
 	if (hsspi->state == HSSPI_RUNNING) {
-		if (hsspi->layers[layer->id] == layer)
-			list_add_tail(&tx_work->list, &hsspi->work_list);
-		else
+		if (hsspi->layers[layer->id] == layer) {
+			tx_work = alloc_work(hsspi);
+			if (tx_work) {
+				tx_work->type = HSSPI_WORK_TX;
+				tx_work->queued = ktime_get();
+				tx_work->tx.blk = blk;
+				tx_work->tx.layer = layer;
+				qm_xport_queue_add(&hsspi->queue,
+						   &tx_work->list,
+						   layer->prio);
+			} else {
+				ret = -ENOMEM;
+			}
+		} else
 			ret = -EINVAL;
 	} else
 		ret = -EAGAIN;
@@ -726,7 +875,6 @@ int hsspi_send(struct hsspi *hsspi, struct hsspi_layer *layer,
 	spin_unlock(&hsspi->lock);
 
 	if (ret) {
-		kfree(tx_work);
 		dev_err(&hsspi->spi->dev, "%s: %d\n", __func__, ret);
 		return ret;
 	}
@@ -763,7 +911,9 @@ void hsspi_stop(struct hsspi *hsspi)
 
 	hsspi->state = HSSPI_STOPPED;
 
-	list_add_tail(&complete_work.list, &hsspi->work_list);
+	/* Drain what is queued, then complete, ahead of any new class work */
+	qm_xport_queue_to_ctrl(&hsspi->queue);
+	qm_xport_queue_add_ctrl(&hsspi->queue, &complete_work.list);
 
 	spin_unlock(&hsspi->lock);
 
@@ -773,3 +923,132 @@ void hsspi_stop(struct hsspi *hsspi)
 
 	dev_dbg(&hsspi->spi->dev, "HSSPI stopped\n");
 }
+
+void hsspi_show_stats(struct hsspi *hsspi, struct seq_file *s)
+{
+	static const char *const prio_names[HSSPI_PRIO_NR] = {
+		[HSSPI_PRIO_UCI] = "uci",
+		[HSSPI_PRIO_LOG] = "log",
+		[HSSPI_PRIO_COREDUMP] = "coredump",
+	};
+	const struct hsspi_stats *st = &hsspi->stats;
+	u64 txs = st->tx + st->tx_errors;
+	int i;
+
+	seq_printf(s, "xfers: %llu (retries %llu)\n", st->xfers, st->retries);
+	seq_printf(s, "tx: %llu (errors %llu)\n", st->tx, st->tx_errors);
+	seq_printf(s, "rx: %llu (errors %llu)\n", st->rx, st->rx_errors);
+	seq_printf(s, "pre_reads: %llu\n", st->pre_reads);
+	seq_printf(s, "tx_queued: avg %llu us max %llu us\n",
+		   txs ? div64_u64(st->tx_queued_us, txs) : 0,
+		   st->tx_queued_max_us);
+	for (i = 0; i < HSSPI_PRIO_NR; i++)
+		seq_printf(s, "tx_%s: %llu (queued max %llu us)\n",
+			   prio_names[i], st->tx_prio[i],
+			   st->tx_prio_queued_max_us[i]);
+	seq_printf(s, "batch_max: %u\n", st->batch_max);
+	seq_printf(s, "work_allocs: %llu\n", st->work_allocs);
+}
+
+static void hsspi_rx_ring_work(struct work_struct *work)
+{
+	struct hsspi_rx_ring *ring =
+		container_of(work, struct hsspi_rx_ring, work);
+	int slot;
+
+	while ((slot = qm_xport_ring_cons(&ring->idx)) >= 0) {
+		ring->consume(ring, &ring->slots[slot]);
+		/* Hand the slot back to the HSSPI thread */
+		qm_xport_ring_pop(&ring->idx);
+	}
+}
+
+int hsspi_rx_ring_init(struct hsspi_rx_ring *ring, unsigned int nr, u16 size,
+		       void (*consume)(struct hsspi_rx_ring *ring,
+				       struct hsspi_block *blk))
+{
+	unsigned int i;
+
+	memset(ring, 0, sizeof(*ring));
+
+	ring->slots = kcalloc(nr, sizeof(*ring->slots), GFP_KERNEL);
+	if (!ring->slots)
+		return -ENOMEM;
+
+	qm_xport_ring_init(&ring->idx, nr);
+	ring->size = size;
+	ring->consume = consume;
+	INIT_WORK(&ring->work, hsspi_rx_ring_work);
+
+	if (hsspi_init_block(&ring->drop, size))
+		goto err;
+
+	for (i = 0; i < nr; i++)
+		if (hsspi_init_block(&ring->slots[i], size))
+			goto err;
+
+	return 0;
+
+err:
+	hsspi_rx_ring_deinit(ring);
+	return -ENOMEM;
+}
+
+void hsspi_rx_ring_deinit(struct hsspi_rx_ring *ring)
+{
+	unsigned int i;
+
+	if (!ring->slots)
+		return;
+
+	cancel_work_sync(&ring->work);
+
+	for (i = 0; i < ring->idx.nr; i++)
+		hsspi_deinit_block(&ring->slots[i]);
+	hsspi_deinit_block(&ring->drop);
+	kfree(ring->slots);
+	ring->slots = NULL;
+}
+
+struct hsspi_block *hsspi_rx_ring_get(struct hsspi_rx_ring *ring, u16 length)
+{
+	struct hsspi_block *blk;
+	int slot;
+
+	if (length > ring->size) {
+		ring->idx.dropped++;
+		return NULL;
+	}
+
+	slot = qm_xport_ring_prod(&ring->idx);
+	blk = slot < 0 ? &ring->drop : &ring->slots[slot];
+
+	blk->length = length;
+	blk->size = length;
+	return blk;
+}
+
+void hsspi_rx_ring_received(struct hsspi_rx_ring *ring,
+			    struct hsspi_block *blk, int status)
+{
+	if (blk == &ring->drop) {
+		ring->idx.dropped++;
+		return;
+	}
+
+	if (status) {
+		/* The slot isn't committed, it is reused by the next get */
+		ring->idx.errors++;
+		return;
+	}
+
+	qm_xport_ring_push(&ring->idx);
+	schedule_work(&ring->work);
+}
+
+void hsspi_rx_ring_show_stats(struct hsspi_rx_ring *ring, struct seq_file *s)
+{
+	seq_printf(s, "rx_ring: %u slots of %u bytes, used %u\n", ring->idx.nr,
+		   ring->size, qm_xport_ring_used(&ring->idx));
+	qm_xport_ring_show(s, "rx", &ring->idx);
+}
@@ -34,7 +34,9 @@
 #include <linux/list.h>
 #include <linux/spinlock.h>
 #include <linux/spi/spi.h>
+#include <linux/uwb/qm_xport.h>
 #include <linux/wait.h>
+#include <linux/workqueue.h>
 
 enum { UL_RESERVED,
        UL_BOOT_FLASH,
@@ -50,6 +52,14 @@ struct stc_header {
 	u16 length;
 } __packed;
 
+/* TX classes of the shared transport core, see &enum qm_xport_class */
+enum hsspi_prio {
+	HSSPI_PRIO_UCI = QM_XPORT_UCI,
+	HSSPI_PRIO_LOG = QM_XPORT_LOG,
+	HSSPI_PRIO_COREDUMP = QM_XPORT_COREDUMP,
+	HSSPI_PRIO_NR = QM_XPORT_NR,
+};
+
 enum hsspi_work_type {
 	HSSPI_WORK_TX = 0,
 	HSSPI_WORK_COMPLETION,
@@ -75,6 +85,7 @@ struct hsspi_block {
 };
 
 struct hsspi_layer;
+struct seq_file;
 
 /**
  * struct hsspi_layer_ops - Upper layer operations.
@@ -111,6 +122,7 @@ struct hsspi_layer_ops {
  * struct hsspi_layer - HSSPI upper layer.
  * @name: Name of this upper layer.
  * @id: id (ul used in the STC header) of this upper layer
+ * @prio: TX class of this upper layer, HSSPI_PRIO_UCI by default
  * @ops: &struct hsspi_layer_ops
  *
  * Basic upper layer structure. Inherit from it to implement a
@@ -119,9 +131,33 @@ struct hsspi_layer_ops {
 struct hsspi_layer {
 	char *name;
 	u8 id;
+	enum hsspi_prio prio;
 	const struct hsspi_layer_ops *ops;
 };
 
+/**
+ * struct hsspi_rx_ring - bounded reception ring of an upper layer
+ * @slots: preallocated blocks handed to the HSSPI thread
+ * @drop: block the data is clocked into when the ring is full
+ * @idx: shared lossy ring indexing @slots, the HSSPI thread produces and
+ *       @work consumes; its dropped counter also takes the blocks too big
+ *       for a slot
+ * @size: size of each slot
+ * @work: runs @consume on the filled slots, out of the HSSPI thread
+ * @consume: upper layer handler of a received block
+ *
+ * Lossy by design: a layer that can't keep up loses its own blocks
+ * instead of holding the HSSPI thread, and so the other layers, back.
+ */
+struct hsspi_rx_ring {
+	struct hsspi_block *slots;
+	struct hsspi_block drop;
+	struct qm_xport_ring idx;
+	u16 size;
+	struct work_struct work;
+	void (*consume)(struct hsspi_rx_ring *ring, struct hsspi_block *blk);
+};
+
 enum hsspi_flags {
 	HSSPI_FLAGS_SS_IRQ = 0,
 	HSSPI_FLAGS_SS_READY = 1,
@@ -129,6 +165,38 @@ enum hsspi_flags {
 	HSSPI_FLAGS_MAX = 3,
 };
 
+/**
+ * struct hsspi_stats - HSSPI engine counters, updated by the HSSPI thread.
+ * @xfers: SPI transfers, including retries
+ * @retries: transfers retried after ss_ready timeout or FW not ready
+ * @tx: blocks sent
+ * @tx_errors: blocks failed to send
+ * @rx: blocks received
+ * @rx_errors: failed receptions
+ * @pre_reads: PRE_READ only transfers
+ * @tx_queued_us: total time TX blocks waited in the work list
+ * @tx_queued_max_us: longest time a TX block waited in the work list
+ * @tx_prio: blocks sent per TX class
+ * @tx_prio_queued_max_us: longest wait in the work list per TX class
+ * @work_allocs: work descriptors allocated because the pool was empty
+ * @batch_max: largest number of works handled in one thread wake-up
+ */
+struct hsspi_stats {
+	u64 xfers;
+	u64 retries;
+	u64 tx;
+	u64 tx_errors;
+	u64 rx;
+	u64 rx_errors;
+	u64 pre_reads;
+	u64 tx_queued_us;
+	u64 tx_queued_max_us;
+	u64 tx_prio[HSSPI_PRIO_NR];
+	u64 tx_prio_queued_max_us[HSSPI_PRIO_NR];
+	u64 work_allocs;
+	u32 batch_max;
+};
+
 enum hsspi_state {
 	HSSPI_RUNNING = 0,
 	HSSPI_ERROR = 1,
@@ -146,8 +214,10 @@ enum hsspi_state {
  *
  */
 struct hsspi {
-	spinlock_t lock; /* protect work_list, layers and state */
-	struct list_head work_list;
+	spinlock_t lock; /* protect queue, free_works, layers and state */
+	struct qm_xport_queue queue;
+	struct list_head free_works;
+	void *work_pool;
 	struct hsspi_layer *layers[UL_MAX_IDX];
 	enum hsspi_state state;
 
@@ -176,6 +246,8 @@ struct hsspi {
 	volatile bool waiting_ss_rdy;
 
 	unsigned int boot_delay_ms;
+
+	struct hsspi_stats stats;
 };
 
 /**
@@ -326,4 +398,65 @@ void hsspi_start(struct hsspi *hsspi);
  */
 void hsspi_stop(struct hsspi *hsspi);
 
+/**
+ * hsspi_show_stats() - print the HSSPI engine counters
+ *
+ * @hsspi: pointer to a &struct hsspi
+ * @s: seq_file to print into
+ *
+ */
+void hsspi_show_stats(struct hsspi *hsspi, struct seq_file *s);
+
+/**
+ * hsspi_rx_ring_init() - allocate a reception ring
+ *
+ * @ring: pointer to a &struct hsspi_rx_ring
+ * @nr: number of slots
+ * @size: largest block the upper layer receives
+ * @consume: handler of the received blocks, called from a workqueue
+ *
+ * Return: 0 or -ENOMEM on error
+ */
+int hsspi_rx_ring_init(struct hsspi_rx_ring *ring, unsigned int nr, u16 size,
+		       void (*consume)(struct hsspi_rx_ring *ring,
+				       struct hsspi_block *blk));
+
+/**
+ * hsspi_rx_ring_deinit() - free a reception ring
+ *
+ * @ring: pointer to a &struct hsspi_rx_ring
+ *
+ * The upper layer must be unregistered first.
+ */
+void hsspi_rx_ring_deinit(struct hsspi_rx_ring *ring);
+
+/**
+ * hsspi_rx_ring_get() - &struct hsspi_layer_ops.get of a ring based layer
+ *
+ * @ring: pointer to a &struct hsspi_rx_ring
+ * @length: length of the block to receive
+ *
+ * Return: a free slot, or the drop block if the ring is full
+ */
+struct hsspi_block *hsspi_rx_ring_get(struct hsspi_rx_ring *ring, u16 length);
+
+/**
+ * hsspi_rx_ring_received() - &struct hsspi_layer_ops.received of a ring
+ * based layer
+ *
+ * @ring: pointer to a &struct hsspi_rx_ring
+ * @blk: block returned by hsspi_rx_ring_get()
+ * @status: reception status
+ */
+void hsspi_rx_ring_received(struct hsspi_rx_ring *ring,
+			    struct hsspi_block *blk, int status);
+
+/**
+ * hsspi_rx_ring_show_stats() - print the ring counters
+ *
+ * @ring: pointer to a &struct hsspi_rx_ring
+ * @s: seq_file to print into
+ */
+void hsspi_rx_ring_show_stats(struct hsspi_rx_ring *ring, struct seq_file *s);
+
 #endif // __HSSPI_H__
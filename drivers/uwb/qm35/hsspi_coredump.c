@@ -296,6 +296,7 @@ void coredump_layer_init(struct coredump_layer *layer)
 {
 	layer->hlayer.name = "QM35 COREDUMP";
 	layer->hlayer.id = UL_COREDUMP;
+	layer->hlayer.prio = HSSPI_PRIO_COREDUMP;
 	layer->hlayer.ops = &coredump_ops;
 	layer->coredump_data = NULL;
 	layer->coredump_data_wr_idx = 0;
@@ -26,6 +26,7 @@
  * QM35 LOG layer HSSPI Protocol
  */
 
+#include <linux/seq_file.h>
 #include <linux/uwb/qmrom.h>
 
 #include "qm35.h"
@@ -38,6 +39,10 @@
 
 #define TRACE_RB_SIZE 0xFFFFF // 1MB
 
+/* Packets waiting to be parsed, the firmware frames are up to 2KB */
+#define LOG_RX_SLOTS 32
+#define LOG_RX_SLOT_SIZE 2048
+
 struct __packed log_packet_hdr {
 	uint16_t cmd_id;
 	uint16_t b_size;
@@ -202,36 +207,34 @@ static void log_unregistered(struct hsspi_layer *hlayer)
 
 static struct hsspi_block *log_get(struct hsspi_layer *hlayer, u16 length)
 {
-	struct log_packet *p;
-
-	p = log_packet_alloc(length);
-	if (!p)
-		return NULL;
+	struct log_layer *layer = container_of(hlayer, struct log_layer, hlayer);
 
-	return &p->blk;
+	return hsspi_rx_ring_get(&layer->rx, length);
 }
 
 static void log_received(struct hsspi_layer *hlayer, struct hsspi_block *blk,
 			 int status)
+{
+	struct log_layer *layer = container_of(hlayer, struct log_layer, hlayer);
+
+	/* Parsed by log_consume(), the HSSPI thread goes on with UCI */
+	hsspi_rx_ring_received(&layer->rx, blk, status);
+}
+
+static void log_consume(struct hsspi_rx_ring *ring, struct hsspi_block *blk)
 {
 	struct log_layer *layer;
 	struct log_packet_hdr hdr;
 	uint8_t *body;
 	struct qm35_ctx *qm35_hdl;
-	struct log_packet *p;
-
-	p = container_of(blk, struct log_packet, blk);
 
-	if (status)
-		goto out;
-
-	layer = container_of(hlayer, struct log_layer, hlayer);
+	layer = container_of(ring, struct log_layer, rx);
 	qm35_hdl = container_of(layer, struct qm35_ctx, log_layer);
 
 	if (blk->length < sizeof(struct log_packet_hdr)) {
 		pr_err("qm35: log packet header too small: %d bytes\n",
 		       blk->length);
-		goto out;
+		return;
 	}
 
 	memcpy(&hdr, blk->data, sizeof(struct log_packet_hdr));
@@ -240,7 +243,7 @@ static void log_received(struct hsspi_layer *hlayer, struct hsspi_block *blk,
 	if (blk->length < sizeof(struct log_packet_hdr) + hdr.b_size) {
 		pr_err("qm35: incomplete log packet: %d/%d bytes\n",
 		       blk->length, hdr.b_size);
-		goto out;
+		return;
 	}
 	if (qm35_hdl->log_qm_traces)
 		pr_info("qm35_log: %.*s\n", hdr.b_size - 2, body);
@@ -261,8 +264,6 @@ static void log_received(struct hsspi_layer *hlayer, struct hsspi_block *blk,
 	default:
 		break;
 	}
-out:
-	log_packet_free(p);
 }
 
 static void log_sent(struct hsspi_layer *hlayer, struct hsspi_block *blk,
@@ -461,8 +462,16 @@ int log_layer_init(struct log_layer *log, struct debug *debug)
 	if (ret)
 		return ret;
 
+	ret = hsspi_rx_ring_init(&log->rx, LOG_RX_SLOTS, LOG_RX_SLOT_SIZE,
+				 log_consume);
+	if (ret) {
+		rb_deinit(&log->rb);
+		return ret;
+	}
+
 	log->hlayer.name = "QM35 LOG";
 	log->hlayer.id = UL_LOG;
+	log->hlayer.prio = HSSPI_PRIO_LOG;
 	log->hlayer.ops = &log_ops;
 	log->enabled = false;
 	log->log_modules = NULL;
@@ -475,6 +484,13 @@ int log_layer_init(struct log_layer *log, struct debug *debug)
 
 void log_layer_deinit(struct log_layer *log)
 {
+	hsspi_rx_ring_deinit(&log->rx);
 	kfree(log->log_modules);
 	rb_deinit(&log->rb);
 }
+
+void log_layer_show_stats(struct log_layer *log, struct seq_file *s)
+{
+	hsspi_rx_ring_show_stats(&log->rx, s);
+	seq_printf(s, "traces_overwritten: %u\n", READ_ONCE(log->rb.dropped));
+}
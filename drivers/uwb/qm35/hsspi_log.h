@@ -42,6 +42,7 @@ struct log_layer {
 	struct hsspi_layer hlayer;
 	uint8_t log_modules_count;
 	struct log_module *log_modules;
+	struct hsspi_rx_ring rx;
 	struct rb rb;
 	bool enabled;
 };
@@ -66,5 +67,6 @@ void log_packet_free(struct log_packet *p);
 
 int log_layer_init(struct log_layer *log, struct debug *debug);
 void log_layer_deinit(struct log_layer *log);
+void log_layer_show_stats(struct log_layer *log, struct seq_file *s);
 
 #endif // __HSSPI_LOG_H__
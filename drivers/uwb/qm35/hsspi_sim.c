@@ -0,0 +1,1164 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * QM35 HSSPI simulated SPI controller
+ *
+ * A dummy SPI controller answering the STC handshake like the QM35
+ * firmware does, with its own HSSPI instance on top. Blocks written on
+ * the test upper layer are echoed back, which lets the bench measure
+ * the messages per second and the round trip latency of the HSSPI
+ * engine without hardware:
+ *
+ *   echo "<count> <depth> <length>" > /sys/kernel/debug/qm35_stc_sim/bench
+ *   cat /sys/kernel/debug/qm35_stc_sim/bench
+ *
+ * The firmware can also flood the log upper layer, keeping the queue
+ * full of log blocks that the bench messages have to get through. The
+ * host log layer takes consume_us to handle each block:
+ *
+ *   echo "<length> <consume_us>" > /sys/kernel/debug/qm35_stc_sim/log_flood
+ *   echo 0 > /sys/kernel/debug/qm35_stc_sim/log_flood
+ *
+ * The UCI flood sends count blocks of pkts UCI notifications with a
+ * length bytes payload, received either through the UCI RX ring or
+ * through the former kzalloc + list path. The writer reads them back
+ * like the /dev/uci reader does, taking consume_us per packet:
+ *
+ *   echo "ring|list <count> <pkts> <length> <consume_us>" > \
+ *	/sys/kernel/debug/qm35_stc_sim/uci_flood
+ *   cat /sys/kernel/debug/qm35_stc_sim/uci_flood
+ */
+
+#include <linux/debugfs.h>
+#include <linux/mman.h>
+#include <linux/mmi_lat_hist.h>
+#include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spi/spi.h>
+#include <linux/uaccess.h>
+
+#include "hsspi.h"
+#include "hsspi_sim.h"
+#include "hsspi_uci.h"
+
+/* STC flags, see hsspi.c */
+#define STC_HOST_WR BIT(7)
+#define STC_HOST_PRD BIT(6)
+#define STC_HOST_RD BIT(5)
+
+#define STC_SOC_ODW BIT(7)
+#define STC_SOC_OA BIT(6)
+#define STC_SOC_RDY BIT(5)
+
+#define SIM_MAX_PAYLOAD (2048)
+#define SIM_QUEUE_LEN (16)
+#define SIM_BENCH_MAX_DEPTH (SIM_QUEUE_LEN / 2)
+#define SIM_BENCH_BLOCKS (2 * SIM_BENCH_MAX_DEPTH)
+#define SIM_BENCH_TIMEOUT_MS (30000)
+/* Log blocks kept queued by the firmware while flooding */
+#define SIM_FLOOD_DEPTH (SIM_QUEUE_LEN - SIM_BENCH_MAX_DEPTH)
+#define SIM_LOG_RX_SLOTS (32)
+#define SIM_UCI_HDR_LEN (4)
+#define SIM_UCI_MAX_PAYLOAD (255)
+#define SIM_UCI_TIMEOUT_MS (5000)
+
+struct sim_msg {
+	u8 ul;
+	u16 length;
+	u8 data[SIM_MAX_PAYLOAD];
+};
+
+struct sim_blk {
+	struct hsspi_block blk;
+	struct list_head list;
+	u8 data[SIM_MAX_PAYLOAD];
+};
+
+/* UCI packet of the former RX path, one kzalloc per packet */
+struct sim_uci_pkt {
+	struct uci_packet p;
+	struct list_head list;
+};
+
+struct hsspi_sim {
+	struct platform_device *pdev;
+	struct spi_controller *ctlr;
+	struct hsspi hsspi;
+	struct hsspi_layer layer;
+	struct hsspi_layer log_layer;
+	struct hsspi_rx_ring log_rx;
+	struct dentry *dir;
+
+	/* Firmware side: blocks waiting to be read by the host */
+	spinlock_t lock; /* protect queue, q_logs and free_blks */
+	struct sim_msg queue[SIM_QUEUE_LEN];
+	unsigned int q_head, q_tail;
+	unsigned int q_logs;
+	u64 dropped;
+
+	/* Log flood */
+	u32 flood_length;
+	u32 flood_consume_us;
+	u64 flood_sent;
+	u64 log_consumed;
+
+	/* UCI flood, the counters are written by the HSSPI thread */
+	struct hsspi_layer uci_hlayer;
+	struct uci_layer uci;
+	struct mutex uci_lock; /* one run at a time */
+	bool uci_use_list;
+	struct mutex uci_list_lock; /* protect uci_list and uci_list_len */
+	struct list_head uci_list;
+	u32 uci_list_len, uci_list_max;
+	u8 uci_tmpl[SIM_MAX_PAYLOAD];
+	u16 uci_tmpl_len;
+	u32 uci_left; /* blocks still to be queued */
+	u32 q_uci;
+	u32 uci_count, uci_pkts, uci_length, uci_consume_us;
+	u32 uci_blocks; /* blocks received or dropped */
+	u32 uci_dropped;
+	u32 uci_ring_dropped;
+	u64 uci_rx_ns; /* get + received on the HSSPI thread */
+	u64 uci_read; /* packets read back */
+	u64 uci_read_ns;
+	u64 uci_elapsed_us;
+	int uci_status;
+
+	/* Bench */
+	struct mutex bench_lock; /* one run at a time */
+	struct list_head free_blks;
+	struct sim_blk *blks;
+	struct completion bench_done;
+	u32 count, depth, length;
+	atomic_t sent, done, errors;
+	struct mmi_lat_hist lat; /* round trips */
+	u64 lat_min_us;
+	u64 elapsed_us;
+};
+
+static struct hsspi_sim *sim;
+
+static bool sim_queue_empty(struct hsspi_sim *sim)
+{
+	return sim->q_head == sim->q_tail;
+}
+
+static struct sim_msg *sim_queue_peek(struct hsspi_sim *sim)
+{
+	return &sim->queue[sim->q_head % SIM_QUEUE_LEN];
+}
+
+static void sim_queue_push(struct hsspi_sim *sim, u8 ul, const void *data,
+			   u16 length)
+{
+	struct sim_msg *msg;
+
+	if (sim->q_tail - sim->q_head >= SIM_QUEUE_LEN ||
+	    length > SIM_MAX_PAYLOAD || !data) {
+		sim->dropped++;
+		return;
+	}
+
+	msg = &sim->queue[sim->q_tail++ % SIM_QUEUE_LEN];
+	msg->ul = ul;
+	msg->length = length;
+	memcpy(msg->data, data, length);
+}
+
+/* Keep SIM_FLOOD_DEPTH log blocks queued, the content doesn't matter */
+static void sim_queue_flood(struct hsspi_sim *sim)
+{
+	struct sim_msg *msg;
+
+	if (!sim->flood_length)
+		return;
+
+	while (sim->q_logs < SIM_FLOOD_DEPTH &&
+	       sim->q_tail - sim->q_head < SIM_QUEUE_LEN) {
+		msg = &sim->queue[sim->q_tail++ % SIM_QUEUE_LEN];
+		msg->ul = UL_LOG;
+		msg->length = sim->flood_length;
+		sim->q_logs++;
+		sim->flood_sent++;
+	}
+}
+
+/* Queue the UCI flood blocks, SIM_FLOOD_DEPTH at most */
+static void sim_queue_uci(struct hsspi_sim *sim)
+{
+	struct sim_msg *msg;
+
+	while (sim->uci_left && sim->q_uci < SIM_FLOOD_DEPTH &&
+	       sim->q_tail - sim->q_head < SIM_QUEUE_LEN) {
+		msg = &sim->queue[sim->q_tail++ % SIM_QUEUE_LEN];
+		msg->ul = UL_UCI_APP;
+		msg->length = sim->uci_tmpl_len;
+		memcpy(msg->data, sim->uci_tmpl, sim->uci_tmpl_len);
+		sim->q_uci++;
+		sim->uci_left--;
+	}
+}
+
+/*
+ * Emulate the firmware side of one STC transaction: the SOC header is
+ * clocked out while the host header is clocked in, so it describes the
+ * state before this transaction.
+ */
+static int sim_transfer_one_message(struct spi_controller *ctlr,
+				    struct spi_message *m)
+{
+	struct spi_transfer *hdr, *payload = NULL;
+	const struct stc_header *host;
+	struct stc_header *soc;
+	struct sim_msg *msg = NULL;
+	bool more;
+
+	hdr = list_first_entry(&m->transfers, struct spi_transfer,
+			       transfer_list);
+	if (!list_is_last(&hdr->transfer_list, &m->transfers))
+		payload = list_next_entry(hdr, transfer_list);
+
+	host = hdr->tx_buf;
+	soc = hdr->rx_buf;
+
+	spin_lock(&sim->lock);
+
+	if (!sim_queue_empty(sim))
+		msg = sim_queue_peek(sim);
+
+	soc->flags = STC_SOC_RDY;
+	soc->ul = 0;
+	soc->length = 0;
+
+	if (host->flags & STC_HOST_RD) {
+		if (msg && msg->ul == host->ul && msg->length == host->length) {
+			soc->flags |= STC_SOC_OA;
+			soc->ul = msg->ul;
+			soc->length = msg->length;
+			if (payload && payload->rx_buf)
+				memcpy(payload->rx_buf, msg->data,
+				       min_t(unsigned int, payload->len,
+					     msg->length));
+			if (msg->ul == UL_LOG)
+				sim->q_logs--;
+			else if (msg->ul == UL_UCI_APP)
+				sim->q_uci--;
+			sim->q_head++;
+		}
+		if (!sim_queue_empty(sim))
+			soc->flags |= STC_SOC_ODW;
+	} else if (msg) {
+		/* WR and PRD both get the output data waiting info */
+		soc->flags |= STC_SOC_ODW;
+		soc->ul = msg->ul;
+		soc->length = msg->length;
+	}
+
+	if ((host->flags & STC_HOST_WR) && host->ul == UL_TEST_HSSPI)
+		sim_queue_push(sim, host->ul, payload ? payload->tx_buf : NULL,
+			       host->length);
+
+	sim_queue_flood(sim);
+	sim_queue_uci(sim);
+	more = !sim_queue_empty(sim);
+
+	spin_unlock(&sim->lock);
+
+	m->actual_length = hdr->len + (payload ? payload->len : 0);
+	m->status = 0;
+
+	/* ss_ready toggles once the transaction is acknowledged */
+	hsspi_clear_spi_slave_busy(&sim->hsspi);
+	hsspi_set_spi_slave_ready(&sim->hsspi);
+	if (more)
+		hsspi_set_output_data_waiting(&sim->hsspi);
+
+	spi_finalize_current_message(ctlr);
+	return 0;
+}
+
+static void sim_odw_cleared(struct hsspi *hsspi)
+{
+}
+
+static void sim_wakeup(struct hsspi *hsspi)
+{
+	hsspi_set_spi_slave_ready(hsspi);
+}
+
+static void sim_reset(struct hsspi *hsspi)
+{
+	dev_warn(&hsspi->spi->dev, "simulated reset\n");
+
+	spin_lock(&sim->lock);
+	sim->q_head = sim->q_tail;
+	sim->q_logs = 0;
+	sim->q_uci = 0;
+	spin_unlock(&sim->lock);
+	hsspi_set_spi_slave_ready(hsspi);
+}
+
+/* Bench upper layer */
+
+static struct sim_blk *sim_blk_get(void)
+{
+	struct sim_blk *sblk;
+
+	spin_lock(&sim->lock);
+	sblk = list_first_entry_or_null(&sim->free_blks, struct sim_blk, list);
+	if (sblk)
+		list_del(&sblk->list);
+	spin_unlock(&sim->lock);
+	return sblk;
+}
+
+static void sim_blk_put(struct hsspi_block *blk)
+{
+	struct sim_blk *sblk = container_of(blk, struct sim_blk, blk);
+
+	spin_lock(&sim->lock);
+	list_add(&sblk->list, &sim->free_blks);
+	spin_unlock(&sim->lock);
+}
+
+static void sim_bench_account(int error)
+{
+	if (error)
+		atomic_inc(&sim->errors);
+
+	if (atomic_inc_return(&sim->done) == sim->count)
+		complete(&sim->bench_done);
+}
+
+static int sim_bench_send(struct hsspi_block *blk)
+{
+	ktime_t now = ktime_get();
+
+	blk->length = sim->length;
+	blk->size = sim->length;
+	memcpy(blk->data, &now, sizeof(now));
+	return hsspi_send(&sim->hsspi, &sim->layer, blk);
+}
+
+static void sim_bench_next(struct hsspi_block *blk)
+{
+	if (atomic_inc_return(&sim->sent) > sim->count) {
+		sim_blk_put(blk);
+		return;
+	}
+
+	if (sim_bench_send(blk)) {
+		sim_blk_put(blk);
+		sim_bench_account(1);
+	}
+}
+
+static int sim_layer_registered(struct hsspi_layer *layer)
+{
+	return 0;
+}
+
+static void sim_layer_unregistered(struct hsspi_layer *layer)
+{
+}
+
+static struct hsspi_block *sim_layer_get(struct hsspi_layer *layer,
+					 u16 length)
+{
+	struct sim_blk *sblk;
+
+	if (length > SIM_MAX_PAYLOAD)
+		return NULL;
+
+	sblk = sim_blk_get();
+	if (!sblk)
+		return NULL;
+
+	sblk->blk.length = length;
+	sblk->blk.size = length;
+	return &sblk->blk;
+}
+
+static void sim_layer_received(struct hsspi_layer *layer,
+			       struct hsspi_block *blk, int status)
+{
+	ktime_t sent;
+	u64 us;
+
+	if (status || blk->length < sizeof(sent)) {
+		sim_blk_put(blk);
+		sim_bench_account(1);
+		return;
+	}
+
+	memcpy(&sent, blk->data, sizeof(sent));
+	us = ktime_us_delta(ktime_get(), sent);
+
+	/* Only the HSSPI thread calls this */
+	mmi_lat_hist_add(&sim->lat, us);
+	if (us < sim->lat_min_us)
+		sim->lat_min_us = us;
+
+	sim_bench_account(0);
+	sim_bench_next(blk);
+}
+
+static void sim_layer_sent(struct hsspi_layer *layer, struct hsspi_block *blk,
+			   int status)
+{
+	sim_blk_put(blk);
+	if (status)
+		sim_bench_account(1);
+}
+
+static const struct hsspi_layer_ops sim_layer_ops = {
+	.registered = sim_layer_registered,
+	.unregistered = sim_layer_unregistered,
+	.get = sim_layer_get,
+	.received = sim_layer_received,
+	.sent = sim_layer_sent,
+};
+
+/* Log upper layer, the blocks go through the same ring as the QM35 logs */
+
+static struct hsspi_block *sim_log_get(struct hsspi_layer *layer, u16 length)
+{
+	return hsspi_rx_ring_get(&sim->log_rx, length);
+}
+
+static void sim_log_received(struct hsspi_layer *layer,
+			     struct hsspi_block *blk, int status)
+{
+	hsspi_rx_ring_received(&sim->log_rx, blk, status);
+}
+
+static void sim_log_sent(struct hsspi_layer *layer, struct hsspi_block *blk,
+			 int status)
+{
+}
+
+static void sim_log_consume(struct hsspi_rx_ring *ring,
+			    struct hsspi_block *blk)
+{
+	u32 us = READ_ONCE(sim->flood_consume_us);
+
+	if (us)
+		usleep_range(us, us + 10);
+	sim->log_consumed++;
+}
+
+static const struct hsspi_layer_ops sim_log_ops = {
+	.registered = sim_layer_registered,
+	.unregistered = sim_layer_unregistered,
+	.get = sim_log_get,
+	.received = sim_log_received,
+	.sent = sim_log_sent,
+};
+
+/*
+ * UCI upper layer, either the UCI RX ring or the former path: a kzalloc'd
+ * block per reception, a kzalloc'd packet for each extra UCI packet it
+ * holds, all linked under a mutex until read.
+ */
+
+static struct hsspi_block *sim_uci_list_get(u16 length)
+{
+	struct sim_uci_pkt *sp;
+
+	sp = kzalloc(sizeof(*sp), GFP_KERNEL);
+	if (!sp)
+		return NULL;
+
+	if (hsspi_init_block(&sp->p.blk, length)) {
+		kfree(sp);
+		return NULL;
+	}
+
+	return &sp->p.blk;
+}
+
+static void sim_uci_list_free(struct sim_uci_pkt *sp)
+{
+	hsspi_deinit_block(&sp->p.blk);
+	kfree(sp);
+}
+
+static void sim_uci_list_add(struct sim_uci_pkt *sp)
+{
+	mutex_lock(&sim->uci_list_lock);
+	list_add_tail(&sp->list, &sim->uci_list);
+	if (++sim->uci_list_len > sim->uci_list_max)
+		sim->uci_list_max = sim->uci_list_len;
+	mutex_unlock(&sim->uci_list_lock);
+}
+
+static void sim_uci_list_received(struct hsspi_block *blk, int status)
+{
+	struct sim_uci_pkt *sp = container_of(blk, struct sim_uci_pkt, p.blk);
+	struct sim_uci_pkt *next;
+	size_t readn = 0, length;
+	const u8 *hdr;
+
+	if (status) {
+		sim_uci_list_free(sp);
+		return;
+	}
+
+	/* The flood only sends control packets, with an 8-bit length */
+	while (blk->length - readn >= SIM_UCI_HDR_LEN) {
+		hdr = (const u8 *)blk->data + readn;
+		length = SIM_UCI_HDR_LEN + hdr[SIM_UCI_HDR_LEN - 1];
+		if (blk->length - readn <= length)
+			break;
+
+		next = kzalloc(sizeof(*next), GFP_KERNEL);
+		if (!next)
+			break;
+
+		next->p.data = blk->data + readn;
+		next->p.length = length;
+		readn += length;
+		sim_uci_list_add(next);
+	}
+
+	sp->p.data = blk->data + readn;
+	sp->p.length = blk->length - readn;
+	sim_uci_list_add(sp);
+}
+
+/* Like the former uci_read(): unlink, copy, free */
+static ssize_t sim_uci_list_read(char __user *buf)
+{
+	struct sim_uci_pkt *sp;
+	ssize_t ret;
+
+	mutex_lock(&sim->uci_list_lock);
+	sp = list_first_entry_or_null(&sim->uci_list, struct sim_uci_pkt,
+				      list);
+	if (sp) {
+		list_del(&sp->list);
+		sim->uci_list_len--;
+	}
+	mutex_unlock(&sim->uci_list_lock);
+
+	if (!sp)
+		return -EAGAIN;
+
+	ret = copy_to_user(buf, sp->p.data, sp->p.length) ? -EFAULT :
+							     sp->p.length;
+	sim_uci_list_free(sp);
+	return ret;
+}
+
+static void sim_uci_list_clear(void)
+{
+	struct sim_uci_pkt *sp, *tmp;
+
+	mutex_lock(&sim->uci_list_lock);
+	list_for_each_entry_safe(sp, tmp, &sim->uci_list, list) {
+		list_del(&sp->list);
+		sim_uci_list_free(sp);
+	}
+	sim->uci_list_len = 0;
+	mutex_unlock(&sim->uci_list_lock);
+}
+
+static bool sim_uci_has_data(void)
+{
+	bool ret;
+
+	if (!sim->uci_use_list)
+		return uci_layer_has_data_available(&sim->uci);
+
+	mutex_lock(&sim->uci_list_lock);
+	ret = !list_empty(&sim->uci_list);
+	mutex_unlock(&sim->uci_list_lock);
+	return ret;
+}
+
+/* One more block received or dropped, the reader may be done */
+static void sim_uci_block_done(void)
+{
+	WRITE_ONCE(sim->uci_blocks, sim->uci_blocks + 1);
+	wake_up_interruptible(&sim->uci.wq);
+}
+
+static struct hsspi_block *sim_uci_get(struct hsspi_layer *layer,
+				       u16 length)
+{
+	struct hsspi_layer *hlayer = &sim->uci.hlayer;
+	struct hsspi_block *blk;
+	u64 start = ktime_get_ns();
+
+	if (sim->uci_use_list)
+		blk = sim_uci_list_get(length);
+	else
+		blk = hlayer->ops->get(hlayer, length);
+
+	sim->uci_rx_ns += ktime_get_ns() - start;
+	if (!blk) {
+		sim->uci_dropped++;
+		sim_uci_block_done();
+	}
+	return blk;
+}
+
+static void sim_uci_received(struct hsspi_layer *layer,
+			     struct hsspi_block *blk, int status)
+{
+	struct hsspi_layer *hlayer = &sim->uci.hlayer;
+	u64 start = ktime_get_ns();
+
+	if (sim->uci_use_list)
+		sim_uci_list_received(blk, status);
+	else
+		hlayer->ops->received(hlayer, blk, status);
+
+	sim->uci_rx_ns += ktime_get_ns() - start;
+	sim_uci_block_done();
+}
+
+static void sim_uci_sent(struct hsspi_layer *layer, struct hsspi_block *blk,
+			 int status)
+{
+}
+
+static const struct hsspi_layer_ops sim_uci_ops = {
+	.registered = sim_layer_registered,
+	.unregistered = sim_layer_unregistered,
+	.get = sim_uci_get,
+	.received = sim_uci_received,
+	.sent = sim_uci_sent,
+};
+
+static void sim_uci_clear(void)
+{
+	struct hsspi_layer *hlayer = &sim->uci.hlayer;
+
+	sim_uci_list_clear();
+	hlayer->ops->unregistered(hlayer);
+}
+
+/* Notifications of length bytes, GID 0, OID counting up */
+static void sim_uci_build(u32 pkts, u32 length)
+{
+	u8 *p = sim->uci_tmpl;
+	u32 i;
+
+	for (i = 0; i < pkts; i++) {
+		p[0] = 0x60;
+		p[1] = i;
+		p[2] = 0;
+		p[3] = length;
+		memset(p + SIM_UCI_HDR_LEN, i, length);
+		p += SIM_UCI_HDR_LEN + length;
+	}
+
+	sim->uci_tmpl_len = p - sim->uci_tmpl;
+}
+
+static int sim_uci_drain(char __user *buf, u32 count, u32 consume_us)
+{
+	u64 start;
+	ssize_t ret;
+	long wret;
+
+	for (;;) {
+		start = ktime_get_ns();
+		if (sim->uci_use_list)
+			ret = sim_uci_list_read(buf);
+		else
+			ret = uci_layer_read(&sim->uci, buf, SIM_MAX_PAYLOAD,
+					     true);
+
+		if (ret > 0) {
+			sim->uci_read_ns += ktime_get_ns() - start;
+			sim->uci_read++;
+			if (consume_us)
+				usleep_range(consume_us, consume_us + 10);
+			continue;
+		}
+
+		if (ret != -EAGAIN)
+			return ret;
+
+		if (READ_ONCE(sim->uci_blocks) >= count && !sim_uci_has_data())
+			return 0;
+
+		wret = wait_event_interruptible_timeout(sim->uci.wq,
+			sim_uci_has_data() || READ_ONCE(sim->uci_blocks) >= count,
+			msecs_to_jiffies(SIM_UCI_TIMEOUT_MS));
+		if (wret < 0)
+			return wret;
+		if (!wret)
+			return -ETIMEDOUT;
+	}
+}
+
+static int sim_uci_run(bool use_list, u32 count, u32 pkts, u32 length,
+		       u32 consume_us)
+{
+	unsigned long addr;
+	ktime_t start;
+	u32 dropped;
+
+	if (!count || !pkts || length > SIM_UCI_MAX_PAYLOAD ||
+	    pkts * (SIM_UCI_HDR_LEN + length) > SIM_MAX_PAYLOAD)
+		return -EINVAL;
+
+	/* Read back into a user buffer, as the /dev/uci reader would */
+	addr = vm_mmap(NULL, 0, SIM_MAX_PAYLOAD, PROT_READ | PROT_WRITE,
+		       MAP_ANONYMOUS | MAP_PRIVATE, 0);
+	if (IS_ERR_VALUE(addr))
+		return -ENOMEM;
+
+	mutex_lock(&sim->uci_lock);
+
+	sim_uci_clear();
+	sim->uci_use_list = use_list;
+	sim->uci_count = count;
+	sim->uci_pkts = pkts;
+	sim->uci_length = length;
+	sim->uci_consume_us = consume_us;
+	sim->uci_blocks = 0;
+	sim->uci_dropped = 0;
+	sim->uci_list_max = 0;
+	sim->uci_rx_ns = 0;
+	sim->uci_read = 0;
+	sim->uci_read_ns = 0;
+	dropped = READ_ONCE(sim->uci.dropped);
+	sim_uci_build(pkts, length);
+
+	start = ktime_get();
+	spin_lock(&sim->lock);
+	sim->uci_left = count;
+	sim_queue_uci(sim);
+	spin_unlock(&sim->lock);
+	hsspi_set_output_data_waiting(&sim->hsspi);
+
+	sim->uci_status = sim_uci_drain((char __user *)addr, count,
+					consume_us);
+	sim->uci_elapsed_us = ktime_us_delta(ktime_get(), start);
+	sim->uci_ring_dropped = READ_ONCE(sim->uci.dropped) - dropped;
+
+	/* Whatever an aborted run left is not for the next one */
+	spin_lock(&sim->lock);
+	sim->uci_left = 0;
+	spin_unlock(&sim->lock);
+
+	mutex_unlock(&sim->uci_lock);
+	vm_munmap(addr, SIM_MAX_PAYLOAD);
+
+	return sim->uci_status;
+}
+
+static ssize_t sim_uci_flood_write(struct file *filp,
+				   const char __user *buff, size_t count,
+				   loff_t *off)
+{
+	u32 n, pkts, length, consume_us = 0;
+	char buf[48], mode[8];
+	bool use_list;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buff, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	if (sscanf(buf, "%7s %u %u %u %u", mode, &n, &pkts, &length,
+		   &consume_us) < 4)
+		return -EINVAL;
+
+	if (!strcmp(mode, "list"))
+		use_list = true;
+	else if (!strcmp(mode, "ring"))
+		use_list = false;
+	else
+		return -EINVAL;
+
+	ret = sim_uci_run(use_list, n, pkts, length, consume_us);
+	return ret ? ret : count;
+}
+
+static u64 sim_div(u64 n, u64 d)
+{
+	return d ? div64_u64(n, d) : 0;
+}
+
+static int sim_uci_flood_show(struct seq_file *s, void *unused)
+{
+	u64 rx_pkts;
+
+	mutex_lock(&sim->uci_lock);
+
+	rx_pkts = (u64)(sim->uci_blocks - sim->uci_dropped) * sim->uci_pkts;
+	seq_printf(s, "uci flood: %s blocks %u x %u pkts length %u consume %u us status %d\n",
+		   sim->uci_use_list ? "list" : "ring", sim->uci_count,
+		   sim->uci_pkts, sim->uci_length, sim->uci_consume_us,
+		   sim->uci_status);
+	seq_printf(s, "blocks: %u dropped %u (ring full %u)\n",
+		   sim->uci_blocks, sim->uci_dropped, sim->uci_ring_dropped);
+	seq_printf(s, "pkts: received %llu read %llu\n", rx_pkts,
+		   sim->uci_read);
+	seq_printf(s, "hsspi thread: %llu ns/pkt\n",
+		   sim_div(sim->uci_rx_ns, rx_pkts));
+	seq_printf(s, "reader: %llu ns/pkt\n",
+		   sim_div(sim->uci_read_ns, sim->uci_read));
+	seq_printf(s, "rate: %llu pkts/s\n",
+		   sim_div(sim->uci_read * USEC_PER_SEC, sim->uci_elapsed_us));
+	if (sim->uci_use_list)
+		seq_printf(s, "list max: %u pkts\n", sim->uci_list_max);
+
+	mutex_unlock(&sim->uci_lock);
+	return 0;
+}
+
+static int sim_uci_flood_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_uci_flood_show, inode->i_private);
+}
+
+static const struct file_operations sim_uci_flood_fops = {
+	.owner = THIS_MODULE,
+	.open = sim_uci_flood_open,
+	.read = seq_read,
+	.write = sim_uci_flood_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int sim_bench_run(u32 count, u32 depth, u32 length)
+{
+	ktime_t start;
+	long ret;
+	int i;
+
+	if (!count || !depth || depth > SIM_BENCH_MAX_DEPTH ||
+	    depth > count || length < sizeof(ktime_t) ||
+	    length > SIM_MAX_PAYLOAD)
+		return -EINVAL;
+
+	mutex_lock(&sim->bench_lock);
+
+	sim->count = count;
+	sim->depth = depth;
+	sim->length = length;
+	atomic_set(&sim->sent, depth);
+	atomic_set(&sim->done, 0);
+	atomic_set(&sim->errors, 0);
+	memset(&sim->lat, 0, sizeof(sim->lat));
+	sim->lat_min_us = U64_MAX;
+	reinit_completion(&sim->bench_done);
+
+	start = ktime_get();
+	for (i = 0; i < depth; i++) {
+		struct sim_blk *sblk = sim_blk_get();
+
+		if (!sblk || sim_bench_send(&sblk->blk)) {
+			if (sblk)
+				sim_blk_put(&sblk->blk);
+			sim_bench_account(1);
+		}
+	}
+
+	ret = wait_for_completion_interruptible_timeout(
+		&sim->bench_done, msecs_to_jiffies(SIM_BENCH_TIMEOUT_MS));
+	sim->elapsed_us = ktime_us_delta(ktime_get(), start);
+
+	mutex_unlock(&sim->bench_lock);
+
+	if (ret < 0)
+		return ret;
+
+	return ret ? 0 : -ETIMEDOUT;
+}
+
+static ssize_t sim_bench_write(struct file *filp, const char __user *buff,
+			       size_t count, loff_t *off)
+{
+	char buf[32];
+	u32 n, depth, length;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buff, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	if (sscanf(buf, "%u %u %u", &n, &depth, &length) != 3)
+		return -EINVAL;
+
+	ret = sim_bench_run(n, depth, length);
+	return ret ? ret : count;
+}
+
+static int sim_bench_show(struct seq_file *s, void *unused)
+{
+	u32 done = atomic_read(&sim->done);
+	u32 errors = atomic_read(&sim->errors);
+	u32 ok = done - errors;
+
+	mutex_lock(&sim->bench_lock);
+
+	seq_printf(s, "msgs: %u/%u depth %u length %u errors %u dropped %llu\n",
+		   done, sim->count, sim->depth, sim->length, errors,
+		   sim->dropped);
+	seq_printf(s, "log flood: length %u sent %llu consumed %llu\n",
+		   sim->flood_length, sim->flood_sent, sim->log_consumed);
+	hsspi_rx_ring_show_stats(&sim->log_rx, s);
+	seq_printf(s, "rate: %llu msgs/s\n",
+		   sim->elapsed_us ?
+			   div64_u64((u64)ok * USEC_PER_SEC, sim->elapsed_us) :
+			   0);
+	if (sim->lat.count) {
+		seq_printf(s, "latency min: %llu us\n", sim->lat_min_us);
+		mmi_lat_hist_show(s, "latency", &sim->lat);
+	}
+
+	mutex_unlock(&sim->bench_lock);
+	return 0;
+}
+
+static int sim_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_bench_show, inode->i_private);
+}
+
+static const struct file_operations sim_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = sim_bench_open,
+	.read = seq_read,
+	.write = sim_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t sim_log_flood_write(struct file *filp, const char __user *buff,
+				   size_t count, loff_t *off)
+{
+	u32 length, consume_us = 0;
+	char buf[32];
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buff, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	if (sscanf(buf, "%u %u", &length, &consume_us) < 1)
+		return -EINVAL;
+
+	if (length > SIM_MAX_PAYLOAD)
+		return -EINVAL;
+
+	spin_lock(&sim->lock);
+	sim->flood_length = length;
+	sim->flood_consume_us = consume_us;
+	if (length) {
+		sim->flood_sent = 0;
+		sim->log_consumed = 0;
+		sim_queue_flood(sim);
+	}
+	spin_unlock(&sim->lock);
+
+	if (length)
+		hsspi_set_output_data_waiting(&sim->hsspi);
+
+	return count;
+}
+
+static const struct file_operations sim_log_flood_fops = {
+	.owner = THIS_MODULE,
+	.write = sim_log_flood_write,
+};
+
+static int sim_hsspi_stats_show(struct seq_file *s, void *unused)
+{
+	hsspi_show_stats(&sim->hsspi, s);
+	return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(sim_hsspi_stats);
+
+int hsspi_sim_init(void)
+{
+	struct spi_board_info info = {
+		.modalias = "qm35-stc-sim",
+		.max_speed_hz = 20000000,
+	};
+	struct spi_device *spi;
+	int i, ret;
+
+	sim = kzalloc(sizeof(*sim), GFP_KERNEL);
+	if (!sim)
+		return -ENOMEM;
+
+	spin_lock_init(&sim->lock);
+	mutex_init(&sim->bench_lock);
+	init_completion(&sim->bench_done);
+	INIT_LIST_HEAD(&sim->free_blks);
+	mutex_init(&sim->uci_lock);
+	mutex_init(&sim->uci_list_lock);
+	INIT_LIST_HEAD(&sim->uci_list);
+
+	sim->blks = kcalloc(SIM_BENCH_BLOCKS, sizeof(*sim->blks), GFP_KERNEL);
+	if (!sim->blks) {
+		ret = -ENOMEM;
+		goto free_sim;
+	}
+
+	for (i = 0; i < SIM_BENCH_BLOCKS; i++) {
+		sim->blks[i].blk.data = sim->blks[i].data;
+		list_add_tail(&sim->blks[i].list, &sim->free_blks);
+	}
+
+	sim->pdev = platform_device_register_simple("qm35-stc-sim", -1, NULL,
+						    0);
+	if (IS_ERR(sim->pdev)) {
+		ret = PTR_ERR(sim->pdev);
+		goto free_blks;
+	}
+
+	sim->ctlr = spi_alloc_master(&sim->pdev->dev, 0);
+	if (!sim->ctlr) {
+		ret = -ENOMEM;
+		goto unregister_pdev;
+	}
+
+	sim->ctlr->bus_num = -1;
+	sim->ctlr->num_chipselect = 1;
+	sim->ctlr->mode_bits = SPI_CPOL | SPI_CPHA;
+	sim->ctlr->transfer_one_message = sim_transfer_one_message;
+
+	ret = spi_register_controller(sim->ctlr);
+	if (ret) {
+		spi_controller_put(sim->ctlr);
+		goto unregister_pdev;
+	}
+
+	spi = spi_new_device(sim->ctlr, &info);
+	if (!spi) {
+		ret = -ENODEV;
+		goto unregister_ctlr;
+	}
+
+	ret = hsspi_init(&sim->hsspi, spi);
+	if (ret)
+		goto unregister_ctlr;
+
+	sim->hsspi.odw_cleared = sim_odw_cleared;
+	sim->hsspi.wakeup = sim_wakeup;
+	sim->hsspi.reset_qm35 = sim_reset;
+	hsspi_set_gpios(&sim->hsspi, NULL, NULL);
+
+	sim->layer.name = "hsspi_sim_bench";
+	sim->layer.id = UL_TEST_HSSPI;
+	sim->layer.ops = &sim_layer_ops;
+	ret = hsspi_register(&sim->hsspi, &sim->layer);
+	if (ret)
+		goto deinit_hsspi;
+
+	ret = hsspi_rx_ring_init(&sim->log_rx, SIM_LOG_RX_SLOTS,
+				 SIM_MAX_PAYLOAD, sim_log_consume);
+	if (ret)
+		goto unregister_layer;
+
+	sim->log_layer.name = "hsspi_sim_log";
+	sim->log_layer.id = UL_LOG;
+	sim->log_layer.prio = HSSPI_PRIO_LOG;
+	sim->log_layer.ops = &sim_log_ops;
+	ret = hsspi_register(&sim->hsspi, &sim->log_layer);
+	if (ret)
+		goto deinit_log_rx;
+
+	/* The sim layer runs the UCI layer ops itself, to time them */
+	ret = uci_layer_init(&sim->uci);
+	if (ret)
+		goto unregister_log;
+
+	sim->uci_hlayer.name = "hsspi_sim_uci";
+	sim->uci_hlayer.id = UL_UCI_APP;
+	sim->uci_hlayer.prio = HSSPI_PRIO_UCI;
+	sim->uci_hlayer.ops = &sim_uci_ops;
+	ret = hsspi_register(&sim->hsspi, &sim->uci_hlayer);
+	if (ret)
+		goto deinit_uci;
+
+	hsspi_set_spi_slave_ready(&sim->hsspi);
+	hsspi_start(&sim->hsspi);
+
+	sim->dir = debugfs_create_dir("qm35_stc_sim", NULL);
+	debugfs_create_file("bench", 0600, sim->dir, sim, &sim_bench_fops);
+	debugfs_create_file("log_flood", 0200, sim->dir, sim,
+			    &sim_log_flood_fops);
+	debugfs_create_file("hsspi_stats", 0444, sim->dir, sim,
+			    &sim_hsspi_stats_fops);
+	debugfs_create_file("uci_flood", 0600, sim->dir, sim,
+			    &sim_uci_flood_fops);
+
+	dev_info(&spi->dev, "QM35 STC simulator ready\n");
+	return 0;
+
+deinit_uci:
+	uci_layer_deinit(&sim->uci);
+unregister_log:
+	hsspi_unregister(&sim->hsspi, &sim->log_layer);
+deinit_log_rx:
+	hsspi_rx_ring_deinit(&sim->log_rx);
+unregister_layer:
+	hsspi_unregister(&sim->hsspi, &sim->layer);
+deinit_hsspi:
+	hsspi_deinit(&sim->hsspi);
+unregister_ctlr:
+	spi_unregister_controller(sim->ctlr);
+unregister_pdev:
+	platform_device_unregister(sim->pdev);
+free_blks:
+	kfree(sim->blks);
+free_sim:
+	kfree(sim);
+	sim = NULL;
+	return ret;
+}
+
+void hsspi_sim_exit(void)
+{
+	if (!sim)
+		return;
+
+	debugfs_remove_recursive(sim->dir);
+	spin_lock(&sim->lock);
+	sim->flood_length = 0;
+	spin_unlock(&sim->lock);
+	hsspi_stop(&sim->hsspi);
+	hsspi_unregister(&sim->hsspi, &sim->uci_hlayer);
+	sim_uci_list_clear();
+	uci_layer_deinit(&sim->uci);
+	hsspi_unregister(&sim->hsspi, &sim->log_layer);
+	hsspi_rx_ring_deinit(&sim->log_rx);
+	hsspi_unregister(&sim->hsspi, &sim->layer);
+	hsspi_deinit(&sim->hsspi);
+	spi_unregister_controller(sim->ctlr);
+	platform_device_unregister(sim->pdev);
+	kfree(sim->blks);
+	kfree(sim);
+	sim = NULL;
+}
@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * QM35 HSSPI simulated SPI controller
+ */
+
+#ifndef __HSSPI_SIM_H___
+#define __HSSPI_SIM_H___
+
+int hsspi_sim_init(void);
+void hsspi_sim_exit(void);
+
+#endif /* __HSSPI_SIM_H___ */
@@ -26,9 +26,17 @@
  * QM35 UCI layer HSSPI Protocol
  */
 
+#include <linux/mm.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+
 #include "qm35.h"
 #include "hsspi_uci.h"
 
+/* 64KB of records */
+#define UCI_RX_RING_ORDER (4)
+#define UCI_RX_RING_SIZE (PAGE_SIZE << UCI_RX_RING_ORDER)
+
 struct uci_packet *uci_packet_alloc(u16 length)
 {
 	struct uci_packet *p;
@@ -53,23 +61,25 @@ void uci_packet_free(struct uci_packet *p)
 	kfree(p);
 }
 
+static inline u32 uci_rec_size(u16 length)
+{
+	return ALIGN(sizeof(struct uci_rx_rec) + length, UCI_RX_REC_ALIGN);
+}
+
 static int uci_registered(struct hsspi_layer *layer)
 {
 	return 0;
 }
 
-static void clear_rx_list(struct uci_layer *uci)
+/* Drop everything not read yet, unless userspace owns the tail */
+static void clear_rx_ring(struct uci_layer *uci)
 {
-	struct uci_packet *p;
-
 	mutex_lock(&uci->lock);
 
-	while (!list_empty(&uci->rx_list)) {
-		p = list_first_entry(&uci->rx_list, struct uci_packet, list);
-
-		list_del(&p->list);
-
-		uci_packet_free(p);
+	if (!atomic_read(&uci->mapped)) {
+		smp_store_release(&uci->ring_tail->tail,
+				  smp_load_acquire(&uci->head));
+		uci->rd_off = 0;
 	}
 
 	mutex_unlock(&uci->lock);
@@ -81,18 +91,58 @@ static void uci_unregistered(struct hsspi_layer *hlayer)
 {
 	struct uci_layer *uci = container_of(hlayer, struct uci_layer, hlayer);
 
-	clear_rx_list(uci);
+	clear_rx_ring(uci);
 }
 
-static struct hsspi_block *uci_get(struct hsspi_layer *hlayer, u16 length)
+/* The tail may come from userspace, never trust it blindly */
+static bool uci_tail_valid(u32 head, u32 tail)
 {
-	struct uci_packet *p;
+	return head - tail <= UCI_RX_RING_SIZE &&
+	       !(tail & (UCI_RX_REC_ALIGN - 1));
+}
 
-	p = uci_packet_alloc(length);
-	if (!p)
+/*
+ * Reserve room for a record in the RX ring, the HSSPI receives in there
+ * and uci_received publishes it. Called from the HSSPI thread only.
+ */
+static struct hsspi_block *uci_get(struct hsspi_layer *hlayer, u16 length)
+{
+	struct uci_layer *uci = container_of(hlayer, struct uci_layer, hlayer);
+	u32 size = UCI_RX_RING_SIZE;
+	u32 head = uci->head;
+	u32 tail = READ_ONCE(uci->ring_tail->tail);
+	u32 used = head - tail;
+	u32 off = head & (size - 1);
+	u32 need = uci_rec_size(length);
+	u32 pad = size - off < need ? size - off : 0;
+	struct uci_rx_rec *rec;
+
+	/* A bogus tail from userspace counts as a full ring */
+	if (!uci_tail_valid(head, tail) || used + pad + need > size) {
+		WRITE_ONCE(uci->ring->dropped, ++uci->dropped);
+		pr_warn_ratelimited("qm35: uci rx ring full, %hu bytes dropped\n",
+				    length);
 		return NULL;
+	}
 
-	return &p->blk;
+	if (pad) {
+		rec = (struct uci_rx_rec *)(uci->ring_data + off);
+		rec->length = 0;
+		rec->flags = UCI_RX_REC_WRAP;
+		head += pad;
+		off = 0;
+	}
+
+	rec = (struct uci_rx_rec *)(uci->ring_data + off);
+	rec->length = 0;
+	rec->flags = 0;
+
+	uci->rx_rec = rec;
+	uci->rx_next = head + need;
+	uci->rx_blk.data = rec + 1;
+	uci->rx_blk.length = length;
+	uci->rx_blk.size = length;
+	return &uci->rx_blk;
 }
 
 static void uci_sent(struct hsspi_layer *hlayer, struct hsspi_block *blk,
@@ -119,55 +169,41 @@ static size_t get_payload_size_from_header(const u8 *header)
 
 #define UCI_PACKET_HEADER_SIZE (4)
 
-static void uci_received(struct hsspi_layer *hlayer, struct hsspi_block *blk,
-			 int status)
+/*
+ * Length of the UCI packet at data. A block may hold several packets,
+ * anything that does not parse as a complete one is returned as is.
+ */
+static size_t uci_packet_length(const u8 *data, size_t remaining)
 {
-	struct uci_layer *uci = container_of(hlayer, struct uci_layer, hlayer);
-	struct uci_packet *p = container_of(blk, struct uci_packet, blk);
-
-	if (status)
-		uci_packet_free(p);
-	else {
-		struct uci_packet *next;
-		size_t readn = 0;
-		size_t payload_size;
-
-		while (1) {
-			if (blk->length - readn < UCI_PACKET_HEADER_SIZE)
-				// Incomplete UCI header
-				break;
+	size_t length;
 
-			payload_size = get_payload_size_from_header(
-				(u8 *)blk->data + readn);
+	if (remaining < UCI_PACKET_HEADER_SIZE)
+		// Incomplete UCI header
+		return remaining;
 
-			if (blk->length - readn <=
-			    UCI_PACKET_HEADER_SIZE + payload_size)
-				// blk contains no additional packet
-				break;
+	length = UCI_PACKET_HEADER_SIZE + get_payload_size_from_header(data);
+	if (remaining <= length)
+		// blk contains no additional packet
+		return remaining;
 
-			next = kzalloc(sizeof(*next), GFP_KERNEL);
-			if (!next)
-				break;
-
-			next->data = p->blk.data + readn;
-			next->length = UCI_PACKET_HEADER_SIZE + payload_size;
-
-			readn += next->length;
+	return length;
+}
 
-			mutex_lock(&uci->lock);
-			list_add_tail(&next->list, &uci->rx_list);
-			mutex_unlock(&uci->lock);
-		}
+static void uci_received(struct hsspi_layer *hlayer, struct hsspi_block *blk,
+			 int status)
+{
+	struct uci_layer *uci = container_of(hlayer, struct uci_layer, hlayer);
 
-		p->data = p->blk.data + readn;
-		p->length = p->blk.length - readn;
+	/* On error the reservation is just not published */
+	if (status)
+		return;
 
-		mutex_lock(&uci->lock);
-		list_add_tail(&p->list, &uci->rx_list);
-		mutex_unlock(&uci->lock);
+	uci->rx_rec->length = blk->length;
+	uci->head = uci->rx_next;
+	/* Record and data must be visible before the new head */
+	smp_store_release(&uci->ring->head, uci->head);
 
-		wake_up_interruptible(&uci->wq);
-	}
+	wake_up_interruptible(&uci->wq);
 }
 
 static const struct hsspi_layer_ops uci_ops = {
@@ -182,52 +218,227 @@ int uci_layer_init(struct uci_layer *uci)
 {
 	uci->hlayer.name = "UCI";
 	uci->hlayer.id = UL_UCI_APP;
+	uci->hlayer.prio = HSSPI_PRIO_UCI;
 	uci->hlayer.ops = &uci_ops;
 
-	INIT_LIST_HEAD(&uci->rx_list);
+	uci->ring = (struct uci_rx_ring_hdr *)get_zeroed_page(GFP_KERNEL);
+	if (!uci->ring)
+		return -ENOMEM;
+
+	uci->ring_tail = (struct uci_rx_ring_tail *)get_zeroed_page(GFP_KERNEL);
+	if (!uci->ring_tail)
+		goto free_ring;
+
+	/* Physically contiguous, so that the SPI DMA can write in there */
+	uci->ring_data = (u8 *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+						UCI_RX_RING_ORDER);
+	if (!uci->ring_data)
+		goto free_tail;
+
+	/* Only informative for userspace, the driver uses UCI_RX_RING_SIZE */
+	uci->ring->size = UCI_RX_RING_SIZE;
+	uci->head = 0;
+	uci->dropped = 0;
+	uci->rd_off = 0;
+	atomic_set(&uci->mapped, 0);
 	mutex_init(&uci->lock);
 	init_waitqueue_head(&uci->wq);
 	return 0;
+
+free_tail:
+	free_page((unsigned long)uci->ring_tail);
+	uci->ring_tail = NULL;
+free_ring:
+	free_page((unsigned long)uci->ring);
+	uci->ring = NULL;
+	return -ENOMEM;
 }
 
 void uci_layer_deinit(struct uci_layer *uci)
 {
-	clear_rx_list(uci);
+	if (!uci->ring)
+		return;
+
+	clear_rx_ring(uci);
+	free_pages((unsigned long)uci->ring_data, UCI_RX_RING_ORDER);
+	free_page((unsigned long)uci->ring_tail);
+	free_page((unsigned long)uci->ring);
+	uci->ring_data = NULL;
+	uci->ring_tail = NULL;
+	uci->ring = NULL;
 }
 
 bool uci_layer_has_data_available(struct uci_layer *uci)
 {
-	bool ret;
+	return smp_load_acquire(&uci->head) != READ_ONCE(uci->ring_tail->tail);
+}
 
-	mutex_lock(&uci->lock);
-	ret = !list_empty(&uci->rx_list);
-	mutex_unlock(&uci->lock);
-	return ret;
+/*
+ * Get the record at the tail, skipping the wrap markers, and its index in
+ * @tailp. Must be called with uci->lock held.
+ */
+static struct uci_rx_rec *uci_ring_peek(struct uci_layer *uci, u32 *tailp)
+{
+	u32 size = UCI_RX_RING_SIZE;
+	u32 head = smp_load_acquire(&uci->head);
+	u32 tail = READ_ONCE(uci->ring_tail->tail);
+	struct uci_rx_rec *rec;
+	u32 off;
+
+	/* Userspace may have left anything in there */
+	if (!uci_tail_valid(head, tail)) {
+		pr_err("qm35: uci rx ring tail %u out of range, resync\n",
+		       tail);
+		tail = head;
+		uci->rd_off = 0;
+		smp_store_release(&uci->ring_tail->tail, tail);
+	}
+
+	while (tail != head) {
+		off = tail & (size - 1);
+		rec = (struct uci_rx_rec *)(uci->ring_data + off);
+		if (!(rec->flags & UCI_RX_REC_WRAP)) {
+			*tailp = tail;
+			return rec;
+		}
+
+		tail += size - off;
+		smp_store_release(&uci->ring_tail->tail, tail);
+	}
+
+	return NULL;
 }
 
-struct uci_packet *uci_layer_read(struct uci_layer *uci, size_t max_size,
-				  bool non_blocking)
+ssize_t uci_layer_read(struct uci_layer *uci, char __user *buf,
+		       size_t max_size, bool non_blocking)
 {
-	struct uci_packet *p;
-	int ret;
+	struct uci_rx_rec *rec;
+	size_t length;
+	ssize_t ret;
+	u32 tail;
+	u8 *data;
+
+	if (atomic_read(&uci->mapped))
+		return -EBUSY;
 
 	if (!non_blocking) {
 		ret = wait_event_interruptible(
 			uci->wq, uci_layer_has_data_available(uci));
 		if (ret)
-			return ERR_PTR(ret);
+			return ret;
 	}
 
 	mutex_lock(&uci->lock);
-	p = list_first_entry_or_null(&uci->rx_list, struct uci_packet, list);
-	if (p) {
-		if (p->length > max_size)
-			p = ERR_PTR(-EMSGSIZE);
-		else
-			list_del(&p->list);
-	} else
-		p = ERR_PTR(-EAGAIN);
 
+	rec = uci_ring_peek(uci, &tail);
+	if (!rec) {
+		ret = -EAGAIN;
+		goto unlock;
+	}
+
+	data = (u8 *)(rec + 1) + uci->rd_off;
+	length = uci_packet_length(data, rec->length - uci->rd_off);
+	if (length > max_size) {
+		ret = -EMSGSIZE;
+		goto unlock;
+	}
+
+	if (copy_to_user(buf, data, length)) {
+		ret = -EFAULT;
+		goto unlock;
+	}
+
+	ret = length;
+	uci->rd_off += length;
+	if (uci->rd_off >= rec->length) {
+		uci->rd_off = 0;
+		smp_store_release(&uci->ring_tail->tail,
+				  tail + uci_rec_size(rec->length));
+	}
+
+unlock:
 	mutex_unlock(&uci->lock);
-	return p;
+	return ret;
+}
+
+static void uci_vma_open(struct vm_area_struct *vma)
+{
+	struct uci_layer *uci = vma->vm_private_data;
+
+	atomic_inc(&uci->mapped);
+}
+
+static void uci_vma_close(struct vm_area_struct *vma)
+{
+	struct uci_layer *uci = vma->vm_private_data;
+
+	atomic_dec(&uci->mapped);
+}
+
+static const struct vm_operations_struct uci_vm_ops = {
+	.open = uci_vma_open,
+	.close = uci_vma_close,
+};
+
+static int uci_vma_read_only(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+#if KERNEL_VERSION(6, 3, 0) <= LINUX_VERSION_CODE
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+	return 0;
+}
+
+int uci_layer_mmap(struct uci_layer *uci, struct vm_area_struct *vma)
+{
+	unsigned long length = vma->vm_end - vma->vm_start;
+	void *addr;
+	int ret;
+
+	switch (vma->vm_pgoff) {
+	case UCI_RX_RING_HDR_PGOFF:
+		if (length != PAGE_SIZE)
+			return -EINVAL;
+
+		ret = uci_vma_read_only(vma);
+		if (ret)
+			return ret;
+
+		addr = uci->ring;
+		break;
+	case UCI_RX_RING_DATA_PGOFF:
+		if (length != UCI_RX_RING_SIZE)
+			return -EINVAL;
+
+		/* Records are trusted by read(), keep them read only */
+		ret = uci_vma_read_only(vma);
+		if (ret)
+			return ret;
+
+		addr = uci->ring_data;
+		break;
+	case UCI_RX_RING_TAIL_PGOFF:
+		if (length != PAGE_SIZE)
+			return -EINVAL;
+
+		addr = uci->ring_tail;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			      virt_to_phys(addr) >> PAGE_SHIFT, length,
+			      vma->vm_page_prot);
+	if (ret)
+		return ret;
+
+	vma->vm_ops = &uci_vm_ops;
+	vma->vm_private_data = uci;
+	uci_vma_open(vma);
+	return 0;
 }
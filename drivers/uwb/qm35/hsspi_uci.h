@@ -35,18 +35,19 @@
 #include <linux/wait.h>
 
 #include "hsspi.h"
+#include "uci_ioctls.h"
+
+struct vm_area_struct;
 
 /**
  * struct uci_packet - UCI packet that implements a &struct hsspi_block.
  * @blk: &struct hsspi_block
  * @write_done: norify when the packet has been really send
- * @list: link with &struct uci_layer.rx_list
  * @status: status of the transfer
  */
 struct uci_packet {
 	struct hsspi_block blk;
 	struct completion *write_done;
-	struct list_head list;
 	u8 *data;
 	int length;
 	int status;
@@ -73,14 +74,35 @@ void uci_packet_free(struct uci_packet *p);
 /**
  * struct uci_layer - Implement an HSSPI Layer
  * @hlayer: &struct hsspi_layer
- * @rx_list: list of received UCI packets
- * @lock: protect the &struct uci_layer.rx_list
- * @wq: notify when the &struct uci_layer.rx_list is not empty
+ * @ring: RX ring header, read only for userspace
+ * @ring_data: RX ring records, the HSSPI receives directly in there
+ * @ring_tail: RX ring consumer index, written by userspace when mapped
+ * @head: producer index, the shared copy is only informative
+ * @dropped: blocks dropped, the shared copy is only informative
+ * @rx_blk: block handed to the HSSPI for the reception in progress
+ * @rx_rec: record of the reception in progress
+ * @rx_next: head once the reception in progress is committed
+ * @lock: serialize read() consumers
+ * @rd_off: offset of the next UCI packet in the tail record
+ * @mapped: number of userspace mappings of the ring
+ * @wq: notify when the ring is not empty
+ *
+ * The ring has a single producer, the HSSPI thread, and a single
+ * consumer, either read() or a userspace reader through mmap().
  */
 struct uci_layer {
 	struct hsspi_layer hlayer;
-	struct list_head rx_list;
+	struct uci_rx_ring_hdr *ring;
+	u8 *ring_data;
+	struct uci_rx_ring_tail *ring_tail;
+	u32 head;
+	u32 dropped;
+	struct hsspi_block rx_blk;
+	struct uci_rx_rec *rx_rec;
+	u32 rx_next;
 	struct mutex lock;
+	u32 rd_off;
+	atomic_t mapped;
 	wait_queue_head_t wq;
 };
 
@@ -107,23 +129,32 @@ void uci_layer_deinit(struct uci_layer *uci);
 bool uci_layer_has_data_available(struct uci_layer *uci);
 
 /**
- * uci_layer_read() - get a packet from the rx_list
+ * uci_layer_read() - copy the next UCI packet of the RX ring to userspace
  * @uci: pointer to &struct uci_layer
+ * @buf: userspace buffer
  * @max_size: maximum size possible for the UCI packet
  * @non_blocking: true if non blocking, false otherwise
  *
- * This function returns an UCI packet if available in the
- * &struct uci_layer.rx_list. The max_size argument logic is due to the way
- * the /dev/uci is make. We should ensure that we return an entire
- * packet in uci_read, so we must get a packet only if the caller has
- * enougth room for it.
+ * The max_size argument logic is due to the way the /dev/uci is make.
+ * We should ensure that we return an entire packet in uci_read, so we
+ * must consume a packet only if the caller has enougth room for it.
  *
- * Return: a &struct uci_packet if succeed,
+ * Return: the length of the packet if succeed,
  *         -EINTR if it was interrupted (in blocking mode),
  *         -ESMGSIZE if the available UCI packet is bigger than max_size,
  *         -EAGAIN if there is no available UCI packet (in non blocking mode)
+ *         -EBUSY if the ring is mapped by userspace
+ */
+ssize_t uci_layer_read(struct uci_layer *uci, char __user *buf,
+		       size_t max_size, bool non_blocking);
+
+/**
+ * uci_layer_mmap() - map the RX ring header or records to userspace
+ * @uci: pointer to &struct uci_layer
+ * @vma: the mapping, see uci_ioctls.h for the layout
+ *
+ * Return: 0 or -errno
  */
-struct uci_packet *uci_layer_read(struct uci_layer *uci, size_t max_size,
-				  bool non_blocking);
+int uci_layer_mmap(struct uci_layer *uci, struct vm_area_struct *vma);
 
 #endif // __HSSPI_UCI_H__
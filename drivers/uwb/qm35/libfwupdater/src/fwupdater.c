@@ -165,6 +165,21 @@ static CKSUM_TYPE checksum(const void *data, const size_t size)
 	return cksum;
 }
 
+/* Copy and checksum in a single pass over the data */
+static CKSUM_TYPE checksum_copy(void *dst, const char *src, size_t size)
+{
+	CKSUM_TYPE cksum = 0, word;
+	size_t idx;
+
+	for (idx = 0; idx < size; idx += CKSUM_SIZE) {
+		memcpy(&word, src + idx, CKSUM_SIZE);
+		memcpy((char *)dst + idx, &word, CKSUM_SIZE);
+		cksum += word;
+	}
+
+	return cksum;
+}
+
 static void prepare_hstc(struct stc *hstc, const char *data, size_t len)
 {
 	CKSUM_TYPE *cksum = (CKSUM_TYPE *)(hstc + 1);
@@ -173,17 +188,66 @@ static void prepare_hstc(struct stc *hstc, const char *data, size_t len)
 	hstc->all = 0;
 	hstc->host_flags.write = 1;
 	hstc->len = len + CKSUM_SIZE;
-	*cksum = checksum(data, len);
+	if (len & (CKSUM_SIZE - 1)) {
+		*cksum = checksum(data, len);
+		memcpy(payload, data, len);
+	} else {
+		*cksum = checksum_copy(payload, data, len);
+	}
 #if IS_ENABLED(CONFIG_INJECT_ERROR)
 	*cksum += 2;
 #endif
-	memcpy(payload, data, len);
+}
+
+/*
+ * The package is streamed as a sequence of segments: the package header,
+ * the image header, the cert chain, then the image in chunks of the
+ * largest size the updater accepts. Each segment is prepared in the
+ * spare buffer while the previous one is on the bus and being written by
+ * the QM, so the host never holds the ROM back.
+ */
+struct fw_stream {
+	const char *data;
+	size_t size;
+	int seg;
+};
+
+static const char *const fw_stream_names[] = {
+	"fw package header",
+	"image header",
+	"cert chain",
+	"data chunk",
+};
+
+static size_t fw_stream_next(struct fw_stream *stream, const char **name)
+{
+	size_t len;
+
+	switch (stream->seg) {
+	case 0:
+		len = sizeof(struct fw_pkg_hdr_t);
+		break;
+	case 1:
+		len = sizeof(struct fw_pkg_img_hdr_t);
+		break;
+	case 2:
+		len = CRYPTO_IMAGES_CERT_PKG_SIZE;
+		break;
+	default:
+		len = MIN(MAX_CHUNK_SIZE, stream->size);
+		break;
+	}
+	*name = fw_stream_names[MIN(stream->seg, 3)];
+	if (stream->seg < 3)
+		stream->seg++;
+	return len;
 }
 
 static int xfer_payload_prep_next(struct qmrom_handle *handle,
 				  const char *step_name, struct stc *hstc,
 				  struct stc *sstc, struct stc *hstc_next,
-				  const char **data, size_t *size)
+				  struct fw_stream *stream,
+				  const char **next_name)
 {
 	int rc = 0, nb_retry = CONFIG_NB_RETRIES;
 	CKSUM_TYPE *cksum = (CKSUM_TYPE *)(hstc + 1);
@@ -196,10 +260,11 @@ static int xfer_payload_prep_next(struct qmrom_handle *handle,
 					hstc->len + sizeof(struct stc));
 		if (hstc_next) {
 			/* Don't wait idle, prepare the next hstc to be sent */
-			size_t to_send = MIN(MAX_CHUNK_SIZE, *size);
-			prepare_hstc(hstc_next, *data, to_send);
-			*size -= to_send;
-			*data += to_send;
+			size_t to_send = fw_stream_next(stream, next_name);
+
+			prepare_hstc(hstc_next, stream->data, to_send);
+			stream->size -= to_send;
+			stream->data += to_send;
 			hstc_next = NULL;
 		}
 		ss_rdy_rc = qmrom_spi_wait_for_ready_line(
@@ -228,21 +293,15 @@ static int xfer_payload_prep_next(struct qmrom_handle *handle,
 	return rc;
 }
 
-static int xfer_payload(struct qmrom_handle *handle, const char *step_name,
-			struct stc *hstc, struct stc *sstc)
-{
-	return xfer_payload_prep_next(handle, step_name, hstc, sstc, NULL, NULL,
-				      NULL);
-}
-
 static int send_data_chunks(struct qmrom_handle *handle, const char *data,
 			    size_t size)
 {
 	struct fw_updater_status_t status;
 	uint32_t chunk_nr = 0;
 	struct stc *hstc, *sstc, *hstc_current, *hstc_next;
+	struct fw_stream stream = { .data = data, .size = size };
+	const char *name, *next_name;
 	char *rx, *tx;
-	CKSUM_TYPE *cksum;
 	int rc = 0;
 
 	LOG_DBG("chunk_nr:%u\n", chunk_nr);
@@ -259,69 +318,39 @@ static int send_data_chunks(struct qmrom_handle *handle, const char *data,
 	hstc = (struct stc *)tx;
 	hstc_current = hstc;
 	hstc_next = (struct stc *)&tx[MAX_CHUNK_SIZE + TRANPORT_HEADER_SIZE];
-	cksum = (CKSUM_TYPE *)(hstc + 1);
 
-	/* wait for the QM to be ready */
+	/* Prepare the package header while waiting for the QM to be ready */
+	prepare_hstc(hstc_current, stream.data, fw_stream_next(&stream, &name));
+	stream.size -= hstc_current->len - CKSUM_SIZE;
+	stream.data += hstc_current->len - CKSUM_SIZE;
+
 	rc = qmrom_spi_wait_for_ready_line(handle->ss_rdy_handle,
 					   WAIT_SS_RDY_CHUNK_TIMEOUT);
 	if (rc)
 		LOG_ERR("Waiting for ss-rdy failed with %d\n", rc);
 
-	/* Sending the fw package header */
-	prepare_hstc(hstc, data, sizeof(struct fw_pkg_hdr_t));
-	LOG_INFO("Sending the fw package header (%zu bytes, cksum is 0x%08x)\n",
-		 sizeof(struct fw_pkg_hdr_t), *cksum);
-	// hexdump(LOG_INFO, hstc->payload + 4, sizeof(struct fw_pkg_hdr_t));
-	rc = xfer_payload(handle, "fw package header", hstc, sstc);
-	if (rc)
-		goto exit;
-	/* Move the data to the next offset minus the header footprint */
-	size -= sizeof(struct fw_pkg_hdr_t);
-	data += sizeof(struct fw_pkg_hdr_t);
-
-	/* Sending the image header */
-	prepare_hstc(hstc, data, sizeof(struct fw_pkg_img_hdr_t));
-	LOG_INFO("Sending the image header (%zu bytes cksum 0x%08x)\n",
-		 sizeof(struct fw_pkg_img_hdr_t), *cksum);
-	// hexdump(LOG_INFO, hstc->payload + 4, sizeof(struct fw_pkg_img_hdr_t));
-	rc = xfer_payload(handle, "image header", hstc, sstc);
-	if (rc)
-		goto exit;
-	size -= sizeof(struct fw_pkg_img_hdr_t);
-	data += sizeof(struct fw_pkg_img_hdr_t);
-
-	/* Sending the cert chain */
-	prepare_hstc(hstc, data, CRYPTO_IMAGES_CERT_PKG_SIZE);
-	LOG_INFO("Sending the cert chain (%d bytes cksum 0x%08x)\n",
-		 CRYPTO_IMAGES_CERT_PKG_SIZE, *cksum);
-	rc = xfer_payload(handle, "cert chain", hstc, sstc);
-	if (rc)
-		goto exit;
-	size -= CRYPTO_IMAGES_CERT_PKG_SIZE;
-	data += CRYPTO_IMAGES_CERT_PKG_SIZE;
-
-	/* Sending the fw image */
-	LOG_INFO("Sending the image (%zu bytes)\n", size);
-	LOG_DBG("Sending a chunk (%zu bytes cksum 0x%08x)\n",
-		MIN(MAX_CHUNK_SIZE, size), *cksum);
-	prepare_hstc(hstc_current, data, MIN(MAX_CHUNK_SIZE, size));
-	size -= hstc_current->len - CKSUM_SIZE;
-	data += hstc_current->len - CKSUM_SIZE;
-	do {
-		rc = xfer_payload_prep_next(handle, "data chunk", hstc_current,
-					    sstc, hstc_next, &data, &size);
+	LOG_INFO("Sending the fw package (%zu bytes)\n", size);
+	for (;;) {
+		bool more = stream.size != 0;
+
+		LOG_DBG("Sending %s (%u bytes cksum 0x%08x)\n", name,
+			hstc_current->len - (uint32_t)CKSUM_SIZE,
+			*(CKSUM_TYPE *)(hstc_current + 1));
+		rc = xfer_payload_prep_next(handle, name, hstc_current, sstc,
+					    more ? hstc_next : NULL, &stream,
+					    &next_name);
 		if (rc)
 			goto exit;
 		chunk_nr++;
+		if (!more)
+			break;
+		name = next_name;
 		/* swap hstcs */
 		hstc = hstc_current;
 		hstc_current = hstc_next;
 		hstc_next = hstc;
-	} while (size);
-
-	/* Sends the last now */
-	rc = xfer_payload_prep_next(handle, "data chunk", hstc_current, sstc,
-				    NULL, NULL, NULL);
+	}
+	LOG_INFO("Sent %u chunks\n", chunk_nr);
 
 exit:
 	// tries to get the flashing status anyway...
@@ -312,36 +312,68 @@ static void dump_stats(void)
 }
 #endif
 
+#define qm357xx_rom_write_stc_c0(h, s)                                  \
+	({                                                              \
+		int rc;                                                 \
+		qmrom_spi_wait_for_ready_line((h)->ss_rdy_handle,       \
+					      SPI_READY_TIMEOUT_MS_C0); \
+		rc = qm357xx_rom_write_stc((h), (s));                   \
+		rc;                                                     \
+	})
+
+static uint32_t qm357xx_rom_c0_prep_chunk(struct stc *hstc, uint8_t cmd,
+					  const char *data, uint32_t left)
+{
+	uint32_t tx_bytes = left > CHUNK_SIZE_C0 ? CHUNK_SIZE_C0 : left;
+
+	qm357xx_rom_prep_size_cmd32(hstc, cmd, tx_bytes, data);
+	return tx_bytes;
+}
+
+/*
+ * Chunks are double buffered: the next one is built while the ROM programs
+ * the RRAM with the previous one, so it is ready to go as soon as the ROM
+ * asks for it. Retries resend the already built chunk.
+ */
 static int qm357xx_rom_c0_flash_data(struct qmrom_handle *handle,
 				     struct firmware *fw, uint8_t cmd,
 				     uint8_t resp, bool skip_last_check)
 {
-	int rc, sent = 0, nb_poll_retry, chunk = 0;
+	int rc = 0, sent = 0, nb_poll_retry, chunk = 0;
 	const char *bin_data = (const char *)fw->data;
+	struct stc *cur, *next, *tmp;
+	uint32_t tx_bytes, next_bytes = 0;
 #ifdef C0_WRITE_STATS
 	ktime_t start_time;
 #endif
 
-	while (sent < fw->size) {
-		uint32_t tx_bytes = fw->size - sent;
-		if (tx_bytes > CHUNK_SIZE_C0)
-			tx_bytes = CHUNK_SIZE_C0;
+	qmrom_alloc(cur, sizeof(struct stc) + sizeof(uint32_t) + CHUNK_SIZE_C0);
+	qmrom_alloc(next, sizeof(struct stc) + sizeof(uint32_t) + CHUNK_SIZE_C0);
+	if (!cur || !next) {
+		LOG_ERR("%s: chunk buffers allocation failure\n", __func__);
+		rc = -ENOMEM;
+		goto end;
+	}
 
+	tx_bytes = qm357xx_rom_c0_prep_chunk(cur, cmd, bin_data, fw->size);
+	while (sent < fw->size) {
 		LOG_DBG("%s: sending command %#x with %" PRIu32 " bytes\n",
 			__func__, cmd, tx_bytes);
 #ifdef C0_WRITE_STATS
 		start_time = ktime_get();
 #endif
-		rc = qm357xx_rom_write_size_cmd32_c0(handle, cmd, tx_bytes,
-						     bin_data);
+		rc = qm357xx_rom_write_stc_c0(handle, cur);
 		if (rc)
-			return rc;
+			goto end;
 		sent += tx_bytes;
 		bin_data += tx_bytes;
 		if (skip_last_check && sent == fw->size) {
 			LOG_INFO("%s: flashing done, quitting now\n", __func__);
 			break;
 		}
+		if (sent < fw->size)
+			next_bytes = qm357xx_rom_c0_prep_chunk(
+				next, cmd, bin_data, fw->size - sent);
 		qm357xx_rom_c0_poll_soc(handle);
 		nb_poll_retry = CONFIG_CHUNK_FLASHING_RETRIES;
 		while (handle->sstc->soc_flags.err && --nb_poll_retry >= 0) {
@@ -351,8 +383,7 @@ static int qm357xx_rom_c0_flash_data(struct qmrom_handle *handle,
 				__func__, cmd, chunk,
 				CONFIG_CHUNK_FLASHING_RETRIES - nb_poll_retry,
 				handle->sstc->raw_flags);
-			rc = qm357xx_rom_write_size_cmd32_c0(
-				handle, cmd, tx_bytes, bin_data - tx_bytes);
+			rc = qm357xx_rom_write_stc_c0(handle, cur);
 			qm357xx_rom_c0_poll_soc(handle);
 		}
 #ifdef C0_WRITE_STATS
@@ -367,14 +398,25 @@ static int qm357xx_rom_c0_flash_data(struct qmrom_handle *handle,
 				resp);
 			if (handle->sstc->payload[0] ==
 			    ERR_FIRST_KEY_CERT_OR_FW_VER)
-				return PEG_ERR_FIRST_KEY_CERT_OR_FW_VER;
+				rc = PEG_ERR_FIRST_KEY_CERT_OR_FW_VER;
 			else
-				return SPI_PROTO_WRONG_RESP;
+				rc = SPI_PROTO_WRONG_RESP;
+			goto end;
 		}
 		chunk++;
+		tmp = cur;
+		cur = next;
+		next = tmp;
+		tx_bytes = next_bytes;
 	}
+	rc = 0;
 	qmrom_msleep(SPI_READY_TIMEOUT_MS_C0);
-	return 0;
+end:
+	if (cur)
+		qmrom_free(cur);
+	if (next)
+		qmrom_free(next);
+	return rc;
 }
 
 static int
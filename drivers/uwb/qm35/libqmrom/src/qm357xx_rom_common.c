@@ -56,19 +56,30 @@ int qm357xx_rom_write_size_cmd(struct qmrom_handle *handle, uint8_t cmd,
 				  sizeof(struct stc) + handle->hstc->len);
 }
 
-int qm357xx_rom_write_size_cmd32(struct qmrom_handle *handle, uint32_t cmd,
+void qm357xx_rom_prep_size_cmd32(struct stc *hstc, uint32_t cmd,
 				 uint16_t data_size, const char *data)
 {
-	handle->hstc->all = 0;
-	handle->hstc->host_flags.write = 1;
-	handle->hstc->ul = 1;
-	handle->hstc->len = data_size + sizeof(cmd);
-	memcpy(handle->hstc->payload, &cmd, sizeof(cmd));
-	memcpy(&handle->hstc->payload[sizeof(cmd)], data, data_size);
+	hstc->all = 0;
+	hstc->host_flags.write = 1;
+	hstc->ul = 1;
+	hstc->len = data_size + sizeof(cmd);
+	memcpy(hstc->payload, &cmd, sizeof(cmd));
+	memcpy(&hstc->payload[sizeof(cmd)], data, data_size);
+}
 
+/* Sends a command prepared outside of handle->hstc */
+int qm357xx_rom_write_stc(struct qmrom_handle *handle, struct stc *hstc)
+{
 	return qmrom_spi_transfer(handle->spi_handle, (char *)handle->sstc,
-				  (const char *)handle->hstc,
-				  sizeof(struct stc) + handle->hstc->len);
+				  (const char *)hstc,
+				  sizeof(struct stc) + hstc->len);
+}
+
+int qm357xx_rom_write_size_cmd32(struct qmrom_handle *handle, uint32_t cmd,
+				 uint16_t data_size, const char *data)
+{
+	qm357xx_rom_prep_size_cmd32(handle->hstc, cmd, data_size, data);
+	return qm357xx_rom_write_stc(handle, handle->hstc);
 }
 
 /*
@@ -62,6 +62,12 @@
 #include "hsspi_uci.h"
 #include "hsspi_test.h"
 #include "hsspi_coredump.h"
+#ifdef CONFIG_QM35_HSSPI_SIM
+#include "hsspi_sim.h"
+#endif
+#ifdef CONFIG_QM35_QMROM_SIM
+#include "qmrom_sim.h"
+#endif
 
 #define QM35_REGULATOR_DELAY_US 1000
 
@@ -294,20 +300,9 @@ static ssize_t uci_read(struct file *filp, char __user *buf, size_t len,
 	struct miscdevice *uci_dev = filp->private_data;
 	struct qm35_ctx *qm35_hdl =
 		container_of(uci_dev, struct qm35_ctx, uci_dev);
-	struct uci_packet *p;
-	int ret;
-
-	p = uci_layer_read(&qm35_hdl->uci_layer, len,
-			   filp->f_flags & O_NONBLOCK);
-	if (IS_ERR(p))
-		return PTR_ERR(p);
 
-	ret = copy_to_user(buf, p->data, p->length);
-	if (!ret)
-		ret = p->length;
-
-	uci_packet_free(p);
-	return ret;
+	return uci_layer_read(&qm35_hdl->uci_layer, buf, len,
+			      filp->f_flags & O_NONBLOCK);
 }
 
 static ssize_t uci_write(struct file *filp, const char __user *buf, size_t len,
@@ -362,6 +357,15 @@ static __poll_t uci_poll(struct file *filp, struct poll_table_struct *wait)
 	return mask;
 }
 
+static int uci_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct miscdevice *uci_dev = filp->private_data;
+	struct qm35_ctx *qm35_hdl =
+		container_of(uci_dev, struct qm35_ctx, uci_dev);
+
+	return uci_layer_mmap(&qm35_hdl->uci_layer, vma);
+}
+
 static const struct file_operations uci_fops = {
 	.owner = THIS_MODULE,
 	.open = uci_open,
@@ -370,6 +374,7 @@ static const struct file_operations uci_fops = {
 	.read = uci_read,
 	.write = uci_write,
 	.poll = uci_poll,
+	.mmap = uci_mmap,
 };
 
 #if IS_ENABLED(CONFIG_QM35_COREDUMP)
@@ -619,6 +624,8 @@ static int qm_firmware_flash_qm357_macro_pkg(struct qm35_ctx *qm35_hdl,
 	int rc, nb_retries = flashing_retries;
 	const uint8_t *fw_data;
 	uint32_t fw_size;
+	ktime_t start;
+	s64 elapsed_us;
 
 	rc = qm357xx_rom_fw_macro_pkg_get_fw_idx(fw, 1, &fw_size, &fw_data);
 	if (rc) {
@@ -667,11 +674,19 @@ static int qm_firmware_flash_qm357_macro_pkg(struct qm35_ctx *qm35_hdl,
 			qmrom_spi_set_freq(fu_spi_speed_hz);
 		else
 			qmrom_spi_set_freq(FWUPDATER_SPI_SPEED_HZ);
+		start = ktime_get();
 		rc = run_fwupdater(h, fw_data, fw_size);
+		elapsed_us = max_t(s64, ktime_us_delta(ktime_get(), start), 1);
 		if (rc) {
 			dev_err(&qm35_hdl->spi->dev,
 				"Attempt %d: fw app flashing failed with %d!\n",
 				flashing_retries - nb_retries, rc);
+		} else {
+			dev_info(&qm35_hdl->spi->dev,
+				 "fw app flashed: %u bytes in %lld ms (%llu KB/s)\n",
+				 fw_size, div_s64(elapsed_us, USEC_PER_MSEC),
+				 div64_u64((u64)fw_size * USEC_PER_SEC,
+					   (u64)elapsed_us * 1024));
 		}
 	} while (rc && --nb_retries > 0);
 	return rc;
@@ -1401,7 +1416,55 @@ static struct spi_driver qm35_spi_driver = {
 	.probe =	qm35_probe,
 	.remove =	qm35_remove,
 };
+#if defined(CONFIG_QM35_HSSPI_SIM) || defined(CONFIG_QM35_QMROM_SIM)
+static int __init qm35_init(void)
+{
+	int ret;
+
+	ret = spi_register_driver(&qm35_spi_driver);
+	if (ret)
+		return ret;
+
+#ifdef CONFIG_QM35_HSSPI_SIM
+	ret = hsspi_sim_init();
+	if (ret)
+		goto unregister;
+#endif
+#ifdef CONFIG_QM35_QMROM_SIM
+	ret = qmrom_sim_init();
+	if (ret)
+		goto exit_hsspi_sim;
+#endif
+
+	return 0;
+
+#ifdef CONFIG_QM35_QMROM_SIM
+exit_hsspi_sim:
+#endif
+#ifdef CONFIG_QM35_HSSPI_SIM
+	hsspi_sim_exit();
+unregister:
+#endif
+	spi_unregister_driver(&qm35_spi_driver);
+	return ret;
+}
+
+static void __exit qm35_exit(void)
+{
+#ifdef CONFIG_QM35_QMROM_SIM
+	qmrom_sim_exit();
+#endif
+#ifdef CONFIG_QM35_HSSPI_SIM
+	hsspi_sim_exit();
+#endif
+	spi_unregister_driver(&qm35_spi_driver);
+}
+
+module_init(qm35_init);
+module_exit(qm35_exit);
+#else
 module_spi_driver(qm35_spi_driver);
+#endif
 
 MODULE_AUTHOR("Qorvo US, Inc.");
 MODULE_DESCRIPTION("QM35 SPI device interface");
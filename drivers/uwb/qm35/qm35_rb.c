@@ -181,8 +181,11 @@ int rb_push(struct rb *rb, const char *data, rb_entry_size_t len)
 		// not overwritten
 		bool skipped = __rb_skip(rb);
 
-		if (equal_tails)
+		if (equal_tails) {
 			rb->rdtail = rb->tail;
+			if (skipped)
+				rb->dropped++;
+		}
 
 		if (!skipped)
 			break;
@@ -219,6 +222,7 @@ int rb_init(struct rb *rb, uint32_t size)
 	rb->head = 0;
 	rb->tail = 0;
 	rb->rdtail = 0;
+	rb->dropped = 0;
 	rb->size = size;
 
 	return 0;
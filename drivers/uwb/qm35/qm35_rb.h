@@ -39,6 +39,8 @@ struct rb {
 	uint32_t head;
 	uint32_t tail;
 	uint32_t rdtail;
+	/* entries overwritten before being read */
+	uint32_t dropped;
 	struct mutex lock;
 };
 
@@ -0,0 +1,284 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * QM35 firmware updater protocol emulator
+ *
+ * Answers the STC handshake of the fw updater like the QM35 does: every
+ * chunk is checksummed, takes the SPI clock time on the bus, then keeps
+ * ss-rdy low for a configurable RRAM programming time. The final status
+ * is returned once the whole package is received. This lets the bench
+ * measure the download throughput of run_fwupdater() without hardware:
+ *
+ *   echo "<size_kb> <spi_hz> <flash_us>" > /sys/kernel/debug/qm35_qmrom_sim/bench
+ *   cat /sys/kernel/debug/qm35_qmrom_sim/bench
+ */
+
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#include <linux/uwb/qmrom.h>
+#include <linux/uwb/qmrom_spi.h>
+#include <linux/uwb/spi_rom_protocol.h>
+#include <linux/uwb/fwupdater.h>
+
+#include "qmrom_sim.h"
+
+#define SIM_MAX_SIZE_KB (2048)
+#define SIM_COMMS_RETRIES (10)
+
+struct qmrom_sim {
+	struct mutex lock; /* one bench at a time */
+	struct dentry *dir;
+
+	/* Emulated QM */
+	ktime_t ready_at;
+	u32 flash_us;
+	u32 bus_hz; /* clock of the emulated bus, qmrom_spi_set_freq() is global */
+	size_t expected;
+	size_t received;
+	u32 chunks;
+	struct fw_updater_status_t status;
+
+	/* Last bench */
+	u32 size_kb;
+	u32 spi_hz;
+	int rc;
+	u64 elapsed_us;
+};
+
+static struct qmrom_sim *sim;
+
+bool qmrom_sim_owns(void *handle)
+{
+	return sim && handle == sim;
+}
+
+static void sim_bus_delay(size_t size)
+{
+	unsigned int hz = sim->bus_hz;
+	u64 us;
+
+	if (!hz)
+		return;
+
+	us = div_u64((u64)size * 8 * USEC_PER_SEC, hz);
+	if (us > 10)
+		usleep_range(us, us + 10);
+	else if (us)
+		udelay(us);
+}
+
+static void sim_write(struct stc *sstc, const struct stc *hstc)
+{
+	const u8 *data = hstc->payload + sizeof(u32);
+	size_t len = hstc->len - sizeof(u32);
+	u32 cksum = 0, word;
+	size_t idx;
+
+	for (idx = 0; idx + sizeof(word) <= len; idx += sizeof(word)) {
+		memcpy(&word, data + idx, sizeof(word));
+		cksum += word;
+	}
+	for (; idx < len; idx++)
+		cksum += data[idx];
+
+	memcpy(&word, hstc->payload, sizeof(word));
+	if (cksum != word) {
+		sim->status.cksum_errors++;
+	} else {
+		sim->received += len;
+		sim->chunks++;
+	}
+
+	sstc->soc_flags.ready = 1;
+	sim->ready_at = ktime_add_us(ktime_get(), sim->flash_us);
+}
+
+int qmrom_sim_transfer(void *handle, char *rbuf, const char *wbuf,
+		       size_t size)
+{
+	const struct stc *hstc = (const struct stc *)wbuf;
+	struct stc *sstc = (struct stc *)rbuf;
+	bool done = sim->received >= sim->expected;
+
+	sim_bus_delay(size);
+	memset(rbuf, 0, size);
+
+	if (hstc->host_flags.write) {
+		sim_write(sstc, hstc);
+	} else if (hstc->host_flags.read) {
+		if (done && size >= sizeof(*sstc) + sizeof(sim->status))
+			memcpy(sstc->payload, &sim->status,
+			       sizeof(sim->status));
+		sstc->soc_flags.out_active = 1;
+	} else {
+		/* Status poll or pre-read */
+		sstc->soc_flags.out_waiting = done;
+	}
+
+	return 0;
+}
+
+int qmrom_sim_wait_for_ready_line(void *handle, unsigned int timeout_ms)
+{
+	s64 us = ktime_us_delta(sim->ready_at, ktime_get());
+
+	if (us <= 0)
+		return 0;
+
+	if (us > timeout_ms * USEC_PER_MSEC) {
+		msleep(timeout_ms);
+		return -1;
+	}
+
+	usleep_range(us, us + 10);
+	return 0;
+}
+
+int qmrom_sim_read_irq_line(void *handle)
+{
+	return 0;
+}
+
+static int sim_bench_run(u32 size_kb, u32 spi_hz, u32 flash_us)
+{
+	struct qmrom_handle *h;
+	ktime_t start;
+	size_t size;
+	char *pkg;
+
+	if (!size_kb || size_kb > SIM_MAX_SIZE_KB || !spi_hz)
+		return -EINVAL;
+
+	size = (size_t)size_kb * 1024;
+	pkg = kvmalloc(size, GFP_KERNEL);
+	h = kzalloc(sizeof(*h), GFP_KERNEL);
+	if (!pkg || !h) {
+		kvfree(pkg);
+		kfree(h);
+		return -ENOMEM;
+	}
+
+	get_random_bytes(pkg, size);
+	h->spi_handle = sim;
+	h->ss_rdy_handle = sim;
+	h->ss_irq_handle = sim;
+	h->comms_retries = SIM_COMMS_RETRIES;
+	h->skip_check_fw_boot = true;
+
+	mutex_lock(&sim->lock);
+	sim->ready_at = 0;
+	sim->flash_us = flash_us;
+	sim->bus_hz = spi_hz;
+	sim->expected = size;
+	sim->received = 0;
+	sim->chunks = 0;
+	memset(&sim->status, 0, sizeof(sim->status));
+	sim->status.magic = FWUPDATER_STATUS_MAGIC;
+
+	start = ktime_get();
+	sim->rc = run_fwupdater(h, pkg, size);
+	sim->elapsed_us = ktime_us_delta(ktime_get(), start);
+
+	sim->size_kb = size_kb;
+	sim->spi_hz = spi_hz;
+	mutex_unlock(&sim->lock);
+
+	kfree(h);
+	kvfree(pkg);
+	return 0;
+}
+
+static ssize_t sim_bench_write(struct file *filp, const char __user *buff,
+			       size_t count, loff_t *off)
+{
+	char buf[48];
+	u32 size_kb, spi_hz, flash_us;
+	int ret;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, buff, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+	if (sscanf(buf, "%u %u %u", &size_kb, &spi_hz, &flash_us) != 3)
+		return -EINVAL;
+
+	ret = sim_bench_run(size_kb, spi_hz, flash_us);
+	return ret ? ret : count;
+}
+
+static int sim_bench_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&sim->lock);
+
+	seq_printf(s, "size: %u KB spi %u Hz flash %u us/chunk rc %d\n",
+		   sim->size_kb, sim->spi_hz, sim->flash_us, sim->rc);
+	seq_printf(s, "chunks: %u received %zu/%zu cksum errors %u\n",
+		   sim->chunks, sim->received, sim->expected,
+		   sim->status.cksum_errors);
+	seq_printf(s, "time: %llu us rate: %llu KB/s\n", sim->elapsed_us,
+		   sim->elapsed_us ?
+			   div64_u64((u64)sim->size_kb * USEC_PER_SEC,
+				     sim->elapsed_us) :
+			   0);
+
+	mutex_unlock(&sim->lock);
+	return 0;
+}
+
+static int sim_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sim_bench_show, inode->i_private);
+}
+
+static const struct file_operations sim_bench_fops = {
+	.owner = THIS_MODULE,
+	.open = sim_bench_open,
+	.read = seq_read,
+	.write = sim_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+int qmrom_sim_init(void)
+{
+	sim = kzalloc(sizeof(*sim), GFP_KERNEL);
+	if (!sim)
+		return -ENOMEM;
+
+	mutex_init(&sim->lock);
+	sim->dir = debugfs_create_dir("qm35_qmrom_sim", NULL);
+	debugfs_create_file("bench", 0600, sim->dir, sim, &sim_bench_fops);
+
+	return 0;
+}
+
+void qmrom_sim_exit(void)
+{
+	if (!sim)
+		return;
+
+	debugfs_remove_recursive(sim->dir);
+	kfree(sim);
+	sim = NULL;
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * QM35 firmware updater protocol emulator
+ */
+
+#ifndef __QMROM_SIM_H___
+#define __QMROM_SIM_H___
+
+#include <linux/types.h>
+
+int qmrom_sim_init(void);
+void qmrom_sim_exit(void);
+
+/* Hooks for qmrom_spi.c, the handles of the bench point to the emulator */
+bool qmrom_sim_owns(void *handle);
+int qmrom_sim_transfer(void *handle, char *rbuf, const char *wbuf,
+		       size_t size);
+int qmrom_sim_wait_for_ready_line(void *handle, unsigned int timeout_ms);
+int qmrom_sim_read_irq_line(void *handle);
+
+#endif /* __QMROM_SIM_H___ */
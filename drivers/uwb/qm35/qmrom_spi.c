@@ -33,6 +33,9 @@
 #include <linux/uwb/spi_rom_protocol.h>
 
 #include "qm35.h"
+#ifdef CONFIG_QM35_QMROM_SIM
+#include "qmrom_sim.h"
+#endif
 
 #define QUOTE(name) #name
 #define STR(macro) QUOTE(macro)
@@ -55,7 +58,7 @@ void qmrom_set_fwname(const char *name)
 int qmrom_spi_transfer(void *handle, char *rbuf, const char *wbuf, size_t size)
 {
 	struct spi_device *spi = (struct spi_device *)handle;
-	struct qm35_ctx *qm35_ctx = spi_get_drvdata(spi);
+	struct qm35_ctx *qm35_ctx;
 	int rc;
 
 	struct spi_transfer xfer[] = {
@@ -67,6 +70,11 @@ int qmrom_spi_transfer(void *handle, char *rbuf, const char *wbuf, size_t size)
 		},
 	};
 
+#ifdef CONFIG_QM35_QMROM_SIM
+	if (qmrom_sim_owns(handle))
+		return qmrom_sim_transfer(handle, rbuf, wbuf, size);
+#endif
+	qm35_ctx = spi_get_drvdata(spi);
 	qm35_ctx->qmrom_qm_ready = false;
 	rc = spi_sync_transfer(spi, xfer, ARRAY_SIZE(xfer));
 
@@ -193,6 +201,10 @@ int qmrom_spi_wait_for_ready_line(void *handle, unsigned int timeout_ms)
 {
 	struct qm35_ctx *qm35_ctx = (struct qm35_ctx *)handle;
 
+#ifdef CONFIG_QM35_QMROM_SIM
+	if (qmrom_sim_owns(handle))
+		return qmrom_sim_wait_for_ready_line(handle, timeout_ms);
+#endif
 	wait_event_interruptible_timeout(qm35_ctx->qmrom_wq_ready,
 					 qm35_ctx->qmrom_qm_ready,
 					 msecs_to_jiffies(timeout_ms));
@@ -201,6 +213,10 @@ int qmrom_spi_wait_for_ready_line(void *handle, unsigned int timeout_ms)
 
 int qmrom_spi_read_irq_line(void *handle)
 {
+#ifdef CONFIG_QM35_QMROM_SIM
+	if (qmrom_sim_owns(handle))
+		return qmrom_sim_read_irq_line(handle);
+#endif
 	return gpiod_get_value(handle);
 }
 
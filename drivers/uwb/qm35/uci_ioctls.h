@@ -4,6 +4,7 @@
 #define __UCI_IOCTLS_H___
 
 #include <asm/ioctl.h>
+#include <linux/types.h>
 
 #define UCI_DEV_NAME "uci"
 #define UCI_IOC_TYPE 'U'
@@ -24,4 +25,42 @@ enum qm35_ctrl_state {
 	QM35_CTRL_STATE_UCI_APP = 0x0020,
 };
 
+/*
+ * UCI RX ring, mapped with mmap() on the uci device:
+ *  - page offset UCI_RX_RING_HDR_PGOFF, one page, read only: the header.
+ *  - page offset UCI_RX_RING_DATA_PGOFF, hdr.size bytes, read only: records.
+ *  - page offset UCI_RX_RING_TAIL_PGOFF, one page, read/write: the tail.
+ *
+ * head and tail are free running byte indexes, the record at index i is at
+ * offset (i & (size - 1)) of the data area. The driver only moves head, the
+ * reader only moves tail. A tail more than size behind head or not
+ * UCI_RX_REC_ALIGN aligned is discarded and the ring is resynchronized to
+ * head. A record holds one or more UCI packets. A record
+ * with UCI_RX_REC_WRAP means the next record is at the start of the area.
+ * Records are UCI_RX_REC_ALIGN aligned.
+ *
+ * read() on the uci device returns -EBUSY while the ring is mapped.
+ */
+#define UCI_RX_RING_HDR_PGOFF 0
+#define UCI_RX_RING_DATA_PGOFF 1
+#define UCI_RX_RING_TAIL_PGOFF 2
+
+#define UCI_RX_REC_WRAP 0x1
+#define UCI_RX_REC_ALIGN 8
+
+struct uci_rx_ring_hdr {
+	__u32 head;
+	__u32 size;
+	__u32 dropped; /* blocks dropped because the ring was full */
+};
+
+struct uci_rx_ring_tail {
+	__u32 tail;
+};
+
+struct uci_rx_rec {
+	__u16 length;
+	__u16 flags;
+};
+
 #endif /* __UCI_IOCTLS_H___ */
@@ -25,6 +25,7 @@
 #include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/module.h>
+#include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/slab.h>
 #include <linux/sysfs.h>
@@ -154,12 +155,15 @@ struct qm35_qtraces_header {
  */
 static void qm35_logs_list_clear(struct qm35_logs_list *ll, struct qm35 *qm35)
 {
-	struct sk_buff *s, *n;
+	struct sk_buff *s;
 	unsigned long flags;
+	int i;
+
 	spin_lock_irqsave(&ll->lock, flags);
-	list_for_each_entry_safe (s, n, &ll->list, list) {
-		list_del(&s->list);
-		ll->count--;
+	while ((i = qm_xport_ring_cons(&ll->ring)) >= 0) {
+		s = ll->slots[i];
+		ll->slots[i] = NULL;
+		qm_xport_ring_pop(&ll->ring);
 		spin_unlock_irqrestore(&ll->lock, flags);
 		kfree_skb(s);
 		spin_lock_irqsave(&ll->lock, flags);
@@ -168,51 +172,94 @@ static void qm35_logs_list_clear(struct qm35_logs_list *ll, struct qm35 *qm35)
 }
 
 /**
- * qm35_logs_list_remove_first() - Remove first packed stored.
+ * qm35_logs_list_trim() - Release the oldest slots already emptied.
  * @ll: Pointer to struct qm35_logs_list to work on.
- * @qm35: QM35 instance used to free packets.
  *
- * Remove the first log packet stored in the list IF list is full (if count >=
- * QM35_LOGS_MAX_PACKET_STORED).
- * Called BEFORE a LOG packet is added to the list. Not used for QTRACE packets.
+ * A reader filtering on a log module takes packets out of the middle of the
+ * ring, their slots are only released once all the older ones are.
+ * Called with ll->lock held.
  */
-static void qm35_logs_list_remove_first(struct qm35_logs_list *ll,
-					struct qm35 *qm35)
+static void qm35_logs_list_trim(struct qm35_logs_list *ll)
 {
-	struct sk_buff *first;
-	unsigned long flags;
+	int i;
 
-	spin_lock_irqsave(&ll->lock, flags);
-	if (ll->count < QM35_LOGS_MAX_PACKET_STORED) {
-		spin_unlock_irqrestore(&ll->lock, flags);
-		return;
-	}
-	first = list_first_entry(&ll->list, struct sk_buff, list);
-	list_del(&first->list);
-	ll->count--;
-	spin_unlock_irqrestore(&ll->lock, flags);
-	kfree_skb(first);
+	while ((i = qm_xport_ring_cons(&ll->ring)) >= 0 && !ll->slots[i])
+		qm_xport_ring_pop(&ll->ring);
+}
+
+/**
+ * qm35_logs_list_take() - Take a stored packet out of the ring.
+ * @ll: Pointer to struct qm35_logs_list to work on.
+ * @pos: Position of the packet, between ring tail and head.
+ *
+ * Called with ll->lock held. The caller owns the returned packet and can
+ * drop the lock to copy it.
+ *
+ * Returns: The packet stored at @pos.
+ */
+static struct sk_buff *qm35_logs_list_take(struct qm35_logs_list *ll,
+					   unsigned int pos)
+{
+	struct sk_buff **slot = &ll->slots[pos % ll->ring.nr];
+	struct sk_buff *skb = *slot;
+
+	*slot = NULL;
+	qm35_logs_list_trim(ll);
+	return skb;
 }
 
 /**
- * qm35_logs_list_append() - Add a new log at the end of the queue.
+ * qm35_logs_list_resume() - Next position to scan after ll->lock was dropped.
+ * @ll: Pointer to struct qm35_logs_list to work on.
+ * @pos: Position just handled.
+ *
+ * Called with ll->lock held. The producer may have evicted older packets in
+ * the meantime.
+ *
+ * Returns: The position preceding the next one to scan.
+ */
+static unsigned int qm35_logs_list_resume(struct qm35_logs_list *ll,
+					  unsigned int pos)
+{
+	if ((int)(pos + 1 - ll->ring.tail) < 0)
+		return ll->ring.tail - 1;
+	return pos;
+}
+
+/**
+ * qm35_logs_list_append() - Add a new packet at the end of the ring.
  * @ll: Pointer to struct qm35_logs_list to work on.
  * @skb: packet to store
  *
  * We store directly the provided packet to avoid data copy. It will be freed
  * later, when an application open and read the log file.
  *
- * Returns: Zero on success or negative error.
+ * The ring is bounded: when it is full, the oldest packet is dropped and
+ * counted, readers are after the latest ones. A firmware flooding logs then
+ * costs memory neither to the system nor to UCI traffic.
  */
 static void qm35_logs_list_append(struct qm35_logs_list *ll,
 				  struct sk_buff *skb)
 {
+	struct sk_buff *old = NULL;
 	unsigned long flags;
+	int i;
 
 	spin_lock_irqsave(&ll->lock, flags);
-	list_add_tail(&skb->list, &ll->list);
-	ll->count++;
+	i = qm_xport_ring_prod(&ll->ring);
+	if (i < 0) {
+		i = qm_xport_ring_cons(&ll->ring);
+		old = ll->slots[i];
+		ll->slots[i] = NULL;
+		qm_xport_ring_pop(&ll->ring);
+		ll->ring.dropped++;
+		qm35_logs_list_trim(ll);
+		i = qm_xport_ring_prod(&ll->ring);
+	}
+	ll->slots[i] = skb;
+	qm_xport_ring_push(&ll->ring);
 	spin_unlock_irqrestore(&ll->lock, flags);
+	kfree_skb(old);
 }
 
 /**
@@ -235,9 +282,10 @@ static ssize_t qm35_qtraces_read(struct file *filp, struct kobject *kobp,
 	struct qm35_logs *qml =
 		container_of(bin_attr, struct qm35_logs, qtraces.bin_attr);
 	struct qm35_logs_list *ll = &qml->qtraces;
-	struct sk_buff *skb, *n;
+	struct sk_buff *skb;
 	unsigned long flags;
 	unsigned copied = 0;
+	unsigned int i;
 	int error = 0;
 	size_t remain = count;
 	char __user *cur = buf;
@@ -245,15 +293,17 @@ static ssize_t qm35_qtraces_read(struct file *filp, struct kobject *kobp,
 	((void)pos); /* unused */
 
 	spin_lock_irqsave(&ll->lock, flags);
-	list_for_each_entry_safe (skb, n, &ll->list, list) {
+	for (i = ll->ring.tail; i != ll->ring.head; i++) {
+		skb = ll->slots[i % ll->ring.nr];
+		if (!skb)
+			continue; /* taken by another reader. */
 		if (remain < skb->len) {
 			error = copied ? 0 : -ENOSPC;
 			break; /* no space in buffer. */
 		}
-		/* Early delete from list. */
-		list_del(&skb->list);
-		ll->count--;
-		/* Ensure producer thread can add new entries in list during
+		/* Early removal from ring. */
+		qm35_logs_list_take(ll, i);
+		/* Ensure producer thread can add new entries in ring during
 		 * copy and free. */
 		spin_unlock_irqrestore(&ll->lock, flags);
 
@@ -266,8 +316,9 @@ static ssize_t qm35_qtraces_read(struct file *filp, struct kobject *kobp,
 		/* Free packet. */
 		kfree_skb(skb);
 
-		/* Re-lock to continue for list reading. */
+		/* Re-lock to continue for ring reading. */
 		spin_lock_irqsave(&ll->lock, flags);
+		i = qm35_logs_list_resume(ll, i);
 	}
 	spin_unlock_irqrestore(&ll->lock, flags);
 	if (error)
@@ -323,10 +374,10 @@ static void qm35_qtraces_packet_recv(void *data, struct sk_buff *skb)
 
 	/* Need to be error prone for packet coming from FW. */
 	if (skb->len < QTRACE_PKT_HDR_SIZE)
-		goto freepkt;
+		goto badpkt;
 	qtrace_pkt = (struct qm35_qtraces_header *)skb->data;
 	if (skb->len < qtrace_pkt->body_size)
-		goto freepkt;
+		goto badpkt;
 	/* All packet will be processed by user-space application.
 	 * Save all of them in the right list. */
 	qm35_logs_list_append(&qml->qtraces, skb);
@@ -336,7 +387,8 @@ static void qm35_qtraces_packet_recv(void *data, struct sk_buff *skb)
 	}
 	return;
 
-freepkt:
+badpkt:
+	qml->qtraces.ring.errors++;
 	kfree_skb(skb);
 	return;
 }
@@ -403,17 +455,22 @@ static ssize_t qm35_logs_read_common(struct qm35_logs *qml,
 				     size_t count, loff_t *ppos)
 {
 	struct qm35_logs_list *ll = &qml->logs;
-	struct sk_buff *skb, *n;
+	struct sk_buff *skb;
 	unsigned long flags;
 	unsigned copied = 0;
+	unsigned int i;
 	int error = 0;
 	size_t remain = count;
 	char __user *cur = buf;
 
 	spin_lock_irqsave(&ll->lock, flags);
-	list_for_each_entry_safe (skb, n, &ll->list, list) {
+	for (i = ll->ring.tail; i != ll->ring.head; i++) {
 		struct qm35_logs_rsp *log_pkt;
-		bool copy;
+		int rc = 0;
+
+		skb = ll->slots[i % ll->ring.nr];
+		if (!skb)
+			continue; /* taken by another reader. */
 
 		log_pkt = (struct qm35_logs_rsp *)skb->data;
 		if (remain < log_pkt->hdr.body_size) {
@@ -421,37 +478,36 @@ static ssize_t qm35_logs_read_common(struct qm35_logs *qml,
 			break; /* no space in buffer. */
 		}
 
-		/* Ensure producer thread can add new entries in list during copy. */
-		spin_unlock_irqrestore(&ll->lock, flags);
-
-		copy = !parent || check_name(parent, log_pkt);
-		if (!copy) {
-			spin_lock_irqsave(&ll->lock, flags);
+		if (parent && !check_name(parent, log_pkt))
 			continue;
-		}
+
+		/* Take it out of the ring, so that neither another reader nor
+		 * the producer evicting old packets can free it during copy. */
+		qm35_logs_list_take(ll, i);
+		spin_unlock_irqrestore(&ll->lock, flags);
 
 		/* Copy this log entry. */
 		if (parent) {
 			if (copy_to_user(cur, log_pkt->data,
 					 log_pkt->hdr.body_size))
-				return -EFAULT;
+				rc = -EFAULT;
 		} else {
 			memcpy(cur, log_pkt->data, log_pkt->hdr.body_size);
 		}
+		if (!rc) {
+			/* Update sizes and position. */
+			remain -= log_pkt->hdr.body_size;
+			cur += log_pkt->hdr.body_size;
+			copied++;
+		}
 
-		/* Update sizes and position. */
-		remain -= log_pkt->hdr.body_size;
-		cur += log_pkt->hdr.body_size;
-		copied++;
+		kfree_skb(skb);
+		if (rc)
+			return rc;
 
-		/* Re-lock for list management. */
+		/* Re-lock for ring management. */
 		spin_lock_irqsave(&ll->lock, flags);
-		list_del(&skb->list);
-		ll->count--;
-
-		/* Free packet (inside lock after list_del to avoid race with
-		 * another reader). */
-		kfree_skb(skb);
+		i = qm35_logs_list_resume(ll, i);
 	}
 	spin_unlock_irqrestore(&ll->lock, flags);
 	if (error)
@@ -625,6 +681,46 @@ static const struct file_operations qm35_logs_module_level_fops = {
 	.write = qm35_logs_module_level_write,
 };
 
+/**
+ * qm35_logs_stats_show() - Show the logs and qtraces ring counters.
+ * @s: The seq_file to print to.
+ * @unused: Unused.
+ *
+ * Returns: 0.
+ */
+static int qm35_logs_stats_show(struct seq_file *s, void *unused)
+{
+	struct qm35_logs *qml = s->private;
+
+	seq_printf(s, "logs_stored: %u/%u\n", qm_xport_ring_used(&qml->logs.ring),
+		   qml->logs.ring.nr);
+	qm_xport_ring_show(s, "logs", &qml->logs.ring);
+	seq_printf(s, "qtraces_stored: %u/%u\n",
+		   qm_xport_ring_used(&qml->qtraces.ring), qml->qtraces.ring.nr);
+	qm_xport_ring_show(s, "qtraces", &qml->qtraces.ring);
+	return 0;
+}
+
+/**
+ * qm35_logs_stats_open() - File open callback function.
+ * @inode: inode opened
+ * @file: file opened
+ *
+ * Returns: Zero or a negative error
+ */
+static int qm35_logs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qm35_logs_stats_show, inode->i_private);
+}
+
+static const struct file_operations qm35_logs_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = qm35_logs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 /**
  * qm35_logs_read() - Read logs.
  * @filp: The struct file instance.
@@ -711,15 +807,15 @@ static void qm35_logs_packet_recv(void *data, struct sk_buff *skb)
 	struct qm35_logs_rsp *log_pkt = (struct qm35_logs_rsp *)skb->data;
 
 	/* Need to be error prone for packet coming from FW. */
-	if (skb->len < sizeof(struct qm35_logs_header))
-		goto freepkt;
-	if (skb->len <
-	    (sizeof(struct qm35_logs_header) + log_pkt->hdr.body_size))
+	if (skb->len < sizeof(struct qm35_logs_header) ||
+	    skb->len <
+		    (sizeof(struct qm35_logs_header) + log_pkt->hdr.body_size)) {
+		qml->logs.ring.errors++;
 		goto freepkt;
+	}
 
 	switch (log_pkt->hdr.cmd_id) {
 	case QM35_LOGS_DATA:
-		qm35_logs_list_remove_first(&qml->logs, qml->qm35);
 		qm35_logs_list_append(&qml->logs, skb);
 #if LOG_PRINTK != 0
 		dev_info(dev, "FW: %.*s\n", log_pkt->hdr.body_size,
@@ -838,7 +934,17 @@ static int qm35_logs_init(struct qm35 *qm35)
 	qml->qm35 = qm35;
 	qml->dev = dev;
 
-	INIT_LIST_HEAD(&qml->qtraces.list);
+	qml->qtraces.slots = kcalloc(QM35_LOGS_MAX_PACKET_STORED,
+				     sizeof(*qml->qtraces.slots), GFP_KERNEL);
+	qml->logs.slots = kcalloc(QM35_LOGS_MAX_PACKET_STORED,
+				  sizeof(*qml->logs.slots), GFP_KERNEL);
+	if (!qml->qtraces.slots || !qml->logs.slots) {
+		dev_err(dev, "%s: Cannot allocate memory\n", THIS_MODULE->name);
+		rc = -ENOMEM;
+		goto err_qtraces;
+	}
+
+	qm_xport_ring_init(&qml->qtraces.ring, QM35_LOGS_MAX_PACKET_STORED);
 	spin_lock_init(&qml->qtraces.lock);
 
 	rc = qm35_transport_register(qm35, QM35_TRANSPORT_MSG_QTRACE,
@@ -850,7 +956,7 @@ static int qm35_logs_init(struct qm35 *qm35)
 		goto err_qtraces;
 	}
 
-	INIT_LIST_HEAD(&qml->logs.list);
+	qm_xport_ring_init(&qml->logs.ring, QM35_LOGS_MAX_PACKET_STORED);
 	spin_lock_init(&qml->logs.lock);
 	init_waitqueue_head(&qml->rx_queue);
 	INIT_WORK(&qml->request_work, qm35_logs_request);
@@ -874,6 +980,8 @@ err_logs:
 				  QM35_TRANSPORT_PRIO_NORMAL,
 				  qm35_qtraces_packet_recv);
 err_qtraces:
+	kfree(qml->logs.slots);
+	kfree(qml->qtraces.slots);
 	kfree(qml);
 error:
 	dev_err(dev, "%s: Failed to initialize (%d)\n", THIS_MODULE->name, rc);
@@ -952,6 +1060,8 @@ static int qm35_logs_online(struct qm35 *qm35)
 		rc = PTR_ERR(qml->debugfs_path);
 		goto err_dir;
 	}
+	debugfs_create_file("stats", S_IRUSR, qml->debugfs_path, qml,
+			    &qm35_logs_stats_fops);
 
 	/* Retrieve log sources from FW in another thread.
 	 * Failure to retrieve log sources isn't a critical error.
@@ -1027,6 +1137,8 @@ static void qm35_logs_deinit(struct qm35 *qm35)
 	qm35_logs_list_clear(&qml->qtraces, qml->qm35);
 	mutex_unlock(&qml->file_mutex);
 	mutex_destroy(&qml->file_mutex);
+	kfree(qml->logs.slots);
+	kfree(qml->qtraces.slots);
 
 	/* Free instance. */
 	kfree(qml);
@@ -28,11 +28,13 @@
 #include <linux/spinlock.h>
 #include <linux/sysfs.h>
 #include <linux/types.h>
+#include <linux/uwb/qm_xport.h>
 #include <linux/wait.h>
 #include <linux/workqueue.h>
 
 /* Forward declaration to avoid need to include qm35.h here. */
 struct qm35;
+struct sk_buff;
 
 #define QM35_LOGS_MAX_PACKET_STORED 1024
 
@@ -53,17 +55,19 @@ enum qm35_logs_cmd_id {
 };
 
 /**
- * struct qm35_logs_list - List to store received logs or qtrace packets.
+ * struct qm35_logs_list - Ring to store received logs or qtrace packets.
  * @bin_attr: Binary attribute to expose this list in sysfs.
- * @list: List storing received struct sk_buff.
- * @lock: Spin-lock to protect `list` access.
- * @count: Number of objects in list (max is QM35_LOGS_MAX_PACKET_STORED).
+ * @slots: QM35_LOGS_MAX_PACKET_STORED received struct sk_buff, NULL once
+ *         taken by a reader.
+ * @ring: Shared lossy ring indexing `slots`. When full, the oldest packet is
+ *        evicted and counted as dropped.
+ * @lock: Spin-lock to protect `slots` and `ring` access.
  */
 struct qm35_logs_list {
 	struct bin_attribute bin_attr;
-	struct list_head list;
+	struct sk_buff **slots;
+	struct qm_xport_ring ring;
 	spinlock_t lock;
-	uint32_t count;
 };
 
 /**
@@ -220,19 +220,26 @@ static int qm35_spi_thread(void *data)
 	struct qm35_spi *qmspi = data;
 	struct qm35_worker *wk = &qmspi->worker;
 	unsigned long pending_work = 0;
+	bool irq_served = false;
 
 	dev_info(qmspi->base.dev, "Worker thread started\n");
 	/* Run until stopped */
 	while (!kthread_should_stop()) {
 		/* Pending work items */
 		pending_work = qm35_get_pending_work(qmspi);
-		/* Check IRQ activity */
-		if (pending_work & QM35_IRQ_WORK) {
+		/* Check IRQ activity. A firmware flooding logs keeps the IRQ
+		 * raised, a pending generic work (UCI, log or coredump command)
+		 * then runs between two IRQ rounds instead of after the flood.
+		 */
+		if ((pending_work & QM35_IRQ_WORK) &&
+		    !(irq_served && (pending_work & QM35_GENERIC_WORK))) {
 			/* Handle the event in the ISR */
 			qm35_spi_isr(qmspi);
 			qm35_clear_irq(qmspi);
+			irq_served = true;
 			continue;
 		}
+		irq_served = false;
 		/* Execute generic works */
 		if (pending_work & QM35_GENERIC_WORK) {
 			struct qm35_work *cmd = wk->work;
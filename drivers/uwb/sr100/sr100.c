@@ -31,6 +31,7 @@
 #include <linux/list.h>
 #include <linux/irq.h>
 #include <linux/jiffies.h>
+#include <linux/ktime.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
 #include <linux/interrupt.h>
@@ -73,6 +74,13 @@ static bool is_fw_dwnld_enabled = false;
 /* Maximum UCI packet size supported from the driver */
 #define MAX_UCI_PKT_SIZE 4200
 
+/* Gap SR100 needs between the UCI header and payload of a write */
+#define SR100_WRITE_HDR_DELAY_US 30
+/* Time given to SR100 to ack the read handshake, then to release IRQ */
+#define SR100_IRQ_ACK_TIMEOUT_MS 1
+#define SR100_IRQ_RELEASE_TIMEOUT_MS 10
+enum sr100_irq_levels { SR100_IRQ_LOW, SR100_IRQ_HIGH };
+
 /* Different driver debug lever */
 enum SR100_DEBUG_LEVEL { SR100_DEBUG_OFF, SR100_FULL_DEBUG };
 enum spi_status_codes{
@@ -132,10 +140,8 @@ struct sr100_dev {
 #define READ_THROUGH_PUT 0x01
 #define WRITE_THROUGH_PUT 0x02
 struct sr100_through_put {
-  struct timeval rstart_tv;
-  struct timeval wstart_tv;
-  struct timeval rstop_tv;
-  struct timeval wstop_tv;
+  ktime_t rstart;
+  ktime_t wstart;
   unsigned long total_through_put_wbytes;
   unsigned long total_through_put_rbytes;
   unsigned long total_through_put_rtime;
@@ -157,12 +163,9 @@ static void sr100_stop_throughput_measurement(unsigned int type,
  ****************************************************************************/
 static void sr100_start_throughput_measurement(unsigned int type) {
   if (type == READ_THROUGH_PUT) {
-    memset(&sr100_through_put_t.rstart_tv, 0x00, sizeof(struct timeval));
-    do_gettimeofday(&sr100_through_put_t.rstart_tv);
+    sr100_through_put_t.rstart = ktime_get();
   } else if (type == WRITE_THROUGH_PUT) {
-    memset(&sr100_through_put_t.wstart_tv, 0x00, sizeof(struct timeval));
-    do_gettimeofday(&sr100_through_put_t.wstart_tv);
-
+    sr100_through_put_t.wstart = ktime_get();
   } else {
     printk(KERN_ALERT " sr100_start_throughput_measurement: wrong type = %d",
            type);
@@ -180,25 +183,13 @@ static void sr100_start_throughput_measurement(unsigned int type) {
 static void sr100_stop_throughput_measurement(unsigned int type,
                                               int no_of_bytes) {
   if (type == READ_THROUGH_PUT) {
-    memset(&sr100_through_put_t.rstop_tv, 0x00, sizeof(struct timeval));
-    do_gettimeofday(&sr100_through_put_t.rstop_tv);
     sr100_through_put_t.total_through_put_rbytes += no_of_bytes;
     sr100_through_put_t.total_through_put_rtime +=
-        (sr100_through_put_t.rstop_tv.tv_usec -
-         sr100_through_put_t.rstart_tv.tv_usec) +
-        ((sr100_through_put_t.rstop_tv.tv_sec -
-          sr100_through_put_t.rstart_tv.tv_sec) *
-         1000000);
+        ktime_us_delta(ktime_get(), sr100_through_put_t.rstart);
   } else if (type == WRITE_THROUGH_PUT) {
-    memset(&sr100_through_put_t.wstop_tv, 0x00, sizeof(struct timeval));
-    do_gettimeofday(&sr100_through_put_t.wstop_tv);
     sr100_through_put_t.total_through_put_wbytes += no_of_bytes;
     sr100_through_put_t.total_through_put_wtime +=
-        (sr100_through_put_t.wstop_tv.tv_usec -
-         sr100_through_put_t.wstart_tv.tv_usec) +
-        ((sr100_through_put_t.wstop_tv.tv_sec -
-          sr100_through_put_t.wstart_tv.tv_sec) *
-         1000000);
+        ktime_us_delta(ktime_get(), sr100_through_put_t.wstart);
   } else {
     printk(KERN_ALERT " sr100_stop_throughput_measurement: wrong type = %d",
            type);
@@ -267,6 +258,43 @@ static void sr100_enable_irq(struct sr100_dev* sr100_dev) {
   spin_unlock_irqrestore(&sr100_dev->irq_enabled_lock, flags);
 }
 
+/******************************************************************************
+ * Function    : sr100_wait_irq_level
+ *
+ * Description : Sleep until the IRQ line is at the given level. The irq is
+ *               armed with the matching level trigger, so that no edge can be
+ *               missed between the gpio check and the wait
+ *
+ * Parameters  : sr100_dev  :  sr100 device structure pointer
+ *               level      :  SR100_IRQ_LOW or SR100_IRQ_HIGH
+ *               timeout    :  timeout in jiffies
+ *
+ * Returns     : 0 once the line is at level, -ETIMEDOUT or -ERESTARTSYS
+ ****************************************************************************/
+static int sr100_wait_irq_level(struct sr100_dev* sr100_dev, int level,
+                                long timeout) {
+  long ret;
+
+  if (!!gpio_get_value(sr100_dev->irq_gpio) == level)
+    return 0;
+
+  if (level == SR100_IRQ_LOW)
+    irq_set_irq_type(sr100_dev->spi->irq, IRQ_TYPE_LEVEL_LOW);
+  sr100_enable_irq(sr100_dev);
+  ret = wait_event_interruptible_timeout(sr100_dev->read_wq,
+                                         sr100_dev->irq_received, timeout);
+  sr100_disable_irq(sr100_dev);
+  if (level == SR100_IRQ_LOW)
+    irq_set_irq_type(sr100_dev->spi->irq, IRQ_TYPE_LEVEL_HIGH);
+
+  if (ret < 0)
+    return ret;
+  /* Timed out, or woken up by an abort */
+  if (!!gpio_get_value(sr100_dev->irq_gpio) != level)
+    return -ETIMEDOUT;
+  return 0;
+}
+
 /******************************************************************************
  * Function    : sr100_dev_irq_handler
  *
@@ -385,38 +413,44 @@ static long sr100_dev_ioctl(struct file* filp, unsigned int cmd,
 ****************************************************************************/
 
 static int sr100_dev_transceive(struct sr100_dev* sr100_dev, int op_mode, int count ){
-  int ret,retry_count;
+  int ret;
   mutex_lock(&sr100_dev->sr100_access_lock);
   sr100_dev->mode = op_mode;
   sr100_dev->totalBtyesToRead = 0;
   sr100_dev->IsExtndLenIndication = 0;
   ret = -1;
-  retry_count = 0;
 
   switch(sr100_dev->mode){
     case SR100_WRITE_MODE:
     {
+      struct spi_transfer xfers[2] = {
+        {
+          .tx_buf = sr100_dev->tx_buffer,
+          .len = NORMAL_MODE_HEADER_LEN,
+        },
+        {
+          .tx_buf = sr100_dev->tx_buffer + NORMAL_MODE_HEADER_LEN,
+          .len = count - NORMAL_MODE_HEADER_LEN,
+        },
+      };
+
+      if (count > NORMAL_MODE_HEADER_LEN) {
+        /* Release CS and give SR100 time to parse the header */
+        xfers[0].cs_change = 1;
+        xfers[0].delay.value = SR100_WRITE_HDR_DELAY_US;
+        xfers[0].delay.unit = SPI_DELAY_UNIT_USECS;
+      }
+
       sr100_dev->write_count = 0;
-      /* UCI Header write */
-      ret = spi_write(sr100_dev->spi, sr100_dev->tx_buffer, NORMAL_MODE_HEADER_LEN);
+      /* UCI Header and payload write, in a single message */
+      ret = spi_sync_transfer(sr100_dev->spi, xfers,
+                              count > NORMAL_MODE_HEADER_LEN ? 2 : 1);
       if (ret < 0) {
         ret = -EIO;
-        printk("spi_write header : Failed.\n");
+        printk("spi_write : Failed.\n");
         goto transcive_end;
-      } else {
-        count -= NORMAL_MODE_HEADER_LEN;
-      }
-      if(count > 0) {
-	usleep_range(30,50);
-        /* UCI Payload write */
-        ret = spi_write(sr100_dev->spi, sr100_dev->tx_buffer + NORMAL_MODE_HEADER_LEN, count);
-        if (ret < 0) {
-          ret = -EIO;
-          printk("spi_write payload : Failed.\n");
-          goto transcive_end;
-        }
       }
-      sr100_dev->write_count = count + NORMAL_MODE_HEADER_LEN;
+      sr100_dev->write_count = count;
       ret = spi_transcive_success;
     }
     break;
@@ -427,45 +461,21 @@ static int sr100_dev_transceive(struct sr100_dev* sr100_dev, int op_mode, int co
         ret = spi_irq_wait_request;
         goto transcive_end;
       }
-      retry_count = 0;
       gpio_set_value_cansleep(sr100_dev->spi_handshake_gpio, 1);
-      while (gpio_get_value(sr100_dev->irq_gpio)) {
-        if (retry_count == 100) {
-           break;
-        }
-        udelay(10);
-        retry_count++;
+      /* SR100 acks the handshake by dropping IRQ */
+      if (sr100_wait_irq_level(sr100_dev, SR100_IRQ_LOW,
+                               msecs_to_jiffies(SR100_IRQ_ACK_TIMEOUT_MS))) {
+        SR100_DBG_MSG("IRQ not dropped after handshake\n");
       }
-      sr100_enable_irq(sr100_dev);
       sr100_dev->read_count = 0;
-      retry_count = 0;
       /* wait for inetrrupt upto 500ms after that timeout will happen and returns read fail */
-      ret = wait_event_interruptible_timeout(sr100_dev->read_wq, sr100_dev->irq_received,sr100_dev->timeOutInMs);
-      if (ret == 0) {
-        printk("wait_event_interruptible timeout() : Failed.\n");
+      ret = sr100_wait_irq_level(sr100_dev, SR100_IRQ_HIGH,
+                                 sr100_dev->timeOutInMs);
+      if (ret) {
+        printk("Second IRQ wait : Failed %d.\n", ret);
         ret = spi_irq_wait_timeout;
         goto transcive_end;
       }
-#if 0 // ideally below code is not required to check the gpio status in loop
-      sr100_set_irq_flag(sr100_dev);
-      if(!gpio_get_value(sr100_dev->irq_gpio)){
-        printk("Spurious interrupt detected at second irq");
-        retry_count++;
-        if(retry_count == MAX_READ_RETRY_COUNT){
-          retry_count = 0;
-          printk("Max retry count reached at second irq");
-        } else{
-          msleep(3);
-          sr100_dev->irq_enabled = false;
-          goto second_irq_wait;
-        }
-      }
-#endif
-      if(!gpio_get_value(sr100_dev->irq_gpio)){
-        printk("Second IRQ is Low");
-        ret = -1;
-        goto transcive_end;
-      }
       ret = spi_read(sr100_dev->spi, (void*)sr100_dev->rx_buffer, NORMAL_MODE_HEADER_LEN);
       if (ret < 0) {
         pr_info("sr100_dev_read: spi read error %d\n ", ret);
@@ -495,15 +505,10 @@ static int sr100_dev_transceive(struct sr100_dev* sr100_dev, int op_mode, int co
         }
       }
       sr100_dev->read_count = (unsigned int)(sr100_dev->totalBtyesToRead + NORMAL_MODE_HEADER_LEN);
-      retry_count = 0;
-      do{
-        usleep_range(10,15);
-        retry_count++;
-        if(retry_count == 1000){
-          printk("Slave not released the IRQ even after 10ms");
-          break;
-        }
-      }while(gpio_get_value(sr100_dev->irq_gpio));
+      if (sr100_wait_irq_level(sr100_dev, SR100_IRQ_LOW,
+                               msecs_to_jiffies(SR100_IRQ_RELEASE_TIMEOUT_MS))) {
+        printk("Slave not released the IRQ even after 10ms");
+      }
       ret = spi_transcive_success;
       gpio_set_value_cansleep(sr100_dev->spi_handshake_gpio, 0);
     }
@@ -701,7 +706,15 @@ first_irq_wait:
     printk("Abort Read pending......");
     return ret;
   }
+#if (ENABLE_THROUGHPUT_MEASUREMENT == 1)
+  sr100_start_throughput_measurement(READ_THROUGH_PUT);
+#endif
   ret = sr100_dev_transceive(sr100_dev,SR100_READ_MODE, count);
+#if (ENABLE_THROUGHPUT_MEASUREMENT == 1)
+  sr100_stop_throughput_measurement(READ_THROUGH_PUT,
+                                    ret == spi_transcive_success ?
+                                    sr100_dev->read_count : 0);
+#endif
   if(ret == spi_transcive_success){
     if (copy_to_user(buf, sr100_dev->rx_buffer, sr100_dev->read_count)) {
       pr_info("sr100_dev_read: copy to user failed\n");
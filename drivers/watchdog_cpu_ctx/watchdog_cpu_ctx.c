@@ -14,8 +14,10 @@
 #include <linux/proc_fs.h>
 #include <linux/errno.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/types.h>
@@ -33,7 +35,9 @@
 #include <linux/kallsyms.h>
 #include <linux/io.h>
 #include <linux/mm_types.h>
+#include <linux/workqueue.h>
 #include <linux/mmi_annotate.h>
+#include <linux/mmi_crash_bundle.h>
 #include <soc/qcom/mmi_boot_info.h>
 #include "watchdog_cpu_ctx.h"
 
@@ -71,6 +75,17 @@ struct platform_data {
 	size_t		mem_size;
 };
 
+/* Crash record, kept for procfs once the region is cleared */
+static struct wdog_rec_hdr rec_hdr;
+static struct wdog_rec_cpu *rec_cpus;
+static unsigned long *rec_stacks;
+static struct proc_dir_entry *procfs_file;
+
+/* The stacks are in the crash record, only annotate them on request */
+static bool annotate_raw_mem;
+module_param(annotate_raw_mem, bool, 0644);
+MODULE_PARM_DESC(annotate_raw_mem, "Annotate the hex dump of the saved stacks");
+
 const struct msm_wdog_cpuctx_header mwc_header[] = {
 	{
 		.type	= CPUCTX_LNX_INFO,
@@ -336,13 +351,18 @@ static void msm_wdt_show_raw_mem(unsigned long addr, int nbytes,
 	int	i, j;
 	int	nlines;
 	unsigned long *p;
+	char	line[96];
+	int	len;
+
+	if (!annotate_raw_mem)
+		return;
 
-	MSMWDTD("%s: %#lx: ", label, old_addr);
 	if (!virt_is_valid(old_addr)) {
-		MSMWDTD("is not valid kernel address.\n");
+		MSMWDTD("%s: %#lx: is not valid kernel address.\n",
+			label, old_addr);
 		return;
 	}
-	MSMWDTD("\n");
+	MSMWDTD("%s: %#lx: \n", label, old_addr);
 
 	/*
 	 * round address down to unsigned long aligned boundary
@@ -357,16 +377,15 @@ static void msm_wdt_show_raw_mem(unsigned long addr, int nbytes,
 		 * just display low 16 bits of address to keep
 		 * each line of the dump < 80 characters
 		 */
-		MSMWDTD("%04lx ", (unsigned long)old_addr & 0xffff);
+		len = scnprintf(line, sizeof(line), "%04lx ",
+				(unsigned long)old_addr & 0xffff);
 		for (j = 0; j < (32 / sizeof(unsigned long)); j++) {
-			if (sizeof(unsigned long) == 4)
-				MSMWDTD(" %08lx", *p);
-			else
-				MSMWDTD(" %016lx", *p);
+			len += scnprintf(line + len, sizeof(line) - len,
+					" %0*lx", (int)(2 * sizeof(*p)), *p);
 			++p;
 			old_addr += sizeof(*p);
 		}
-		MSMWDTD("\n");
+		MSMWDTD("%s\n", line);
 	}
 }
 
@@ -386,29 +405,28 @@ static void msm_wdog_show_sc_status(uint32_t sc_status)
 	MSMWDTD("\n");
 }
 
-static void msm_wdt_show_thread_saved_pc(struct task_struct *p,
-				struct thread_info *ti);
-static void msm_wdt_show_task(struct task_struct *p, struct thread_info *ti)
+static void msm_wdt_show_task(struct wdog_rec_cpu *rc)
 {
 	unsigned state;
 	const char *stat_nam = TASK_STATE_TO_CHAR_STR;
 
-	state = p->state ? __ffs(p->state) + 1 : 0;
-	MSMWDTD("%-15.15s %c", p->comm,
+	state = rc->task_state ? __ffs(rc->task_state) + 1 : 0;
+	MSMWDTD("%-15.15s %c", rc->comm,
 		state < strlen(stat_nam) - 1 ? stat_nam[state] : '?');
 	if (state == TASK_RUNNING)
 		MSMWDTD(" running  ");
 	else
-		msm_wdt_show_thread_saved_pc(p, ti);
-	MSMWDTD("pid %6d tgid %6d 0x%08lx\n", task_pid_nr(p), task_tgid_nr(p),
-			(unsigned long)ti->flags);
+		MSMWDTD(" %0*lx ", (int)(2 * sizeof(long)),
+			(unsigned long)rc->saved_pc);
+	MSMWDTD("pid %6d tgid %6d 0x%08lx\n", rc->pid, rc->tgid,
+			(unsigned long)rc->ti_flags);
 }
 
 #if defined(CONFIG_ARM64)
-static void msm_wdt_show_thread_saved_pc(struct task_struct *p,
+static unsigned long msm_wdt_thread_saved_pc(struct task_struct *p,
 				struct thread_info *ti)
 {
-	MSMWDTD(" %016lx ", (unsigned long)p->thread.cpu_context.pc);
+	return p->thread.cpu_context.pc;
 }
 
 static int msm_wdt_unwind_frame_aa64(struct stackframe *frame,
@@ -554,10 +572,10 @@ static int msm_wdt_stackframe(struct stackframe *frame, void *data)
 	return 0;
 }
 
-static void msm_wdt_show_thread_saved_pc(struct task_struct *p,
+static unsigned long msm_wdt_thread_saved_pc(struct task_struct *p,
 				struct thread_info *ti)
 {
-	MSMWDTD(" %08lx ", (unsigned long)ti->cpu_context.pc);
+	return ti->cpu_context.pc;
 }
 
 static void msm_wdt_show_regs(struct sysdbgCPUCtxtType *sysdbg_ctx)
@@ -633,146 +651,268 @@ static void msm_wdt_unwind(struct sysdbgCPUCtxtType *sysdbg_ctx,
 }
 #endif
 
-static void msm_wdog_ctx_print(struct msm_wdog_cpuctx *ctx,
-				phys_addr_t paddr, size_t ctx_size)
+static int msm_wdog_ctx_info_invalid(struct msm_wdog_cpuctx_info *info)
+{
+	return (info->sig != MSM_WDOG_CTX_SIG) ||
+		(info->rev2 != MSM_WDOG_CTX_REV) ||
+		(info->rev != MSM_WDOG_CTX_REV) ||
+		(info->size != WDOG_CPUCTX_SIZE_PERCPU) ||
+		(info->ret != ERR_NONE);
+}
+
+static void msm_wdog_rec_task(struct wdog_rec_cpu *rc, struct task_struct *p,
+				struct thread_info *ti)
+{
+	memcpy(rc->comm, p->comm, sizeof(rc->comm));
+	rc->comm[sizeof(rc->comm) - 1] = '\0';
+	rc->task_state = p->state;
+	rc->saved_pc = msm_wdt_thread_saved_pc(p, ti);
+	rc->ti_flags = ti->flags;
+	rc->pid = task_pid_nr(p);
+	rc->tgid = task_tgid_nr(p);
+	rc->flags |= WDOG_REC_TASK;
+}
+
+/*
+ * Copy what the next steps need out of the region once: the checks of
+ * each cpu, its registers and a THREAD_SIZE aligned copy of its stack.
+ * Symbolizing and annotating is done later from the record.
+ */
+static void msm_wdog_ctx_record(struct msm_wdog_cpuctx *ctx)
 {
 	struct msm_wdog_cpuctx *ctxi;
 	struct msm_dump_data *cpu_data;
-	struct msm_wdog_cpuctx_info *info;
-	struct msm_wdog_cpuctx_stat *stat;
-	cpumask_t cpus, cpus_nodump, cpus_regs, cpus_dd;
-	unsigned long stack_tmp = 0;
-	int cpu;
+	struct wdog_rec_cpu *rc;
+	unsigned int nr = num_present_cpus();
+	ktime_t start = ktime_get();
+	unsigned long stack;
+	int cpu, i = 0;
+
+	rec_cpus = kcalloc(nr, sizeof(*rec_cpus), GFP_KERNEL);
+	rec_stacks = kcalloc(nr, sizeof(*rec_stacks), GFP_KERNEL);
+	if (!rec_cpus || !rec_stacks) {
+		MSMWDT_ERR("Alloc crash record failed.\n");
+		kfree(rec_cpus);
+		kfree(rec_stacks);
+		rec_cpus = NULL;
+		rec_stacks = NULL;
+		return;
+	}
 
-	cpumask_clear(&cpus);
 	for_each_cpu(cpu, cpu_present_mask) {
+		if (i >= nr)
+			break;
 		ctxi = &ctx[cpu];
 		cpu_data = &ctxi->cpu_data;
-		if (msm_wdog_ctx_header_check(ctxi)) {
-			MSMWDTD_IFWDOG("CPU%d: ctx header invalid\n", cpu);
+		rc = &rec_cpus[i++];
+		rc->cpu = cpu;
+
+		if (msm_wdog_ctx_header_check(ctxi))
+			continue;
+		rc->flags |= WDOG_REC_HDR;
+		memcpy_fromio(&rc->info, &ctxi->info, sizeof(rc->info));
+		if (msm_wdog_ctx_info_invalid(&rc->info))
+			continue;
+		rc->flags |= WDOG_REC_CTX;
+
+		rc->dump_magic = cpu_data->magic;
+		rc->dump_version = cpu_data->version;
+		if (!rc->dump_magic && !rc->dump_version &&
+				!ctxi->sysdbg.data.status[0]) {
+			rc->flags |= WDOG_REC_NO_DUMP;
 			continue;
 		}
+		if (rc->dump_magic != DUMP_MAGIC_NUMBER ||
+				msm_wdog_cpu_regs_version_unknown(rc->dump_version))
+			continue;
+		memcpy_fromio(&rc->sysdbg, &ctxi->sysdbg.data,
+				sizeof(rc->sysdbg));
+		memcpy_fromio(&rc->stat, &ctxi->stat, sizeof(rc->stat));
+		rc->flags |= WDOG_REC_REGS;
 
-		info = &ctxi->info;
-		if ((info->sig != MSM_WDOG_CTX_SIG) ||
-				(info->rev2 != MSM_WDOG_CTX_REV) ||
-				(info->rev != MSM_WDOG_CTX_REV) ||
-				(info->size != WDOG_CPUCTX_SIZE_PERCPU) ||
-				(info->ret != ERR_NONE)) {
-			MSMWDTD_IFWDOG("CPU%d: sig %x rev %x/%x sz %x ret %x\n",
-					cpu, info->sig, (unsigned)info->rev,
-					info->rev2, info->size, info->ret);
+		if (rc->stat.ret != ERR_NONE && rc->stat.ret != ERR_TASK_INVAL)
+			continue;
+		stack = __get_free_pages(GFP_KERNEL, THREAD_SIZE_ORDER);
+		if (!stack) {
+			MSMWDT_ERR("Alloc temp stack failed.\n");
 			continue;
 		}
-		cpumask_set_cpu(cpu, &cpus);
+		memcpy_fromio((void *)stack, ctxi->stack, THREAD_SIZE);
+		rec_stacks[i - 1] = stack;
+		rc->flags |= WDOG_REC_STACK;
+
+		if (rc->stat.ret == ERR_TASK_INVAL)
+			continue;
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(4,9,0) || !IS_ENABLED(CONFIG_THREAD_INFO_IN_TASK)
+		msm_wdog_rec_task(rc, &ctxi->task, (struct thread_info *)stack);
+#else
+		msm_wdog_rec_task(rc, &ctxi->task, &ctxi->task.thread_info);
+#endif
 	}
 
-	if (cpumask_empty(&cpus))
-		return;
+	rec_hdr.magic = WDOG_REC_MAGIC;
+	rec_hdr.version = WDOG_REC_VERSION;
+	rec_hdr.hdr_size = sizeof(rec_hdr);
+	rec_hdr.cpu_size = sizeof(*rec_cpus);
+	rec_hdr.nr_cpus = i;
+	rec_hdr.thread_size = THREAD_SIZE;
+	rec_hdr.aa64 = IS_ENABLED(CONFIG_ARM64);
+	rec_hdr.kaslr_offset = ctx->lnx.kaslr_offset;
+	rec_hdr.decode_us = ktime_us_delta(ktime_get(), start);
+}
+
+static void msm_wdog_ctx_print(void)
+{
+	struct wdog_rec_cpu *rc;
+	struct msm_wdog_copy *job;
+	unsigned int nr_nodump = 0, nr_regs = 0;
+	int i;
 
-	cpumask_clear(&cpus_nodump);
-	cpumask_clear(&cpus_regs);
-	cpumask_clear(&cpus_dd);
+	for (i = 0; i < rec_hdr.nr_cpus; i++) {
+		rc = &rec_cpus[i];
+		if (!(rc->flags & WDOG_REC_HDR))
+			MSMWDTD_IFWDOG("CPU%d: ctx header invalid\n", rc->cpu);
+		else if (!(rc->flags & WDOG_REC_CTX))
+			MSMWDTD_IFWDOG("CPU%d: sig %x rev %x/%x sz %x ret %x\n",
+					rc->cpu, rc->info.sig,
+					(unsigned)rc->info.rev, rc->info.rev2,
+					rc->info.size, rc->info.ret);
+	}
 
-	for_each_cpu(cpu, &cpus) {
+	for (i = 0; i < rec_hdr.nr_cpus; i++) {
 		uint32_t *status;
-		ctxi = &ctx[cpu];
-		cpu_data = &ctxi->cpu_data;
-		stat = &ctxi->stat;
 
-		if (!cpu_data->magic && !cpu_data->version &&
-				!ctxi->sysdbg.data.status[0]) {
-			MSMWDTD_IFWDOG("CPU%d: No Dump!\n", cpu);
-			cpumask_set_cpu(cpu, &cpus_nodump);
+		rc = &rec_cpus[i];
+		if (!(rc->flags & WDOG_REC_CTX))
+			continue;
+		if (rc->flags & WDOG_REC_NO_DUMP) {
+			MSMWDTD_IFWDOG("CPU%d: No Dump!\n", rc->cpu);
+			nr_nodump++;
 			continue;
 		}
-		if (cpu_data->magic != DUMP_MAGIC_NUMBER) {
+		if (rc->dump_magic != DUMP_MAGIC_NUMBER) {
 			MSMWDTD_IFWDOG("CPU%d: dump magic mismatch %x/%x\n",
-				cpu, cpu_data->magic, DUMP_MAGIC_NUMBER);
+				rc->cpu, rc->dump_magic, DUMP_MAGIC_NUMBER);
 			continue;
 		}
-		if (msm_wdog_cpu_regs_version_unknown(cpu_data->version)) {
+		if (!(rc->flags & WDOG_REC_REGS)) {
 			MSMWDTD_IFWDOG("CPU%d: unknown version %d\n",
-				cpu, cpu_data->version);
+				rc->cpu, rc->dump_version);
 			continue;
 		}
-		cpumask_set_cpu(cpu, &cpus_regs);
-		status = &ctxi->sysdbg.data.status[0];
-		MSMWDTD("CPU%d: %x %x ", cpu, status[0], status[1]);
+		nr_regs++;
+		status = &rc->sysdbg.status[0];
+		MSMWDTD("CPU%d: %x %x ", rc->cpu, status[0], status[1]);
 		msm_wdog_show_sc_status(status[1]);
-		if (stat->ret == ERR_NONE || stat->ret == ERR_TASK_INVAL)
-			cpumask_set_cpu(cpu, &cpus_dd);
 	}
 
-	if (cpumask_equal(&cpus_nodump, cpu_present_mask)) {
+	if (rec_hdr.nr_cpus && nr_nodump == rec_hdr.nr_cpus) {
 		MSMWDTD_IFWDOG("Might be Secure Watchdog Bite!\n");
 		return;
 	}
-	if (cpumask_empty(&cpus_regs))
+	if (!nr_regs)
 		return;
 	MSMWDTD("\n");
-	for_each_cpu(cpu, &cpus_regs) {
-		struct msm_wdog_copy *job;
-
-		ctxi = &ctx[cpu];
-		stat = &ctxi->stat;
-		MSMWDTD("CPU%d: ret %x", cpu, stat->ret);
-		if (stat->stack_va) {
-			MSMWDTD(" stack %lx ", (unsigned long)stat->stack_va);
-			job = &stat->jobs[LNX_STACK];
+	for (i = 0; i < rec_hdr.nr_cpus; i++) {
+		rc = &rec_cpus[i];
+		if (!(rc->flags & WDOG_REC_REGS))
+			continue;
+		MSMWDTD("CPU%d: ret %x", rc->cpu, rc->stat.ret);
+		if (rc->stat.stack_va) {
+			MSMWDTD(" stack %lx ", (unsigned long)rc->stat.stack_va);
+			job = &rc->stat.jobs[LNX_STACK];
 			MSMWDTD("%lx -> %lx (%lx) ", (unsigned long)job->from,
 					(unsigned long)job->to,
 					(unsigned long)job->size);
-			job = &stat->jobs[LNX_TASK];
+			job = &rc->stat.jobs[LNX_TASK];
 			MSMWDTD("%lx -> %lx (%lx)", (unsigned long)job->from,
 					(unsigned long)job->to,
 					(unsigned long)job->size);
 		}
 		MSMWDTD("\n");
 	}
-	for_each_cpu(cpu, &cpus_regs) {
-		ctxi = &ctx[cpu];
-		MSMWDTD("\nCPU%d\n", cpu);
-		msm_wdt_show_regs(&ctxi->sysdbg.data);
+	for (i = 0; i < rec_hdr.nr_cpus; i++) {
+		rc = &rec_cpus[i];
+		if (!(rc->flags & WDOG_REC_REGS))
+			continue;
+		MSMWDTD("\nCPU%d\n", rc->cpu);
+		msm_wdt_show_regs(&rc->sysdbg);
 	}
-	for_each_cpu(cpu, &cpus_dd) {
-		unsigned long data;
+	for (i = 0; i < rec_hdr.nr_cpus; i++) {
+		rc = &rec_cpus[i];
+		if (!(rc->flags & WDOG_REC_STACK))
+			continue;
+		MSMWDTD("\nCPU%d\n", rc->cpu);
+		if (rc->flags & WDOG_REC_TASK)
+			msm_wdt_show_task(rc);
+		msm_wdt_unwind(&rc->sysdbg, rc->stat.stack_va,
+			rec_hdr.kaslr_offset, rec_stacks[i]);
+	}
+	MSMWDTD("\n");
+}
 
-		ctxi = &ctx[cpu];
-		stat = &ctxi->stat;
-		if (!IS_ALIGNED((unsigned long)ctxi->stack, THREAD_SIZE)
-					&& !stack_tmp) {
-			stack_tmp = __get_free_pages(GFP_KERNEL,
-					THREAD_SIZE_ORDER);
-			if (!stack_tmp)
-				MSMWDT_ERR("Alloc temp stack failed.\n");
-		}
-		if (stack_tmp) {
-			memcpy_fromio((void *)stack_tmp, ctxi->stack,
-					THREAD_SIZE);
-			data = stack_tmp;
-		} else {
-			data = (unsigned long)ctxi->stack;
-		}
+static void msm_wdog_ctx_print_work(struct work_struct *work)
+{
+	ktime_t start = ktime_get();
 
-		MSMWDTD("\nCPU%d\n", cpu);
-		if(stat->ret != ERR_TASK_INVAL) {
-#if LINUX_VERSION_CODE <= KERNEL_VERSION(4,9,0) || !IS_ENABLED(CONFIG_THREAD_INFO_IN_TASK)
-			msm_wdt_show_task(&ctxi->task,
-				(struct thread_info *)ctxi->stack);
-#else
-			msm_wdt_show_task(&ctxi->task,
-				&ctxi->task.thread_info);
-#endif
-		}
-		msm_wdt_unwind(&ctxi->sysdbg.data, ctxi->stat.stack_va,
-			ctx->lnx.kaslr_offset, data);
+	msm_wdog_ctx_print();
+	pr_info("WdogCtx: decoded in %u us, annotated in %lld us\n",
+		rec_hdr.decode_us, ktime_us_delta(ktime_get(), start));
+}
+
+static DECLARE_WORK(print_work, msm_wdog_ctx_print_work);
+
+static void msm_wdog_rec_free(void)
+{
+	int i;
+
+	if (rec_stacks) {
+		for (i = 0; i < rec_hdr.nr_cpus; i++)
+			if (rec_stacks[i])
+				free_pages(rec_stacks[i], THREAD_SIZE_ORDER);
 	}
-	MSMWDTD("\n");
-	if (stack_tmp)
-		free_pages(stack_tmp, THREAD_SIZE_ORDER);
+	kfree(rec_stacks);
+	kfree(rec_cpus);
+	rec_stacks = NULL;
+	rec_cpus = NULL;
+}
+
+static int wdog_rec_seq_show(struct seq_file *f, void *ptr)
+{
+	int i;
+
+	if (!rec_cpus)
+		return 0;
+
+	seq_write(f, &rec_hdr, sizeof(rec_hdr));
+	seq_write(f, rec_cpus, rec_hdr.nr_cpus * sizeof(*rec_cpus));
+	for (i = 0; i < rec_hdr.nr_cpus; i++)
+		if (rec_stacks[i])
+			seq_write(f, (void *)rec_stacks[i], THREAD_SIZE);
+	return 0;
 }
 
+static int wdog_rec_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wdog_rec_seq_show, NULL);
+}
+
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+static const struct proc_ops wdog_rec_operations = {
+	.proc_open		= wdog_rec_open,
+	.proc_read		= seq_read,
+	.proc_lseek		= seq_lseek,
+	.proc_release	= single_release,
+};
+#else
+static const struct file_operations wdog_rec_operations = {
+	.open		= wdog_rec_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static void watchdog_cpu_ctx_table_register(struct device *dev,
 	struct platform_data *pdata)
 {
@@ -845,6 +985,8 @@ static int watchdog_cpu_ctx_probe(struct platform_device *pdev)
 	}
 
 	watchdog_cpu_ctx_table_register(dev, pdata);
+	mmi_crash_region_add("WDOG_CPU_CTX", NULL, pdata->mem_address,
+			pdata->mem_size, MMI_CRASH_PRIO_CRITICAL);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,4,0)
 	ctx_vaddr = ioremap_wc(pdata->mem_address, pdata->mem_size);
 #else
@@ -858,8 +1000,18 @@ static int watchdog_cpu_ctx_probe(struct platform_device *pdev)
 		goto err;
 	}
 
-	msm_wdog_ctx_print(ctx_vaddr, pdata->mem_address, pdata->mem_size);
+	msm_wdog_ctx_record(ctx_vaddr);
 	msm_wdog_ctx_reset(ctx_vaddr, pdata->mem_size);
+	if (!rec_cpus)
+		goto err;
+	dev_info(dev, "crash record of %u cpus in %u us\n",
+			rec_hdr.nr_cpus, rec_hdr.decode_us);
+
+	/* Create the procfs file at /proc/driver/wdog_cpu_ctx */
+	procfs_file = proc_create("driver/wdog_cpu_ctx",
+		0400, NULL, &wdog_rec_operations);
+	if (bi_powerup_reason() == PU_REASON_WDOG_AP_RESET)
+		schedule_work(&print_work);
 
 err:
 	return err;
@@ -867,6 +1019,11 @@ err:
 
 static int watchdog_cpu_ctx_remove(struct platform_device *pdev)
 {
+	mmi_crash_region_remove("WDOG_CPU_CTX");
+	cancel_work_sync(&print_work);
+	if (procfs_file)
+		remove_proc_entry("driver/wdog_cpu_ctx", NULL);
+	msm_wdog_rec_free();
 	return 0;
 }
 
@@ -358,6 +358,50 @@ struct msm_wdog_cpuctx {
 #define WDOG_CPUCTX_SIZE_PERCPU	(sizeof(struct msm_wdog_cpuctx))
 #define WDOG_CPUCTX_SIZE	(num_present_cpus() * WDOG_CPUCTX_SIZE_PERCPU)
 
+/*
+ * Crash record decoded from the region before it is cleared, read from
+ * /proc/driver/wdog_cpu_ctx. Layout: struct wdog_rec_hdr, nr_cpus
+ * struct wdog_rec_cpu, then thread_size bytes of stack for every cpu
+ * with WDOG_REC_STACK set, in the same order.
+ */
+#define WDOG_REC_MAGIC		0x57435231	/* WCR1 */
+#define WDOG_REC_VERSION	1
+
+#define WDOG_REC_HDR		BIT(0)	/* ctx header valid */
+#define WDOG_REC_CTX		BIT(1)	/* ctx info valid */
+#define WDOG_REC_NO_DUMP	BIT(2)	/* nothing saved for this cpu */
+#define WDOG_REC_REGS		BIT(3)	/* sysdbg and stat valid */
+#define WDOG_REC_STACK		BIT(4)	/* stack saved */
+#define WDOG_REC_TASK		BIT(5)	/* task fields valid */
+
+struct wdog_rec_hdr {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t hdr_size;
+	uint32_t cpu_size;
+	uint32_t nr_cpus;
+	uint32_t thread_size;
+	uint32_t aa64;
+	uint32_t decode_us;
+	uint64_t kaslr_offset;
+} __packed __aligned(4);
+
+struct wdog_rec_cpu {
+	uint32_t cpu;
+	uint32_t flags;
+	struct msm_wdog_cpuctx_info info;
+	uint32_t dump_magic;
+	uint32_t dump_version;
+	struct msm_wdog_cpuctx_stat stat;
+	struct sysdbgCPUCtxtType sysdbg;
+	uint64_t task_state;
+	uint64_t saved_pc;
+	uint64_t ti_flags;
+	int32_t pid;
+	int32_t tgid;
+	char comm[TASK_COMM_LEN];
+} __packed __aligned(4);
+
 #define KASLR_MAGIC_NUM 0xdead4ead
 #define KASLR_REGION_LEN 32
 
@@ -13,7 +13,10 @@
 #ifndef __MMI_ANNOTATE_H_INCLUDED
 #define __MMI_ANNOTATE_H_INCLUDED
 
+#include <linux/types.h>
+
 int mmi_annotate(const char *fmt, ...);
 int mmi_annotate_persist(const char *fmt, ...);
+int mmi_annotate_bin(u32 id, const void *data, size_t len);
 
 #endif		/* __MMI_ANNOTATE_H_INCLUDED */
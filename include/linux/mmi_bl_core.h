@@ -0,0 +1,66 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MMI_BL_CORE_H_INCLUDED
+#define __MMI_BL_CORE_H_INCLUDED
+
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/ratelimit.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/*
+ * Brightness front end shared by the backlight drivers, provided by
+ * mmi_bl_core.ko. Requests are queued and applied from a work item, so
+ * a burst collapses to its latest level; a level equal to the one on
+ * the chip is dropped. update() runs serialized and only has to program
+ * the level it is given, transitions included. Counters are under
+ * debugfs mmi_bl_core/<name>.
+ */
+struct mmi_bl_core {
+	const char		*name;
+	int			(*update)(void *data, int level);
+	void			*data;
+
+	struct mutex		lock;		/* serializes update() */
+	spinlock_t		req_lock;	/* requested, pending, requests, coalesced */
+	int			requested;
+	bool			pending;
+	int			applied;	/* -1 if unknown */
+	struct work_struct	work;
+	struct ratelimit_state	rs;
+	struct dentry		*dentry;
+
+	u64			requests;
+	u64			coalesced;
+	u64			skipped;
+	u64			updates;
+	u64			errors;
+	ktime_t			stats_start;
+};
+
+int mmi_bl_core_init(struct mmi_bl_core *core, const char *name,
+		     int (*update)(void *data, int level), void *data);
+void mmi_bl_core_exit(struct mmi_bl_core *core);
+/* Apply level later, superseding any level still queued */
+void mmi_bl_core_queue(struct mmi_bl_core *core, int level);
+/* Apply level before returning, e.g. for suspend or power off */
+int mmi_bl_core_set(struct mmi_bl_core *core, int level);
+/* The chip lost its state, write the next level even if unchanged */
+void mmi_bl_core_invalidate(struct mmi_bl_core *core);
+
+#endif		/* __MMI_BL_CORE_H_INCLUDED */
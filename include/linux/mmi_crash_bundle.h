@@ -0,0 +1,131 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MMI_CRASH_BUNDLE_H_INCLUDED
+#define __MMI_CRASH_BUNDLE_H_INCLUDED
+
+#include <linux/bits.h>
+#include <linux/errno.h>
+#include <linux/types.h>
+#include <linux/version.h>
+#if !IS_ENABLED(CONFIG_MMI_CRASH_BUNDLE)
+#include <linux/string.h>
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
+#include <soc/qcom/minidump.h>
+#endif
+#endif
+#endif
+
+/*
+ * Index of the crash artifacts, kept by mmi_qcom_minidump in its
+ * bundle-mem reserved region so the next boot, or the bootloader, finds
+ * every artifact of a crash with one read: a struct mmi_crash_bundle_hdr
+ * followed by nr_entries struct mmi_crash_bundle_entry, in priority
+ * order. The header is valid when magic is set and crc matches the
+ * entries.
+ */
+#define MMI_CRASH_BUNDLE_MAGIC		0x4d434231	/* MCB1 */
+#define MMI_CRASH_BUNDLE_VERSION	1
+#define MMI_CRASH_NAME_LEN		16
+
+/* Lower goes first when the budget is short */
+enum mmi_crash_prio {
+	MMI_CRASH_PRIO_CRITICAL	= 0,	/* cpu context, bundle index */
+	MMI_CRASH_PRIO_HIGH	= 10,	/* annotations */
+	MMI_CRASH_PRIO_NORMAL	= 20,	/* firmware logs */
+	MMI_CRASH_PRIO_LOW	= 30,
+};
+
+enum mmi_crash_reason {
+	MMI_CRASH_REASON_NONE,
+	MMI_CRASH_REASON_PANIC,
+	MMI_CRASH_REASON_SW_REBOOT,
+};
+
+#define MMI_CRASH_F_INDEXED	BIT(0)	/* fits in the budget */
+#define MMI_CRASH_F_MINIDUMP	BIT(1)	/* added to the QCOM minidump */
+
+struct mmi_crash_bundle_entry {
+	char		name[MMI_CRASH_NAME_LEN];
+	uint32_t	prio;
+	uint32_t	flags;
+	uint64_t	paddr;
+	uint64_t	size;
+} __packed __aligned(4);
+
+struct mmi_crash_bundle_hdr {
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	hdr_size;
+	uint32_t	entry_size;
+	uint32_t	nr_entries;
+	uint32_t	reason;		/* enum mmi_crash_reason */
+	uint64_t	budget;		/* 0 if unlimited */
+	uint64_t	total;		/* bytes of the indexed regions */
+	uint32_t	seq;		/* bumped on every update */
+	uint32_t	crc;		/* crc32 of the entries */
+} __packed __aligned(4);
+
+#if IS_ENABLED(CONFIG_MMI_CRASH_BUNDLE)
+/*
+ * Register a crash artifact. Regions with a vaddr are also added to the
+ * QCOM minidump as long as they fit in the budget. Returns -ENOSPC if
+ * the region is left out of the bundle.
+ */
+int mmi_crash_region_add(const char *name, void *vaddr, phys_addr_t paddr,
+			 size_t size, int prio);
+/* Unregister, from the minidump too, before the region is freed */
+void mmi_crash_region_remove(const char *name);
+/* Safe from atomic context, panic notifiers included */
+void mmi_crash_bundle_set_reason(u32 reason);
+#else
+/* No registry, go to the minidump directly */
+static inline int mmi_crash_region_add(const char *name, void *vaddr,
+				phys_addr_t paddr, size_t size, int prio)
+{
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
+	struct md_region md_entry;
+
+	if (!vaddr)
+		return 0;
+	strscpy(md_entry.name, name, sizeof(md_entry.name));
+	md_entry.virt_addr = (uintptr_t)vaddr;
+	md_entry.phys_addr = paddr;
+	md_entry.size = size;
+	if (msm_minidump_add_region(&md_entry) < 0)
+		return -EINVAL;
+#endif
+#endif
+	return 0;
+}
+
+static inline void mmi_crash_region_remove(const char *name)
+{
+#if KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE
+#if IS_ENABLED(CONFIG_QCOM_MINIDUMP)
+	struct md_region md_entry;
+
+	memset(&md_entry, 0, sizeof(md_entry));
+	strscpy(md_entry.name, name, sizeof(md_entry.name));
+	msm_minidump_remove_region(&md_entry);
+#endif
+#endif
+}
+
+static inline void mmi_crash_bundle_set_reason(u32 reason) {}
+#endif
+
+#endif		/* __MMI_CRASH_BUNDLE_H_INCLUDED */
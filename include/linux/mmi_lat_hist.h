@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __MMI_LAT_HIST_H_INCLUDED
+#define __MMI_LAT_HIST_H_INCLUDED
+
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/*
+ * Log2 latency histogram in microseconds. Bucket i counts samples in
+ * [2^(i-1), 2^i) us, bucket 0 is < 1us and the last bucket also takes
+ * everything above. Header only, so that drivers need no extra module.
+ */
+#define MMI_LAT_HIST_BUCKETS		24
+
+/* For users printing through something else than a seq_file */
+#define MMI_LAT_HIST_FMT		"%s: count %llu avg %llu us max %llu us\n"
+#define MMI_LAT_HIST_BUCKET_FMT		"  %10llu us: %llu\n"
+
+/* Not serialized, the caller provides the locking */
+struct mmi_lat_hist {
+	u64 count;
+	u64 sum_us;
+	u64 max_us;
+	u64 buckets[MMI_LAT_HIST_BUCKETS];
+};
+
+static inline unsigned int mmi_lat_hist_bucket(u64 us)
+{
+	unsigned int bucket = us ? fls64(us) : 0;
+
+	return bucket < MMI_LAT_HIST_BUCKETS ?
+		bucket : MMI_LAT_HIST_BUCKETS - 1;
+}
+
+/* Lower bound of a bucket, in us */
+static inline u64 mmi_lat_hist_floor(unsigned int bucket)
+{
+	return bucket ? BIT_ULL(bucket - 1) : 0;
+}
+
+static inline void mmi_lat_hist_add(struct mmi_lat_hist *hist, u64 us)
+{
+	hist->buckets[mmi_lat_hist_bucket(us)]++;
+	hist->count++;
+	hist->sum_us += us;
+	if (us > hist->max_us)
+		hist->max_us = us;
+}
+
+static inline void mmi_lat_hist_show(struct seq_file *s, const char *name,
+				     const struct mmi_lat_hist *hist)
+{
+	unsigned int i;
+
+	seq_printf(s, MMI_LAT_HIST_FMT, name, hist->count,
+		   hist->count ? div64_u64(hist->sum_us, hist->count) : 0,
+		   hist->max_us);
+	for (i = 0; i < MMI_LAT_HIST_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+
+		seq_printf(s, MMI_LAT_HIST_BUCKET_FMT,
+			   mmi_lat_hist_floor(i), hist->buckets[i]);
+	}
+}
+
+#endif		/* __MMI_LAT_HIST_H_INCLUDED */
@@ -0,0 +1,141 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _NCI_XPORT_H_
+#define _NCI_XPORT_H_
+
+#include <linux/ktime.h>
+#include <linux/mmi_lat_hist.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/wait.h>
+
+#define NCI_XPORT_HDR_LEN		3
+#define NCI_XPORT_PAYLOAD_LEN_IDX	2
+#define NCI_XPORT_MAX_PAYLOAD_LEN	255
+#define NCI_XPORT_MAX_PKT_LEN	(NCI_XPORT_HDR_LEN + NCI_XPORT_MAX_PAYLOAD_LEN)
+/* Room for a few back-to-back packets */
+#define NCI_XPORT_FIFO_SIZE		2048
+/* Longer gaps between a packet and the next write are idle time */
+#define NCI_XPORT_TURNAROUND_MAX_MS	1000
+
+struct dentry;
+struct nci_xport;
+
+/**
+ * struct nci_xport_ops - chip specific part of an NCI transport
+ * @recv:	bus read of len bytes, return len or -errno
+ * @irq_level:	level of the controller IRQ line
+ * @powered:	false once the controller is off, this releases the readers
+ * @enable_irq:	arm the IRQ, the handler must call nci_xport_irq()
+ * @disable_irq: disarm the IRQ
+ * @filter:	optional, return true to consume a packet before userspace
+ *		gets it
+ */
+struct nci_xport_ops {
+	int (*recv)(struct nci_xport *xp, u8 *buf, size_t len);
+	int (*irq_level)(struct nci_xport *xp);
+	bool (*powered)(struct nci_xport *xp);
+	void (*enable_irq)(struct nci_xport *xp);
+	void (*disable_irq)(struct nci_xport *xp);
+	bool (*filter)(struct nci_xport *xp, const u8 *pkt, size_t len);
+};
+
+/**
+ * struct nci_xport_stats - packet statistics
+ * @packets:	packets given to userspace
+ * @bytes:	bytes given to userspace
+ * @batched:	packets read without waiting for a new IRQ
+ * @filtered:	packets consumed by the &nci_xport_ops.filter
+ * @spurious:	IRQs with the line low by the time the reader woke up
+ * @errors:	failed bus reads
+ */
+struct nci_xport_stats {
+	u64 packets;
+	u64 bytes;
+	u64 batched;
+	u64 filtered;
+	u64 spurious;
+	u64 errors;
+};
+
+/* Where the time of an NCI transaction goes */
+enum nci_xport_lat_id {
+	NCI_XPORT_LAT_IRQ_WAIT,		/* Waiting for the IRQ line */
+	NCI_XPORT_LAT_XFER,		/* Bus read of a packet */
+	NCI_XPORT_LAT_DELIVER,		/* IRQ to the packet read by userspace */
+	NCI_XPORT_LAT_TURNAROUND,	/* Packet read to the next write */
+	NCI_XPORT_LAT_WRITE,		/* Bus write of a packet */
+	NCI_XPORT_LAT_POWER,		/* Power sequencing */
+	NCI_XPORT_LAT_ESE_RESET,	/* eSE cold reset command to response */
+	NCI_XPORT_LAT_NR,
+};
+
+/**
+ * struct nci_xport - NCI transport shared by the NFC controller drivers
+ * @name:	transport name, for debugfs and the traces
+ * @ops:	chip callbacks
+ * @priv:	chip driver data
+ * @wq:	queue woken up by the chip IRQ handler
+ * @lock:	serializes the readers, protects the fifo and the stats
+ * @irq_fired:	set by nci_xport_irq()
+ * @irq_ts:	time of the last IRQ
+ * @flushed:	set by nci_xport_flush(), the fifo is dropped by the next read
+ * @fifo:	packets read from the bus, each behind a record header
+ * @fifo_len:	valid bytes in @fifo
+ * @rd:	offset of the record being read
+ * @pkt_off:	bytes of the record payload already read
+ * @stats:	packet statistics
+ * @lat_lock:	protects @last_rx and @lat, taken by readers and writers
+ * @last_rx:	time userspace got the last packet, 0 once a write went out
+ * @lat:	latency histograms
+ * @dir:	debugfs directory
+ */
+struct nci_xport {
+	const char *name;
+	const struct nci_xport_ops *ops;
+	void *priv;
+	wait_queue_head_t *wq;
+	struct mutex lock;
+	bool irq_fired;
+	ktime_t irq_ts;
+	bool flushed;
+	u8 *fifo;
+	size_t fifo_len;
+	size_t rd;
+	size_t pkt_off;
+	struct nci_xport_stats stats;
+	spinlock_t lat_lock;
+	ktime_t last_rx;
+	struct mmi_lat_hist lat[NCI_XPORT_LAT_NR];
+	struct dentry *dir;
+};
+
+int nci_xport_init(struct nci_xport *xp, const char *name,
+		   const struct nci_xport_ops *ops, wait_queue_head_t *wq,
+		   void *priv);
+void nci_xport_deinit(struct nci_xport *xp);
+void nci_xport_irq(struct nci_xport *xp);
+int nci_xport_wait_irq(struct nci_xport *xp, int timeout_ms);
+ssize_t nci_xport_read(struct nci_xport *xp, char __user *buf, size_t count,
+		       bool nonblock);
+bool nci_xport_has_data(struct nci_xport *xp);
+void nci_xport_flush(struct nci_xport *xp);
+void nci_xport_lat_add(struct nci_xport *xp, enum nci_xport_lat_id id,
+		       ktime_t start);
+ktime_t nci_xport_write_begin(struct nci_xport *xp);
+void nci_xport_write_end(struct nci_xport *xp, ktime_t start);
+
+#endif /* _NCI_XPORT_H_ */
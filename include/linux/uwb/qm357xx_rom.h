@@ -92,5 +92,8 @@ int qm357xx_rom_write_size_cmd(struct qmrom_handle *handle, uint8_t cmd,
 			       uint16_t data_size, const char *data);
 int qm357xx_rom_write_size_cmd32(struct qmrom_handle *handle, uint32_t cmd,
 				 uint16_t data_size, const char *data);
+void qm357xx_rom_prep_size_cmd32(struct stc *hstc, uint32_t cmd,
+				 uint16_t data_size, const char *data);
+int qm357xx_rom_write_stc(struct qmrom_handle *handle, struct stc *hstc);
 
 #endif /* __QM357XX_ROM_H__ */
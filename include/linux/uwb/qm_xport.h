@@ -0,0 +1,191 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2026 Motorola Mobility LLC
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __QM_XPORT_H_INCLUDED
+#define __QM_XPORT_H_INCLUDED
+
+#include <asm/barrier.h>
+#include <linux/errno.h>
+#include <linux/list.h>
+#include <linux/seq_file.h>
+#include <linux/types.h>
+
+/*
+ * Transport core shared by the qm35 and qm358 drivers. Header only, the
+ * two drivers are separate module sets and don't link against each other.
+ */
+
+/*
+ * Traffic classes, a class is only served once the ones before are empty:
+ * ranging traffic first, then logs, then coredump. Control entries (stop,
+ * layer removal) go before every class so that no traffic can hold them.
+ */
+enum qm_xport_class {
+	QM_XPORT_UCI = 0,
+	QM_XPORT_LOG,
+	QM_XPORT_COREDUMP,
+	QM_XPORT_NR,
+};
+
+/* Not serialized, the caller provides the locking */
+struct qm_xport_queue {
+	struct list_head ctrl;
+	struct list_head classes[QM_XPORT_NR];
+};
+
+static inline void qm_xport_queue_init(struct qm_xport_queue *q)
+{
+	int i;
+
+	INIT_LIST_HEAD(&q->ctrl);
+	for (i = 0; i < QM_XPORT_NR; i++)
+		INIT_LIST_HEAD(&q->classes[i]);
+}
+
+static inline void qm_xport_queue_add(struct qm_xport_queue *q,
+				      struct list_head *entry,
+				      enum qm_xport_class cls)
+{
+	list_add_tail(entry, &q->classes[cls]);
+}
+
+static inline void qm_xport_queue_add_ctrl(struct qm_xport_queue *q,
+					   struct list_head *entry)
+{
+	list_add_tail(entry, &q->ctrl);
+}
+
+/* Move everything queued to the control list, in class order */
+static inline void qm_xport_queue_to_ctrl(struct qm_xport_queue *q)
+{
+	int i;
+
+	for (i = 0; i < QM_XPORT_NR; i++)
+		list_splice_tail_init(&q->classes[i], &q->ctrl);
+}
+
+static inline bool qm_xport_queue_empty(const struct qm_xport_queue *q)
+{
+	int i;
+
+	if (!list_empty(&q->ctrl))
+		return false;
+	for (i = 0; i < QM_XPORT_NR; i++)
+		if (!list_empty(&q->classes[i]))
+			return false;
+	return true;
+}
+
+/*
+ * Move the control entries, or else the first non-empty class, to @batch.
+ * Return: the class taken, QM_XPORT_NR for control, -ENOENT if empty.
+ */
+static inline int qm_xport_queue_take(struct qm_xport_queue *q,
+				      struct list_head *batch)
+{
+	int i;
+
+	if (!list_empty(&q->ctrl)) {
+		list_splice_tail_init(&q->ctrl, batch);
+		return QM_XPORT_NR;
+	}
+
+	for (i = 0; i < QM_XPORT_NR; i++) {
+		if (list_empty(&q->classes[i]))
+			continue;
+		list_splice_tail_init(&q->classes[i], batch);
+		return i;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Index ring over nr slots owned by the caller. Lossy: a producer that
+ * finds it full drops its entry, or evicts the oldest one, and counts it
+ * instead of waiting for the consumer.
+ *
+ * Lockless with one producer and one consumer. The producer may only
+ * evict (qm_xport_ring_cons() then qm_xport_ring_pop()) when a lock
+ * shared with the consumer is held.
+ */
+struct qm_xport_ring {
+	unsigned int nr;
+	unsigned int head;	/* next slot to fill, written by the producer */
+	unsigned int tail;	/* next slot to consume, written by the consumer */
+	u64 received;
+	u64 dropped;
+	u64 errors;
+};
+
+static inline void qm_xport_ring_init(struct qm_xport_ring *ring,
+				      unsigned int nr)
+{
+	ring->nr = nr;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->received = 0;
+	ring->dropped = 0;
+	ring->errors = 0;
+}
+
+/* Producer: slot to fill, -ENOSPC if the ring is full */
+static inline int qm_xport_ring_prod(struct qm_xport_ring *ring)
+{
+	/* Pairs with the release in qm_xport_ring_pop() */
+	if (ring->head - smp_load_acquire(&ring->tail) >= ring->nr)
+		return -ENOSPC;
+
+	return ring->head % ring->nr;
+}
+
+/* Producer: hand the slot returned by qm_xport_ring_prod() over */
+static inline void qm_xport_ring_push(struct qm_xport_ring *ring)
+{
+	ring->received++;
+	/* Pairs with the acquire in qm_xport_ring_cons() */
+	smp_store_release(&ring->head, ring->head + 1);
+}
+
+/* Consumer: oldest filled slot, -ENOENT if the ring is empty */
+static inline int qm_xport_ring_cons(struct qm_xport_ring *ring)
+{
+	/* Pairs with the release in qm_xport_ring_push() */
+	if (ring->tail == smp_load_acquire(&ring->head))
+		return -ENOENT;
+
+	return ring->tail % ring->nr;
+}
+
+/* Consumer: hand the slot returned by qm_xport_ring_cons() back */
+static inline void qm_xport_ring_pop(struct qm_xport_ring *ring)
+{
+	/* Pairs with the acquire in qm_xport_ring_prod() */
+	smp_store_release(&ring->tail, ring->tail + 1);
+}
+
+static inline unsigned int qm_xport_ring_used(const struct qm_xport_ring *ring)
+{
+	return READ_ONCE(ring->head) - READ_ONCE(ring->tail);
+}
+
+static inline void qm_xport_ring_show(struct seq_file *s, const char *name,
+				      const struct qm_xport_ring *ring)
+{
+	seq_printf(s, "%s_received: %llu\n", name, ring->received);
+	seq_printf(s, "%s_dropped: %llu\n", name, ring->dropped);
+	seq_printf(s, "%s_errors: %llu\n", name, ring->errors);
+}
+
+#endif		/* __QM_XPORT_H_INCLUDED */
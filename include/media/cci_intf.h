@@ -49,4 +49,48 @@ struct msm_cci_intf_xfer {
 #define MSM_CCI_INTF_WRITE32 \
 	_IOWR('X', BASE_VIDIOC_PRIVATE + 51, struct msm_cci_intf_xfer)
 
+/*
+ * Session: the CCI master stays initialized from SESSION_OPEN until
+ * SESSION_CLOSE or close() of the fd, and READ/WRITE on that device and
+ * bus skip their own init/release meanwhile. SCRIPT runs up to
+ * MSM_CCI_INTF_MAX_SCRIPT entries on the session slave, back to back
+ * writes without delay going out as one CCI burst.
+ */
+#define MSM_CCI_INTF_MAX_SCRIPT 256
+/* Longest delay_us of an entry, the master is held while it elapses */
+#define MSM_CCI_INTF_MAX_DELAY_US 1000000
+
+#define MSM_CCI_INTF_OP_WRITE 0
+#define MSM_CCI_INTF_OP_READ  1
+
+struct msm_cci_intf_session {
+	unsigned short cci_device;  /* 0 = DEVICE_0, 1 = DEVICE_1 */
+	unsigned short cci_bus;     /* 0 = MASTER_0, 1 = MASTER_1 */
+	unsigned short slave_addr;  /* 7-bit addr of intended device */
+	unsigned short reg_width;   /* 1 or 2 */
+	unsigned short data_width;  /* 1, 2 or 4 */
+};
+
+struct msm_cci_intf_script_entry {
+	uint16_t op;        /* MSM_CCI_INTF_OP_* */
+	uint16_t addr;
+	uint32_t data;      /* read back for MSM_CCI_INTF_OP_READ */
+	uint32_t delay_us;  /* after this entry, up to MSM_CCI_INTF_MAX_DELAY_US */
+};
+
+struct msm_cci_intf_script {
+	uint32_t count;     /* entries, 1 to MSM_CCI_INTF_MAX_SCRIPT */
+	uint32_t done;      /* entries executed */
+	uint64_t entries;   /* struct msm_cci_intf_script_entry * */
+	uint32_t bursts;    /* CCI transactions issued */
+	uint32_t elapsed_us;
+};
+
+#define MSM_CCI_INTF_SESSION_OPEN \
+	_IOW('X', BASE_VIDIOC_PRIVATE + 52, struct msm_cci_intf_session)
+#define MSM_CCI_INTF_SESSION_CLOSE \
+	_IO('X', BASE_VIDIOC_PRIVATE + 53)
+#define MSM_CCI_INTF_SCRIPT \
+	_IOWR('X', BASE_VIDIOC_PRIVATE + 54, struct msm_cci_intf_script)
+
 #endif